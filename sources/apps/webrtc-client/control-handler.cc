@@ -12,10 +12,80 @@
 
 extern float screen_scale_factor_;
 
-std::string InputEventHandler::OnKeyboardEvent(KeyboardOptions *p_key_options) {
+namespace {
+
+// Compact control records, see "Compact Control Records" in
+// doc/control_protocol_spec.rst.
+enum RecordType : uint8_t {
+  kRecordFrameStats = 1,
+  kRecordMouseMove  = 2,
+  kRecordMouseDown  = 3,
+  kRecordMouseUp    = 4,
+  kRecordKeyDown    = 5,
+  kRecordKeyUp      = 6,
+  kRecordLatency    = 16,
+};
+
+const uint8_t kRecordHasLatency = 0x01;
+const uint8_t kRecordHasClient  = 0x02;
+const int kControlRecordVersion = 1;
+
+// Little-endian record, sent as '!' followed by its base64
+class RecordWriter {
+public:
+  RecordWriter(uint8_t type, uint8_t flags) { U8(type); U8(flags); }
+
+  void U8(uint8_t v) { buf_[size_++] = v; }
+  void U32(uint32_t v) {
+    for (int i = 0; i < 4; i++)
+      U8((uint8_t)(v >> (8 * i)));
+  }
+  void U64(uint64_t v) {
+    for (int i = 0; i < 8; i++)
+      U8((uint8_t)(v >> (8 * i)));
+  }
+
+  std::string Text() const {
+    static const char kBase64[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string text(1, '!');
+    text.reserve(1 + (size_ + 2) / 3 * 4);
+    for (size_t i = 0; i < size_; i += 3) {
+      uint32_t v = (uint32_t)buf_[i] << 16;
+      if (i + 1 < size_) v |= (uint32_t)buf_[i + 1] << 8;
+      if (i + 2 < size_) v |= buf_[i + 2];
+      text += kBase64[(v >> 18) & 63];
+      text += kBase64[(v >> 12) & 63];
+      text += i + 1 < size_ ? kBase64[(v >> 6) & 63] : '=';
+      text += i + 2 < size_ ? kBase64[v & 63] : '=';
+    }
+    return text;
+  }
+
+private:
+  uint8_t buf_[64];
+  size_t size_ = 0;
+};
+
+uint64_t ReadU64(const uint8_t *p) {
+  uint64_t v = 0;
+  for (int i = 7; i >= 0; i--)
+    v = (v << 8) | p[i];
+  return v;
+}
+
+} // namespace
+
+std::string InputEventHandler::OnKeyboardEvent(KeyboardOptions *p_key_options, bool compact) {
   WPARAM wparam = p_key_options->v_key_;
   UINT msg = p_key_options->msg_;
 
+  if (compact && (msg == WM_KEYDOWN || msg == WM_KEYUP)) {
+    RecordWriter record(msg == WM_KEYDOWN ? kRecordKeyDown : kRecordKeyUp, 0);
+    record.U32((uint32_t)wparam);
+    return record.Text();
+  }
+
   rapidjson::Document event;
   event.SetObject();
   rapidjson::Document::AllocatorType &alloc = event.GetAllocator();
@@ -46,7 +116,7 @@ std::string InputEventHandler::OnKeyboardEvent(KeyboardOptions *p_key_options) {
 }
 
 std::string InputEventHandler::OnMouseEvent(MouseOptions *p_m_options,
-                                           bool is_raw) {
+                                           bool is_raw, bool compact) {
   rapidjson::Document event;
   event.SetObject();
   rapidjson::Document::AllocatorType& alloc = event.GetAllocator();
@@ -58,6 +128,22 @@ std::string InputEventHandler::OnMouseEvent(MouseOptions *p_m_options,
   int x = (int) (((float) p_m_options->x_pos_ * screen_scale_factor_ / client_window_width) * 32767);
   int y = (int) (((float) p_m_options->y_pos_ * screen_scale_factor_ / client_window_height) * 32767);
 
+  // Wheel events stay JSON
+  if (compact && p_m_options->m_event_ != kMouseWheel) {
+    if (p_m_options->m_event_ == kMouseMove) {
+      RecordWriter record(kRecordMouseMove, 0);
+      record.U32((uint32_t)x);
+      record.U32((uint32_t)y);
+      return record.Text();
+    }
+    bool down = p_m_options->m_button_state_ == kMouseButtonDown;
+    RecordWriter record(down ? kRecordMouseDown : kRecordMouseUp, 0);
+    record.U32((uint32_t)x);
+    record.U32((uint32_t)y);
+    record.U8((uint8_t)p_m_options->m_event_);  // which: 1 left, 2 middle, 3 right
+    return record.Text();
+  }
+
   rapidjson::Value parameters(rapidjson::kObjectType);
   parameters.SetObject();
 
@@ -179,7 +265,7 @@ std::string InputEventHandler::onPointerlockchange(bool reativeMode)
   return buffer.GetString();
 }
 
-std::string InputEventHandler::OnStatsRequest(FrameStats* p_framestats)
+std::string InputEventHandler::OnStatsRequest(FrameStats* p_framestats, bool compact)
 {
     int64_t ts = p_framestats->ts;
     int64_t size = p_framestats->size;
@@ -188,6 +274,19 @@ std::string InputEventHandler::OnStatsRequest(FrameStats* p_framestats)
     int64_t p_loss = p_framestats->p_loss;
     UINT64 latencymsg = p_framestats->latencymsg_;
 
+    if (compact) {
+        RecordWriter record(kRecordFrameStats, latencymsg > 0 ? kRecordHasLatency : 0);
+        record.U32((uint32_t)ts);
+        record.U32((uint32_t)size);
+        record.U32((uint32_t)delay);
+        record.U32((uint32_t)start_delay);
+        record.U32((uint32_t)p_loss);
+        if (latencymsg > 0) {
+            record.U64(latencymsg);
+        }
+        return record.Text();
+    }
+
     rapidjson::Document event;
     event.SetObject();
     rapidjson::Document::AllocatorType& alloc = event.GetAllocator();
@@ -215,3 +314,47 @@ std::string InputEventHandler::OnStatsRequest(FrameStats* p_framestats)
     event.Accept(writer);
     return buffer.GetString();
 }
+
+std::string InputEventHandler::OnControlFormatRequest()
+{
+    rapidjson::Document event;
+    event.SetObject();
+    rapidjson::Document::AllocatorType& alloc = event.GetAllocator();
+
+    rapidjson::Value parameters(rapidjson::kObjectType);
+    parameters.SetObject();
+    parameters.AddMember("version", kControlRecordVersion, alloc);
+
+    rapidjson::Value data(rapidjson::kObjectType);
+    data.AddMember("event", "controlformat", alloc);
+    data.AddMember("parameters", parameters, alloc);
+    event.AddMember("type", "control", alloc);
+    event.AddMember("data", data, alloc);
+
+    rapidjson::StringBuffer buffer;
+    rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+    event.Accept(writer);
+    return buffer.GetString();
+}
+
+bool InputEventHandler::ParseLatencyRecord(const uint8_t *data, size_t size,
+                                           rapidjson::Document &document)
+{
+    if (size < 10 || data[0] != kRecordLatency) {
+        return false;
+    }
+    bool has_client = (data[1] & kRecordHasClient) != 0;
+    if (size != (has_client ? 34u : 10u)) {
+        return false;
+    }
+
+    document.SetObject();
+    rapidjson::Document::AllocatorType& alloc = document.GetAllocator();
+    document.AddMember("serverEncodeFrameTime", ReadU64(data + 2), alloc);
+    if (has_client) {
+        document.AddMember("clientSendLatencyTime", ReadU64(data + 10), alloc);
+        document.AddMember("serverReceivedLatencyTime", ReadU64(data + 18), alloc);
+        document.AddMember("serverRenderClientInputTime", ReadU64(data + 26), alloc);
+    }
+    return true;
+}
@@ -17,10 +17,13 @@
 #ifndef GA_CONTROL_HANDLER_H_
 #define GA_CONTROL_HANDLER_H_
 
+#include <stdint.h>
 #include <map>
 #include <string>
 #include <windows.h>
 
+#include "rapidjson/document.h"
+
 #define GA_LEGACY_INPUT 1
 #define GA_RAW_INPUT 2
 
@@ -62,13 +65,20 @@ struct FrameStats {
   UINT64 latencymsg_;
 };
 
+// With |compact| set, frame stats, mouse buttons and moves and keys are
+// encoded as compact control records, see doc/control_protocol_spec.rst.
+// Only used once the server acknowledged OnControlFormatRequest().
 class InputEventHandler {
 public:
-  static std::string OnKeyboardEvent(KeyboardOptions *p_k_options);
-  static std::string OnMouseEvent(MouseOptions *p_m_options, bool is_raw);
+  static std::string OnKeyboardEvent(KeyboardOptions *p_k_options, bool compact = false);
+  static std::string OnMouseEvent(MouseOptions *p_m_options, bool is_raw, bool compact = false);
   static std::string OnSizeChange(UINT render_w, UINT render_h);
   static std::string onPointerlockchange(bool relativeMode);
-  static std::string OnStatsRequest(FrameStats* p_framestats);
+  static std::string OnStatsRequest(FrameStats* p_framestats, bool compact = false);
+  static std::string OnControlFormatRequest();
+  // Converts a compact E2E latency side data record to its JSON form.
+  // Returns false if |data| is not such a record.
+  static bool ParseLatencyRecord(const uint8_t *data, size_t size, rapidjson::Document &document);
 };
 
 #endif // GA_CONTROL_HANDLER_H_
@@ -44,7 +44,9 @@ void GameSession::OnStreamAdded()
       m = InputEventHandler::OnSizeChange(render_width_, render_height_);
       pc_->SendMessage(m);
   }
-  //
+
+  // Step2: ask for compact control records, JSON is kept until acknowledged
+  pc_->SendMessage(InputEventHandler::OnControlFormatRequest());
 }
 void GameSession::SendSizeChange(UINT render_w, UINT render_h) {
 
@@ -63,6 +65,11 @@ void GameSession::OnDataReceivedHandler(
     return;
   }
 
+  if (ga::json::FromString(msg, "key") == "control-format") {
+    compact_control_ = true;
+    return;
+  }
+
   std::string type = ga::json::FromString(msg, "type");
   if (type == "cursor") {
     if (connect_settings_.mousestate_callback_) {
@@ -104,20 +111,20 @@ void CALLBACK GameSession::SendFrameStats(FrameStats *p_frame_stats)
 {
 
   std::string m;
-  m = InputEventHandler::OnStatsRequest(p_frame_stats);
+  m = InputEventHandler::OnStatsRequest(p_frame_stats, compact_control_);
   pc_->SendMessage(m);
 }
 
 void GameSession::SendMouseEvent(MouseOptions *p_m_options, bool is_raw) {
   std::string m;
-  m = InputEventHandler::OnMouseEvent(p_m_options, is_raw);
+  m = InputEventHandler::OnMouseEvent(p_m_options, is_raw, compact_control_);
   pc_->SendMessage(m);
 }
 
 void GameSession::SendKeyboardEvent(
     KeyboardOptions *p_key_options) {
   std::string m;
-  m = InputEventHandler::OnKeyboardEvent(p_key_options);
+  m = InputEventHandler::OnKeyboardEvent(p_key_options, compact_control_);
   pc_->SendMessage(m);
 }
 
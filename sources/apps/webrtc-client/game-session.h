@@ -21,6 +21,7 @@
 #include "ga-option.h"
 #include "stdlib.h"
 #include "control-handler.h"
+#include <atomic>
 #include <memory>
 
 #include <Windows.h>
@@ -54,5 +55,6 @@ private:
   UINT render_height_; // local display resoluiton height
   BOOL prev_pointerlock_status_; // track client cursor mode change between absolute and relatie mode
   void* gpMsg_ = nullptr;
+  std::atomic<bool> compact_control_{false}; // server acknowledged compact control records
 };
 #endif
@@ -165,7 +165,8 @@ void DXRenderer::RenderFrame(std::unique_ptr<owt::base::VideoBuffer> buffer) {
 
                     decode_duration = (handle->decode_end - handle->decode_start); // decode times are already in ms
 
-                    if (ga::json::ParseMessage(side_data_document, message)) {
+                    if (InputEventHandler::ParseLatencyRecord((const uint8_t*)handle->side_data, handle->side_data_size, side_data_document) ||
+                        ga::json::ParseMessage(side_data_document, message)) {
                         // Check if side data is corrupted. Ignore if this is the case.
                         has_side_data = true;
                     }
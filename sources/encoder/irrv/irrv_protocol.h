@@ -173,9 +173,14 @@ typedef enum _irrv_vctrl_type {
     IRRV_CTRL_SKIP_FRAME_SETTING    = 26,
     IRRV_CTRL_PROFILE_LEVEL         = 27,
     IRRV_CTRL_CLIENT_FEEDBACK       = 28,
+    IRRV_CTRL_FLIGHT_RECORDER_SNAPSHOT = 29,
     IRRV_CTRL_END
 } irrv_vctrl_type;
 
+/* Values of IRRV_CTRL_KEYFRAME_SETTING, older encoders take any of them for an IDR */
+#define IRRV_KEYFRAME_IDR       1   // new subscriber or reset decoder
+#define IRRV_KEYFRAME_RECOVERY  2   // lost frames, answered with an intra refresh wave if enabled
+
 typedef struct _irrv_rir_t {
     uint32_t reserved;
     uint32_t type;
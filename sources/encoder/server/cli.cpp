@@ -153,6 +153,20 @@ void icr_parse_args(int argc, char *argv[], encoder_info_t &info) {
         { "tcae",           required_argument,  0,  'V' }, // enable tcae
         { "user",           required_argument,  0,  'W' }, // user id for multi-user in one android session
         { "tcae_log_path",  required_argument,  0,  'X' }, // enable tcae
+        { "tcae_rc",        required_argument,  0,  'Y' }, // tcae rate controller: netpred, gcc or bbr
+        { "tcae_drop",      required_argument,  0,  'Z' }, // enable tcae frame drop
+        { "flight_recorder", required_argument, 0,  '0' }, // seconds of encoded output kept in memory
+        { "finput_format",  required_argument,  0,  '1' }, // pixel format of a raw input file
+        { "finput_fps",     required_argument,  0,  '2' }, // rate the input file is played at
+        { "finput_preload", no_argument,        0,  '3' }, // preload the input file into huge pages
+        { "thread_policy",  required_argument,  0,  '4' }, // cpu affinity and scheduling of the encoder threads
+        { "frame_pool_prealloc", required_argument, 0, '5' }, // frames preallocated for system memory surfaces
+        { "frame_pool_max", required_argument,  0,  '6' }, // max frames queued to the encoder
+        { "frame_pool_hugepages", no_argument,  0,  '7' }, // allocate frames on huge pages
+        { "adaptive_ladder", required_argument, 0,  '8' }, // resolution and framerate ladder stepped with the bitrate
+        { "adaptive_bpp",   required_argument,  0,  '9' }, // bits per pixel under which the ladder steps down
+        { "recovery_rir",   required_argument,  0,  '@' }, // frames of the intra refresh wave answering lost frames
+        { "recovery_window", required_argument, 0,  '#' }, // ms in which lost frame requests are coalesced
         { 0, 0, 0, 0 }
     };
 
@@ -310,6 +324,48 @@ void icr_parse_args(int argc, char *argv[], encoder_info_t &info) {
         case 'X':
             info.tcaeLogPath = optarg;
             break;
+        case 'Y':
+            info.tcaeRateCtrl = optarg;
+            break;
+        case 'Z':
+            info.tcaeFrameDrop = !!atoi(optarg);
+            break;
+        case '0':
+            info.flightRecorderSec = atoi(optarg);
+            break;
+        case '1':
+            info.finput_format = optarg;
+            break;
+        case '2':
+            info.finput_fps = atoi(optarg);
+            break;
+        case '3':
+            info.finput_preload = true;
+            break;
+        case '4':
+            info.thread_policy = optarg;
+            break;
+        case '5':
+            info.frame_pool_prealloc = atoi(optarg);
+            break;
+        case '6':
+            info.frame_pool_max = atoi(optarg);
+            break;
+        case '7':
+            info.frame_pool_hugepages = true;
+            break;
+        case '8':
+            info.adaptive_ladder = optarg;
+            break;
+        case '9':
+            info.adaptive_bpp = atof(optarg);
+            break;
+        case '@':
+            info.recovery_rir = atoi(optarg);
+            break;
+        case '#':
+            info.recovery_window = atoi(optarg);
+            break;
         default:
             break;
         }
@@ -427,6 +483,8 @@ void encoder_properties_sanity_check(encoder_info_t *info) {
         {ICR_ENCODER_LOG_LEVEL, &info->loglevel,                      NULL   },
         {ICR_ENCODER_PROFILE,   &info->profile,                       NULL   },
         {ICR_ENCODER_LEVEL,     &info->level,                         NULL   },
+        {ICR_ENCODER_THREAD_POLICY, &info->thread_policy,             NULL   },
+        {ICR_ENCODER_ADAPTIVE_LADDER, &info->adaptive_ladder,         NULL   },
     };
 
     for(auto prop:int_prop_table) {
@@ -523,6 +581,7 @@ void show_encoder_info(encoder_info_t *info) {
 #define Name(X) (#X)
 #define show_para_int(X) {std::string xname=Name(X);sock_log("%-30s: %d\n",xname.substr(6,xname.size()-1).c_str(), X);}
 #define show_para_str(X) {std::string xname=Name(X);sock_log("%-30s: %s\n",xname.substr(6,xname.size()-1).c_str(), X);}
+#define show_para_float(X) {std::string xname=Name(X);sock_log("%-30s: %.3f\n",xname.substr(6,xname.size()-1).c_str(), X);}
     sock_log("\nencoder_info:\n");
     show_para_int(info->nPixfmt);
     show_para_int(info->gop_size);
@@ -555,6 +614,9 @@ void show_encoder_info(encoder_info_t *info) {
     show_para_int(info->slices);
     show_para_int(info->sei);
     show_para_str(info->finput);
+    show_para_str(info->finput_format);
+    show_para_int(info->finput_fps);
+    show_para_int(info->finput_preload);
     show_para_int(info->vframe);
     show_para_str(info->foutput);
     show_para_str(info->loglevel);
@@ -577,6 +639,17 @@ void show_encoder_info(encoder_info_t *info) {
     show_para_int(info->user_id);
     show_para_int(info->tcaeEnabled);
     show_para_str(info->tcaeLogPath);
+    show_para_str(info->tcaeRateCtrl);
+    show_para_int(info->tcaeFrameDrop);
+    show_para_int(info->flightRecorderSec);
+    show_para_str(info->thread_policy);
+    show_para_int(info->frame_pool_prealloc);
+    show_para_int(info->frame_pool_max);
+    show_para_int(info->frame_pool_hugepages);
+    show_para_str(info->adaptive_ladder);
+    show_para_float(info->adaptive_bpp);
+    show_para_int(info->recovery_rir);
+    show_para_int(info->recovery_window);
 #undef Name
 #undef show_para_int
 #undef show_para_str
@@ -663,7 +736,19 @@ void icr_print_usage(const char *arg0) {
         "           range: [0, 51]\n"
         "\n"
         "       -finput path \n"
-        "           Set the local file for input \n"
+        "           Set the local file for input, played in a loop. \n"
+        "           A .y4m file, or raw frames of the stream size \n"
+        "\n"
+        "       -finput_format value \n"
+        "           Pixel format of a raw input file: rgba, bgra, nv12 or i420 \n"
+        "           rgba by default \n"
+        "\n"
+        "       -finput_fps value \n"
+        "           Play the input file at value fps, 0 (default) to feed a frame \n"
+        "           each time the encoder asks, as fast as possible \n"
+        "\n"
+        "       -finput_preload \n"
+        "           Copy the input file into huge pages before playing it \n"
         "\n"
         "       -vframe value \n"
         "           Set the dumping output number of frames for local input \n"
@@ -736,6 +821,41 @@ void icr_print_usage(const char *arg0) {
         "           enable the skip frame function \n"
         "       -plugin value\n"
         "           value could be vaapi or qsv \n"
+        "       -tcae_rc value\n"
+        "           TCAE rate controller, value could be netpred, gcc or bbr \n"
+        "           netpred is used by default. \n"
+        "       -tcae_drop value\n"
+        "           value could be 0 or 1, 1 to let TCAE drop frames \n"
+        "           when the network delay exceeds the latency budget. \n"
+        "       -flight_recorder value\n"
+        "           keep the last value seconds of encoded output in memory, \n"
+        "           written to disk on SIGUSR2 or client request. \n"
+        "           0 (disabled) by default, up to 64MB are kept. \n"
+        "       -thread_policy value\n"
+        "           CPU affinity, NUMA node and scheduling of the encoder threads, \n"
+        "           as role:setting=value:...;role:... with roles transcoder, vhal, \n"
+        "           pipe, io or all and settings cpus=<list>, node=<n|gpu>, \n"
+        "           fifo=<1-99> and nice=<-20-19>, \n"
+        "           e.g. transcoder:node=gpu:fifo=10;io:nice=10 \n"
+        "       -frame_pool_prealloc value\n"
+        "           frames allocated at start for system memory surfaces, \n"
+        "           on the NUMA node of the transcoder thread. 2 by default. \n"
+        "       -frame_pool_max value\n"
+        "           max frames queued to the encoder. 16 by default. \n"
+        "       -frame_pool_hugepages\n"
+        "           allocate the frames on 2MB huge pages. \n"
+        "       -adaptive_ladder value\n"
+        "           step the resolution and framerate down when the bitrate gets \n"
+        "           too low for them, and back up once it recovers. value is auto \n"
+        "           or the rungs as scale[@fps],... e.g. 1,0.75,0.75@30,0.5@30 \n"
+        "       -adaptive_bpp value\n"
+        "           bits per pixel under which the ladder steps down. 0.05 by default. \n"
+        "       -recovery_rir value\n"
+        "           answer the key frame requests for lost frames with an intra refresh \n"
+        "           wave of value frames instead of an IDR. 0 (IDR) by default. \n"
+        "           Losses a wave does not recover are answered with an IDR. \n"
+        "       -recovery_window value\n"
+        "           ms after an answer in which more requests are covered by it. 100 by default. \n"
         "\n",
         arg0
     );
@@ -116,6 +116,8 @@ struct char_prop {
 #define ICR_ENCODER_CLIENT_HEIGHT             "sys.icr.media_client_height"
 #define ICR_ENCODER_LOW_DELAY_BRC             "sys.icr.media_low_delay_brc"
 #define ICR_ENCODER_SKIP_FRAME                "sys.icr.media_skip_frame"
+#define ICR_ENCODER_THREAD_POLICY             "sys.icr.thread_policy"
+#define ICR_ENCODER_ADAPTIVE_LADDER           "sys.icr.adaptive_ladder"
 #define ICR_ENCODER_VIDEO_ALPHA               "sys.icr.enable_video_alpha"
 #define ICR_ENCODER_CROP_TOP                  "sys.icr.crop.top"
 #define ICR_ENCODER_CROP_BOTTOM               "sys.icr.crop.bottom"
@@ -0,0 +1,151 @@
+// Copyright (C) 2023 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions
+// and limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include <fcntl.h>
+#include <iterator>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#include "display_buffer_cache.h"
+
+#define KCMP_FILE_TYPE 0  ///< KCMP_FILE of linux/kcmp.h
+
+using namespace vhal::client;
+
+// Whether two fds are the same open file, i.e. the same dma-buf. A buffer
+// that can't be checked, kcmp missing or denied, is not taken for the
+// cached one: a wrong hit would show another buffer's content.
+bool DisplayBufferCache::sameFile(int fd1, int fd2)
+{
+#ifdef SYS_kcmp
+    long ret = syscall(SYS_kcmp, getpid(), getpid(), KCMP_FILE_TYPE, fd1, fd2);
+    if (ret >= 0)
+        return ret == 0;
+#endif
+    m_stats.unverified++;
+    return false;
+}
+
+DisplayBufferCache::~DisplayBufferCache()
+{
+    for (auto &it : m_entries)
+        close(it.second.fd);
+}
+
+disp_res_t* DisplayBufferCache::acquire(DisplayRenderer *renderer, cros_gralloc_handle_t handle)
+{
+    struct stat st;
+    int fd = handle->fds[0];
+    bool keyed = fd >= 0 && fstat(fd, &st) == 0;
+
+    if (keyed) {
+        uint64_t modifier = ((uint64_t)handle->format_modifiers[1] << 32) | handle->format_modifiers[0];
+        Key key((uint64_t)st.st_dev, (uint64_t)st.st_ino,
+                (int)handle->width, (int)handle->height, (int)handle->format, modifier,
+                (int)handle->offsets[0], (int)handle->offsets[1], (int)handle->offsets[2], (int)handle->offsets[3],
+                (int)handle->strides[0], (int)handle->strides[1], (int)handle->strides[2], (int)handle->strides[3]);
+
+        auto it = m_entries.find(key);
+        if (it != m_entries.end() && sameFile(it->second.fd, fd)) {
+            Entry &e = it->second;
+            if (e.refs++ == 0)
+                m_idle.erase(e.idle);
+            // The resource is the new handle's now, the old fds are closed
+            e.res->local_handle = &handle->base;
+            for (int i = 0; i < MAX_HANDLE_COUNT; i++)
+                e.res->prime_fds[i] = handle->fds[i];
+            m_stats.hits++;
+            return e.res;
+        }
+
+        if (it != m_entries.end() && it->second.refs == 0) {
+            // Another buffer behind an idle one's inode
+            m_idle.erase(it->second.idle);
+            m_idle.push_front(key);
+            it->second.idle = m_idle.begin();
+            evict(renderer, m_idle.size() - 1);
+            it = m_entries.end();
+        }
+
+        if (it == m_entries.end()) {
+            disp_res_t *res = renderer->createDispRes(handle);
+            if (!res)
+                return NULL;
+            m_stats.imports++;
+            m_entries[key] = Entry{ res, 1, fcntl(fd, F_DUPFD_CLOEXEC, 0), {} };
+            m_keys[res] = key;
+            return res;
+        }
+        // else in use by another buffer with the same inode, not cached
+    }
+
+    disp_res_t *res = renderer->createDispRes(handle);
+    if (res) {
+        m_stats.imports++;
+        m_stats.uncached++;
+        m_uncached.insert(res);
+    }
+    return res;
+}
+
+void DisplayBufferCache::release(DisplayRenderer *renderer, disp_res_t *res)
+{
+    if (!res)
+        return;
+
+    if (m_uncached.erase(res)) {
+        renderer->destroyDispRes(res);
+        return;
+    }
+
+    auto key = m_keys.find(res);
+    if (key == m_keys.end())
+        return;
+    Entry &e = m_entries.at(key->second);
+    if (--e.refs == 0) {
+        m_idle.push_back(key->second);
+        e.idle = std::prev(m_idle.end());
+        evict(renderer, m_maxIdle);
+    }
+}
+
+void DisplayBufferCache::clear(DisplayRenderer *renderer)
+{
+    for (auto &it : m_entries) {
+        renderer->destroyDispRes(it.second.res);
+        close(it.second.fd);
+    }
+    for (disp_res_t *res : m_uncached)
+        renderer->destroyDispRes(res);
+    m_entries.clear();
+    m_keys.clear();
+    m_idle.clear();
+    m_uncached.clear();
+}
+
+void DisplayBufferCache::evict(DisplayRenderer *renderer, size_t maxIdle)
+{
+    while (m_idle.size() > maxIdle) {
+        auto it = m_entries.find(m_idle.front());
+        renderer->destroyDispRes(it->second.res);
+        close(it->second.fd);
+        m_keys.erase(it->second.res);
+        m_entries.erase(it);
+        m_idle.pop_front();
+        m_stats.evictions++;
+    }
+}
@@ -0,0 +1,96 @@
+// Copyright (C) 2023 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions
+// and limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef _DISPLAY_BUFFER_CACHE_H_
+#define _DISPLAY_BUFFER_CACHE_H_
+
+#include <list>
+#include <map>
+#include <set>
+#include <tuple>
+
+#include "display_common.h"
+#include "display_renderer.h"
+
+/*
+ * Display resources of the buffers Android created, kept after their
+ * removal so that a buffer created again is not imported again.
+ *
+ * Android reallocates the same gralloc buffers on rotation, resolution
+ * changes or app switches, and sends them again with new fds. A buffer is
+ * recognized by the inode of its first dma-buf, with its layout (offsets,
+ * strides, modifier, size and format); the fd of the first import is kept
+ * so the inode can't be reused meanwhile.
+ *
+ * Resources are refcounted by the handles using them. Up to |maxIdle| of
+ * those without a handle are kept, the least recently used are destroyed
+ * first.
+ */
+class DisplayBufferCache {
+public :
+    struct Stats {
+        long imports = 0;      ///< resources created by the renderer
+        long hits = 0;         ///< resources reused
+        long evictions = 0;    ///< idle resources destroyed
+        long uncached = 0;     ///< buffers without an identity, imported every time
+        long unverified = 0;   ///< cached buffers that couldn't be compared, imported again
+    };
+
+    explicit DisplayBufferCache(size_t maxIdle = 8) : m_maxIdle(maxIdle) {}
+    virtual ~DisplayBufferCache();
+    DisplayBufferCache(const DisplayBufferCache&) = delete;
+    DisplayBufferCache &operator= (const DisplayBufferCache&) = delete;
+
+    /* Resource of the buffer of |handle|, imported by |renderer| if not cached, NULL if that fails */
+    disp_res_t* acquire(DisplayRenderer *renderer, vhal::client::cros_gralloc_handle_t handle);
+
+    /* Release a resource got from acquire(), it's destroyed when evicted */
+    void release(DisplayRenderer *renderer, disp_res_t *res);
+
+    /* Destroy all resources, none may be in use anymore */
+    void clear(DisplayRenderer *renderer);
+
+    const Stats &stats() const { return m_stats; }
+
+protected :
+    /* Whether |fd1| and |fd2| are the same dma-buf, false if that can't be told */
+    virtual bool sameFile(int fd1, int fd2);
+
+private :
+    typedef std::tuple<uint64_t, uint64_t,              // st_dev, st_ino
+                       int, int, int,                   // width, height, format
+                       uint64_t,                        // modifier
+                       int, int, int, int,              // offsets
+                       int, int, int, int> Key;         // strides
+
+    struct Entry {
+        disp_res_t *res;
+        int refs;
+        int fd;                                     // dup of the first dma-buf fd
+        std::list<Key>::iterator idle;              // in m_idle when refs is 0
+    };
+
+    void evict(DisplayRenderer *renderer, size_t maxIdle);
+
+    size_t m_maxIdle;
+    std::map<Key, Entry> m_entries;
+    std::map<disp_res_t*, Key> m_keys;
+    std::list<Key> m_idle;                          // least recently used first
+    std::set<disp_res_t*> m_uncached;               // resources of buffers without a key
+    Stats m_stats;
+};
+
+#endif // _DISPLAY_BUFFER_CACHE_H_
@@ -61,6 +61,9 @@ void DisplayServer::signal_handler(int signum) {
             SOCK_LOG(("%s:%d : received SIGQUIT, set event_flag to 1!\n", __func__, __LINE__));
             event_flag = 1;
             break;
+        case SIGUSR2://write flight recorder snapshot
+            irr_stream_flight_recorder_snapshot();
+            break;
     default:
         SOCK_LOG(("%s:%d : received a signal that needn't handle!\n", __func__, __LINE__));
         break;
@@ -27,6 +27,7 @@
 #include "irrv/irrv_protocol.h"
 #include "display_server_vhal.h"
 #include "display_video_renderer.h"
+#include "utils/ThreadPlacement.h"
 #include "utils/TimeLog.h"
 
 #include <stdlib.h>
@@ -72,6 +73,13 @@ bool DisplayServerVHAL::init(char *id, encoder_info_t *info)
         dev_dri = "/dev/dri/renderD128";
     int gpuid = 0;
     sscanf(dev_dri, "/dev/dri/renderD%d", &gpuid);
+
+    // before any of the encoder threads starts
+    if (ThreadPlacement::configure(info->thread_policy, dev_dri) < 0)
+    {
+        cerr << "Error: bad thread policy " << info->thread_policy << endl;
+        return false;
+    }
     
     string path;
     if (!info->hwc_sock)
@@ -107,6 +115,7 @@ bool DisplayServerVHAL::init(char *id, encoder_info_t *info)
     try {
         m_vhalReceiver = new VirtualHwcReceiver(std::move(cfg), [this](CommandType cmd, const frame_info_t* frame)
             {
+                ThreadPlacement::applyOnce(ThreadPlacement::VHAL_RECEIVER, "icr-vhal-rx");
                 CommandHandler(cmd, frame);
             });
     }
@@ -190,9 +199,14 @@ void DisplayServerVHAL::deinit()
     //list<pair<vhal::client::cros_gralloc_handle_t, disp_res_t*>>::iterator iter;
     for(auto iter = m_dispReses.begin(); iter!= m_dispReses.end();) {
         disp_res_t *dispRes = iter->second;
-        m_renderer->destroyDispRes(dispRes);
+        m_bufferCache.release(m_renderer, dispRes);
         m_dispReses.erase(iter++);
     }
+    m_bufferCache.clear(m_renderer);
+
+    const DisplayBufferCache::Stats &stats = m_bufferCache.stats();
+    cout << "Info, display buffers: " << stats.imports << " imported, " << stats.hits << " reused, "
+         << stats.evictions << " evicted, " << stats.unverified << " unverified" << endl;
     m_renderer->deinit();
     delete m_renderer;
 
@@ -201,15 +215,15 @@ void DisplayServerVHAL::deinit()
 
 void DisplayServerVHAL::CreateBuffer(cros_gralloc_handle_t handle)
 {
-    // Create DispRes
-    disp_res_t* dispRes = m_renderer->createDispRes(handle);
+    // Create DispRes, or reuse the one of a buffer created before
+    disp_res_t* dispRes = m_bufferCache.acquire(m_renderer, handle);
 
     auto ite = m_dispReses.find(handle);
     if (ite != m_dispReses.end())
     {
-        // destory the old one
+        // release the old one
         disp_res_t *old = ite->second;
-        m_renderer->destroyDispRes(old);
+        m_bufferCache.release(m_renderer, old);
         m_dispReses.erase(ite);
     }
 
@@ -232,7 +246,7 @@ void DisplayServerVHAL::RemoveBuffer(cros_gralloc_handle_t handle)
 
     if (dispRes)
     {
-        m_renderer->destroyDispRes(dispRes);
+        m_bufferCache.release(m_renderer, dispRes);
         m_dispReses.erase(handle);
     }
 
@@ -255,7 +269,8 @@ void DisplayServerVHAL::DisplayRequest(cros_gralloc_handle_t handle, vhal::clien
         irr_stream_incClient();
         irr_stream_setEncodeFlag(true);
         irr_stream_setTransmitFlag(true);
-        irr_stream_force_keyframe(1);
+        // the encoder restarts with the new resolution, an IDR anyway
+        irr_stream_force_keyframe(IRR_KEYFRAME_IDR);
     }
 
     auto ite = m_dispReses.find(handle);
@@ -307,6 +322,8 @@ void DisplayServerVHAL::CommandHandler(CommandType cmd, const vhal::client::fram
 
 int DisplayServerVHAL::PipeMsgHandler()
 {
+    ThreadPlacement::apply(ThreadPlacement::PIPE_MSG, "icr-pipe-msg");
+
     // create epoll
     int epollfd = epoll_create1(0);
     if (epollfd < 0)
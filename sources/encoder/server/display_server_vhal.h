@@ -18,6 +18,7 @@
 #define _DISPLAY_SERVER_VHAL_H_
 
 #include "display_server.h"
+#include "display_buffer_cache.h"
 #include "hwc_vhal.h"
 #include <thread>
 
@@ -42,6 +43,7 @@ protected:
     int PipeMsgHandler();
 
     std::map<vhal::client::cros_gralloc_handle_t, disp_res_t*> m_dispReses;
+    DisplayBufferCache m_bufferCache;
 
     vhal::client::VirtualHwcReceiver *m_vhalReceiver = nullptr;
 
@@ -47,6 +47,9 @@ static void inline encoder_info_init(encoder_info_t &info) {
 
     info.tcaeEnabled = true;
     info.tcaeLogPath = nullptr;
+    info.tcaeRateCtrl = nullptr;
+    info.tcaeFrameDrop = false;
+    info.flightRecorderSec = 0;
 }
 
 static void inline show_version() {
@@ -161,6 +164,7 @@ int main(int argc, char *argv[])
     sigaction(SIGINT,     &sa_usr, NULL); // Ctrl+C trigger
     sigaction(SIGTERM,    &sa_usr, NULL); // Ctrl+\ trigger
     sigaction(SIGQUIT,    &sa_usr, NULL); // kill command will trigger
+    sigaction(SIGUSR2,    &sa_usr, NULL); // flight recorder snapshot
 
     server->run();
     server->deinit();
@@ -97,13 +97,9 @@ int CCallbackMux::write(AVPacket *pPkt) {
         if (m_pRuntimeWriter && m_pRuntimeWriter->getRuntimeWriterStatus() != RUNTIME_WRITER_STATUS::STOPPED) {
             auto pkt_data = std::make_shared<IORuntimeData>();
 
-            pkt_data->type = IORuntimeDataType::SYSTEM_BLOCK_COPY;
-            pkt_data->blk.reset(new BlockData(pPkt->data, pPkt->size));
-            // pkt_data->data = pPkt->data;
-            pkt_data->size = pPkt->size;
-            pkt_data->key_frame = (pPkt->flags & AV_PKT_FLAG_KEY) ? true : false;
-
-            m_pRuntimeWriter->submitRuntimeData(RUNTIME_WRITE_MODE::OUTPUT, std::move(pkt_data));
+            // Hold a reference to the encoded packet instead of copying it
+            if (pkt_data->refPacket(pPkt) == 0)
+                m_pRuntimeWriter->submitRuntimeData(RUNTIME_WRITE_MODE::OUTPUT, std::move(pkt_data));
         }
 
         if (ret < 0) {
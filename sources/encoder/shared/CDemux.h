@@ -66,6 +66,7 @@ public:
     virtual void setMinFpsEnc(int iMinFpsEnc) { m_MinFpsEnc = iMinFpsEnc; }
     virtual int  getMinFpsEnc() { return m_MinFpsEnc; }
     virtual void setFirstStartEncoding(bool bFirstStartEncoding) { m_bFirstStartEncoding = bFirstStartEncoding; }
+    virtual void updateDynamicChangedFramerate(int framerate) { }
 
     virtual void stop() { }
 private:
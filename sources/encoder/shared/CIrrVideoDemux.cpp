@@ -196,9 +196,8 @@ int CIrrVideoDemux::readPacket(IrrPacket *irrpkt) {
             pkt_data->va_surface_id = surfaceId;
             pkt_data->type = IORuntimeDataType::VAAPI_SURFACE;
         } else {
-            pkt_data->data = irrpkt->av_pkt.data;
-            pkt_data->size = irrpkt->av_pkt.size;
-            pkt_data->type = IORuntimeDataType::SYSTEM_BLOCK;
+            // irrpkt is released before the writer thread gets to it, keep a reference
+            pkt_data->refPacket(&irrpkt->av_pkt);
         }
         pkt_data->width = m_Info.m_pCodecPars->width;
         pkt_data->height = m_Info.m_pCodecPars->height;
@@ -28,6 +28,10 @@
 #endif
 
 #include "tcae/CTcaeWrapper.h"
+#include "utils/AdaptiveLadder.h"
+#include "utils/FlightRecorder.h"
+#include "utils/IntraRecovery.h"
+#include "utils/ThreadPlacement.h"
 
 extern "C" {
 #include <libavutil/time.h>
@@ -36,6 +40,8 @@ extern "C" {
 #include <libavcodec/avcodec.h>
 #include <libavutil/opt.h>
 #include <libavutil/avstring.h>
+#include <libavutil/intreadwrite.h>
+#include <limits.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
@@ -113,6 +119,10 @@ CTransCoder::~CTransCoder() {
         delete m_MJPEGEncoder;
     if (m_tcae)
         delete m_tcae;
+    if (m_flightRecorder)
+        delete m_flightRecorder;
+    delete m_ladder;
+    delete m_recovery;
 
     av_buffer_unref(&m_phw_frames_ctx);
     delete m_pDemux;
@@ -187,6 +197,7 @@ int CTransCoder::start() {
 
     try {
         m_thread = std::thread([this] {
+            ThreadPlacement::apply(ThreadPlacement::TRANSCODER, "icr-transcoder");
             while (1) {
                 run();
                 {
@@ -798,6 +809,19 @@ int CTransCoder::doOutput(bool flush) {
                     && m_nLatencyStats) {
                 m_mEncoders[idx]->setLatencyStats(m_nLatencyStats);
             }
+
+            // The recorded stream cannot continue across an encoder restart
+            if (m_flightRecorder && pSinkInfo->m_pCodecPars->codec_type == AVMEDIA_TYPE_VIDEO) {
+                AVCodecParameters *par = m_mEncoders[idx]->getStreamInfo()->m_pCodecPars;
+                m_flightRecorder->reset(par->codec_id, par->width, par->height, (int)(m_frameRate + 0.5f));
+            }
+
+            // The first encoder gives the base of the ladder, later ones may be its rungs
+            if (m_ladder && pSinkInfo->m_pCodecPars->codec_type == AVMEDIA_TYPE_VIDEO &&
+                m_ladder->base().width == 0) {
+                AVCodecParameters *par = m_mEncoders[idx]->getStreamInfo()->m_pCodecPars;
+                m_ladder->setBase(par->width, par->height, m_frameRate);
+            }
         }
 
         if (m_screenCaptureFlag && !m_MJPEGEncoder && m_screenCaptureInterval > 0) {
@@ -835,16 +859,25 @@ int CTransCoder::doOutput(bool flush) {
                 if (m_isFramerateChange) {
                     updateDynamicChangedFramerate(idx);
                 }
-                ret = pEnc->write(pFrameEnc);
-                if (ret < 0) {
-                    if (ret != AVERROR_EOF)
-                        m_Log->Error("Failed to encode a frame. Msg: %s.\n",
-                                     m_Log->ErrToStr(ret).c_str());
-                    else
-                        m_Log->Warn("Eof detected. Exiting...\n");
+                if (m_tcaeDropFrame) {
+                    // The frame never reaches the encoder, so the next frame is
+                    // predicted from the last encoded one and the reference
+                    // chain stays intact.
+                    m_tcaeDropFrame = false;
+                    m_nTcaeDroppedFrames++;
+                    m_Log->Debug("TCAE drop frame, total dropped=%zu\n", m_nTcaeDroppedFrames);
+                } else {
+                    ret = pEnc->write(pFrameEnc);
+                    if (ret < 0) {
+                        if (ret != AVERROR_EOF)
+                            m_Log->Error("Failed to encode a frame. Msg: %s.\n",
+                                         m_Log->ErrToStr(ret).c_str());
+                        else
+                            m_Log->Warn("Eof detected. Exiting...\n");
 
-                    av_frame_free(&pFrameEnc);
-                    return ret;
+                        av_frame_free(&pFrameEnc);
+                        return ret;
+                    }
                 }
                 // av_frame_free(&pFrameEnc);
 
@@ -885,7 +918,7 @@ int CTransCoder::doOutput(bool flush) {
                          * */
                         if (likely(curEncFrames > lastEncFrames)) {
                             float fps = (curEncFrames - lastEncFrames) / dt;
-                            m_Log->Info("ICR encoder frame=%zu fps=%.2f\n", curEncFrames, fps);
+                            m_Log->Info("ICR encoder frame=%zu fps=%.2f tcae_dropped=%zu\n", curEncFrames, fps, m_nTcaeDroppedFrames);
                         }
                         m_statsStartTimeInMs = currTimeInMs;
                         lastEncFrames = curEncFrames;
@@ -907,6 +940,26 @@ int CTransCoder::doOutput(bool flush) {
 
                 pkt.stream_index = idx;
                 ret = m_pMux->write(&pkt);
+                if (m_flightRecorder && ret >= 0 &&
+                    pEnc->getStreamInfo()->m_pCodecPars->codec_type == AVMEDIA_TYPE_VIDEO) {
+                    FlightRecorder::FrameInfo info;
+                    info.timestamp_us = getUs();
+                    info.pts = pkt.pts;
+                    info.size = pkt.size;
+                    info.key_frame = pkt.flags & AV_PKT_FLAG_KEY;
+                    info.target_bitrate = m_bitrate;
+                    info.qp = m_lastQP;
+                    info.tcae_target_size = m_lastTcaeTargetSize;
+                    m_flightRecorder->push(&pkt, info);
+                }
+                if (m_ladder && ret >= 0 &&
+                    pEnc->getStreamInfo()->m_pCodecPars->codec_type == AVMEDIA_TYPE_VIDEO) {
+                    applyAdaptiveLadder(pEnc, &pkt);
+                }
+                if (m_recovery && ret >= 0 &&
+                    pEnc->getStreamInfo()->m_pCodecPars->codec_type == AVMEDIA_TYPE_VIDEO) {
+                    m_recovery->onEncoded(getUs(), pkt.size, pkt.flags & AV_PKT_FLAG_KEY);
+                }
                 if (m_nLatencyStats) {
                     m_mProfTimer["cycle_trans"]->profTimerEnd("cycle_trans", m_mPktPts[idx]);
                 }
@@ -1045,6 +1098,17 @@ void CTransCoder::dynamicSetEncParameters(CEncoder *pEnc, AVFrame *pFrame, AVFra
 
     curEncFrames = pEnc->getEncFrames();
 
+    if (m_recovery) {
+        int action = m_recovery->onFrame(getUs());
+        if (action & IntraRecovery::IDR)
+            m_forceKeyFrame = 1;
+        // the wave starts or stops with the next frame encoded, after TCAE below
+        if (action & IntraRecovery::REFRESH_START)
+            m_recoveryAction = IntraRecovery::REFRESH_START;
+        else if (action & IntraRecovery::REFRESH_STOP)
+            m_recoveryAction = IntraRecovery::REFRESH_STOP;
+    }
+
     if(m_forceKeyFrame) {
         m_Log->Info("Force key frame at framenum=%d\n", curEncFrames);
         (*pFrameEnc)->pict_type = AV_PICTURE_TYPE_I;
@@ -1060,7 +1124,18 @@ void CTransCoder::dynamicSetEncParameters(CEncoder *pEnc, AVFrame *pFrame, AVFra
     // The code that follows uses the target and max bitrates determined here
     if (m_tcaeEnabled && m_tcae)
     {
-        uint32_t targetSize = m_tcae->GetTargetSize();
+        // Never drop a requested key frame, nor count it as dropped
+        bool dropFrame = false;
+        bool mayDrop = (*pFrameEnc)->pict_type != AV_PICTURE_TYPE_I;
+        uint32_t targetSize = m_tcae->GetTargetSize(mayDrop ? &dropFrame : nullptr);
+        m_lastTcaeTargetSize = targetSize;
+
+        // Pending parameter changes below are left for the next encoded frame
+        if (dropFrame) {
+            m_tcaeDropFrame = true;
+            return;
+        }
+
         if (targetSize > 0 && m_qsvPlugin && !m_tcae->LogsOnlyMode())
         {
             // Ensure LowDelayBRC is on
@@ -1080,6 +1155,7 @@ void CTransCoder::dynamicSetEncParameters(CEncoder *pEnc, AVFrame *pFrame, AVFra
 
     if(m_setQP) {
         m_Log->Info("set qp at framenum=%d, qp=%d\n", curEncFrames, m_setQP);
+        m_lastQP = m_setQP;
 #ifdef FFMPEG_v42
         AVFrameSideData *fside = av_frame_get_side_data((*pFrameEnc), AV_FRAME_DATA_CONFIG_QP);
         if (NULL == fside) {
@@ -1186,6 +1262,35 @@ void CTransCoder::dynamicSetEncParameters(CEncoder *pEnc, AVFrame *pFrame, AVFra
         m_setRIR = false;
     }
 
+#ifdef FFMPEG_v42
+    if (m_recoveryAction) {
+        // One wave over the recovery cycle, then back to the rolling intra refresh set, if any
+        int type = 0, cycle_size = 0;
+        if (m_recoveryAction == IntraRecovery::REFRESH_START) {
+            type = m_IntRefType == 2 ? 2 : 1;
+            cycle_size = m_recovery->cycle();
+        } else if (m_IntRefType == 1 || m_IntRefType == 2) {
+            type = m_IntRefType;
+            cycle_size = m_IntRefCycleSize;
+        }
+        m_Log->Debug("set recovery RIR at framenum=%d, type=%d, cycle_size=%d\n", curEncFrames, type, cycle_size);
+
+        AVRollingIntraRefresh rir_config = {static_cast<uint16_t>(type), static_cast<uint16_t>(cycle_size),
+                                            static_cast<uint8_t>(type ? m_IntRefQPDelta : 0)};
+
+        AVFrameSideData *fside = av_frame_get_side_data((*pFrameEnc), AV_FRAME_DATA_RIR_FRAME);
+        if (NULL == fside) {
+            fside = av_frame_new_side_data((*pFrameEnc), AV_FRAME_DATA_RIR_FRAME, sizeof(AVRollingIntraRefresh));
+        }
+        if (fside) {
+            memcpy(fside->data, &rir_config, sizeof(AVRollingIntraRefresh));
+        } else {
+            m_Log->Warn("Failed to set recovery RIR side-data \n");
+        }
+        m_recoveryAction = 0;
+    }
+#endif
+
     if(m_setROI) {
 #ifdef FFMPEG_v42
         m_Log->Info("set regions of interest at frame_number: %d with following parameters:\n", curEncFrames);
@@ -1378,6 +1483,12 @@ void CTransCoder::updateFrameSkipped() {
 }
 
 int CTransCoder::forceKeyFrame(int force) {
+    // AV1 has no rolling intra refresh here, recovery takes an IDR there too
+    if (m_recovery && force) {
+        m_recovery->request(getUs(), force != IRR_KEYFRAME_RECOVERY || m_nCodecId == AV_CODEC_ID_AV1);
+        return 0;
+    }
+
     m_forceKeyFrame = force;
     m_setDynamicEncode = true;
     m_DyEncodeTimeLog->begin("IRRB_Dynamic_Encode_ForceKeyFrame_setting");
@@ -1409,6 +1520,11 @@ int CTransCoder::setMaxBitrate(int max_bitrate) {
 
 
 int CTransCoder::setFramerate(float framerate) {
+    if (m_ladder) {
+        AdaptiveLadder::Step base = m_ladder->base();
+        if (base.width > 0)
+            rebaseAdaptiveLadder(base.width, base.height, framerate);
+    }
     m_setFramerate = framerate;
     m_frameRate    = framerate;
     m_setDynamicEncode = true;
@@ -1493,6 +1609,10 @@ int CTransCoder::changeResolution(int width, int height) {
     m_isResolutionChange = true;
     m_newWidth  = width;
     m_newHeight = height;
+    if (m_ladder) {
+        AdaptiveLadder::Step base = m_ladder->base();
+        rebaseAdaptiveLadder(width, height, base.width > 0 ? base.fps : m_frameRate);
+    }
     return 0;
 }
 
@@ -1964,7 +2084,7 @@ int CTransCoder::setClientFeedback(unsigned int delay, unsigned int size) {
     return 0;
 }
 
-bool CTransCoder::enableTcae(const char* tcaeLogPath)
+bool CTransCoder::enableTcae(const char* tcaeLogPath, const char* tcaeRateCtrl, bool tcaeFrameDrop)
 {
     m_tcae = new CTcaeWrapper();
     if (m_tcae)
@@ -1984,7 +2104,14 @@ bool CTransCoder::enableTcae(const char* tcaeLogPath)
         if (tcaeLogPath)
             m_tcae->setTcaeLogPath(tcaeLogPath);
 
-        int ret = m_tcae->Initialize(100, maxSize); // 100ms latency as results of experiments
+        tcaeRateController rateCtrl = TCAE_RC_NETPRED;
+        if (tcaeRateCtrl && !GetRateControllerByName(tcaeRateCtrl, &rateCtrl))
+        {
+            m_Log->Warn("CTransCoder::enableTcae: unknown rate controller %s, use netpred\n", tcaeRateCtrl);
+            rateCtrl = TCAE_RC_NETPRED;
+        }
+
+        int ret = m_tcae->Initialize(100, maxSize, rateCtrl, tcaeFrameDrop); // 100ms latency as results of experiments
         if (ret < 0)
         {
             delete m_tcae;
@@ -2009,6 +2136,129 @@ bool CTransCoder::enableTcae(const char* tcaeLogPath)
     return m_tcaeEnabled;
 }
 
+void CTransCoder::enableFlightRecorder(int seconds, const char *prefix)
+{
+    delete m_flightRecorder;
+    m_flightRecorder = nullptr;
+
+    if (seconds > 0)
+        m_flightRecorder = new FlightRecorder(seconds, FLIGHT_RECORDER_MAX_BYTES, prefix);
+}
+
+int CTransCoder::requestFlightRecorderSnapshot()
+{
+    // Also called from signal handlers, nothing but an atomic store here
+    if (!m_flightRecorder)
+        return -ENOENT;
+
+    m_flightRecorder->requestSnapshot();
+    return 0;
+}
+
+int CTransCoder::enableAdaptiveLadder(const char *spec, float bpp_floor, int min_size)
+{
+    AdaptiveLadder::Params params;
+    if (bpp_floor > 0)
+        params.bppFloor = bpp_floor;
+    // AV1 reports a quantizer index, not a QP, the bitrate alone decides
+    if (m_nCodecId == AV_CODEC_ID_AV1)
+        params.qpHigh = INT_MAX;
+
+    AdaptiveLadder *ladder = new AdaptiveLadder();
+    int ret = ladder->init(spec, params, min_size);
+    if (ret < 0) {
+        delete ladder;
+        return ret;
+    }
+
+    delete m_ladder;
+    m_ladder = ladder;
+    m_Log->Info("Adaptive resolution and framerate ladder \"%s\" enabled, floor %.3f bits per pixel\n",
+                spec ? spec : "auto", params.bppFloor);
+    return 0;
+}
+
+int CTransCoder::enableIntraRecovery(int cycle, int window_ms)
+{
+#ifdef FFMPEG_v42
+    if (cycle <= 0)
+        return AVERROR(EINVAL);
+
+    delete m_recovery;
+    m_recovery = new IntraRecovery(cycle, window_ms);
+    m_Log->Info("Lost frames are answered with intra refresh waves of %d frames, requests within %d ms coalesced\n",
+                cycle, window_ms > 0 ? window_ms : INTRA_RECOVERY_DEFAULT_WINDOW_MS);
+    return 0;
+#else
+    m_Log->Warn("This ffmpeg version doesn't support setting dynamic RIR!\n");
+    return AVERROR(ENOSYS);
+#endif
+}
+
+// The client or the application asked for another resolution or framerate,
+// the ladder starts again from there at its top rung
+void CTransCoder::rebaseAdaptiveLadder(int width, int height, float framerate)
+{
+    AdaptiveLadder::Step cur = m_ladder->current();
+    AdaptiveLadder::Step top;
+    if (!m_ladder->setBase(width, height, framerate, &top))
+        return;
+
+    // undo the size and the framerate of the lower rung, the ladder only
+    // steps again when its rung changes
+    if (top.width != cur.width || top.height != cur.height) {
+        m_newWidth  = top.width;
+        m_newHeight = top.height;
+        m_isResolutionChange = true;
+    }
+    if (top.fps != cur.fps && !m_setFramerate) {
+        m_setFramerate = framerate;
+        m_frameRate    = framerate;
+        m_setDynamicEncode = true;
+        setOutputProp("r", std::to_string(framerate).c_str());
+        m_pDemux->updateDynamicChangedFramerate((int)framerate);
+    }
+}
+
+void CTransCoder::applyAdaptiveLadder(CEncoder *pEnc, const AVPacket *pkt)
+{
+    // The budget is what TCAE gives the frame, else the bitrate set
+    int budget = m_bitrate;
+    if (m_tcaeEnabled && m_tcae && !m_tcae->LogsOnlyMode() && m_lastTcaeTargetSize > 0)
+        budget = (int)FFMIN(m_lastTcaeTargetSize * 8.0 * m_frameRate, INT_MAX);
+
+    // Encoders exporting their quality give the QP as a lambda
+    int qp = -1;
+    int sdSize = 0;
+    uint8_t *sd = av_packet_get_side_data(pkt, AV_PKT_DATA_QUALITY_STATS, &sdSize);
+    if (sd && sdSize >= 4)
+        qp = AV_RL32(sd) / FF_QP2LAMBDA;
+
+    AdaptiveLadder::Step step;
+    if (!m_ladder->update(getUs(), pkt->size, budget, qp, &step))
+        return;
+
+    // A new resolution restarts the filter and the encoder on the next frame,
+    // which is then an IDR. The framerate changes without a new GOP.
+    AVCodecParameters *par = pEnc->getStreamInfo()->m_pCodecPars;
+    if (step.width != par->width || step.height != par->height) {
+        m_newWidth  = step.width;
+        m_newHeight = step.height;
+        m_isResolutionChange = true;
+    }
+
+    if (step.fps != m_frameRate) {
+        m_setFramerate = step.fps;
+        m_frameRate    = step.fps;
+        m_setDynamicEncode = true;
+        m_DyEncodeTimeLog->begin("IRRB_Dynamic_Encode_Framerate_setting");
+        setOutputProp("r", std::to_string(step.fps).c_str());
+        m_pDemux->updateDynamicChangedFramerate((int)(step.fps + 0.5f));
+        if (m_tcaeEnabled && m_tcae)
+            m_tcae->SetFps(step.fps);
+    }
+}
+
 
 
 void CTransCoder::setRenderFpsEncFlag(bool bRenderFpsEnc) {
@@ -32,6 +32,9 @@
 #include "utils/TimeLog.h"
 
 class CTcaeWrapper;
+class FlightRecorder;
+class AdaptiveLadder;
+class IntraRecovery;
 class CTransLog;
 class CDecoder;
 class CFilter;
@@ -45,6 +48,7 @@ class CEncoder;
 
 #define DEFAULT_SCREEN_CAPTURE_QUALITY 80
 #define SIZE_CHANGE_THRESHOLD 5000
+#define FLIGHT_RECORDER_MAX_BYTES  (64 << 20)
 
 using getTranscoderRunAllowedFlag = std::function<bool(void)>;
 using getTranscoderClientsNum = std::function<int(void)>;
@@ -244,11 +248,26 @@ public:
     inline void EnableVaapiPlugin() { m_vaapiPlugin = true; m_qsvPlugin = false; }
     inline void EnableQsvPlugin() { m_qsvPlugin = true; m_vaapiPlugin = false; }
 
-    bool enableTcae(const char* tcaeLogPath = nullptr);
+    bool enableTcae(const char* tcaeLogPath = nullptr, const char* tcaeRateCtrl = nullptr, bool tcaeFrameDrop = false);
 
     /* set size and delay from client feedback */
     int setClientFeedback(unsigned int delay, unsigned int size);
 
+    /* keep the last seconds of encoded output in memory, 0 to disable */
+    void enableFlightRecorder(int seconds, const char *prefix);
+
+    /* write the flight recorder content to disk on the next encoded frame,
+     * async-signal-safe */
+    int requestFlightRecorderSnapshot();
+
+    /* step the resolution and framerate down and up with the bitrate budget,
+     * see AdaptiveLadder. Rungs smaller than min_size are left out. */
+    int enableAdaptiveLadder(const char *spec, float bpp_floor, int min_size);
+
+    /* answer key frame requests for lost frames with intra refresh waves of
+     * cycle frames, coalescing those within window_ms, see IntraRecovery */
+    int enableIntraRecovery(int cycle, int window_ms);
+
     void setRenderFpsEncFlag(bool bRenderFpsEnc);
     bool getRenderFpsEncFlag(void);
 
@@ -271,6 +290,9 @@ private:
     void updateFrameSkipped();
 
 private:
+    void rebaseAdaptiveLadder(int width, int height, float framerate);
+    void applyAdaptiveLadder(CEncoder *pEnc, const AVPacket *pkt);
+
     CDemux                   *m_pDemux = nullptr;
     std::map<int, CDecoder *> m_mDecoders;
     std::map<int, CFilter *>  m_mFilters;
@@ -380,6 +402,17 @@ private:
 
     CTcaeWrapper *m_tcae = nullptr;
     bool m_tcaeEnabled = false;
+    bool m_tcaeDropFrame = false;      ///< current frame is dropped by TCAE and not submitted to encoder
+    size_t m_nTcaeDroppedFrames = 0;
+    uint32_t m_lastTcaeTargetSize = 0;
+
+    FlightRecorder *m_flightRecorder = nullptr;
+    int m_lastQP = 0;                  ///< last QP requested by client, for the flight recorder
+
+    AdaptiveLadder *m_ladder = nullptr;
+
+    IntraRecovery *m_recovery = nullptr;
+    int m_recoveryAction = 0;          ///< IntraRecovery actions left for the next encoded frame
 };
 
 #endif /* CTRANSCODER_H */
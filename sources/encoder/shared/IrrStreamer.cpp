@@ -16,8 +16,13 @@
 
 #include "IrrStreamer.h"
 
-#ifdef ENABLE_MEMSHARE
+extern "C" {
+#include <libavutil/pixdesc.h>
+}
+
 #include "CFFEncoder.h"
+#include "utils/ThreadPlacement.h"
+#ifdef ENABLE_MEMSHARE
 #include "CEncoder.h"
 #endif
 
@@ -42,8 +47,12 @@ void IrrStreamer::Unregister()
 
 IrrStreamer::IrrStreamer(int id, int w, int h, float framerate) : CTransLog(__func__){
     m_nPixfmt    = AV_PIX_FMT_RGBA;
+    m_nSurfacePixfmt = AV_PIX_FMT_RGBA;
     m_nMaxPkts   = 5;
     m_nCurPkts   = 0;
+    m_nPoolPrealloc = 2;
+    m_nPoolMax   = 16;
+    m_bPoolHugePages = false;
     m_pTrans     = nullptr;
     m_pMux       = nullptr;
     m_pDemux     = nullptr;
@@ -72,6 +81,23 @@ IrrStreamer::~IrrStreamer() {
     stop();
     av_buffer_unref(&m_hw_frames_ctx);
     av_buffer_pool_uninit(&m_pPool);
+    delete m_pFramePool;
+    delete m_pConverter;
+}
+
+/*
+ * Format system memory frames are converted to for the encoder |codec|,
+ * as picked by CTransCoder. Hardware encoders upload NV12.
+ */
+static AVPixelFormat get_convert_format(const char *codec)
+{
+    if (!codec)
+        return AV_PIX_FMT_NV12;
+
+    int fmt = CFFEncoder::GetBestFormat(codec, AV_PIX_FMT_NV12);
+    if (fmt == AV_PIX_FMT_VAAPI || fmt == AV_PIX_FMT_QSV)
+        return AV_PIX_FMT_NV12;
+    return (AVPixelFormat)fmt;
 }
 
 static inline const char* get_codec_name(AVCodecID id)
@@ -100,9 +126,35 @@ int IrrStreamer::start(IrrStreamInfo *param) {
 
     float frameRate = atoi(param->framerate) ? atoi(param->framerate) : m_fFramerate;
     if(param->pix_format== (int)AV_PIX_FMT_BGRA){
-        m_nPixfmt    = (AVPixelFormat)param->pix_format;
+        m_nSurfacePixfmt = (AVPixelFormat)param->pix_format;
+    }
+    m_nPixfmt = m_nSurfacePixfmt;
+    if (m_pWriter && m_pWriter->hasInputStream()) {
+        m_nPixfmt    = m_pWriter->getInputFormat();
+    } else if (!m_bVASurface && !m_bQSVSurface) {
+        // System memory surfaces are converted while copied into packets,
+        // rather than copied as they are and converted by the filters.
+        AVPixelFormat fmt = get_convert_format(param->codec);
+        if (RgbToYuv::isSupported(m_nSurfacePixfmt, fmt, m_nWidth, m_nHeight)) {
+            if (!m_pConverter)
+                m_pConverter = new RgbToYuv();
+            m_nPixfmt = fmt;
+            Info("Convert %s surfaces to %s\n", av_get_pix_fmt_name(m_nSurfacePixfmt), av_get_pix_fmt_name(fmt));
+        }
     }
 
+    if (param->frame_pool_max > 0)
+        m_nPoolMax = param->frame_pool_max;
+    if (param->frame_pool_prealloc > 0)
+        m_nPoolPrealloc = param->frame_pool_prealloc;
+    m_bPoolHugePages = param->frame_pool_hugepages;
+#ifndef ENABLE_MEMSHARE
+    // Packets of system memory surfaces are copied into frames allocated
+    // now rather than on the first surfaces.
+    if (!(m_pWriter && m_pWriter->hasInputStream()) && !m_bVASurface && !m_bQSVSurface)
+        InitFramePool(m_nWidth, m_nHeight, m_nPoolPrealloc);
+#endif
+
     //Create a pkt with blank frame to initialize CIrrVideoDemux::m_Pkt
     IrrPacket pkt;
     if (InitBlankFramePacket(pkt) != 0) {
@@ -245,7 +297,7 @@ int IrrStreamer::start(IrrStreamInfo *param) {
 
     if (param->tcaeEnabled)
     {
-        m_tcaeEnabled = m_pTrans->enableTcae(param->tcaeLogPath);
+        m_tcaeEnabled = m_pTrans->enableTcae(param->tcaeLogPath, param->tcaeRateCtrl, param->tcaeFrameDrop);
     }
 
     if (m_tcaeEnabled)
@@ -256,6 +308,23 @@ int IrrStreamer::start(IrrStreamInfo *param) {
     if (m_pWriter)
         m_pTrans->setIOStreamWriter(m_pWriter);
 
+    m_pTrans->enableFlightRecorder(param->flightRecorderSec,
+    #if defined(ANDROID) || defined(__ANDROID__)
+        "/data/"
+    #else
+        "./"
+    #endif
+    );
+
+    // The smallest size all codecs take, the codec may be changed later
+    if (param->adaptive_ladder &&
+        m_pTrans->enableAdaptiveLadder(param->adaptive_ladder, param->adaptive_bpp, MIN_RESOLUTION_VALUE_HEVC) < 0)
+        Warn("%s : %d : invalid adaptive ladder \"%s\", ignored\n", __func__, __LINE__, param->adaptive_ladder);
+
+    if (param->recovery_rir > 0 &&
+        m_pTrans->enableIntraRecovery(param->recovery_rir, param->recovery_window) < 0)
+        Warn("%s : %d : no intra refresh recovery, lost frames are answered with IDRs\n", __func__, __LINE__);
+
     auto runtime_writer = std::make_shared<IORuntimeWriter>(
         m_nCodecId
     #if defined(ANDROID) || defined(__ANDROID__)
@@ -271,12 +340,22 @@ int IrrStreamer::start(IrrStreamInfo *param) {
 
     m_pRuntimeWriter = std::move(runtime_writer);
 
-    return m_pTrans->start();
+    int ret = m_pTrans->start();
+    if (ret == 0 && m_pWriter)
+        ret = m_pWriter->startInput();
+
+    return ret;
 }
 
 void IrrStreamer::stop() {
+    // A paced input clip calls write(), stop it before taking m_Lock.
+    if (m_pWriter)
+        m_pWriter->stopInput();
+
     lock_guard<mutex> lock(m_Lock);
     m_pTrans->stop();
+    if (m_pFramePool)
+        m_pFramePool->logStats();
     delete m_pTrans;
     m_pTrans = nullptr;
     ///< Demux will be released by CTransCoder's deconstuctor.
@@ -298,10 +377,16 @@ int IrrStreamer::generate_packet(irr_surface_t* surface, IrrPacket& pkt)
         return AVERROR(EINVAL);
     }
 
+#ifdef ENABLE_MEMSHARE
+    if (m_pPool && m_nPoolPixfmt != m_nPixfmt) {
+        av_buffer_pool_uninit(&m_pPool);
+    }
+
     if (!m_pPool) {
         size_t size = av_image_get_buffer_size(m_nPixfmt, surface->info.width, surface->info.height, 32);
 
         m_pPool = av_buffer_pool_init2(size, this, m_BufAlloc, nullptr);
+        m_nPoolPixfmt = m_nPixfmt;
     }
 
     if (!m_pPool) {
@@ -310,6 +395,16 @@ int IrrStreamer::generate_packet(irr_surface_t* surface, IrrPacket& pkt)
     }
 
     AVBufferRef *pBuf = av_buffer_pool_get(m_pPool);
+#else
+    size_t size = av_image_get_buffer_size(m_nPixfmt, surface->info.width, surface->info.height, 32);
+    if (!m_pFramePool || m_nPoolPixfmt != m_nPixfmt || m_pFramePool->frameSize() != size) {
+        // Only a surface handle is written into the frames of VA and QSV surfaces
+        bool handles = surface->encode_type == QSVSURFACE_ID || surface->encode_type == VASURFACE_ID;
+        InitFramePool(surface->info.width, surface->info.height, handles ? 0 : m_nPoolPrealloc);
+    }
+
+    AVBufferRef *pBuf = m_pFramePool->get();
+#endif
     if (!pBuf) {
         Error("no free buffer in buffer pool now!\n");
         return AVERROR(ENOMEM);
@@ -324,6 +419,20 @@ int IrrStreamer::generate_packet(irr_surface_t* surface, IrrPacket& pkt)
         memcpy(pBuf->data, &(surface->mfxSurf), sizeof(void*)); // sizeof(mfxFrameSurface1*)
     } else if (surface->encode_type == VASURFACE_ID) {
         memcpy(pBuf->data, &(surface->vaSurfaceID), sizeof(VASurfaceID));
+    } else if (m_nPixfmt != m_nSurfacePixfmt && m_pConverter) {
+        // Planes packed as the rawvideo decoder expects them
+        uint8_t *dst[4];
+        int dst_stride[4];
+        int w = surface->info.width;
+        int h = surface->info.height;
+
+        av_image_fill_arrays(dst, dst_stride, pBuf->data, m_nPixfmt, w, h, 1);
+        int ret = m_pConverter->convert(surface->info.pdata, w * 4, m_nSurfacePixfmt, w, h,
+                                        surface->flip_image, dst, dst_stride, m_nPixfmt);
+        if (ret < 0) {
+            av_buffer_unref(&pBuf);
+            return ret;
+        }
     } else {
         int stride = surface->info.width * 4;
         int h = surface->info.height;
@@ -367,6 +476,31 @@ int IrrStreamer::write(irr_surface_t* surface) {
     return m_pDemux->sendPacket(&pkt);
 }
 
+int IrrStreamer::write(AVBufferRef *frame) {
+    // Takes the reference to |frame|, which holds one frame of m_nPixfmt and
+    // is passed to the decoder as it is, without a copy.
+    std::unique_lock<mutex> lock(m_Lock);
+
+    if (!frame) {
+        return AVERROR(EINVAL);
+    }
+
+    if (!m_pDemux) {
+        Error("%s : %d : fail to get Demux!\n", __func__, __LINE__);
+        av_buffer_unref(&frame);
+        return AVERROR(EINVAL);
+    }
+
+    IrrPacket pkt;
+    av_init_packet(&pkt.av_pkt);
+    pkt.av_pkt.buf  = frame;
+    pkt.av_pkt.data = frame->data;
+    pkt.av_pkt.size = frame->size;
+    pkt.av_pkt.stream_index = 0;
+
+    return m_pDemux->sendPacket(&pkt);
+}
+
 #ifdef ENABLE_MEMSHARE
 static void freeAvBuffer(void *opaque, uint8_t *data) {
     AVFrame *hw_frame = (AVFrame *)opaque;
@@ -492,18 +626,15 @@ void IrrStreamer::hwframe_ctx_init(){
 #endif
 
 #ifndef ENABLE_MEMSHARE
-#ifdef FFMPEG_v42
-AVBufferRef* IrrStreamer::m_BufAlloc(void *opaque, int size) {
-#else
-AVBufferRef* IrrStreamer::m_BufAlloc(void *opaque, size_t size) {
-#endif
-    IrrStreamer *pThis = static_cast<IrrStreamer*> (opaque);
-
-    /* Check if the number of packets reaches the limit */
-    if (pThis->m_nCurPkts >= pThis->m_nMaxPkts)
-        return nullptr;
+int IrrStreamer::InitFramePool(int width, int height, int prealloc) {
+    size_t size = av_image_get_buffer_size(m_nPixfmt, width, height, 32);
 
-    return av_buffer_alloc(size);
+    if (!m_pFramePool)
+        m_pFramePool = new FramePool();
+    m_nPoolPixfmt = m_nPixfmt;
+    // on the node of the encode thread, which reads the frames
+    return m_pFramePool->init(size, prealloc, m_nPoolMax, ThreadPlacement::roleNode(ThreadPlacement::TRANSCODER),
+                              m_bPoolHugePages && prealloc > 0);
 }
 #endif
 #ifdef ENABLE_MEMSHARE
@@ -537,7 +668,7 @@ int IrrStreamer::force_key_frame(int force_key_frame) {
     }
 
     if(force_key_frame) {
-        m_pTrans->forceKeyFrame(1);
+        m_pTrans->forceKeyFrame(force_key_frame);
     }
 
     return 0;
@@ -851,6 +982,7 @@ void IrrStreamer::set_screen_capture_quality(int quality_factor) {
 }
 
 void IrrStreamer::set_iostream_writer_params(const char *input_file, const int width, const int height,
+                                             const char *input_format, const int input_fps, const bool input_preload,
                                              const char *output_file, const int output_frame_number) {
     lock_guard<mutex> lock(m_Lock);
 
@@ -860,18 +992,22 @@ void IrrStreamer::set_iostream_writer_params(const char *input_file, const int w
     IOStreamWriter *writer = new IOStreamWriter();
 
     if (input_file) {
-        int frame_size = width * height * 4; // assume 32bpp
-        auto foo = [this](const int w, const int h, const void *p, const int f) {
-            irr_surface_t surface{};
-            surface.info.width = w;
-            surface.info.height = h;
-            surface.info.pdata = (unsigned char*)p;
-            surface.flip_image = f;
-            surface.encode_type = DATA_BUFFER;
-            write(&surface);
+        AVPixelFormat format = AV_PIX_FMT_RGBA;
+        if (input_format) {
+            format = strcmp(input_format, "i420") ? av_get_pix_fmt(input_format) : AV_PIX_FMT_YUV420P;
+        }
+
+        auto foo = [this](AVBufferRef *frame) {
+            write(frame);
         };
 
-        writer->setInputStream(input_file, frame_size, width, height, foo);
+        if (writer->setInputStream(input_file, width, height, format, input_fps, input_preload, foo) == 0 &&
+            (writer->getInputWidth() != m_nWidth || writer->getInputHeight() != m_nHeight)) {
+            Error("Input file is %dx%d, the stream %dx%d, ignore it\n",
+                  writer->getInputWidth(), writer->getInputHeight(), m_nWidth, m_nHeight);
+            delete writer;
+            writer = new IOStreamWriter();
+        }
     }
 
 #ifdef BUILD_FOR_HOST
@@ -899,6 +1035,14 @@ int IrrStreamer::set_client_feedback(unsigned int delay, unsigned int size)
         return 0;
 }
 
+int IrrStreamer::flight_recorder_snapshot()
+{
+    if (!m_pTrans)
+        return -ENAVAIL;
+
+    return m_pTrans->requestFlightRecorderSnapshot();
+}
+
 std::string getStringResolution(int width, int height) {
     return std::to_string(width) + "x" + std::to_string(height);
 }
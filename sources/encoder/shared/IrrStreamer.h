@@ -27,7 +27,9 @@
 #include "CIrrVideoDemux.h"
 #include "CTransCoder.h"
 #include "utils/IOStreamWriter.h"
+#include "utils/FramePool.h"
 #include "utils/IORuntimeWriter.h"
+#include "utils/RgbToYuv.h"
 #include "irrv/irrv_protocol.h"
 
 #define MIN_RESOLUTION_VALUE_H264 32
@@ -48,6 +50,7 @@ public:
     int   start(IrrStreamInfo *param);
     void  stop();
     int   write(irr_surface_t* surface);
+    int   write(AVBufferRef *frame);
     int   generate_packet(irr_surface_t* surface, IrrPacket& pkt);
     int   force_key_frame(int force_key_frame);
     int   set_qp(int qp);
@@ -73,9 +76,11 @@ public:
     void  set_screen_capture_interval(int captureInterval);
     void  set_screen_capture_quality(int quality_factor);
     void  set_iostream_writer_params(const char *input_file, const int width, const int height,
+                                     const char *input_format, const int input_fps, const bool input_preload,
                                      const char *output_file, const int output_frame_number);
 
     int   set_client_feedback(unsigned int delay, unsigned int size);
+    int   flight_recorder_snapshot();
 
     void setVASurfaceFlag(bool bVASurfaceID);
     bool getVASurfaceFlag();
@@ -132,9 +137,16 @@ private:
     IOStreamWriter *m_pWriter;
     IORuntimeWriter::Ptr m_pRuntimeWriter;
     AVBufferPool  *m_pPool = nullptr;
+    FramePool     *m_pFramePool = nullptr;
+    AVPixelFormat  m_nPoolPixfmt = AV_PIX_FMT_NONE;
     int            m_nMaxPkts;   ///< Max number of cached frames
+    int            m_nPoolPrealloc;  ///< frames preallocated and kept by m_pFramePool
+    int            m_nPoolMax;       ///< frames allocated at most by m_pFramePool
+    bool           m_bPoolHugePages;
     int            m_nCurPkts;
-    AVPixelFormat  m_nPixfmt;
+    AVPixelFormat  m_nPixfmt;         ///< format of the packets sent to the demux
+    AVPixelFormat  m_nSurfacePixfmt;  ///< format of system memory surfaces
+    RgbToYuv      *m_pConverter = nullptr;
     int            m_nWidth, m_nHeight;
     int            m_nCodecId;
     float          m_fFramerate;
@@ -155,6 +167,7 @@ private:
     irr_surface_t* m_blankSurface = nullptr;
 
     int InitBlankFramePacket(IrrPacket& pkt);
+    int InitFramePool(int width, int height, int prealloc);
     int DeinitBlankFramePacket();
 
 #ifdef FFMPEG_v42
@@ -185,6 +185,16 @@ struct IrrStreamInfo {
     bool bQSVSurface;          ///< Is QSV Surface used
     bool tcaeEnabled;          ///< Is TCAE enabled
     const char *tcaeLogPath;   ///< TCAE log file path
+    const char *tcaeRateCtrl;  ///< TCAE rate controller name
+    bool tcaeFrameDrop;        ///< Is TCAE frame drop enabled
+    int flightRecorderSec;     ///< Flight recorder length in seconds, 0 to disable
+    int frame_pool_prealloc;   ///< Frames preallocated for system memory surfaces, 0 for the default
+    int frame_pool_max;        ///< Max frames queued to the encoder, 0 for the default
+    bool frame_pool_hugepages; ///< Allocate the frames on huge pages
+    const char *adaptive_ladder; ///< Resolution and framerate ladder stepped with the bitrate, NULL to disable
+    float adaptive_bpp;        ///< Bits per pixel under which the ladder steps down, 0 for the default
+    int recovery_rir;          ///< Frames of the intra refresh wave answering lost frames, 0 for IDRs
+    int recovery_window;       ///< Window coalescing key frame requests in ms, 0 for the default
 
     struct CallBackTable {     ///< Callback function tables
         void *opaque;          ///< Used by callback functions
@@ -208,7 +218,7 @@ int irr_stream_start(IrrStreamInfo *stream_info);
 void irr_stream_stop();
 
 /*
- * @Desc force key frame
+ * @Desc force key frame, IRR_KEYFRAME_IDR or IRR_KEYFRAME_RECOVERY
  */
 int irr_stream_force_keyframe(int force_key_frame);
 
@@ -332,6 +342,7 @@ void irr_sream_set_screen_capture_interval(int captureInterval);
 void irr_stream_set_screen_capture_quality(int quality_factor);
 
 void irr_stream_set_iostream_writer_params(const char *input_file, const int width, const int height,
+                                           const char *input_format, const int input_fps, const bool input_preload,
                                            const char *output_file, const int output_frame_number);
 
 void irr_stream_set_crop(int client_rect_right, int client_rect_bottom, int fb_rect_right, int fb_rect_bottom, 
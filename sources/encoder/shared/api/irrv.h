@@ -46,6 +46,10 @@ extern "C" {
 
 #define MAX_PLANE_NUM 4
 
+/* Values of irr_stream_force_keyframe() */
+#define IRR_KEYFRAME_IDR       1   ///< an IDR, for a new subscriber or a reset decoder
+#define IRR_KEYFRAME_RECOVERY  2   ///< frames were lost, an intra refresh wave may do
+
 /**
  * Type of surface, for exmaple a surface which have a prime id,
  * or user allocate buffers(not DRM_PRIME or KERNEL_PRIME), user can use
@@ -151,6 +155,9 @@ typedef struct _irr_encoder_info {
     int slices;                ///< Encoder number of slices, used in parallelized encoding
     int sei;                   ///< Encoding SEI information
     const char *finput;        ///< Local input file in file dump mode
+    const char *finput_format; ///< Pixel format of a raw input file: rgba (default), bgra, nv12 or i420
+    int finput_fps;            ///< Rate the input file is played at, 0 to feed it as fast as it is encoded
+    bool finput_preload;       ///< Copy the input file into huge pages before playing it
     int vframe;                ///< Frame number of the input file
     const char *foutput;       ///< Local input file in file dump mode
     const char *loglevel;      ///< Log level to enable icr encoder logs by level
@@ -167,6 +174,17 @@ typedef struct _irr_encoder_info {
     const char *plugin;        ///< indicate which plugin is used or not, default vaapi-plugin is used
     bool tcaeEnabled;          ///< indicate whether tcae is enabled or not
     const char * tcaeLogPath;  ///< indicate path to generate tcae dumps. If empty not enabled.
+    const char * tcaeRateCtrl; ///< tcae rate controller: netpred, gcc or bbr. If empty netpred is used.
+    bool tcaeFrameDrop;        ///< indicate whether tcae may drop frames when the delay exceeds the budget
+    int flightRecorderSec;     ///< seconds of encoded output kept in memory for snapshots, 0 to disable
+    const char *thread_policy; ///< cpu affinity and scheduling of the encoder threads, see ThreadPlacement
+    int frame_pool_prealloc;   ///< frames preallocated for system memory surfaces, 0 for the default of 2
+    int frame_pool_max;        ///< max frames queued to the encoder, 0 for the default of 16
+    bool frame_pool_hugepages; ///< allocate the frames on huge pages
+    const char *adaptive_ladder; ///< resolution and framerate ladder stepped with the bitrate, "auto" or see AdaptiveLadder, NULL to disable
+    float adaptive_bpp;        ///< bits per pixel under which the ladder steps down, 0 for the default of 0.05
+    int recovery_rir;          ///< frames of the intra refresh wave answering lost frames, 0 to answer with an IDR
+    int recovery_window;       ///< ms within which key frame requests are coalesced, 0 for the default of 100
     int user_id;               ///< indicate the user id in mulit-user scenario
 } encoder_info_t;
 
@@ -245,10 +263,15 @@ void irr_stream_setEncodeFlag(bool bAllowEncode);
 void irr_stream_setTransmitFlag(bool bAllowTransmit);
 
 /*
- * @Desc force key frame
+ * @Desc force key frame, IRR_KEYFRAME_IDR or IRR_KEYFRAME_RECOVERY
  */
 int irr_stream_force_keyframe(int force_key_frame);
 
+/*
+ * @Desc write the last seconds of encoded output to disk, async-signal-safe
+ */
+int irr_stream_flight_recorder_snapshot();
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
@@ -1046,6 +1046,16 @@ int irr_encoder_start(int id, encoder_info_t *encoder_info) {
         info.plugin           = encoder_info->plugin;
         info.tcaeEnabled      = encoder_info->tcaeEnabled;
         info.tcaeLogPath      = encoder_info->tcaeLogPath;
+        info.tcaeRateCtrl     = encoder_info->tcaeRateCtrl;
+        info.tcaeFrameDrop    = encoder_info->tcaeFrameDrop;
+        info.flightRecorderSec = encoder_info->flightRecorderSec;
+        info.frame_pool_prealloc  = encoder_info->frame_pool_prealloc;
+        info.frame_pool_max       = encoder_info->frame_pool_max;
+        info.frame_pool_hugepages = encoder_info->frame_pool_hugepages;
+        info.adaptive_ladder      = encoder_info->adaptive_ladder;
+        info.adaptive_bpp         = encoder_info->adaptive_bpp;
+        info.recovery_rir         = encoder_info->recovery_rir;
+        info.recovery_window      = encoder_info->recovery_window;
 
         if (encoder_info->encodeType == VASURFACE_ID) {
             if (strncmp(info.plugin, "qsv", strlen("qsv")) == 0) {
@@ -1368,7 +1378,9 @@ static void set_iostream_writer(encoder_info_t* info)
         return;
     }
     e_Log->Info("%s : %d : %s!\n", __func__, __LINE__, info->foutput);
-    irr_stream_set_iostream_writer_params(info->finput, info->width, info->height, info->foutput, info->vframe);
+    irr_stream_set_iostream_writer_params(info->finput, info->width, info->height,
+                                          info->finput_format, info->finput_fps, info->finput_preload,
+                                          info->foutput, info->vframe);
 }
 
 void irr_encoder_write_crop(int client_rect_right, int client_rect_bottom, int fb_rect_right, int fb_rect_bottom, 
@@ -71,6 +71,7 @@ const std::map<irrv_vctrl_type, std::string> VCtrlTypeMap = {
     { IRRV_CTRL_SKIP_FRAME_SETTING   , "IRRV_CTRL_SKIP_FRAME_SETTING   " },
     { IRRV_CTRL_PROFILE_LEVEL        , "IRRV_CTRL_PROFILE_LEVEL        " },
     { IRRV_CTRL_CLIENT_FEEDBACK      , "IRRV_CTRL_CLIENT_FEEDBACK    " },
+    { IRRV_CTRL_FLIGHT_RECORDER_SNAPSHOT, "IRRV_CTRL_FLIGHT_RECORDER_SNAPSHOT" },
     { IRRV_CTRL_END                  , "IRRV_CTRL_END                  " },
 };
 
@@ -333,7 +334,8 @@ int irrv_checknewconn(void *opaque)
 #endif
                             switch (vctrl.ctrl_type) {
                             case IRRV_CTRL_KEYFRAME_SETTING:
-                                irr_stream_force_keyframe(vctrl.value);
+                                irr_stream_force_keyframe(vctrl.value == IRRV_KEYFRAME_RECOVERY ?
+                                                          IRR_KEYFRAME_RECOVERY : IRR_KEYFRAME_IDR);
                                 break;
                             case IRRV_CTRL_BITRATE_SETTING:
                                 irr_stream_set_bitrate(vctrl.value);
@@ -449,6 +451,9 @@ int irrv_checknewconn(void *opaque)
                             case IRRV_CTRL_CLIENT_FEEDBACK:
                                 irr_stream_set_client_feedback(vctrl.client_feedback.delay, vctrl.client_feedback.size);
                                 break;
+                            case IRRV_CTRL_FLIGHT_RECORDER_SNAPSHOT:
+                                irr_stream_flight_recorder_snapshot();
+                                break;
                             default:
                                 IrrvLog.Warn("ERROR encode setting (type < %d)\n", IRRV_CTRL_END);
                                 break;
@@ -288,12 +288,14 @@ void irr_stream_set_screen_capture_quality(int quality_factor) {
 }
 
 void irr_stream_set_iostream_writer_params(const char *input_file, const int width, const int height,
+                                           const char *input_format, const int input_fps, const bool input_preload,
                                            const char *output_file, const int output_frame_number) {
     IrrStreamer* pStreamer = IrrStreamer::get();
     if (!pStreamer)
         return;
 
-    pStreamer->set_iostream_writer_params(input_file, width, height, output_file, output_frame_number);
+    pStreamer->set_iostream_writer_params(input_file, width, height, input_format, input_fps, input_preload,
+                                          output_file, output_frame_number);
 }
 
 void irr_stream_set_crop(int client_rect_right, int client_rect_bottom, int fb_rect_right, int fb_rect_bottom, 
@@ -424,6 +426,14 @@ int irr_stream_set_client_feedback(uint32_t delay, uint32_t size) {
     return pStreamer->set_client_feedback(delay, size);
 }
 
+int irr_stream_flight_recorder_snapshot() {
+    IrrStreamer* pStreamer = IrrStreamer::get();
+    if (!pStreamer)
+        return -ENAVAIL;
+
+    return pStreamer->flight_recorder_snapshot();
+}
+
 void irr_stream_set_encode_renderfps_flag(bool bRenderFpsEnc) {
     IrrStreamer* pStreamer = IrrStreamer::get();
     if (!pStreamer)
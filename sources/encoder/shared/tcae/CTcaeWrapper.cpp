@@ -134,7 +134,7 @@ bool CTcaeWrapper::LogsOnlyMode()
     return m_logger.LogsOnlyMode();
 }
 
-int CTcaeWrapper::Initialize(uint32_t targetDelay, uint32_t maxFrameSize)
+int CTcaeWrapper::Initialize(uint32_t targetDelay, uint32_t maxFrameSize, tcaeRateController rateController, bool frameDrop)
 {
     try
     {
@@ -147,8 +147,11 @@ int CTcaeWrapper::Initialize(uint32_t targetDelay, uint32_t maxFrameSize)
 
     TcaeInitParams_t params = {0};
     params.featuresSet          = TCAE_MODE_STANDALONE;
+    if (frameDrop)
+        params.featuresSet     |= TCAE_PREDICT_FRAME_SIZE | TCAE_FRAME_DROP;
     params.targetDelayInMs      = targetDelay;
     params.bufferedRecordsCount = 100;
+    params.rateController       = rateController;
     if (maxFrameSize > 0)
         params.maxFrameSizeInBytes = maxFrameSize;
 
@@ -161,6 +164,7 @@ int CTcaeWrapper::Initialize(uint32_t targetDelay, uint32_t maxFrameSize)
     else
     {
         printf("################TCAE starts success!################\n");
+        printf("TCAE rate controller: %s, frame drop: %s\n", GetRateControllerName(rateController), frameDrop ? "on" : "off");
     }
 
     m_logger.InitLog(m_tcaeLogPath);
@@ -168,7 +172,7 @@ int CTcaeWrapper::Initialize(uint32_t targetDelay, uint32_t maxFrameSize)
     return 0;
 }
 
-int CTcaeWrapper::UpdateClientFeedback(uint32_t delay, uint32_t size)
+int CTcaeWrapper::UpdateClientFeedback(uint32_t delay, uint32_t size, uint32_t packetLossRate, int32_t creditBytes)
 {
     if (m_tcae == nullptr)
         return ERR_NULL_PTR;
@@ -177,7 +181,8 @@ int CTcaeWrapper::UpdateClientFeedback(uint32_t delay, uint32_t size)
 
     pfnData.lastPacketDelayInUs        = delay;
     pfnData.transmittedDataSizeInBytes = size;
-    pfnData.packetLossRate             = 0;
+    pfnData.packetLossRate             = packetLossRate;
+    pfnData.creditBytes                = creditBytes;
 
     tcaeStatus sts = m_tcae->UpdateNetworkState(&pfnData);
     if (sts != ERR_NONE)
@@ -213,12 +218,14 @@ int CTcaeWrapper::UpdateEncodedSize(uint32_t encodedSize)
     return 0;
 }
 
-uint32_t CTcaeWrapper::GetTargetSize()
+uint32_t CTcaeWrapper::GetTargetSize(bool* dropFrame)
 {
     if (m_tcae == nullptr)
         return ERR_NULL_PTR;
 
     FrameSettings_t settings = {0};
+    // Frames are never dropped in the logs only mode
+    settings.keepFrame = dropFrame == nullptr || LogsOnlyMode();
 
     tcaeStatus sts = m_tcae->PredictEncSettings(&settings);
     if (sts != ERR_NONE)
@@ -229,6 +236,9 @@ uint32_t CTcaeWrapper::GetTargetSize()
 
     uint32_t targetSize = settings.frameSizeInBytes;
 
+    if (dropFrame)
+        *dropFrame = settings.dropFrame;
+
     m_logger.GetTargetSize(targetSize);
 
     return targetSize;
@@ -77,13 +77,17 @@ public:
 
     bool LogsOnlyMode();
 
-    int Initialize(uint32_t targetDelay = 60, uint32_t maxFrameSize = 0);
+    int Initialize(uint32_t targetDelay = 60, uint32_t maxFrameSize = 0,
+                   tcaeRateController rateController = TCAE_RC_NETPRED, bool frameDrop = false);
 
-    int UpdateClientFeedback(uint32_t delay, uint32_t size);
+    int UpdateClientFeedback(uint32_t delay, uint32_t size,
+                             uint32_t packetLossRate = 0, int32_t creditBytes = 0);
 
     int UpdateEncodedSize(uint32_t encodedSize);
 
-    uint32_t GetTargetSize();
+    // dropFrame is set if the frame should not be encoded at all. Pass
+    // nullptr for a frame that is encoded anyway, so that no drop is counted.
+    uint32_t GetTargetSize(bool* dropFrame = nullptr);
 
     void setTcaeLogPath(const char* path) { m_tcaeLogPath = path; };
 
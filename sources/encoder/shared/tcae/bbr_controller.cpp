@@ -0,0 +1,271 @@
+// Copyright (C) 2018-2022 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions
+// and limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include <math.h>
+#include <algorithm>
+#include "bbr_controller.h"
+#include "enc_frame_settings_predictor.h"
+
+namespace {
+    const double   HighGain          = 2.885;  // 2/ln(2)
+    const double   DrainGain         = 1.0 / HighGain;
+    const double   ProbeRttGain      = 0.5;
+    const double   CycleGains[]      = { 1.25, 0.75, 1.0, 1.0, 1.0, 1.0, 1.0, 1.0 };
+    const uint32_t CycleLength       = sizeof(CycleGains) / sizeof(CycleGains[0]);
+    const double   FullBwThreshold   = 1.25;
+    const uint32_t FullBwRounds      = 3;
+    const double   RtPropWindowInSec = 10.0;
+    const double   ProbeRttInSec     = 0.2;
+    const double   LossThreshold     = 2.0;   // percent
+    const double   NoFeedbackDecay   = 0.95;
+}
+
+BbrController::BbrController():
+    m_targetDelay(16),
+    m_fps(30.0),
+    m_minSize(5000.0),
+    m_maxSize(1000000.0),
+    m_frameCount(0),
+    m_rtPropStamp(0),
+    m_mode(Mode::Startup),
+    m_cycleIndex(0),
+    m_cycleStart(0),
+    m_probeRttStart(0),
+    m_fullBw(0.0),
+    m_fullBwCount(0),
+    m_filledPipe(false),
+    m_lastDelay(0.0),
+    m_lossRate(0),
+    m_creditBytes(0),
+    m_framesWithoutFeedback(0),
+    m_noFeedbackScale(1.0)
+{
+}
+
+void BbrController::SetTargetDelay(double target_in_ms)
+{
+    m_targetDelay = target_in_ms;
+}
+
+void BbrController::SetMaxTargetSize(uint32_t maxBytes)
+{
+    m_maxSize = maxBytes;
+}
+
+void BbrController::SetMinTargetSize(uint32_t minBytes)
+{
+    m_minSize = minBytes;
+}
+
+void BbrController::SetRecordedLen(int record_len)
+{
+    // Filter windows are derived from fps and RTprop instead
+    (void)record_len;
+}
+
+void BbrController::SetFPS(double fps)
+{
+    if (fps > 0)
+        m_fps = fps;
+}
+
+void BbrController::UpdateBtlBw(double rate)
+{
+    // BtlBw window is ten round trips, but not shorter than one second
+    double rtProp = m_rtProp.empty() ? 0.0 : m_rtProp.front().value;
+    uint64_t window = std::max<uint64_t>(1, uint64_t(std::max(m_fps, 10.0 * rtProp * m_fps / 1000.0)));
+
+    while (!m_btlBw.empty() && m_btlBw.back().value <= rate)
+        m_btlBw.pop_back();
+    m_btlBw.push_back({ m_frameCount, rate });
+    while (m_frameCount - m_btlBw.front().frame >= window)
+        m_btlBw.pop_front();
+}
+
+void BbrController::UpdateRtProp(double delayInMs)
+{
+    uint64_t window = std::max<uint64_t>(1, uint64_t(RtPropWindowInSec * m_fps));
+
+    if (m_rtProp.empty() || delayInMs <= m_rtProp.front().value)
+        m_rtPropStamp = m_frameCount;
+
+    while (!m_rtProp.empty() && m_rtProp.back().value >= delayInMs)
+        m_rtProp.pop_back();
+    m_rtProp.push_back({ m_frameCount, delayInMs });
+    while (m_frameCount - m_rtProp.front().frame >= window)
+        m_rtProp.pop_front();
+}
+
+void BbrController::UpdateMode()
+{
+    double btlBw = m_btlBw.front().value;
+    double rtProp = m_rtProp.front().value;
+
+    // One round trip in frames, and the length of one gain cycle phase
+    uint64_t roundFrames = std::max<uint64_t>(1, uint64_t(ceil(rtProp * m_fps / 1000.0)));
+    uint64_t phaseFrames = std::max<uint64_t>(roundFrames, uint64_t(m_fps / CycleLength));
+
+    if (!m_filledPipe)
+    {
+        if (btlBw >= m_fullBw * FullBwThreshold)
+        {
+            m_fullBw = btlBw;
+            m_fullBwCount = 0;
+        }
+        else if (++m_fullBwCount >= FullBwRounds * roundFrames)
+        {
+            m_filledPipe = true;
+        }
+    }
+
+    switch (m_mode)
+    {
+    case Mode::Startup:
+        if (m_filledPipe)
+            m_mode = Mode::Drain;
+        break;
+    case Mode::Drain:
+        if (m_lastDelay <= rtProp + 1000.0 / m_fps)
+        {
+            m_mode = Mode::ProbeBw;
+            m_cycleIndex = 0;
+            m_cycleStart = m_frameCount;
+        }
+        break;
+    case Mode::ProbeBw:
+        if (m_frameCount - m_cycleStart >= phaseFrames)
+        {
+            m_cycleIndex = (m_cycleIndex + 1) % CycleLength;
+            m_cycleStart = m_frameCount;
+        }
+        // Leave the draining phase early once the queue is gone
+        else if (m_cycleIndex == 1 && m_lastDelay <= rtProp + 1000.0 / m_fps)
+        {
+            m_cycleIndex = 2;
+            m_cycleStart = m_frameCount;
+        }
+        break;
+    case Mode::ProbeRtt:
+        if (m_frameCount - m_probeRttStart >= uint64_t(ProbeRttInSec * m_fps) + roundFrames)
+        {
+            m_mode = m_filledPipe ? Mode::ProbeBw : Mode::Startup;
+            m_cycleIndex = 0;
+            m_cycleStart = m_frameCount;
+            m_rtPropStamp = m_frameCount;
+        }
+        break;
+    }
+
+    // RTprop has not been refreshed for a while, drain the queue to re-measure it
+    if (m_mode != Mode::ProbeRtt && m_frameCount - m_rtPropStamp >= uint64_t(RtPropWindowInSec * m_fps))
+    {
+        m_mode = Mode::ProbeRtt;
+        m_probeRttStart = m_frameCount;
+    }
+}
+
+double BbrController::PacingGain() const
+{
+    switch (m_mode)
+    {
+    case Mode::Startup:  return HighGain;
+    case Mode::Drain:    return DrainGain;
+    case Mode::ProbeBw:  return CycleGains[m_cycleIndex];
+    case Mode::ProbeRtt: return ProbeRttGain;
+    }
+    return 1.0;
+}
+
+void BbrController::UpdateNetworkState(const PerFrameNetworkData_t& data, uint32_t encodedSize)
+{
+    (void)encodedSize;
+
+    double delayInMs = double(data.lastPacketDelayInUs) / 1000.0;
+    double size = double(data.transmittedDataSizeInBytes);
+
+    // Delivery rate of this frame. Prefer the spread between first and last
+    // packet arrival, else use the arrival interval to the previous frame
+    // (frame interval plus delay change). Neither can exceed the link rate.
+    double transferInMs;
+    if (data.firstPacketDelayInUs && data.firstPacketDelayInUs < data.lastPacketDelayInUs)
+        transferInMs = double(data.lastPacketDelayInUs - data.firstPacketDelayInUs) / 1000.0;
+    else if (m_frameCount > 0)
+        transferInMs = 1000.0 / m_fps + delayInMs - m_lastDelay;
+    else
+        transferInMs = delayInMs;
+    transferInMs = std::max(transferInMs, 1.0);
+
+    m_framesWithoutFeedback = 0;
+    m_noFeedbackScale = 1.0;
+    m_lossRate = data.packetLossRate;
+    m_creditBytes = data.creditBytes;
+    m_lastDelay = delayInMs;
+    m_frameCount++;
+
+    UpdateRtProp(delayInMs);
+
+    // A queue past the target delay means the link got slower than the max
+    // filter remembers, which would keep it filling for a whole window.
+    // Start over from the current delivery rate and drain.
+    if (delayInMs > m_targetDelay && m_mode != Mode::ProbeRtt)
+    {
+        m_btlBw.clear();
+        if (m_filledPipe)
+            m_mode = Mode::Drain;
+    }
+
+    UpdateBtlBw(size * 1000.0 / transferInMs);
+    UpdateMode();
+}
+
+void BbrController::UpdateEncodedSize(uint32_t encodedSize)
+{
+    (void)encodedSize;
+
+    // Back off if feedback stops arriving for more than half a second
+    if (++m_framesWithoutFeedback > m_fps / 2)
+        m_noFeedbackScale *= NoFeedbackDecay;
+}
+
+uint32_t BbrController::GetNextFrameSize()
+{
+    if (m_btlBw.empty())
+        return uint32_t(m_maxSize);
+
+    double btlBw = m_btlBw.front().value;
+    double rtProp = m_rtProp.front().value;
+
+    double gain = PacingGain();
+    double lossScale = 1.0;
+    if (m_lossRate >= LossThreshold)
+    {
+        // Do not probe into a lossy link
+        gain = std::min(gain, 1.0);
+        lossScale = std::max(0.5, 1.0 - 0.5 * m_lossRate / 100.0);
+    }
+
+    double size = gain * btlBw / m_fps * lossScale * m_noFeedbackScale;
+
+    // Keep the queue a frame can build within the target delay budget
+    double queueBudget = std::max(m_targetDelay - rtProp, 0.0) * btlBw / 1000.0;
+    size = std::min(size, queueBudget);
+
+    // Negative credit is backlog in the transport, drain it from this frame
+    if (m_creditBytes < 0)
+        size += m_creditBytes;
+
+    return uint32_t(std::min(std::max(size, m_minSize), m_maxSize));
+}
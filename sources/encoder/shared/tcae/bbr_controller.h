@@ -0,0 +1,89 @@
+// Copyright (C) 2018-2022 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions
+// and limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef __BBR_CONTROLLER_H__
+#define __BBR_CONTROLLER_H__
+
+#include <deque>
+#include "rate_controller.h"
+
+// Bandwidth/RTT estimator modelled after BBR. It keeps a windowed max of the
+// per-frame delivery rate (BtlBw) and a windowed min of the frame delay
+// (RTprop), and paces frames at gain * BtlBw, cycling the gain to probe for
+// more bandwidth and to drain the queue it builds. The frame size is also
+// capped so that the expected queueing delay stays within the target delay.
+//
+// Unlike the delay-gradient controller it does not react to jitter as
+// congestion, which suits links with noisy delay such as Wi-Fi and LTE.
+class BbrController : public RateController
+{
+public:
+    BbrController();
+
+    void SetTargetDelay(double target_in_ms) override;
+    void SetMaxTargetSize(uint32_t maxBytes) override;
+    void SetMinTargetSize(uint32_t minBytes) override;
+    void SetRecordedLen(int record_len) override;
+    void SetFPS(double fps) override;
+
+    void UpdateNetworkState(const PerFrameNetworkData_t& data, uint32_t encodedSize) override;
+    void UpdateEncodedSize(uint32_t encodedSize) override;
+
+    uint32_t GetNextFrameSize() override;
+
+protected:
+    enum class Mode { Startup, Drain, ProbeBw, ProbeRtt };
+
+    struct Sample
+    {
+        uint64_t frame;
+        double   value;
+    };
+
+    void UpdateBtlBw(double rate);
+    void UpdateRtProp(double delayInMs);
+    void UpdateMode();
+    double PacingGain() const;
+
+    double m_targetDelay;
+    double m_fps;
+    double m_minSize;
+    double m_maxSize;
+
+    uint64_t m_frameCount;
+
+    // Windowed max of delivery rate (bytes/s), monotonic deque
+    std::deque<Sample> m_btlBw;
+    // Windowed min of delay (ms), monotonic deque
+    std::deque<Sample> m_rtProp;
+    uint64_t m_rtPropStamp;
+
+    Mode     m_mode;
+    uint32_t m_cycleIndex;
+    uint64_t m_cycleStart;
+    uint64_t m_probeRttStart;
+    double   m_fullBw;
+    uint32_t m_fullBwCount;
+    bool     m_filledPipe;
+    double   m_lastDelay;
+
+    uint32_t m_lossRate;
+    int32_t  m_creditBytes;
+    uint32_t m_framesWithoutFeedback;
+    double   m_noFeedbackScale;
+};
+
+#endif
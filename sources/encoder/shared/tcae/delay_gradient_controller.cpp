@@ -0,0 +1,365 @@
+// Copyright (C) 2018-2022 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions
+// and limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include <math.h>
+#include <algorithm>
+#include "delay_gradient_controller.h"
+#include "enc_frame_settings_predictor.h"
+
+namespace {
+    // Constants follow the GCC draft and the WebRTC trendline estimator
+    const size_t DefaultTrendlineWindow  = 20;
+    const double SmoothingCoeff          = 0.9;
+    const double ThresholdGain           = 4.0;
+    const double MaxNumDeltas            = 60.0;
+    const double InitialThreshold        = 12.5;  // ms
+    const double MinThreshold            = 6.0;   // ms
+    const double MaxThreshold            = 600.0; // ms
+    const double ThresholdUpCoeff        = 0.0087;
+    const double ThresholdDownCoeff      = 0.039;
+    const double OveruseTimeThreshold    = 10.0;  // ms
+    const double DecreaseFactor          = 0.85;
+    const double MinDecreaseInterval     = 10.0;  // ms, bounds of the round trip
+    const double MaxDecreaseInterval     = 200.0; // between two decreases
+    const double IncreasePerSecond       = 1.08;
+    const double LossHighPercent         = 10.0;
+    const double LossLowPercent          = 2.0;
+    const double LossIncreaseFactor      = 1.05;
+    const double NoFeedbackDecay         = 0.95;
+    const double ThroughputWindow        = 0.25;  // s
+}
+
+DelayGradientController::DelayGradientController():
+    m_targetDelay(16),
+    m_fps(30.0),
+    m_minSize(5000.0),
+    m_maxSize(1000000.0),
+    m_windowLen(DefaultTrendlineWindow),
+    m_times(DefaultTrendlineWindow, 0.0),
+    m_delays(DefaultTrendlineWindow, 0.0),
+    m_head(0),
+    m_count(0),
+    m_prevDelay(-1.0),
+    m_delayDelta(0.0),
+    m_accumulatedDelay(0.0),
+    m_smoothedDelay(0.0),
+    m_frameCount(0),
+    m_numDeltas(0),
+    m_threshold(InitialThreshold),
+    m_prevTrend(0.0),
+    m_overuseTime(0.0),
+    m_overuseCounter(0),
+    m_usage(Usage::Normal),
+    m_rateState(RateState::Increase),
+    m_rate(0.0),
+    m_lastDecreaseRate(0.0),
+    m_lastDecreaseFrame(-1),
+    m_decreaseHoldMs(0.0),
+    m_lossBound(0.0),
+    m_sizesHead(0),
+    m_sizesCount(0),
+    m_sizesSum(0.0),
+    m_creditBytes(0),
+    m_framesWithoutFeedback(0)
+{
+    SetFPS(m_fps);
+}
+
+void DelayGradientController::SetTargetDelay(double target_in_ms)
+{
+    m_targetDelay = target_in_ms;
+}
+
+void DelayGradientController::SetMaxTargetSize(uint32_t maxBytes)
+{
+    m_maxSize = maxBytes;
+    m_lossBound = m_maxSize * m_fps;
+}
+
+void DelayGradientController::SetMinTargetSize(uint32_t minBytes)
+{
+    m_minSize = minBytes;
+}
+
+void DelayGradientController::SetRecordedLen(int record_len)
+{
+    // The trendline only needs a short window, the regression window of
+    // NetPred would make overuse detection far too slow.
+    (void)record_len;
+}
+
+void DelayGradientController::SetFPS(double fps)
+{
+    if (fps <= 0)
+        return;
+
+    m_fps = fps;
+
+    // Received rate over a quarter second worth of frames, short enough
+    // to see the link rate soon after the queue builds
+    size_t len = std::max<size_t>(2, size_t(ceil(fps * ThroughputWindow)));
+    m_sizes.assign(len, 0.0);
+    m_arrivals.assign(len, 0.0);
+    m_sizesHead = 0;
+    m_sizesCount = 0;
+    m_sizesSum = 0.0;
+
+    m_lossBound = m_maxSize * m_fps;
+}
+
+double DelayGradientController::UpdateTrendline(double delayInMs)
+{
+    double frameTime = 1000.0 / m_fps * double(m_frameCount);
+
+    if (m_prevDelay < 0)
+    {
+        m_prevDelay = delayInMs;
+        return 0.0;
+    }
+
+    // Delay variation between consecutive frames, accumulated and smoothed
+    double delta = delayInMs - m_prevDelay;
+    m_prevDelay = delayInMs;
+    m_delayDelta = delta;
+    if (m_numDeltas < MaxNumDeltas)
+        m_numDeltas++;
+
+    m_accumulatedDelay += delta;
+    m_smoothedDelay = SmoothingCoeff * m_smoothedDelay + (1 - SmoothingCoeff) * m_accumulatedDelay;
+
+    m_head = (m_head + 1) % m_windowLen;
+    m_times[m_head] = frameTime;
+    m_delays[m_head] = m_smoothedDelay;
+    if (m_count < m_windowLen)
+        m_count++;
+
+    if (m_count < m_windowLen)
+        return m_prevTrend;
+
+    // Least squares slope of smoothed delay over time
+    double meanT = 0.0, meanD = 0.0;
+    for (size_t i = 0; i < m_count; i++)
+    {
+        meanT += m_times[i];
+        meanD += m_delays[i];
+    }
+    meanT /= m_count;
+    meanD /= m_count;
+
+    double num = 0.0, den = 0.0;
+    for (size_t i = 0; i < m_count; i++)
+    {
+        num += (m_times[i] - meanT) * (m_delays[i] - meanD);
+        den += (m_times[i] - meanT) * (m_times[i] - meanT);
+    }
+
+    double slope = (den > 1e-6) ? num / den : 0.0;
+    return slope * std::min<double>(m_numDeltas, MaxNumDeltas) * ThresholdGain;
+}
+
+void DelayGradientController::UpdateThreshold(double trend)
+{
+    // Ignore sudden large spikes, e.g. from a Wi-Fi retransmission burst
+    if (fabs(trend) > m_threshold + 15.0)
+        return;
+
+    double k = fabs(trend) < m_threshold ? ThresholdDownCoeff : ThresholdUpCoeff;
+    double frameTimeInMs = 1000.0 / m_fps;
+    m_threshold += k * (fabs(trend) - m_threshold) * std::min(frameTimeInMs, 100.0);
+    m_threshold = std::min(std::max(m_threshold, MinThreshold), MaxThreshold);
+}
+
+DelayGradientController::Usage DelayGradientController::Detect(double trend, double delayInMs)
+{
+    Usage usage = Usage::Normal;
+
+    if (trend > m_threshold)
+    {
+        m_overuseTime += 1000.0 / m_fps;
+        m_overuseCounter++;
+        if (m_overuseTime > OveruseTimeThreshold && m_overuseCounter > 1 && trend >= m_prevTrend)
+        {
+            m_overuseTime = 0.0;
+            m_overuseCounter = 0;
+            usage = Usage::Overuse;
+        }
+        else
+        {
+            usage = m_usage;
+        }
+    }
+    else if (trend < -m_threshold)
+    {
+        m_overuseTime = 0.0;
+        m_overuseCounter = 0;
+        usage = Usage::Underuse;
+    }
+    else
+    {
+        m_overuseTime = 0.0;
+        m_overuseCounter = 0;
+    }
+
+    // Absolute delay above the budget is an overuse regardless of the trend,
+    // as long as the queue keeps growing; a draining one was already cut
+    if (delayInMs > m_targetDelay && m_delayDelta > 0)
+        usage = Usage::Overuse;
+
+    m_prevTrend = trend;
+    UpdateThreshold(trend);
+
+    return usage;
+}
+
+void DelayGradientController::UpdateRate(Usage usage, double throughput, double delayInMs)
+{
+    switch (usage)
+    {
+    case Usage::Overuse:
+        m_rateState = RateState::Decrease;
+        break;
+    case Usage::Underuse:
+        m_rateState = RateState::Hold;
+        break;
+    case Usage::Normal:
+        if (m_rateState == RateState::Hold || m_rateState == RateState::Decrease)
+            m_rateState = RateState::Increase;
+        break;
+    }
+
+    double frameTime = 1.0 / m_fps;
+
+    switch (m_rateState)
+    {
+    case RateState::Increase:
+        if (m_lastDecreaseRate > 0 && m_rate > m_lastDecreaseRate / DecreaseFactor)
+        {
+            // Past the throughput that congested the link last time, which
+            // no longer holds
+            m_lastDecreaseRate = 0;
+        }
+
+        if (m_lastDecreaseRate > 0 && m_rate > 0.95 * m_lastDecreaseRate)
+        {
+            // Close to the last congestion point, probe additively by about
+            // one average frame per second
+            m_rate += (m_rate / m_fps) * frameTime;
+        }
+        else
+        {
+            m_rate *= pow(IncreasePerSecond, frameTime);
+        }
+        // Do not run away from what is actually being sent
+        if (throughput > 0)
+            m_rate = std::min(m_rate, 1.5 * throughput + 10000.0);
+        break;
+    case RateState::Decrease:
+        // One decrease per round trip, the feedback of the frames in flight
+        // still shows the queue the last one is draining. The frame delay
+        // stands in for the round trip, which is not measured here.
+        if (m_lastDecreaseFrame < 0 ||
+            double(int64_t(m_frameCount) - m_lastDecreaseFrame) * 1000.0 / m_fps >= m_decreaseHoldMs)
+        {
+            m_rate = DecreaseFactor * (throughput > 0 ? std::min(throughput, m_rate) : m_rate);
+            m_lastDecreaseRate = m_rate;
+            m_lastDecreaseFrame = int64_t(m_frameCount);
+            m_decreaseHoldMs = std::min(std::max(delayInMs, MinDecreaseInterval), MaxDecreaseInterval);
+        }
+        m_rateState = RateState::Hold;
+        break;
+    case RateState::Hold:
+        break;
+    }
+}
+
+void DelayGradientController::UpdateLossBound(uint32_t lossRate)
+{
+    double loss = double(lossRate);
+
+    if (loss > LossHighPercent)
+        m_lossBound = m_rate * (1.0 - 0.5 * loss / 100.0);
+    else if (loss < LossLowPercent)
+        m_lossBound = std::max(m_lossBound, m_rate) * pow(LossIncreaseFactor, 1.0 / m_fps);
+}
+
+double DelayGradientController::ClampRate(double rate) const
+{
+    return std::min(std::max(rate, m_minSize * m_fps), m_maxSize * m_fps);
+}
+
+void DelayGradientController::UpdateNetworkState(const PerFrameNetworkData_t& data, uint32_t encodedSize)
+{
+    double delayInMs = double(data.lastPacketDelayInUs) / 1000.0;
+    double size = double(data.transmittedDataSizeInBytes);
+
+    m_framesWithoutFeedback = 0;
+    m_creditBytes = data.creditBytes;
+    m_frameCount++;
+
+    if (m_rate <= 0)
+        m_rate = ClampRate(0.5 * (m_minSize + m_maxSize) * m_fps);
+
+    // Sliding throughput, as received: while a queue builds the
+    // frames arrive slower than they are sent and the sent rate would be
+    // far above the link
+    size_t len = m_sizes.size();
+    if (m_sizesCount == len)
+        m_sizesSum -= m_sizes[m_sizesHead];
+    else
+        m_sizesCount++;
+    m_sizes[m_sizesHead] = size;
+    m_arrivals[m_sizesHead] = 1000.0 / m_fps * double(m_frameCount) + delayInMs;
+    m_sizesSum += size;
+    size_t newest = m_sizesHead;
+    m_sizesHead = (m_sizesHead + 1) % len;
+    size_t oldest = m_sizesCount == len ? m_sizesHead : 0;
+
+    double throughput = m_sizesSum / m_sizesCount * m_fps;
+    double span = m_arrivals[newest] - m_arrivals[oldest];
+    if (m_sizesCount > 1 && span > 500.0 / m_fps)
+        throughput = (m_sizesSum - m_sizes[oldest]) * 1000.0 / span;
+
+    double trend = UpdateTrendline(delayInMs);
+    m_usage = Detect(trend, delayInMs);
+
+    UpdateRate(m_usage, throughput, delayInMs);
+    UpdateLossBound(data.packetLossRate);
+
+    m_rate = ClampRate(std::min(m_rate, m_lossBound));
+}
+
+void DelayGradientController::UpdateEncodedSize(uint32_t encodedSize)
+{
+    (void)encodedSize;
+
+    // Back off if feedback stops arriving for more than half a second
+    if (++m_framesWithoutFeedback > m_fps / 2)
+        m_rate = ClampRate(m_rate * NoFeedbackDecay);
+}
+
+uint32_t DelayGradientController::GetNextFrameSize()
+{
+    if (m_rate <= 0)
+        return uint32_t(m_maxSize);
+
+    double size = m_rate / m_fps;
+
+    // Negative credit is backlog in the transport, drain it from this frame
+    if (m_creditBytes < 0)
+        size += m_creditBytes;
+
+    return uint32_t(std::min(std::max(size, m_minSize), m_maxSize));
+}
@@ -0,0 +1,104 @@
+// Copyright (C) 2018-2022 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions
+// and limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef __DELAY_GRADIENT_CONTROLLER_H__
+#define __DELAY_GRADIENT_CONTROLLER_H__
+
+#include <vector>
+#include "rate_controller.h"
+
+// Delay-gradient congestion control, modelled after GCC (Google Congestion
+// Control). A trendline filter over the accumulated frame delay variation
+// detects queue build-up (overuse) against an adaptive threshold. The target
+// rate is then increased multiplicatively while the link is normal, held on
+// underuse, and cut to a fraction of the measured throughput on overuse, at
+// most once per round trip so that a draining queue is not cut again.
+// A loss-based bound caps the rate when the client reports packet loss.
+//
+// Time is measured in frames at the configured fps, feedback arrives in
+// batches on the encode thread so wall clock time is not meaningful here.
+class DelayGradientController : public RateController
+{
+public:
+    DelayGradientController();
+
+    void SetTargetDelay(double target_in_ms) override;
+    void SetMaxTargetSize(uint32_t maxBytes) override;
+    void SetMinTargetSize(uint32_t minBytes) override;
+    void SetRecordedLen(int record_len) override;
+    void SetFPS(double fps) override;
+
+    void UpdateNetworkState(const PerFrameNetworkData_t& data, uint32_t encodedSize) override;
+    void UpdateEncodedSize(uint32_t encodedSize) override;
+
+    uint32_t GetNextFrameSize() override;
+
+protected:
+    enum class Usage { Normal, Overuse, Underuse };
+    enum class RateState { Increase, Decrease, Hold };
+
+    double UpdateTrendline(double delayInMs);
+    Usage Detect(double trend, double delayInMs);
+    void UpdateThreshold(double trend);
+    void UpdateRate(Usage usage, double throughput, double delayInMs);
+    void UpdateLossBound(uint32_t lossRate);
+    double ClampRate(double rate) const;
+
+    double m_targetDelay;
+    double m_fps;
+    double m_minSize;
+    double m_maxSize;
+
+    // Trendline filter over (frame time, smoothed accumulated delay)
+    size_t m_windowLen;
+    std::vector<double> m_times;
+    std::vector<double> m_delays;
+    size_t m_head;
+    size_t m_count;
+    double m_prevDelay;
+    double m_delayDelta;
+    double m_accumulatedDelay;
+    double m_smoothedDelay;
+    uint64_t m_frameCount;
+    uint32_t m_numDeltas;
+
+    // Overuse detector
+    double m_threshold;
+    double m_prevTrend;
+    double m_overuseTime;
+    int    m_overuseCounter;
+    Usage  m_usage;
+
+    // AIMD rate control, bytes per second
+    RateState m_rateState;
+    double m_rate;
+    double m_lastDecreaseRate;
+    int64_t m_lastDecreaseFrame;
+    double m_decreaseHoldMs;
+    double m_lossBound;
+
+    // Received rate over the last quarter second of feedback
+    std::vector<double> m_sizes;
+    std::vector<double> m_arrivals;     // ms, frame time plus delay
+    size_t m_sizesHead;
+    size_t m_sizesCount;
+    double m_sizesSum;
+
+    int32_t  m_creditBytes;
+    uint32_t m_framesWithoutFeedback;
+};
+
+#endif
@@ -129,8 +129,9 @@ tcaeStatus PredictorTcaeImpl::StartImpl(TcaeInitParams_t* params, StateLogger* l
 
 
     //Configure Network Predictor
-    std::unique_ptr<NetPred> netPred;
-    netPred.reset(new NetPred());
+    std::unique_ptr<RateController> netPred = CreateRateController(tcaeRateController(params->rateController));
+    if (!netPred)
+        return ERR_INVALID_ARG;
     netPred->SetMaxTargetSize(maxFrameSize);
     netPred->SetMinTargetSize(maxFrameSize/10);
 
@@ -222,9 +223,8 @@ tcaeStatus PredictorTcaeImpl::UpdateNetworkStateImpl(PerFrameNetworkData_t* data
 
         m_validFeedback = true;
 
-        uint32_t delayInMs = uint32_t(ceil(double(delayInUs) / 1000.0));
         std::lock_guard<std::mutex> guard(m_inputMutex);
-        m_cachedNetworkStats.push_back(std::pair<uint32_t, uint32_t>(transmittedDataSize, delayInMs));
+        m_cachedNetworkStats.push_back(*data);
     }
 
     return ERR_NONE;
@@ -312,11 +312,12 @@ tcaeStatus PredictorTcaeImpl::PredictEncSettingsImpl(FrameSettings_t* encSetting
                 m_cachedBitstreamSize.pop_front();
             }
 
-            transmittedSize = m_cachedNetworkStats.front().first;
-            delayInMs = m_cachedNetworkStats.front().second;
-            m_cachedNetworkStats.pop_front();
+            const PerFrameNetworkData_t& stats = m_cachedNetworkStats.front();
+            transmittedSize = stats.transmittedDataSizeInBytes;
+            delayInMs = uint32_t(ceil(double(stats.lastPacketDelayInUs) / 1000.0));
 
-            m_NetworkPredictor->UpdateSizeAndDelay(transmittedSize, bitstreamSize, delayInMs);
+            m_NetworkPredictor->UpdateNetworkState(stats, bitstreamSize);
+            m_cachedNetworkStats.pop_front();
         }
 
         if (delayInMs != 0)
@@ -334,7 +335,7 @@ tcaeStatus PredictorTcaeImpl::PredictEncSettingsImpl(FrameSettings_t* encSetting
 
             bitstreamSize = m_cachedBitstreamSize.front();
             if (m_validFeedback)
-                m_NetworkPredictor->UpdateSizeAndDelay(m_lastTransmittedSize, bitstreamSize, -1);
+                m_NetworkPredictor->UpdateEncodedSize(bitstreamSize);
             m_cachedBitstreamSize.pop_front();
         }
 
@@ -342,7 +343,7 @@ tcaeStatus PredictorTcaeImpl::PredictEncSettingsImpl(FrameSettings_t* encSetting
         m_idrRequested = false;
     }
 
-    //get netPred result if exists
+    //get rate controller result if exists
     uint32_t predictedFrameSize = m_NetworkPredictor->GetNextFrameSize();
 
     //make a decision about IDR insertion
@@ -358,7 +359,7 @@ tcaeStatus PredictorTcaeImpl::PredictEncSettingsImpl(FrameSettings_t* encSetting
             predictedFrameSize = std::min(IDRSizeIncreaseCoeff * predictedFrameSize, m_maxFrameSizeInBytes);
         }
     }
-    else if ((m_features & TCAE_FRAME_DROP) && (m_frameDropsCount < m_maxSequentialDropsCount))
+    else if ((m_features & TCAE_FRAME_DROP) && !encSettings->keepFrame && (m_frameDropsCount < m_maxSequentialDropsCount))
     {
         if ((m_frameDropsCount == 0) && (m_framesSinceLastDrop < m_minDropFramesDist)); //new sequence, distance is too short
         else if (m_lastKnownDelayInMs > m_initialTargetDelayInMs)    //either 0 or meaningful value for m_lastKnownDelay is covered
@@ -19,7 +19,8 @@
 #include <mutex>
 #include <memory>
 #include <cstdint>
-#include "net_pred.h"
+#include <deque>
+#include "rate_controller.h"
 
 enum tcaeStatus
 {
@@ -67,6 +68,7 @@ struct TcaeInitParams_t
     uint16_t maxSequentialDropsCount;
     uint32_t maxFrameSizeInBytes;
     uint16_t minDropFramesDistance;
+    uint32_t rateController;          /**< tcaeRateController, TCAE_RC_NETPRED by default */
 };
 
 struct PerFrameNetworkData_t
@@ -91,6 +93,7 @@ struct FrameSettings_t
     uint16_t encFrameType;
     uint32_t frameSizeInBytes;
     bool     dropFrame;
+    bool     keepFrame;     // in: the frame is encoded whatever is predicted, e.g. a forced key frame
 };
 
 class StateLogger
@@ -123,7 +126,7 @@ private:
     tcaeStatus PredictEncSettingsImpl(FrameSettings_t* encSettings, StateLogger* log=nullptr);
 
     //internal objects
-    std::unique_ptr<NetPred> m_NetworkPredictor;
+    std::unique_ptr<RateController> m_NetworkPredictor;
 
     //initial settings
     uint32_t m_features;
@@ -145,7 +148,7 @@ private:
     //protected input
     std::mutex m_inputMutex;
     std::deque<uint32_t> m_cachedBitstreamSize;
-    std::deque < std::pair<uint32_t /*transmitted size*/, uint32_t /*delay in ms*/> > m_cachedNetworkStats;
+    std::deque<PerFrameNetworkData_t> m_cachedNetworkStats;
     bool m_idrRequested;
     bool m_validFeedback = false;
 
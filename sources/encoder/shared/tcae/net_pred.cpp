@@ -31,6 +31,7 @@ NetPred::NetPred():
     m_exceptionThreshold(1.0),
     m_reverseBandWidth(1.0),
     m_propagotionDelay(0.0),
+    m_pointsSinceEffective(0),
     m_effectiveSizeThreshold(1.0),
     m_effectiveDataLen(2),
 #ifdef _DEBUG
@@ -59,6 +60,7 @@ NetPred::NetPred():
 {
 
     m_forgotRatio = pow(0.01, 1.0 / 2 /m_recordedLen);
+    SetRecordedLen(m_recordedLen);
 
     //Enable steady state check
     char* envStr = nullptr;
@@ -96,8 +98,8 @@ NetPred::~NetPred()
 void NetPred::Clear()
 {
 
-    m_sizes.clear();
-    m_delays.clear();
+    m_window.Clear();
+    m_pointsSinceEffective = 0;
 }
 
 void NetPred::UpdateSizeAndDelay(uint32_t size, uint32_t encoded_size, double delay_in_ms)
@@ -140,17 +142,16 @@ void NetPred::UpdateSizeAndDelay(uint32_t size, uint32_t encoded_size, double de
 
     double sizeInK = (double)size / 1000.0;
 
-    m_delays.push_front(delay_in_ms);
-    m_sizes.push_front(sizeInK);
+    m_window.Push(delay_in_ms, sizeInK);
 
-    if (int(m_delays.size()) > m_recordedLen)
+    if (m_pointsSinceEffective < m_window.Capacity())
     {
-        m_delays.pop_back();
-        m_sizes.pop_back();
+        m_pointsSinceEffective++;
     }
 
     if (sizeInK >= m_effectiveSizeThreshold)
     {
+        m_pointsSinceEffective = 0;
         m_effectiveSizes.push_front(sizeInK);
         m_effectiveDelays.push_front(delay_in_ms);
         if (m_effectiveDelays.size() > m_effectiveDataLen)
@@ -165,25 +166,11 @@ void NetPred::UpdateSizeAndDelay(uint32_t size, uint32_t encoded_size, double de
     double reverseBandWidth = m_reverseBandWidth;
     double standardError = 0.0;
 
-    if (m_sizes.size() >= 0.2 * m_recordedLen)
+    if (m_window.Count() >= 0.2 * m_recordedLen)
     {
         double mse = 0.0;
         double count = 0.0;
-        double weight = 1.0;
-        for (size_t i = 1; i < m_sizes.size(); i++)
-        {
-            if (m_delays[i] < 1e-6 && m_sizes[i] < 1e-6)
-            {
-                ;
-            }
-            else
-            {
-                double estDelay = m_reverseBandWidth * m_sizes[i] + m_propagotionDelay;
-                mse += weight * weight * (m_delays[i] - estDelay) * (m_delays[i] - estDelay);
-                count += weight * weight;
-            }
-            weight *= m_forgotRatio;
-        }
+        m_window.Residual(m_reverseBandWidth, m_propagotionDelay, mse, count);
 
         //initially mse = 0 and count = 0
         //they are initialized in the same place in cycle
@@ -252,95 +239,70 @@ void NetPred::UpdateSizeAndDelay(uint32_t size, uint32_t encoded_size, double de
 void NetPred::UpdateModel()
 {
 
-    std::deque<double> delays;
-    std::deque<double> sizes;
-    delays.clear();
-    sizes.clear();
-    bool validSequence = false;
-    for (size_t i = 0; i < m_sizes.size(); i++)
-    {
-        delays.push_back(m_delays[i]);
-        sizes.push_back(m_sizes[i]);
-        if (m_sizes[i] >= m_effectiveSizeThreshold)
-        {
-            validSequence = true;
-        }
-    }
+    // Index of the newest point above m_effectiveSizeThreshold
+    bool validSequence = m_pointsSinceEffective < m_window.Count();
 
+    const WeightedWindow* window = &m_window;
     if (!validSequence)
     {
-        // original code fron NetPred.cpp
-        //for (int i = m_effectiveSizes.size() - 1; i >= 0; i--)
-        //{
-        //    delays.push_front(m_effectiveDelays[i]);
-        //    delays.pop_back();
-        //    sizes.push_front(m_effectiveSizes[i]);
-        //    sizes.pop_back();
-        //}
-        // rewrite to reverse interatore to avoid type cast  size_t -> long long -> see i >= 0 
-        for (auto it = m_effectiveSizes.crbegin(); it != m_effectiveSizes.crend(); it++)
+        // Put the last effective points in front of the window, keeping its
+        // length, as NetPred.cpp did with push_front()/pop_back() on a copy.
+        // Note that delays are seeded with the effective sizes there as well.
+        size_t effectiveCount = m_effectiveSizes.size();
+        m_seededWindow.Assign(m_window);
+        for (size_t i = 0; i < m_seededWindow.Count(); i++)
         {
-            delays.push_front(*it);
-            delays.pop_back();
-            sizes.push_front(*it);
-            sizes.pop_back();
+            if (i < effectiveCount)
+                m_seededWindow.Set(i, m_effectiveSizes[i], m_effectiveSizes[i]);
+            else
+                m_seededWindow.Set(i, m_window.Delay(i - effectiveCount), m_window.Size(i - effectiveCount));
         }
-
+        m_seededWindow.Recompute();
+        window = &m_seededWindow;
     }
 
-    UpdateModelNormal(delays, sizes);
+    UpdateModelNormal(*window);
     if (!SanityCheck())
     {
         if (m_dumpPoints.good())
             m_dumpPoints << "UpdateModelSafe ......" << std::endl;
-        UpdateModelSafe(delays, sizes);
+        UpdateModelSafe(*window);
     }
 
     if (!SanityCheck())
     {
         if (m_dumpPoints.good())
             m_dumpPoints << "UpdateModelSmall ......" << std::endl;
-        UpdateModelSmall(delays, sizes);
+        UpdateModelSmall(*window);
     }
 
     //double mse = 0.0;
 }
 
-void NetPred::UpdateModelNormal(std::deque<double>& delays, std::deque<double>& sizes)
+void NetPred::UpdateModelNormal(const WeightedWindow& window)
 {
 
-    if (delays.size() < 0.2 * m_recordedLen)
+    if (window.Count() < 0.2 * m_recordedLen)
     {
         if (m_dumpPoints.good())
             m_dumpPoints << "UpdateModelSmall ......" << std::endl;
-        return UpdateModelSmall(delays, sizes);
+        return UpdateModelSmall(window);
     }
 
-    double meanDelay = WeightedMean(delays);
-    double meanSize = WeightedMean(sizes);
+    double meanDelay = window.MeanDelay();
+    double meanSize = window.MeanSize();
 
     if (m_dumpPoints.good())
         m_dumpPoints << "MeanSize, MeanDelay: " << meanSize << "," << meanDelay << std::endl;
 
     double accD = 0.0;
     double accN = 0.0;
-    double weight = 1.0;
-    for (size_t i = 0; i < delays.size(); i++)
-    {
-        if (delays[i] < 1e-6 && sizes[i] < 1e-6)
-        {
-            ;
-        }
-        else
-        {
-            accD += weight * weight * (delays[i] - meanDelay) * (sizes[i] - meanSize);
-            accN += weight * weight * (sizes[i] - meanSize) * (sizes[i] - meanSize);
-        }
-
-        weight *= m_forgotRatio;
+    window.Covariance(meanDelay, meanSize, accD, accN);
 
-        if (m_dumpPoints.good())
-            m_dumpPoints << sizes[i] << "," << delays[i] << std::endl;
+    if (m_dumpPoints.good())
+    {
+        for (size_t i = 0; i < window.Count(); i++)
+            m_dumpPoints << window.Size(i) << "," << window.Delay(i) << std::endl;
     }
 
     if (accN < 1e-6)
@@ -348,7 +310,7 @@ void NetPred::UpdateModelNormal(std::deque<double>& delays, std::deque<double>&
         if (m_dumpPoints.good())
             m_dumpPoints << "UpdateModelSmall ......" << std::endl;
 
-        return UpdateModelSmall(delays, sizes);
+        return UpdateModelSmall(window);
     }
     else
     {
@@ -363,11 +325,11 @@ void NetPred::UpdateModelNormal(std::deque<double>& delays, std::deque<double>&
 
 }
 
-void NetPred::UpdateModelSmall(std::deque<double>& delays, std::deque<double>& sizes)
+void NetPred::UpdateModelSmall(const WeightedWindow& window)
 {
 
-    double meanDelay = WeightedMean(delays);
-    double meanSize = WeightedMean(sizes);
+    double meanDelay = window.MeanDelay();
+    double meanSize = window.MeanSize();
 
     if (m_dumpPoints.good())
         m_dumpPoints << "MeanSize, MeanDelay: " << meanSize << "," << meanDelay << std::endl;
@@ -387,52 +349,28 @@ void NetPred::UpdateModelSmall(std::deque<double>& delays, std::deque<double>& s
     }
 }
 
-void NetPred::UpdateModelSafe(std::deque<double>& delays, std::deque<double>& sizes)
+void NetPred::UpdateModelSafe(const WeightedWindow& window)
 {
 
-    double meanDelay = WeightedMean(delays);
-    double meanSize = WeightedMean(sizes);
+    double meanDelay = window.MeanDelay();
+    double meanSize = window.MeanSize();
 
-    std::deque<double> safeDelays;
-    std::deque<double> safeSizes;
-
-    for (size_t i = 0; i < delays.size(); i ++)
+    // Keep only points on the same side of the means for both axes. This
+    // depends on the current means, so it is a full pass over the window,
+    // but it only runs when the normal model fails the sanity check.
+    m_safeWindow.Assign(window);
+    for (size_t i = 0; i < window.Count(); i ++)
     {
-        double deltaX = delays[i] - meanDelay;
-        double deltaY = sizes[i] - meanSize;
-        if (deltaX * deltaY > 0)
-        {
-            safeDelays.push_back(delays[i]);
-            safeSizes.push_back(sizes[i]);
-        }
-        else
+        double deltaX = window.Delay(i) - meanDelay;
+        double deltaY = window.Size(i) - meanSize;
+        if (!(deltaX * deltaY > 0))
         {
-            safeDelays.push_back(0.0);
-            safeSizes.push_back(0.0);
+            m_safeWindow.Set(i, 0.0, 0.0);
         }
     }
+    m_safeWindow.Recompute();
 
-    UpdateModelNormal(safeDelays, safeSizes);
-}
-
-double NetPred::WeightedMean(std::deque<double>& data)
-{
-
-    double accD = 0.0;
-    double accN = 0.0;
-    double weight = 1.0;
-    for (auto ite = data.begin(); ite != data.end(); ite++)
-    {
-        accD += weight * (*ite);
-        accN += weight;
-        weight *= m_forgotRatio;
-    }
-    if (accN < 1e-6)
-    {
-        return 0.0;
-    }
-    return accD / accN;
-
+    UpdateModelNormal(m_safeWindow);
 }
 
 bool NetPred::OscillationDetected()
@@ -580,6 +518,13 @@ uint32_t NetPred::GetNextFrameSize()
 void NetPred::SetRecordedLen(int record_len)
 {
     m_recordedLen = record_len;
+
+    // Windows are preallocated here, so updates never allocate
+    size_t capacity = record_len > 0 ? size_t(record_len) : 0;
+    m_window.Reset(capacity, m_forgotRatio);
+    m_seededWindow.Reset(capacity, m_forgotRatio);
+    m_safeWindow.Reset(capacity, m_forgotRatio);
+    m_pointsSinceEffective = 0;
 }
 
 void NetPred::SetTargetDelay(double target_in_ms)
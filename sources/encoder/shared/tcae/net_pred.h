@@ -21,6 +21,7 @@
 #include <deque>
 #include <iostream>
 #include <fstream>
+#include "weighted_window.h"
 
 class NetPred
 {
@@ -55,11 +56,9 @@ protected:
     void CheckNewSteadyState(uint32_t encoded_size, double delay_in_ms);
     void AdjustTarget(double delay_in_ms);
 
-    void UpdateModelNormal(std::deque<double>& m_delays, std::deque<double>& m_sizes);
-    void UpdateModelSmall(std::deque<double>& m_delays, std::deque<double>& m_sizes);
-    void UpdateModelSafe(std::deque<double>& m_delays, std::deque<double>& m_sizes);
-
-    double WeightedMean(std::deque<double>& data);
+    void UpdateModelNormal(const WeightedWindow& window);
+    void UpdateModelSmall(const WeightedWindow& window);
+    void UpdateModelSafe(const WeightedWindow& window);
 
     bool SanityCheck();
     bool IsSpikeOn();
@@ -78,8 +77,13 @@ protected:
 
     double m_forgotRatio;
 
-    std::deque<double> m_delays;
-    std::deque<double> m_sizes;
+    // Last m_recordedLen (delay, size) points, newest first
+    WeightedWindow m_window;
+    // Preallocated copies of m_window for the fallback model updates
+    WeightedWindow m_seededWindow;
+    WeightedWindow m_safeWindow;
+    // Number of points pushed since the last one above m_effectiveSizeThreshold
+    size_t m_pointsSinceEffective;
 
     std::deque<double> m_effectiveDelays;
     std::deque<double> m_effectiveSizes;
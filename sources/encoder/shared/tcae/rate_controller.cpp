@@ -0,0 +1,112 @@
+// Copyright (C) 2018-2022 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions
+// and limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include <math.h>
+#include <strings.h>
+#include "rate_controller.h"
+#include "enc_frame_settings_predictor.h"
+#include "bbr_controller.h"
+#include "delay_gradient_controller.h"
+#include "net_pred.h"
+
+namespace {
+
+// Adapter exposing NetPred through the RateController interface.
+// Packet loss and credit bytes are not part of the NetPred model.
+class NetPredRateController : public RateController
+{
+public:
+    void SetTargetDelay(double target_in_ms) override { m_netPred.SetTargetDelay(target_in_ms); }
+    void SetMaxTargetSize(uint32_t maxBytes) override { m_netPred.SetMaxTargetSize(maxBytes); }
+    void SetMinTargetSize(uint32_t minBytes) override { m_netPred.SetMinTargetSize(minBytes); }
+    void SetRecordedLen(int record_len) override { m_netPred.SetRecordedLen(record_len); }
+    void SetFPS(double fps) override { m_netPred.SetFPS(fps); }
+
+    void UpdateNetworkState(const PerFrameNetworkData_t& data, uint32_t encodedSize) override
+    {
+        uint32_t delayInMs = uint32_t(ceil(double(data.lastPacketDelayInUs) / 1000.0));
+
+        m_lastTransmittedSize = data.transmittedDataSizeInBytes;
+        m_netPred.UpdateSizeAndDelay(data.transmittedDataSizeInBytes, encodedSize, delayInMs);
+    }
+
+    void UpdateEncodedSize(uint32_t encodedSize) override
+    {
+        m_netPred.UpdateSizeAndDelay(m_lastTransmittedSize, encodedSize, -1);
+    }
+
+    uint32_t GetNextFrameSize() override { return m_netPred.GetNextFrameSize(); }
+
+private:
+    NetPred m_netPred;
+    uint32_t m_lastTransmittedSize = 0;
+};
+
+struct RateControllerName
+{
+    const char* name;
+    tcaeRateController type;
+};
+
+const RateControllerName RateControllerNames[] = {
+    { "netpred",        TCAE_RC_NETPRED },
+    { "gcc",            TCAE_RC_DELAY_GRADIENT },
+    { "delay-gradient", TCAE_RC_DELAY_GRADIENT },
+    { "bbr",            TCAE_RC_BBR },
+};
+
+} // namespace
+
+std::unique_ptr<RateController> CreateRateController(tcaeRateController type)
+{
+    switch (type)
+    {
+    case TCAE_RC_NETPRED:
+        return std::unique_ptr<RateController>(new NetPredRateController());
+    case TCAE_RC_DELAY_GRADIENT:
+        return std::unique_ptr<RateController>(new DelayGradientController());
+    case TCAE_RC_BBR:
+        return std::unique_ptr<RateController>(new BbrController());
+    default:
+        return nullptr;
+    }
+}
+
+bool GetRateControllerByName(const char* name, tcaeRateController* type)
+{
+    if (!name || !type)
+        return false;
+
+    for (const auto& entry : RateControllerNames)
+    {
+        if (strcasecmp(entry.name, name) == 0)
+        {
+            *type = entry.type;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* GetRateControllerName(tcaeRateController type)
+{
+    for (const auto& entry : RateControllerNames)
+    {
+        if (entry.type == type)
+            return entry.name;
+    }
+    return "unknown";
+}
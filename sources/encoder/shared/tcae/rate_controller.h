@@ -0,0 +1,63 @@
+// Copyright (C) 2018-2022 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions
+// and limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef __RATE_CONTROLLER_H__
+#define __RATE_CONTROLLER_H__
+
+#include <stdint.h>
+#include <memory>
+
+struct PerFrameNetworkData_t;
+
+enum tcaeRateController
+{
+    TCAE_RC_NETPRED        = 0,   /**< delay/size regression (NetPred), default */
+    TCAE_RC_DELAY_GRADIENT = 1,   /**< delay-gradient trend estimator with AIMD, GCC-like */
+    TCAE_RC_BBR            = 2,   /**< bottleneck bandwidth and min delay estimator, BBR-like */
+};
+
+// Congestion control strategy used by PredictorTcaeImpl to pick the next
+// target frame size. All sizes are in bytes and delays in milliseconds.
+class RateController
+{
+public:
+    virtual ~RateController() = default;
+
+    virtual void SetTargetDelay(double target_in_ms) = 0;
+    virtual void SetMaxTargetSize(uint32_t maxBytes) = 0;
+    virtual void SetMinTargetSize(uint32_t minBytes) = 0;
+    virtual void SetRecordedLen(int record_len) = 0;
+    virtual void SetFPS(double fps) = 0;
+
+    // Client feedback for one frame, paired with its encoded size
+    // (0 if the encoded size is not known).
+    virtual void UpdateNetworkState(const PerFrameNetworkData_t& data, uint32_t encodedSize) = 0;
+
+    // Encoded frame for which there is no client feedback yet.
+    virtual void UpdateEncodedSize(uint32_t encodedSize) = 0;
+
+    virtual uint32_t GetNextFrameSize() = 0;
+};
+
+std::unique_ptr<RateController> CreateRateController(tcaeRateController type);
+
+// Maps "netpred", "gcc"/"delay-gradient" and "bbr" to a controller type.
+// Returns false for unknown names.
+bool GetRateControllerByName(const char* name, tcaeRateController* type);
+
+const char* GetRateControllerName(tcaeRateController type);
+
+#endif
@@ -0,0 +1,219 @@
+// Copyright (C) 2018-2022 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions
+// and limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "weighted_window.h"
+
+void WeightedWindow::Reset(size_t capacity, double forgotRatio)
+{
+    m_capacity = capacity;
+    m_delays.assign(capacity, 0.0);
+    m_sizes.assign(capacity, 0.0);
+
+    m_ratio = forgotRatio;
+    m_ratio2 = forgotRatio * forgotRatio;
+
+    // Same accumulation order as the per-sample weights
+    double weight = 1.0;
+    for (size_t i = 0; i < capacity; i++)
+        weight *= forgotRatio;
+    m_ratioN = weight;
+    m_ratio2N = weight * weight;
+
+    Clear();
+}
+
+void WeightedWindow::Clear()
+{
+    m_count = 0;
+    m_head = 0;
+    m_pushesSinceRecompute = 0;
+    m_sums = {};
+}
+
+void WeightedWindow::Push(double delay, double size)
+{
+    if (m_capacity == 0)
+        return;
+
+    bool full = (m_count == m_capacity);
+    double oldDelay = 0.0, oldSize = 0.0;
+    if (full)
+    {
+        oldDelay = Delay(m_count - 1);
+        oldSize = Size(m_count - 1);
+    }
+
+    m_head = (m_head == 0) ? m_capacity - 1 : m_head - 1;
+    m_delays[m_head] = delay;
+    m_sizes[m_head] = size;
+    if (!full)
+        m_count++;
+
+    if (++m_pushesSinceRecompute >= m_capacity)
+    {
+        Recompute();
+        return;
+    }
+
+    // Age all samples by one step, add the new one and drop the evicted one
+    Sums& s = m_sums;
+    s.w = 1.0 + m_ratio * s.w;
+    s.d = delay + m_ratio * s.d;
+    s.s = size + m_ratio * s.s;
+    if (full)
+    {
+        s.w -= m_ratioN;
+        s.d -= m_ratioN * oldDelay;
+        s.s -= m_ratioN * oldSize;
+    }
+
+    s.qw *= m_ratio2;
+    s.qd *= m_ratio2;
+    s.qs *= m_ratio2;
+    s.qdd *= m_ratio2;
+    s.qds *= m_ratio2;
+    s.qss *= m_ratio2;
+    if (!IsZero(delay, size))
+    {
+        s.qw += 1.0;
+        s.qd += delay;
+        s.qs += size;
+        s.qdd += delay * delay;
+        s.qds += delay * size;
+        s.qss += size * size;
+    }
+    if (full && !IsZero(oldDelay, oldSize))
+    {
+        s.qw -= m_ratio2N;
+        s.qd -= m_ratio2N * oldDelay;
+        s.qs -= m_ratio2N * oldSize;
+        s.qdd -= m_ratio2N * oldDelay * oldDelay;
+        s.qds -= m_ratio2N * oldDelay * oldSize;
+        s.qss -= m_ratio2N * oldSize * oldSize;
+    }
+}
+
+void WeightedWindow::Assign(const WeightedWindow& src)
+{
+    if (m_capacity < src.m_count)
+        Reset(src.m_capacity, src.m_ratio);
+
+    m_ratio = src.m_ratio;
+    m_ratio2 = src.m_ratio2;
+    m_ratioN = src.m_ratioN;
+    m_ratio2N = src.m_ratio2N;
+    m_head = 0;
+    m_count = src.m_count;
+    for (size_t i = 0; i < m_count; i++)
+    {
+        m_delays[i] = src.Delay(i);
+        m_sizes[i] = src.Size(i);
+    }
+    m_sums = src.m_sums;
+    m_pushesSinceRecompute = 0;
+}
+
+void WeightedWindow::Set(size_t i, double delay, double size)
+{
+    m_delays[Index(i)] = delay;
+    m_sizes[Index(i)] = size;
+}
+
+void WeightedWindow::Recompute()
+{
+    Sums s = {};
+    double weight = 1.0;
+    for (size_t i = 0; i < m_count; i++)
+    {
+        double delay = Delay(i);
+        double size = Size(i);
+
+        s.w += weight;
+        s.d += weight * delay;
+        s.s += weight * size;
+
+        if (!IsZero(delay, size))
+        {
+            double weight2 = weight * weight;
+            s.qw += weight2;
+            s.qd += weight2 * delay;
+            s.qs += weight2 * size;
+            s.qdd += weight2 * delay * delay;
+            s.qds += weight2 * delay * size;
+            s.qss += weight2 * size * size;
+        }
+
+        weight *= m_ratio;
+    }
+
+    m_sums = s;
+    m_pushesSinceRecompute = 0;
+}
+
+double WeightedWindow::MeanDelay() const
+{
+    if (m_sums.w < 1e-6)
+        return 0.0;
+    return m_sums.d / m_sums.w;
+}
+
+double WeightedWindow::MeanSize() const
+{
+    if (m_sums.w < 1e-6)
+        return 0.0;
+    return m_sums.s / m_sums.w;
+}
+
+void WeightedWindow::Covariance(double meanDelay, double meanSize, double& accD, double& accN) const
+{
+    const Sums& s = m_sums;
+
+    accD = s.qds - meanSize * s.qd - meanDelay * s.qs + meanDelay * meanSize * s.qw;
+    accN = s.qss - 2.0 * meanSize * s.qs + meanSize * meanSize * s.qw;
+    if (accN < 0.0)
+        accN = 0.0;
+}
+
+void WeightedWindow::Residual(double a, double b, double& mse, double& count) const
+{
+    mse = 0.0;
+    count = 0.0;
+    if (m_count < 2 || m_ratio2 < 1e-12)
+        return;
+
+    // Drop the newest sample and shift weights so that sample 1 has weight 1.0
+    Sums s = m_sums;
+    double delay = Delay(0);
+    double size = Size(0);
+    if (!IsZero(delay, size))
+    {
+        s.qw -= 1.0;
+        s.qd -= delay;
+        s.qs -= size;
+        s.qdd -= delay * delay;
+        s.qds -= delay * size;
+        s.qss -= size * size;
+    }
+
+    mse = (s.qdd - 2.0 * a * s.qds - 2.0 * b * s.qd
+           + a * a * s.qss + 2.0 * a * b * s.qs + b * b * s.qw) / m_ratio2;
+    count = s.qw / m_ratio2;
+
+    if (mse < 0.0)
+        mse = 0.0;
+    if (count < 0.0)
+        count = 0.0;
+}
@@ -0,0 +1,108 @@
+// Copyright (C) 2018-2022 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions
+// and limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef __WEIGHTED_WINDOW_H__
+#define __WEIGHTED_WINDOW_H__
+
+#include <stddef.h>
+#include <vector>
+
+// Fixed-capacity window of (delay, size) samples with exponential forgetting.
+// Index 0 is the newest sample and has weight 1.0, sample i has weight r^i.
+// Weighted sums are maintained incrementally on Push(), so means, the
+// delay/size regression and the residual error are all O(1) to query.
+// Samples with both delay and size close to zero are kept in the window
+// (they count for the weighted means), but are excluded from the regression
+// and residual sums, which use squared weights r^(2*i).
+class WeightedWindow
+{
+public:
+    WeightedWindow() = default;
+
+    // Sets capacity and forgetting ratio. Drops all samples.
+    void Reset(size_t capacity, double forgotRatio);
+    void Clear();
+
+    // Adds the newest sample, evicting the oldest one if the window is full.
+    void Push(double delay, double size);
+
+    size_t Count() const { return m_count; }
+    size_t Capacity() const { return m_capacity; }
+    double Delay(size_t i) const { return m_delays[Index(i)]; }
+    double Size(size_t i) const { return m_sizes[Index(i)]; }
+
+    // Copies samples of another window. Does not allocate if capacity suffices.
+    void Assign(const WeightedWindow& src);
+    // Overwrites sample i in place. Recompute() must be called afterwards.
+    void Set(size_t i, double delay, double size);
+    // Rebuilds all weighted sums from the samples.
+    void Recompute();
+
+    double MeanDelay() const;
+    double MeanSize() const;
+
+    // sum w^2 * (d - meanDelay) * (s - meanSize) and sum w^2 * (s - meanSize)^2
+    void Covariance(double meanDelay, double meanSize, double& accD, double& accN) const;
+
+    // Weighted squared residual of model d = a * s + b over samples 1..N-1
+    // (newest sample excluded), with sample 1 having weight 1.0.
+    void Residual(double a, double b, double& mse, double& count) const;
+
+private:
+    struct Sums
+    {
+        // weighted by r^i, all samples
+        double w;
+        double d;
+        double s;
+        // weighted by r^(2*i), non-zero samples only
+        double qw;
+        double qd;
+        double qs;
+        double qdd;
+        double qds;
+        double qss;
+    };
+
+    static bool IsZero(double delay, double size)
+    {
+        return delay < 1e-6 && size < 1e-6;
+    }
+
+    size_t Index(size_t i) const
+    {
+        size_t idx = m_head + i;
+        return idx < m_capacity ? idx : idx - m_capacity;
+    }
+
+    std::vector<double> m_delays;
+    std::vector<double> m_sizes;
+    size_t m_capacity = 0;
+    size_t m_count = 0;
+    size_t m_head = 0;
+
+    double m_ratio = 1.0;
+    double m_ratio2 = 1.0;
+    double m_ratioN = 1.0;   // r^capacity, weight of evicted sample after shift
+    double m_ratio2N = 1.0;  // r^(2*capacity)
+
+    // Incremental sums drift with every eviction, rebuild them periodically
+    size_t m_pushesSinceRecompute = 0;
+
+    Sums m_sums = {};
+};
+
+#endif
@@ -0,0 +1,238 @@
+// Copyright (C) 2023 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions
+// and limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include "utils/AdaptiveLadder.h"
+
+extern "C" {
+#include <libavutil/error.h>
+#include <libavutil/macros.h>
+}
+
+#define LADDER_ALIGN 8
+
+AdaptiveLadder::AdaptiveLadder() : CTransLog("AdaptiveLadder")
+{
+}
+
+int AdaptiveLadder::init(const char *spec, const Params &params, int minSize)
+{
+    if (!spec || !*spec || !strcmp(spec, "auto"))
+        spec = ADAPTIVE_LADDER_DEFAULT;
+
+    std::vector<Rung> rungs;
+    std::string s(spec);
+    size_t pos = 0;
+    while (pos <= s.size()) {
+        size_t end = s.find(',', pos);
+        if (end == std::string::npos)
+            end = s.size();
+        std::string item = s.substr(pos, end - pos);
+        pos = end + 1;
+
+        char *p;
+        Rung r;
+        r.scale = strtof(item.c_str(), &p);
+        r.fps = 0;
+        bool valid = p != item.c_str();
+        if (valid && *p == '@') {
+            const char *fps = p + 1;
+            r.fps = strtof(fps, &p);
+            valid = p != fps && r.fps > 0;
+        }
+        if (!valid || *p || r.scale <= 0 || r.scale > 1) {
+            Error("Invalid rung \"%s\" in ladder \"%s\"\n", item.c_str(), spec);
+            return AVERROR(EINVAL);
+        }
+        rungs.push_back(r);
+    }
+
+    if (params.bppFloor <= 0 || params.upMargin < 1 || params.downWindows < 1 ||
+        params.upWindows < 1 || params.windowUs <= 0) {
+        Error("Invalid ladder parameters\n");
+        return AVERROR(EINVAL);
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_spec = rungs;
+    m_params = params;
+    m_minSize = minSize;
+    m_steps.clear();
+    m_rung = 0;
+    return 0;
+}
+
+bool AdaptiveLadder::setBase(int width, int height, float fps, Step *step)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    bool lower = m_rung > 0;
+    m_base = Step{ 0, width, height, fps };
+    m_steps.clear();
+    m_rung = 0;
+    m_starved = m_recovered = 0;
+    m_skipWindow = false;
+    m_windowStartUs = -1;
+
+    // the framerate may not be known, e.g. when encoding at the render rate
+    if (width <= 0 || height <= 0 || fps <= 0) {
+        Warn("No ladder without resolution and framerate, %dx%d@%.2f\n", width, height, fps);
+        return false;
+    }
+
+    for (const Rung &r : m_spec) {
+        Step st;
+        st.rung = (int)m_steps.size();
+        if (m_steps.empty()) {
+            // the top rung is the base itself, not aligned
+            st.width = width;
+            st.height = height;
+        } else {
+            st.width = (int)(width * r.scale) / LADDER_ALIGN * LADDER_ALIGN;
+            st.height = (int)(height * r.scale) / LADDER_ALIGN * LADDER_ALIGN;
+        }
+        st.fps = r.fps > 0 ? FFMIN(r.fps, fps) : fps;
+
+        if (!m_steps.empty()) {
+            const Step &prev = m_steps.back();
+            if (st.width < m_minSize || st.height < m_minSize)
+                continue;
+            // only rungs with fewer pixels per second than the one above
+            if ((double)st.width * st.height * st.fps >= (double)prev.width * prev.height * prev.fps)
+                continue;
+        }
+        m_steps.push_back(st);
+    }
+
+    std::string rungs;
+    for (const Step &st : m_steps)
+        rungs += " " + std::to_string(st.width) + "x" + std::to_string(st.height) + "@" + std::to_string((int)(st.fps + 0.5f));
+    Info("Ladder of %dx%d@%.2f:%s, floor %.3f bits per pixel\n", width, height, fps, rungs.c_str(), m_params.bppFloor);
+
+    if (lower && step)
+        *step = m_steps[0];
+    return lower;
+}
+
+AdaptiveLadder::Step AdaptiveLadder::current() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return stepOf(m_rung);
+}
+
+AdaptiveLadder::Step AdaptiveLadder::base() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_base;
+}
+
+AdaptiveLadder::Step AdaptiveLadder::stepOf(int rung) const
+{
+    if (rung < 0 || rung >= (int)m_steps.size())
+        return Step{ 0, 0, 0, 0 };
+    return m_steps[rung];
+}
+
+void AdaptiveLadder::resetWindow(int64_t nowUs)
+{
+    m_windowStartUs = nowUs;
+    m_bytes = 0;
+    m_budget = 0;
+    m_qpSum = 0;
+    m_qpFrames = 0;
+    m_frames = 0;
+}
+
+bool AdaptiveLadder::update(int64_t nowUs, uint32_t size, int budgetBps, int qp, Step *step)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    // nothing to judge without a budget, e.g. constant QP
+    if (m_steps.size() < 2 || budgetBps <= 0) {
+        m_windowStartUs = -1;
+        return false;
+    }
+
+    if (m_windowStartUs < 0)
+        resetWindow(nowUs);
+
+    m_bytes += size;
+    m_budget += budgetBps;
+    m_frames++;
+    if (qp >= 0) {
+        m_qpSum += qp;
+        m_qpFrames++;
+    }
+
+    if (nowUs - m_windowStartUs < m_params.windowUs)
+        return false;
+
+    bool changed = evaluate(nowUs, step);
+    resetWindow(nowUs);
+    return changed;
+}
+
+bool AdaptiveLadder::evaluate(int64_t nowUs, Step *step)
+{
+    if (m_skipWindow) {
+        m_skipWindow = false;
+        return false;
+    }
+
+    // from the first frame to the last, one frame interval less than the frames
+    double seconds = (double)(nowUs - m_windowStartUs) / 1000000;
+    double achieved = m_bytes * 8.0 / seconds * (m_frames - 1) / m_frames;
+    double budget = (double)m_budget / m_frames;
+    int qp = m_qpFrames ? (int)(m_qpSum / m_qpFrames) : -1;
+
+    const Step &cur = m_steps[m_rung];
+    double bpp = budget / ((double)cur.width * cur.height * cur.fps);
+
+    bool starved = m_rung + 1 < (int)m_steps.size() && bpp < m_params.bppFloor &&
+                   (achieved >= budget * m_params.saturation || qp >= m_params.qpHigh);
+
+    bool recovered = false;
+    if (m_rung > 0) {
+        const Step &up = m_steps[m_rung - 1];
+        double upBpp = budget / ((double)up.width * up.height * up.fps);
+        recovered = upBpp >= m_params.bppFloor * m_params.upMargin && qp < m_params.qpHigh;
+    }
+
+    m_starved = starved ? m_starved + 1 : 0;
+    m_recovered = recovered ? m_recovered + 1 : 0;
+
+    int rung = m_rung;
+    if (m_starved >= m_params.downWindows)
+        rung++;
+    else if (m_recovered >= m_params.upWindows)
+        rung--;
+    else
+        return false;
+
+    const Step &next = m_steps[rung];
+    Info("Stepping %s to %dx%d@%.2f: %.3f bits per pixel at %dx%d@%.2f, budget %.0f kbps, achieved %.0f kbps, qp %d\n",
+         rung > m_rung ? "down" : "up", next.width, next.height, next.fps, bpp,
+         cur.width, cur.height, cur.fps, budget / 1000, achieved / 1000, qp);
+
+    m_rung = rung;
+    m_starved = m_recovered = 0;
+    m_skipWindow = true;
+    if (step)
+        *step = next;
+    return true;
+}
@@ -0,0 +1,114 @@
+// Copyright (C) 2023 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions
+// and limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include <stdint.h>
+#include <mutex>
+#include <vector>
+#include "utils/CTransLog.h"
+
+#define ADAPTIVE_LADDER_DEFAULT          "1,0.75,0.75@30,0.5@30"
+#define ADAPTIVE_LADDER_DEFAULT_BPP      0.05f
+
+/**
+ * Picks the encoding resolution and framerate from the bitrate budget.
+ *
+ * The ladder is a list of rungs, each a scale of the base resolution and
+ * a framerate, from the best to the cheapest. Every second the budget (the
+ * TCAE target or the configured bitrate) is turned into bits per pixel of
+ * the current rung. Below the floor, with the encoder using its budget or
+ * with a high QP, it steps one rung down; when the rung above would get
+ * the floor with some margin and the QP is fine for long enough, it steps
+ * back up.
+ *
+ * The spec is a comma separated list of "scale[@fps]", fps defaulting to
+ * and capped by the base framerate, e.g. "1,0.75,0.75@30,0.5@30".
+ */
+class AdaptiveLadder : public CTransLog
+{
+public:
+    struct Step {
+        int   rung;             ///< 0 for the base resolution and framerate
+        int   width;
+        int   height;
+        float fps;
+    };
+
+    struct Params {
+        float bppFloor = ADAPTIVE_LADDER_DEFAULT_BPP;   ///< bits per pixel below which to step down
+        float upMargin = 1.5f;          ///< the rung above must get bppFloor times this to step up
+        float saturation = 0.75f;       ///< share of the budget used for the encoder to be starved
+        int   qpHigh = 40;              ///< QP at which the encoder is starved whatever the bitrate
+        int   downWindows = 2;          ///< starved windows in a row to step down
+        int   upWindows = 5;            ///< recovered windows in a row to step up
+        int64_t windowUs = 1000000;
+    };
+
+    AdaptiveLadder();
+    AdaptiveLadder(const AdaptiveLadder&) = delete;
+    AdaptiveLadder& operator=(const AdaptiveLadder&) = delete;
+
+    /* Parse |spec|, NULL or "auto" for the default ladder. Rungs smaller than |minSize| are skipped. */
+    int init(const char *spec, const Params &params, int minSize);
+
+    /*
+     * New base resolution and framerate, back to the top rung. True when the
+     * encoder was on a lower rung: it has to switch to |step|, the top rung,
+     * whichever of the resolution or the framerate changed.
+     */
+    bool setBase(int width, int height, float fps, Step *step = nullptr);
+
+    /*
+     * Account one encoded frame of |size| bytes at |nowUs|, with a budget of
+     * |budgetBps| bits per second and a QP, -1 if unknown. True when the
+     * encoder has to switch to |step|.
+     */
+    bool update(int64_t nowUs, uint32_t size, int budgetBps, int qp, Step *step);
+
+    Step current() const;
+
+    /* Base resolution and framerate, all 0 before setBase() */
+    Step base() const;
+
+private:
+    struct Rung {
+        float scale;
+        float fps;      ///< 0 for the base framerate
+    };
+
+    Step stepOf(int rung) const;
+    bool evaluate(int64_t nowUs, Step *step);
+    void resetWindow(int64_t nowUs);
+
+    mutable std::mutex m_mutex;
+    Params m_params;
+    int m_minSize = 0;
+    std::vector<Rung> m_spec;
+    Step m_base = {};
+    std::vector<Step> m_steps;          // rungs of the current base
+    int m_rung = 0;
+
+    int64_t m_windowStartUs = -1;
+    uint64_t m_bytes = 0;
+    uint64_t m_budget = 0;              // sum of the per frame budgets
+    int64_t m_qpSum = 0;
+    int m_qpFrames = 0;
+    int m_frames = 0;
+    bool m_skipWindow = false;          // first window after a switch, with its IDR
+    int m_starved = 0;
+    int m_recovered = 0;
+};
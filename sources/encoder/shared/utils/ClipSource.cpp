@@ -0,0 +1,292 @@
+// Copyright (C) 2023 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions
+// and limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "utils/ClipSource.h"
+
+extern "C" {
+#include <libavutil/error.h>
+#include <libavutil/imgutils.h>
+}
+
+#define CLIP_FRAME_ALIGN 64
+#define CLIP_HUGE_PAGE_SIZE (2 << 20)
+
+/*
+ * The memory holding the clip. Frames given out keep a reference, so the
+ * clip can be closed while the encoder still reads from one of them.
+ */
+struct ClipSource::Mapping {
+    uint8_t *data;
+    size_t size;
+    std::atomic<int> refs;
+
+    void unref() {
+        if (refs.fetch_sub(1) == 1) {
+            munmap(data, size);
+            delete this;
+        }
+    }
+};
+
+void ClipSource::releaseFrame(void *opaque, uint8_t *data)
+{
+    static_cast<Mapping *>(opaque)->unref();
+}
+
+ClipSource::ClipSource() : CTransLog("ClipSource")
+{
+}
+
+ClipSource::~ClipSource()
+{
+    stop();
+    if (mMapping) {
+        mMapping->unref();
+        mMapping = nullptr;
+    }
+}
+
+int ClipSource::parseY4M(const uint8_t *data, size_t size)
+{
+    const uint8_t *eol = (const uint8_t *)memchr(data, '\n', size);
+    if (!eol) {
+        Error("Bad Y4M header\n");
+        return AVERROR_INVALIDDATA;
+    }
+
+    std::string header((const char *)data, eol - data);
+    std::string colorspace = "420";
+    size_t pos = 0;
+    while ((pos = header.find(' ', pos)) != std::string::npos) {
+        pos++;
+        switch (header[pos]) {
+        case 'W': mWidth = atoi(header.c_str() + pos + 1); break;
+        case 'H': mHeight = atoi(header.c_str() + pos + 1); break;
+        case 'C': colorspace = header.substr(pos + 1, header.find(' ', pos) - pos - 1); break;
+        default: break;
+        }
+    }
+    // 8 bit 4:2:0 only, the chroma siting variants share the layout
+    bool yuv420 = colorspace == "420" || colorspace == "420jpeg" ||
+                  colorspace == "420paldv" || colorspace == "420mpeg2";
+    if (mWidth <= 0 || mHeight <= 0 || !yuv420) {
+        Error("Unsupported Y4M clip %dx%d C%s, only 4:2:0 is\n", mWidth, mHeight, colorspace.c_str());
+        return AVERROR_PATCHWELCOME;
+    }
+    mFormat = AV_PIX_FMT_YUV420P;
+    mFrameSize = av_image_get_buffer_size(mFormat, mWidth, mHeight, 1);
+
+    size_t offset = eol - data + 1;
+    while (offset + 5 < size && !memcmp(data + offset, "FRAME", 5)) {
+        eol = (const uint8_t *)memchr(data + offset, '\n', size - offset);
+        if (!eol || size - (eol - data + 1) < mFrameSize)
+            break;
+        offset = eol - data + 1;
+        mOffsets.push_back(offset);
+        offset += mFrameSize;
+    }
+    return 0;
+}
+
+int ClipSource::open(const std::string &path, int width, int height, AVPixelFormat format, bool preload)
+{
+    struct stat st;
+    uint8_t *data = nullptr;
+    size_t size = 0;
+    int ret = 0;
+
+    if (mMapping) {
+        Error("A clip is open already\n");
+        return AVERROR(EINVAL);
+    }
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0 || fstat(fd, &st) < 0 || st.st_size <= 0) {
+        ret = AVERROR(errno ? errno : EINVAL);
+        Error("Open input file: %s failed!\n", path.c_str());
+        if (fd >= 0)
+            close(fd);
+        return ret;
+    }
+    size = st.st_size;
+    data = (uint8_t *)mmap(nullptr, size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        ret = AVERROR(errno);
+        Error("Map input file: %s failed!\n", path.c_str());
+        return ret;
+    }
+    madvise(data, size, MADV_WILLNEED);
+
+    if (size > 9 && !memcmp(data, "YUV4MPEG2", 9)) {
+        ret = parseY4M(data, size);
+    } else if (format != AV_PIX_FMT_RGBA && format != AV_PIX_FMT_BGRA &&
+               format != AV_PIX_FMT_NV12 && format != AV_PIX_FMT_YUV420P) {
+        Error("Unsupported raw clip format %d\n", format);
+        ret = AVERROR(EINVAL);
+    } else if (width <= 0 || height <= 0) {
+        Error("Incorrect video frame size %dx%d\n", width, height);
+        ret = AVERROR(EINVAL);
+    } else {
+        mWidth = width;
+        mHeight = height;
+        mFormat = format;
+        mFrameSize = av_image_get_buffer_size(format, width, height, 1);
+        for (size_t offset = 0; offset + mFrameSize <= size; offset += mFrameSize)
+            mOffsets.push_back(offset);
+    }
+    if (ret == 0 && mOffsets.empty()) {
+        Error("No complete frame in input file: %s\n", path.c_str());
+        ret = AVERROR_INVALIDDATA;
+    }
+    if (ret < 0) {
+        munmap(data, size);
+        mOffsets.clear();
+        return ret;
+    }
+
+    if (preload) {
+        // Frames are copied one after the other, each starting aligned,
+        // into memory backed by huge pages when the system has them.
+        size_t stride = FFALIGN(mFrameSize, CLIP_FRAME_ALIGN);
+        size_t total = FFALIGN(stride * mOffsets.size(), CLIP_HUGE_PAGE_SIZE);
+        const char *backing = "hugetlb";
+        uint8_t *copy = (uint8_t *)mmap(nullptr, total, PROT_READ | PROT_WRITE,
+                                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_POPULATE, -1, 0);
+        if (copy == MAP_FAILED) {
+            backing = "transparent huge pages";
+            copy = (uint8_t *)mmap(nullptr, total, PROT_READ | PROT_WRITE,
+                                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (copy != MAP_FAILED)
+                madvise(copy, total, MADV_HUGEPAGE);
+        }
+        if (copy != MAP_FAILED) {
+            for (size_t i = 0; i < mOffsets.size(); i++) {
+                memcpy(copy + i * stride, data + mOffsets[i], mFrameSize);
+                mOffsets[i] = i * stride;
+            }
+            mprotect(copy, total, PROT_READ);
+            munmap(data, size);
+            data = copy;
+            size = total;
+            Info("Preloaded %zu frames into %zu bytes of %s\n", mOffsets.size(), total, backing);
+        } else {
+            Warn("Preload of input file: %s failed, playing it from the mapping\n", path.c_str());
+        }
+    }
+
+    mMapping = new Mapping{data, size, {1}};
+    Info("Set input file: %s, %dx%d format %d, one frame size: %zu valid frames: %zu\n",
+         path.c_str(), mWidth, mHeight, mFormat, mFrameSize, mOffsets.size());
+    return 0;
+}
+
+AVBufferRef *ClipSource::getFrame(int64_t index)
+{
+    if (!mMapping || mOffsets.empty())
+        return nullptr;
+
+    size_t offset = mOffsets[index % (int64_t)mOffsets.size()];
+    mMapping->refs++;
+    AVBufferRef *ref = av_buffer_create(mMapping->data + offset, mFrameSize,
+                                        releaseFrame, mMapping, AV_BUFFER_FLAG_READONLY);
+    if (!ref)
+        mMapping->unref();
+    return ref;
+}
+
+int ClipSource::start(double fps, FrameFunc func)
+{
+    if (!mMapping || !func)
+        return AVERROR(EINVAL);
+
+    stop();
+    mFps = fps;
+    mFunc = std::move(func);
+    mNextFrame = 0;
+    mLateFrames = 0;
+    mStop = false;
+    if (mFps > 0)
+        mThread = std::thread(&ClipSource::run, this);
+
+    if (mFps > 0)
+        Info("Play %d frames in a loop at %.2f fps\n", getFrameCount(), mFps);
+    else
+        Info("Play %d frames in a loop, one each time a frame is asked for\n", getFrameCount());
+    return 0;
+}
+
+void ClipSource::feed()
+{
+    if (!mFunc || mFps > 0)
+        return;
+
+    AVBufferRef *frame = getFrame(mNextFrame);
+    if (!frame)
+        return;
+    mNextFrame++;
+    mFunc(frame);
+}
+
+void ClipSource::run()
+{
+    const int64_t period_ns = (int64_t)(1000000000.0 / mFps);
+    struct timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+
+    while (!mStop) {
+        AVBufferRef *frame = getFrame(mNextFrame);
+        if (frame) {
+            mNextFrame++;
+            mFunc(frame);
+        }
+
+        next.tv_nsec += period_ns;
+        while (next.tv_nsec >= 1000000000) {
+            next.tv_nsec -= 1000000000;
+            next.tv_sec++;
+        }
+
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (now.tv_sec > next.tv_sec || (now.tv_sec == next.tv_sec && now.tv_nsec > next.tv_nsec)) {
+            // Behind schedule: count it and continue from now rather than
+            // sending a burst of frames to catch up.
+            mLateFrames++;
+            next = now;
+            continue;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, nullptr);
+    }
+}
+
+void ClipSource::stop()
+{
+    mStop = true;
+    if (mThread.joinable())
+        mThread.join();
+    if (mFunc) {
+        Info("Played %lld frames, %lld late\n", (long long)mNextFrame, (long long)mLateFrames);
+        mFunc = nullptr;
+    }
+}
@@ -0,0 +1,99 @@
+// Copyright (C) 2023 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions
+// and limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef CLIP_SOURCE_H
+#define CLIP_SOURCE_H
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+#include "utils/CTransLog.h"
+
+extern "C" {
+#include <libavutil/buffer.h>
+#include <libavutil/pixfmt.h>
+}
+
+/*
+ * A raw video clip kept in memory and played back in a loop.
+ *
+ * The file is mapped, or with preload copied once into huge pages, so no
+ * disk read happens while frames are delivered. Frames are handed out as
+ * read-only AVBufferRefs pointing into the mapping, which stays alive
+ * until the last of them is released.
+ *
+ * Y4M files (8 bit 4:2:0) give their own size and format. Other files are
+ * tightly packed frames of the size and format given to open().
+ */
+class ClipSource : public CTransLog
+{
+public:
+    using FrameFunc = std::function<void(AVBufferRef *frame)>;
+
+    ClipSource();
+    ClipSource(const ClipSource&) = delete;
+    ClipSource& operator=(const ClipSource&) = delete;
+    ~ClipSource();
+
+    /*
+     * @param format    RGBA, BGRA, NV12 or YUV420P, ignored for Y4M files
+     * @param preload   copy the clip into huge pages, with each frame aligned
+     */
+    int open(const std::string &path, int width, int height, AVPixelFormat format, bool preload);
+
+    int getFrameCount() const { return (int)mOffsets.size(); }
+    int getWidth() const { return mWidth; }
+    int getHeight() const { return mHeight; }
+    AVPixelFormat getFormat() const { return mFormat; }
+
+    /* A new reference to frame |index| modulo the frame count, no data is copied. */
+    AVBufferRef *getFrame(int64_t index);
+
+    /*
+     * Delivers consecutive frames to |func|, from the first one again after
+     * the last. With |fps| > 0 frames are delivered by a thread of their own
+     * on a fixed schedule, otherwise one per feed() call, as fast as the
+     * caller asks for them.
+     */
+    int start(double fps, FrameFunc func);
+    void feed();
+    void stop();
+
+private:
+    struct Mapping;
+
+    static void releaseFrame(void *opaque, uint8_t *data);
+    int parseY4M(const uint8_t *data, size_t size);
+    void run();
+
+    Mapping *mMapping = nullptr;
+    std::vector<size_t> mOffsets;
+    size_t mFrameSize = 0;
+    int mWidth = 0;
+    int mHeight = 0;
+    AVPixelFormat mFormat = AV_PIX_FMT_NONE;
+
+    double mFps = 0;
+    FrameFunc mFunc = nullptr;
+    int64_t mNextFrame = 0;
+    int64_t mLateFrames = 0;
+    std::atomic<bool> mStop{false};
+    std::thread mThread;
+};
+
+#endif
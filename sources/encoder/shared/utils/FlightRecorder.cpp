@@ -0,0 +1,292 @@
+// Copyright (C) 2023 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions
+// and limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include <ctime>
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavutil/buffer.h>
+}
+#include "utils/FlightRecorder.h"
+
+namespace {
+    void put_le16(uint8_t *p, uint16_t v)
+    {
+        p[0] = v & 0xff;
+        p[1] = v >> 8;
+    }
+
+    void put_le32(uint8_t *p, uint32_t v)
+    {
+        put_le16(p, v & 0xffff);
+        put_le16(p + 2, v >> 16);
+    }
+
+    void put_le64(uint8_t *p, uint64_t v)
+    {
+        put_le32(p, v & 0xffffffff);
+        put_le32(p + 4, v >> 32);
+    }
+}
+
+FlightRecorder::FlightRecorder(int duration_sec, size_t max_bytes, const char *prefix) :
+    CTransLog("FlightRecorder")
+    ,m_maxDurationUs(int64_t(duration_sec) * 1000000)
+    ,m_maxBytes(max_bytes)
+    ,m_prefix(prefix)
+{
+    Info("Keep last %d seconds (at most %zu bytes) of encoded output\n", duration_sec, max_bytes);
+}
+
+FlightRecorder::~FlightRecorder()
+{
+    if (m_snapshotThread.joinable())
+        m_snapshotThread.join();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    clear();
+}
+
+void FlightRecorder::clear()
+{
+    for (auto &e : m_entries)
+        av_buffer_unref(&e.buf);
+
+    m_firstIndex += m_entries.size();
+    m_entries.clear();
+    m_gopStarts.clear();
+    m_bytes = 0;
+}
+
+void FlightRecorder::pop_front_gop()
+{
+    // Remove everything up to the second key frame
+    uint64_t end = m_gopStarts.size() > 1 ? m_gopStarts[1] : m_firstIndex + m_entries.size();
+
+    while (m_firstIndex < end) {
+        Entry &e = m_entries.front();
+        m_bytes -= e.info.size;
+        av_buffer_unref(&e.buf);
+        m_entries.pop_front();
+        m_firstIndex++;
+    }
+    m_gopStarts.pop_front();
+}
+
+void FlightRecorder::reset(int codec_id, int width, int height, int framerate)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    clear();
+    m_codecId = codec_id;
+    m_width = width;
+    m_height = height;
+    m_framerate = framerate;
+    m_overflowReported = false;
+}
+
+int FlightRecorder::record(const AVPacket *pkt, const FrameInfo &info)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    // Recording always starts at a key frame so the snapshot is decodable
+    if (m_entries.empty() && !info.key_frame)
+        return 0;
+
+    // A reference to the data only, cloning the packet would also allocate
+    // the packet and copy its side data on every frame
+    Entry e = { nullptr, pkt->data, pkt->size, info };
+    if (pkt->buf) {
+        e.buf = av_buffer_ref(pkt->buf);
+    } else {
+        e.buf = av_buffer_alloc(pkt->size);
+        if (e.buf) {
+            memcpy(e.buf->data, pkt->data, pkt->size);
+            e.data = e.buf->data;
+        }
+    }
+    if (!e.buf)
+        return AVERROR(ENOMEM);
+
+    if (info.key_frame)
+        m_gopStarts.push_back(m_firstIndex + m_entries.size());
+    m_entries.push_back(e);
+    m_bytes += info.size;
+
+    // Drop the oldest GOP while the rest still covers the time window,
+    // or while over the byte budget
+    while (m_gopStarts.size() > 1) {
+        const Entry &second = m_entries[m_gopStarts[1] - m_firstIndex];
+        if (info.timestamp_us - second.info.timestamp_us < m_maxDurationUs && m_bytes <= m_maxBytes)
+            break;
+        pop_front_gop();
+    }
+
+    // A single GOP larger than the budget cannot be kept decodable
+    if (m_bytes > m_maxBytes) {
+        if (!m_overflowReported) {
+            Warn("GOP exceeds %zu bytes, recording restarts at next key frame\n", m_maxBytes);
+            m_overflowReported = true;
+        }
+        clear();
+    }
+
+    return 0;
+}
+
+int FlightRecorder::push(const AVPacket *pkt, const FrameInfo &info)
+{
+    if (!pkt || pkt->size <= 0)
+        return AVERROR(EINVAL);
+
+    int ret = record(pkt, info);
+
+    if (m_snapshotRequested.exchange(false))
+        snapshot();
+
+    return ret;
+}
+
+int FlightRecorder::snapshot()
+{
+    if (m_snapshotBusy.exchange(true)) {
+        Warn("Snapshot is being written, request ignored\n");
+        return AVERROR(EBUSY);
+    }
+
+    if (m_snapshotThread.joinable())
+        m_snapshotThread.join();
+
+    std::vector<Entry> entries;
+    int codec_id, width, height, framerate;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        entries.reserve(m_entries.size());
+        for (auto &e : m_entries) {
+            AVBufferRef *ref = av_buffer_ref(e.buf);
+            if (!ref)
+                break;
+            entries.push_back({ ref, e.data, e.size, e.info });
+        }
+        codec_id = m_codecId;
+        width = m_width;
+        height = m_height;
+        framerate = m_framerate;
+    }
+
+    if (entries.empty()) {
+        Warn("Nothing recorded yet, snapshot skipped\n");
+        m_snapshotBusy = false;
+        return AVERROR(EAGAIN);
+    }
+
+    char foo[32] = { 0 };
+    const std::time_t t_c = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+    auto local_tm = std::localtime(&t_c);
+    if (local_tm != nullptr)
+        strftime(foo, sizeof(foo), "%Y-%m-%d_%H-%M-%S", local_tm);
+
+    std::string base_name = m_prefix + "flight_" + foo;
+
+    m_snapshotThread = std::thread(&FlightRecorder::write_snapshot, this, std::move(entries),
+                                   std::move(base_name), codec_id, width, height, framerate);
+    return 0;
+}
+
+void FlightRecorder::write_snapshot(std::vector<Entry> entries, std::string base_name,
+                                    int codec_id, int width, int height, int framerate)
+{
+    std::string ext;
+    bool ivf = false;
+
+    if (codec_id == AV_CODEC_ID_H264) {
+        ext = ".264";
+    } else if (codec_id == AV_CODEC_ID_H265) {
+        ext = ".265";
+    } else if (codec_id == AV_CODEC_ID_AV1) {
+        ext = ".ivf";
+        ivf = true;
+    } else {
+        ext = ".bin";
+    }
+
+    std::string file_name = base_name + ext;
+    std::string meta_name = base_name + ".csv";
+    size_t bytes = 0;
+
+    FILE *fp = fopen(file_name.c_str(), "wb");
+    FILE *meta = fopen(meta_name.c_str(), "w");
+    if (!fp || !meta) {
+        Error("Open file:%s failed!\n", fp ? meta_name.c_str() : file_name.c_str());
+        goto done;
+    }
+
+    if (ivf) {
+        // IVF file header, timestamps in pts of a 1/framerate time base
+        uint8_t header[32] = { 'D', 'K', 'I', 'F' };
+        put_le16(header + 4, 0);
+        put_le16(header + 6, 32);
+        memcpy(header + 8, "AV01", 4);
+        put_le16(header + 12, width);
+        put_le16(header + 14, height);
+        put_le32(header + 16, framerate > 0 ? framerate : 30);
+        put_le32(header + 20, 1);
+        put_le32(header + 24, entries.size());
+        fwrite(header, 1, sizeof(header), fp);
+    }
+
+    fprintf(meta, "index,timestamp_us,pts,size,key_frame,target_bitrate,qp,tcae_target_size\n");
+
+    for (size_t i = 0; i < entries.size(); i++) {
+        const Entry &e = entries[i];
+        const FrameInfo &info = e.info;
+
+        if (ivf) {
+            uint8_t frame_header[12];
+            put_le32(frame_header, e.size);
+            put_le64(frame_header + 4, i);
+            fwrite(frame_header, 1, sizeof(frame_header), fp);
+        }
+        if (fwrite(e.data, 1, e.size, fp) != size_t(e.size)) {
+            Error("Write file:%s failed!\n", file_name.c_str());
+            break;
+        }
+        bytes += e.size;
+
+        fprintf(meta, "%zu,%" PRId64 ",%" PRId64 ",%u,%d,%d,%d,%u\n", i, info.timestamp_us, info.pts,
+                info.size, info.key_frame ? 1 : 0, info.target_bitrate, info.qp, info.tcae_target_size);
+    }
+
+    Info("Snapshot of %zu frames (%zu bytes, %.1f s) written to %s\n", entries.size(), bytes,
+         (entries.back().info.timestamp_us - entries.front().info.timestamp_us) / 1000000.0,
+         file_name.c_str());
+
+done:
+    if (fp)
+        fclose(fp);
+    if (meta)
+        fclose(meta);
+
+    for (auto &e : entries)
+        av_buffer_unref(&e.buf);
+
+    m_snapshotBusy = false;
+}
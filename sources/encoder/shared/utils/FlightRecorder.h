@@ -0,0 +1,98 @@
+// Copyright (C) 2023 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions
+// and limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "utils/CTransLog.h"
+
+struct AVPacket;
+struct AVBufferRef;
+
+/**
+ * Keeps the most recent encoded packets in memory, starting from a key
+ * frame so that the content is always decodable, and writes them to disk
+ * on request. Only the data buffers of the packets are referenced, nothing
+ * is copied unless the encoder hands out packets without a buffer.
+ */
+class FlightRecorder : public CTransLog
+{
+public:
+    struct FrameInfo {
+        int64_t  timestamp_us;      ///< wall clock time the packet left the encoder
+        int64_t  pts;
+        uint32_t size;
+        bool     key_frame;
+        int      target_bitrate;    ///< bits per second
+        int      qp;                ///< last requested QP, 0 if BRC decides
+        uint32_t tcae_target_size;  ///< TCAE target frame size in bytes, 0 if not used
+    };
+
+    FlightRecorder(int duration_sec, size_t max_bytes, const char *prefix = "./");
+    FlightRecorder(const FlightRecorder&) = delete;
+    FlightRecorder& operator=(const FlightRecorder&) = delete;
+    ~FlightRecorder();
+
+    /* Drop all recorded packets, e.g. when the encoder is re-created */
+    void reset(int codec_id, int width, int height, int framerate);
+
+    /* Record one encoded packet. A pending snapshot request is served here. */
+    int push(const AVPacket *pkt, const FrameInfo &info);
+
+    /* Ask for a snapshot on the next packet. Safe to call from a signal handler. */
+    void requestSnapshot() { m_snapshotRequested = true; }
+
+    /* Write recorded packets and their metadata to disk in the background */
+    int snapshot();
+
+private:
+    struct Entry {
+        AVBufferRef *buf;
+        const uint8_t *data;
+        int size;
+        FrameInfo info;
+    };
+
+    int record(const AVPacket *pkt, const FrameInfo &info);
+    void pop_front_gop();
+    void clear();
+    void write_snapshot(std::vector<Entry> entries, std::string base_name, int codec_id, int width, int height, int framerate);
+
+    int64_t  m_maxDurationUs;
+    size_t   m_maxBytes;
+    std::string m_prefix;
+
+    std::mutex m_mutex;
+    std::deque<Entry> m_entries;
+    std::deque<uint64_t> m_gopStarts;   ///< absolute index of key frames in m_entries
+    uint64_t m_firstIndex = 0;          ///< absolute index of m_entries.front()
+    size_t   m_bytes = 0;
+    bool     m_overflowReported = false;
+
+    int m_codecId = 0;
+    int m_width = 0;
+    int m_height = 0;
+    int m_framerate = 0;
+
+    std::atomic<bool> m_snapshotRequested{false};
+    std::atomic<bool> m_snapshotBusy{false};
+    std::thread m_snapshotThread;
+};
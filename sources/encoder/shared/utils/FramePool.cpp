@@ -0,0 +1,249 @@
+// Copyright (C) 2023 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions
+// and limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "utils/FramePool.h"
+
+extern "C" {
+#include <libavutil/error.h>
+#include <libavutil/macros.h>
+}
+
+#define POOL_PAGE_SIZE       4096
+#define POOL_HUGE_PAGE_SIZE  (2 << 20)
+#define POOL_MAX_NODES       256
+#define POOL_MPOL_PREFERRED  1  ///< MPOL_PREFERRED of linux/mempolicy.h
+
+/*
+ * Shared by the pool and the frames it gave out, freed by the last of them.
+ */
+struct FramePool::State {
+    std::mutex mutex;
+    std::vector<uint8_t *> idle;
+    size_t frameSize;
+    size_t mapSize;
+    int low, high, node;
+    bool hugePages;
+    bool closed = false;
+    int refs = 1;
+    Stats stats = {};
+
+    uint8_t *alloc(bool &hugetlb)
+    {
+        uint8_t *p = (uint8_t *)MAP_FAILED;
+        hugetlb = false;
+        if (hugePages) {
+            p = (uint8_t *)mmap(nullptr, mapSize, PROT_READ | PROT_WRITE,
+                                MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            hugetlb = p != MAP_FAILED;
+        }
+        if (p == MAP_FAILED) {
+            p = (uint8_t *)mmap(nullptr, mapSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (p == MAP_FAILED)
+                return nullptr;
+            if (hugePages)
+                madvise(p, mapSize, MADV_HUGEPAGE);
+        }
+        if (node >= 0) {
+            unsigned long mask[POOL_MAX_NODES / (8 * sizeof(unsigned long))] = { 0 };
+            mask[node / (8 * sizeof(unsigned long))] |= 1UL << (node % (8 * sizeof(unsigned long)));
+            syscall(SYS_mbind, p, mapSize, POOL_MPOL_PREFERRED, mask, POOL_MAX_NODES, 0);
+        }
+        // fault the pages in now, on the node just set
+        for (size_t off = 0; off < mapSize; off += POOL_PAGE_SIZE)
+            p[off] = 0;
+        return p;
+    }
+
+    void unmap(uint8_t *p)
+    {
+        munmap(p, mapSize);
+    }
+
+    // with the mutex held, true when the state has to be deleted
+    bool unref()
+    {
+        return --refs == 0;
+    }
+
+    void destroy()
+    {
+        for (uint8_t *p : idle)
+            unmap(p);
+        delete this;
+    }
+
+    static void release(void *opaque, uint8_t *data)
+    {
+        State *s = static_cast<State *>(opaque);
+        bool keep, last;
+        {
+            std::lock_guard<std::mutex> lock(s->mutex);
+            s->stats.inUse--;
+            keep = !s->closed && (int)s->idle.size() < s->low;
+            if (keep) {
+                s->idle.push_back(data);
+            } else {
+                s->stats.allocated--;
+                if (!s->closed)
+                    s->stats.trims++;
+            }
+            last = s->unref();
+        }
+        if (!keep)
+            s->unmap(data);
+        if (last)
+            s->destroy();
+    }
+};
+
+FramePool::FramePool() : CTransLog("FramePool")
+{
+}
+
+FramePool::~FramePool()
+{
+    close();
+}
+
+// Frames still in use are unmapped when released
+void FramePool::close()
+{
+    if (!mState)
+        return;
+
+    logStats();
+    bool last;
+    {
+        std::lock_guard<std::mutex> lock(mState->mutex);
+        mState->closed = true;
+        last = mState->unref();
+    }
+    if (last)
+        mState->destroy();
+    mState = nullptr;
+}
+
+int FramePool::init(size_t frameSize, int low, int high, int node, bool hugePages)
+{
+    close();
+
+    mState = new State;
+    mState->frameSize = frameSize;
+    mState->mapSize = FFALIGN(frameSize, hugePages ? POOL_HUGE_PAGE_SIZE : POOL_PAGE_SIZE);
+    mState->high = FFMAX(high, 1);
+    mState->low = FFMIN(FFMAX(low, 0), mState->high);
+    mState->node = node;
+    mState->hugePages = hugePages;
+
+    for (int i = 0; i < mState->low; i++) {
+        bool hugetlb;
+        uint8_t *p = mState->alloc(hugetlb);
+        if (!p) {
+            Warn("Preallocated %d of %d frames of %zu bytes: %s\n", i, mState->low, frameSize, strerror(errno));
+            return AVERROR(ENOMEM);
+        }
+        mState->idle.push_back(p);
+        mState->stats.allocated++;
+        mState->stats.hugetlb += hugetlb;
+    }
+
+    Info("Preallocated %d frames of %zu bytes, up to %d, on %s of node %s\n", mState->low, frameSize,
+         mState->high, mState->stats.hugetlb ? "huge pages" : hugePages ? "transparent huge pages" : "pages",
+         node >= 0 ? std::to_string(node).c_str() : "any");
+    return 0;
+}
+
+AVBufferRef *FramePool::get()
+{
+    if (!mState)
+        return nullptr;
+
+    State *s = mState;
+    uint8_t *p = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(s->mutex);
+        if (!s->idle.empty()) {
+            p = s->idle.back();
+            s->idle.pop_back();
+        } else if (s->stats.allocated < s->high) {
+            // reserved here, allocated out of the lock below
+            s->stats.allocated++;
+            s->stats.grows++;
+        } else {
+            s->stats.misses++;
+            return nullptr;
+        }
+        s->stats.gets++;
+        s->stats.inUse++;
+        s->stats.peakInUse = FFMAX(s->stats.peakInUse, s->stats.inUse);
+        s->refs++;
+    }
+
+    if (!p) {
+        bool hugetlb;
+        p = s->alloc(hugetlb);
+        std::lock_guard<std::mutex> lock(s->mutex);
+        if (!p) {
+            s->stats.allocated--;
+            s->stats.grows--;
+            s->stats.gets--;
+            s->stats.misses++;
+            s->stats.inUse--;
+            s->unref();  // the pool still holds a reference
+            return nullptr;
+        }
+        s->stats.hugetlb += hugetlb;
+    }
+
+    AVBufferRef *buf = av_buffer_create(p, s->frameSize, State::release, s, 0);
+    if (!buf)
+        State::release(s, p);
+    return buf;
+}
+
+size_t FramePool::frameSize() const
+{
+    return mState ? mState->frameSize : 0;
+}
+
+FramePool::Stats FramePool::stats() const
+{
+    if (!mState)
+        return Stats();
+    std::lock_guard<std::mutex> lock(mState->mutex);
+    return mState->stats;
+}
+
+void FramePool::logStats()
+{
+    if (!mState)
+        return;
+
+    Stats st = stats();
+    Info("%d frames of %zu bytes allocated (low %d, high %d), %d in use, peak %d, "
+         "%llu gets, %llu misses, %llu grows, %llu trims, %d on huge pages\n",
+         st.allocated, mState->frameSize, mState->low, mState->high, st.inUse, st.peakInUse,
+         (unsigned long long)st.gets, (unsigned long long)st.misses,
+         (unsigned long long)st.grows, (unsigned long long)st.trims, st.hugetlb);
+}
@@ -0,0 +1,88 @@
+// Copyright (C) 2023 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions
+// and limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef FRAME_POOL_H
+#define FRAME_POOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "utils/CTransLog.h"
+
+extern "C" {
+#include <libavutil/buffer.h>
+}
+
+/*
+ * Pool of frame sized buffers, preallocated and kept between two
+ * watermarks:
+ *  - low   frames allocated by init(), and kept when idle
+ *  - high  frames allocated at most, get() fails beyond
+ * Frames over the low watermark are allocated when the pipeline falls
+ * behind, and released when they come back while |low| frames are idle.
+ *
+ * Each frame is its own mapping, bound to a NUMA node and optionally
+ * backed by 2MB huge pages, and touched at allocation so that encoding
+ * the first frames doesn't fault pages in.
+ *
+ * Buffers got from the pool can outlive it.
+ */
+class FramePool : public CTransLog
+{
+public:
+    struct Stats {
+        uint64_t gets;       ///< successful get()
+        uint64_t misses;     ///< get() failed, at the high watermark or out of memory
+        uint64_t grows;      ///< frames allocated over the low watermark
+        uint64_t trims;      ///< frames released back to the low watermark
+        int allocated;       ///< frames allocated now
+        int inUse;           ///< frames got and not released yet
+        int peakInUse;
+        int hugetlb;         ///< frames allocated from the huge page reserve so far
+    };
+
+    FramePool();
+    FramePool(const FramePool&) = delete;
+    FramePool& operator=(const FramePool&) = delete;
+    ~FramePool();
+
+    /*
+     * @param frameSize  bytes of a frame
+     * @param low, high  watermarks, as above
+     * @param node       NUMA node to allocate on, -1 for the node of the
+     *                   thread touching the frames first
+     * @param hugePages  back the frames with huge pages, from the huge page
+     *                   reserve or transparent huge pages
+     * @return 0 on success, AVERROR(ENOMEM) if the low watermark can't be
+     *         preallocated, the frames that could be are used then
+     */
+    int init(size_t frameSize, int low, int high, int node, bool hugePages);
+
+    /* A frame, nullptr at the high watermark or out of memory */
+    AVBufferRef *get();
+
+    size_t frameSize() const;
+    Stats stats() const;
+    void logStats();
+
+    struct State;
+
+private:
+    void close();
+
+    State *mState = nullptr;
+};
+
+#endif
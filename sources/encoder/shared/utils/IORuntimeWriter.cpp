@@ -18,12 +18,18 @@
 #include <chrono>
 #include <sstream>
 #include <assert.h>
+#include <errno.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/uio.h>
 
 extern "C" {
 #include <libavcodec/avcodec.h>
 }
 #include "CVAAPIDevice.h"
 #include "utils/IORuntimeWriter.h"
+#include "utils/ThreadPlacement.h"
 
 #define VA_CALL(_FUNC)                                                                \
     {                                                                                 \
@@ -34,6 +40,48 @@ extern "C" {
         }                                                                             \
     }
 
+// Max packets written by one writev() call
+static const size_t RUNTIME_WRITE_BATCH = 64;
+// Output files grow in chunks of this size to avoid extent allocation on every write
+static const off_t RUNTIME_PREALLOC_CHUNK = 16 << 20;
+
+IORuntimeData::~IORuntimeData()
+{
+    if (pkt)
+        av_packet_free(&pkt);
+}
+
+int IORuntimeData::refPacket(const AVPacket *src)
+{
+    if (!pkt)
+        pkt = av_packet_alloc();
+    if (!pkt)
+        return AVERROR(ENOMEM);
+
+    int ret = av_packet_ref(pkt, src);
+    if (ret < 0)
+        return ret;
+
+    type = AV_PACKET;
+    size = pkt->size;
+    key_frame = (pkt->flags & AV_PKT_FLAG_KEY) ? true : false;
+    return 0;
+}
+
+const uint8_t *IORuntimeData::payload() const
+{
+    switch (type) {
+    case SYSTEM_BLOCK:
+        return data;
+    case SYSTEM_BLOCK_COPY:
+        return blk ? blk->vec_data.data() : nullptr;
+    case AV_PACKET:
+        return pkt ? pkt->data : nullptr;
+    default:
+        return nullptr;
+    }
+}
+
 FourCC IORuntimeWriter::avFormatToFourCC(const int av_fmt)
 {
     if (av_fmt == AV_PIX_FMT_RGBA)
@@ -50,10 +98,10 @@ int IORuntimeWriter::copy_image_to_file(IOData data, OFStream of)
 
 int IORuntimeWriter::copy_block_to_file(IOData data, OFStream of)
 {
-    if (data->type != SYSTEM_BLOCK)
+    if (data->type != SYSTEM_BLOCK && data->type != AV_PACKET)
         return -1;
 
-    of->write(reinterpret_cast<const char*>(data->data), data->size);
+    of->write(reinterpret_cast<const char*>(data->payload()), data->size);
     return 0;
 }
 
@@ -112,11 +160,95 @@ void IORuntimeWriter::flush_data_queue(SafeQueue<IOData> &queue)
         queue.pop();
 }
 
+int IORuntimeWriter::write_batch_to_fd(int fd, const std::vector<IOData> &batch, off_t &offset, off_t &prealloc_end)
+{
+    struct iovec iov[RUNTIME_WRITE_BATCH];
+    int iovcnt = 0;
+    size_t total = 0;
+
+    for (const auto &data : batch) {
+        if (iovcnt >= (int)RUNTIME_WRITE_BATCH)
+            break;
+        iov[iovcnt].iov_base = const_cast<uint8_t *>(data->payload());
+        iov[iovcnt].iov_len  = data->size;
+        total += data->size;
+        iovcnt++;
+    }
+
+    if (total == 0)
+        return 0;
+
+    // Reserve disk blocks ahead of the write position. KEEP_SIZE leaves the
+    // file size at the written length, so nothing needs trimming on close.
+    if (prealloc_end >= 0 && offset + (off_t)total > prealloc_end) {
+        off_t len = RUNTIME_PREALLOC_CHUNK;
+        while (offset + (off_t)total > prealloc_end + len)
+            len += RUNTIME_PREALLOC_CHUNK;
+        if (fallocate(fd, FALLOC_FL_KEEP_SIZE, prealloc_end, len) == 0)
+            prealloc_end += len;
+        else
+            prealloc_end = -1; // not supported by the file system, don't retry
+    }
+
+    struct iovec *cur = iov;
+    while (iovcnt > 0) {
+        ssize_t written = writev(fd, cur, iovcnt);
+        if (written < 0) {
+            if (errno == EINTR)
+                continue;
+            Error("Runtime dump write failed: %s\n", strerror(errno));
+            return -1;
+        }
+
+        offset += written;
+
+        // Skip fully written buffers and advance into a partially written one
+        while (iovcnt > 0 && (size_t)written >= cur->iov_len) {
+            written -= cur->iov_len;
+            cur++;
+            iovcnt--;
+        }
+        if (iovcnt > 0) {
+            cur->iov_base = static_cast<uint8_t *>(cur->iov_base) + written;
+            cur->iov_len -= written;
+        }
+    }
+
+    return 0;
+}
+
+bool IORuntimeWriter::admit_data(const STREAM_INDEX idx, const IOData &data)
+{
+    if (idx == OUTPUT_STREAM && mWaitKeyFrame) {
+        if (!data->key_frame) {
+            mDroppedFrames[idx]++;
+            return false;
+        }
+        mWaitKeyFrame = false;
+    }
+
+    if (mDataQueues[idx].size() >= mMaxQueueDepth[idx] ||
+        mQueuedBytes[idx] + data->size > mMaxQueueBytes[idx]) {
+        // Only report the first drop, the total is reported on stop
+        if (mDroppedFrames[idx]++ == 0)
+            Warn("Runtime dump %s queue is full, dropping frames\n", idx == OUTPUT_STREAM ? "output" : "input");
+        if (idx == OUTPUT_STREAM)
+            mWaitKeyFrame = true;
+        return false;
+    }
+
+    mQueuedBytes[idx] += data->size;
+    return true;
+}
+
 IORuntimeWriter::IORuntimeWriter(const int codec_id, const char* prefix) :
     CTransLog("IORuntimeWriter")
     ,mCodecID(codec_id)
     ,mPrefix(prefix)
 {
+    for (auto &bytes : mQueuedBytes)
+        bytes = 0;
+
     Verbose("Create a new iostream writer.\n");
 }
 
@@ -163,14 +295,18 @@ int IORuntimeWriter::startWriting(const RUNTIME_WRITE_MODE mode, const int frame
         }
 
         flush_data_queue(mDataQueues[INPUT_STREAM]);
+        mQueuedBytes[INPUT_STREAM] = 0;
+        mDroppedFrames[INPUT_STREAM] = 0;
 
         // trigger input thread
         mThreads[INPUT_STREAM] = std::thread([this, os, frame_num]() {
+            ThreadPlacement::apply(ThreadPlacement::IO_WRITER, "icr-io-input");
             int count_written = 0;
             Verbose("io runtimewriter input thread function\n");
             while (1) {
                 int ret = -1;
                 auto data_in = this->mDataQueues[INPUT_STREAM].pop();
+                this->mQueuedBytes[INPUT_STREAM] -= data_in->size;
 
                 if (data_in->type == SYSTEM_BLOCK && data_in->data == nullptr)
                     break;
@@ -185,6 +321,7 @@ int IORuntimeWriter::startWriting(const RUNTIME_WRITE_MODE mode, const int frame
                     break;
 
                 case SYSTEM_BLOCK:
+                case AV_PACKET:
                     ret = copy_block_to_file(data_in, os);
                     break;
 
@@ -220,51 +357,69 @@ int IORuntimeWriter::startWriting(const RUNTIME_WRITE_MODE mode, const int frame
             ext = ".ivf";
 
         std::string file_name = mPrefix + "output" + "_" + current_time + ext;
-        auto os = std::make_shared<std::ofstream>(file_name);
-        assert (os.get() != nullptr && "Expected a valid file stream");
-
-        if (!os->good()) {
+        int fd = open(file_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0) {
             Error("Open file:%s failed!", file_name.c_str());
-            os->close();
             return -1;
         }
 
         flush_data_queue(mDataQueues[OUTPUT_STREAM]);
+        mQueuedBytes[OUTPUT_STREAM] = 0;
+        mDroppedFrames[OUTPUT_STREAM] = 0;
+        mWaitKeyFrame = false;
 
         // trigger output thread
-        mThreads[OUTPUT_STREAM] = std::thread([this, os, frame_num]() {
+        mThreads[OUTPUT_STREAM] = std::thread([this, fd, frame_num]() {
+            ThreadPlacement::apply(ThreadPlacement::IO_WRITER, "icr-io-output");
             int count_written = 0;
+            bool finished = false;
+            off_t offset = 0, prealloc_end = 0;
+            std::vector<IOData> popped, batch;
 
             Verbose("io runtimewriter output thread function\n");
-            while (1) {
-                auto out_data = this->mDataQueues[OUTPUT_STREAM].pop();
+            while (!finished) {
+                popped.clear();
+                batch.clear();
+                this->mDataQueues[OUTPUT_STREAM].popAll(popped, RUNTIME_WRITE_BATCH);
 
-                if (out_data->type == SYSTEM_BLOCK && out_data->data == nullptr)
-                    break;
+                size_t popped_bytes = 0;
+                for (auto &out_data : popped) {
+                    popped_bytes += out_data->size;
 
-                // the 1st packet must contain key frame data
-                if (count_written == 0 && !out_data->key_frame) {
-                    Debug("not a key frame  %d %d \n", count_written, out_data->key_frame);
-                    continue;
-                }
+                    if (finished)
+                        continue;
+
+                    if (out_data->type == SYSTEM_BLOCK && out_data->data == nullptr) {
+                        finished = true;
+                        continue;
+                    }
 
-                if (frame_num < 0 || count_written < frame_num) {
-                    if (out_data->type == SYSTEM_BLOCK) {
-                        os->write(reinterpret_cast<const char*>(out_data->data), out_data->size);
-                    } else if (out_data->type == SYSTEM_BLOCK_COPY) {
-                        os->write(reinterpret_cast<const char*>(&out_data->blk->vec_data[0]), out_data->size);
+                    // the 1st packet must contain key frame data
+                    if (count_written == 0 && !out_data->key_frame) {
+                        Debug("not a key frame  %d %d \n", count_written, out_data->key_frame);
+                        continue;
                     }
+
+                    if (out_data->payload() == nullptr)
+                        continue;
+
+                    batch.push_back(out_data);
                     count_written++;
+
+                    if (frame_num > 0 && count_written >= frame_num)
+                        finished = true;
                 }
 
-                if (frame_num > 0 && count_written >= frame_num)
-                    break;
+                if (write_batch_to_fd(fd, batch, offset, prealloc_end) < 0)
+                    finished = true;
+
+                // packet references are released here, after the write
+                this->mQueuedBytes[OUTPUT_STREAM] -= popped_bytes;
             }
-            os->close();
+            close(fd);
             Verbose("io runtimewriter output thread exit\n");
         });
 
-        mStreams[OUTPUT_STREAM] = std::move(os);
         mStatus |= OUTPUT_WRITING;
     }
 
@@ -291,6 +446,8 @@ int IORuntimeWriter::stopWriting(const RUNTIME_WRITE_MODE mode)
 
             mThreads[INPUT_STREAM].join();
         }
+        if (mDroppedFrames[INPUT_STREAM])
+            Info("Runtime dump input dropped %llu frames\n", (unsigned long long)mDroppedFrames[INPUT_STREAM]);
         mStatus &= ~INPUT_WRITING;
     }
 
@@ -305,6 +462,8 @@ int IORuntimeWriter::stopWriting(const RUNTIME_WRITE_MODE mode)
 
             mThreads[OUTPUT_STREAM].join();
         }
+        if (mDroppedFrames[OUTPUT_STREAM])
+            Info("Runtime dump output dropped %llu frames\n", (unsigned long long)mDroppedFrames[OUTPUT_STREAM]);
         mStatus &= ~OUTPUT_WRITING;
     }
 
@@ -339,10 +498,13 @@ int IORuntimeWriter::submitRuntimeData(const RUNTIME_WRITE_MODE mode, std::share
         return -1;
     }
 
-    if (mode == INPUT && (mStatus & INPUT_WRITING))
-        mDataQueues[INPUT_STREAM].push(std::move(data));
-    else if (mode == OUTPUT && (mStatus & OUTPUT_WRITING))
-        mDataQueues[OUTPUT_STREAM].push(std::move(data));
+    if (mode == INPUT && (mStatus & INPUT_WRITING)) {
+        if (admit_data(INPUT_STREAM, data))
+            mDataQueues[INPUT_STREAM].push(std::move(data));
+    } else if (mode == OUTPUT && (mStatus & OUTPUT_WRITING)) {
+        if (admit_data(OUTPUT_STREAM, data))
+            mDataQueues[OUTPUT_STREAM].push(std::move(data));
+    }
 
     return 0;
 }
@@ -16,6 +16,8 @@
 
 #pragma once
 
+#include <atomic>
+#include <sys/types.h>
 #include <fstream>
 #include <functional>
 #include <condition_variable>
@@ -24,6 +26,8 @@
 #include "safe_queue.h"
 #include "utils/CTransLog.h"
 
+struct AVPacket;
+
 template <int a, int b, int c, int d>
 struct fourcc {
     enum { code = (a) | (b << 8) | (c << 16) | (d << 24) };
@@ -50,6 +54,7 @@ enum IORuntimeDataType {
     SYSTEM_IMAGE  = 3,
     SYSTEM_BLOCK  = 4,
     SYSTEM_BLOCK_COPY = 5,
+    AV_PACKET     = 6,
 };
 
 struct BlockData {
@@ -70,6 +75,7 @@ struct IORuntimeData {
         uint8_t *data;                      // if type==SYSTEM_BLOCK
     };
     std::unique_ptr<BlockData> blk;         // if type==SYSTEM_BLOCK_COPY
+    AVPacket *pkt = nullptr;                // if type==AV_PACKET, a reference owned by this object
 
     int format; // FourCC
     uint32_t width;
@@ -78,6 +84,14 @@ struct IORuntimeData {
     uint32_t stride[MAX_PLANES_NUMBER];
     uint32_t offset[MAX_PLANES_NUMBER];
     bool key_frame;
+
+    ~IORuntimeData();
+
+    /* Take a new reference to the packet payload, no data is copied if
+     * the packet is refcounted. */
+    int refPacket(const AVPacket *src);
+
+    const uint8_t *payload() const;
 };
 
 enum RUNTIME_WRITE_MODE {
@@ -131,6 +145,13 @@ private:
 
     void flush_data_queue(SafeQueue<IOData> &queue);
 
+    int write_batch_to_fd(int fd, const std::vector<IOData> &batch, off_t &offset, off_t &prealloc_end);
+
+    /* Decide if a frame can be queued without exceeding the queue limits.
+     * Once an output frame is dropped, the following frames are dropped
+     * up to the next key frame so that the dump stays decodable. */
+    bool admit_data(const STREAM_INDEX idx, const IOData &data);
+
     int mCodecID = 0;
 
     std::string mPrefix;
@@ -140,6 +161,14 @@ private:
 
     SafeQueue<IOData> mDataQueues[STREAM_NUMBER];
 
+    // Queue limits, so that a slow disk drops dump frames instead of
+    // growing memory or stalling the encoder.
+    size_t mMaxQueueDepth[STREAM_NUMBER] = { 8, 256 };
+    size_t mMaxQueueBytes[STREAM_NUMBER] = { 256 << 20, 64 << 20 };
+    std::atomic<size_t> mQueuedBytes[STREAM_NUMBER];
+    bool mWaitKeyFrame = false;
+    uint64_t mDroppedFrames[STREAM_NUMBER] = { 0, 0 };
+
     std::mutex _mutex;
 
     std::thread mThreads[STREAM_NUMBER];
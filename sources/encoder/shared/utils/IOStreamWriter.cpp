@@ -23,10 +23,9 @@ IOStreamWriter::IOStreamWriter() : CTransLog("IOStreamWriter")
 
 IOStreamWriter::~IOStreamWriter()
 {
-    if (mInputFile) {
-        mInputFile->close();
-        delete mInputFile;
-        mInputFile = nullptr;
+    if (mInputClip) {
+        delete mInputClip;
+        mInputClip = nullptr;
     }
 
     if (mOutputFile) {
@@ -36,45 +35,46 @@ IOStreamWriter::~IOStreamWriter()
     }
 }
 
-int IOStreamWriter::setInputStream(const std::string &file_path, const int one_frame_size,
-                                   const int width, const int height, feedInputCallbackFunc func)
+int IOStreamWriter::setInputStream(const std::string &file_path, const int width, const int height,
+                                   AVPixelFormat format, double fps, bool preload,
+                                   feedInputCallbackFunc func)
 {
-    int64_t length = 0;
-
     std::unique_lock<std::mutex> lock(_mutex);
 
-    std::ifstream *is = new std::ifstream(file_path, std::ifstream::binary);
-    if (!is->good()) {
-        Error("Open input file: %s failed!\n", file_path.c_str());
-        goto error;
-    }
-
-    // get length of file:
-    is->seekg (0, is->end);
-    length = is->tellg();
-    is->seekg (0, is->beg);
-
-    if (one_frame_size < 0 || width <= 0 || height <= 0) {
-        Error("Incorrect video frame size or bad file!\n");
-        goto error;
+    ClipSource *clip = new ClipSource();
+    if (clip->open(file_path, width, height, format, preload) < 0) {
+        delete clip;
+        return -1;
     }
 
-    mInputFile = is;
+    delete mInputClip;
+    mInputClip = clip;
     mFeedCbFunc = std::move(func);
-    mVideoFrameWidth = width;
-    mVideoFrameHeight = height;
-    mOneVideoFrameSize = one_frame_size;
-    mValidInputFrameNum = length / one_frame_size;
+    mInputFps = fps;
+    mValidInputFrameNum = clip->getFrameCount();
 
-    Info("Set input file: %s, one frame size: %d valid frames: %d\n",
-            file_path.c_str(), one_frame_size, mValidInputFrameNum);
+    Info("Set input file: %s, valid frames: %d, %s\n", file_path.c_str(), mValidInputFrameNum,
+         fps > 0 ? "paced" : "fed by the encoder");
 
     return 0;
+}
+
+int IOStreamWriter::startInput()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    if (!mInputClip || !mFeedCbFunc)
+        return 0;
+
+    return mInputClip->start(mInputFps, mFeedCbFunc);
+}
 
-error:
-    is->close();
-    delete is;
-    return -1;
+void IOStreamWriter::stopInput()
+{
+    // Not under _mutex: the paced thread may be in the frame callback,
+    // which can end up in writeToOutputStream().
+    if (mInputClip)
+        mInputClip->stop();
 }
 
 int IOStreamWriter::setOutputStream(const std::string &file_path)
@@ -106,31 +106,11 @@ void IOStreamWriter::setOutputFrameNumber(const int frame_num)
 
 void IOStreamWriter::feedVideoFrameFromInputStream()
 {
-    std::unique_lock<std::mutex> lock(_mutex);
-
-    // no valid input set or EoF had reached
-    if (mValidInputFrameNum <= 0 || mInputFile == nullptr)
+    // no valid input set, or the input is paced by its own thread
+    if (mInputClip == nullptr)
         return;
 
-    if (mInputFile->eof()) {
-        Info("EoF reached.\n");
-        mInputFile->close();
-        delete mInputFile;
-        mInputFile = nullptr;
-        return;
-    }
-
-    // allocate memory:
-    char *buffer = new char[mOneVideoFrameSize];
-
-    mInputFile->read(buffer, mOneVideoFrameSize);
-
-    // read a complete frame
-    if (mInputFile->gcount() == mOneVideoFrameSize && mFeedCbFunc) {
-        mFeedCbFunc(mVideoFrameWidth, mVideoFrameHeight, static_cast<const void*>(buffer), 0);
-    }
-
-    delete []buffer;
+    mInputClip->feed();
 }
 
 int IOStreamWriter::writeToOutputStream(const char *data, size_t size) {
@@ -143,16 +123,17 @@ int IOStreamWriter::writeToOutputStream(const char *data, size_t size) {
     mOutputFile->write(data, size);
     mWrittenFrameCount++;
 
-    if (mValidInputFrameNum > 0 && mWrittenFrameCount >= mValidInputFrameNum) {
+    // The input loops, so without a frame number one pass of it is written
+    if (mOutputFrameNumber > 0) {
+        if (mWrittenFrameCount >= mOutputFrameNumber) {
+            Info("Have written enough frames.");
+            goto enough_frame_written;
+        }
+    } else if (mValidInputFrameNum > 0 && mWrittenFrameCount >= mValidInputFrameNum) {
         Info("Have all input frames written.");
         goto enough_frame_written;
     }
 
-    if (mOutputFrameNumber > 0 && mWrittenFrameCount >= mOutputFrameNumber) {
-        Info("Have written enough frames.");
-        goto enough_frame_written;
-    }
-
     return 0;
 
 enough_frame_written:
@@ -21,22 +21,19 @@
 #include <functional>
 #include <condition_variable>
 #include "utils/CTransLog.h"
+#include "utils/ClipSource.h"
 
-using feedInputCallbackFunc = std::function<void(const int width, const int height,
-                                                 const void *pixels, const int flip)>;
+using feedInputCallbackFunc = ClipSource::FrameFunc;
 
 class IOStreamWriter : public CTransLog
 {
 private:
-    std::ifstream *mInputFile = nullptr;
+    ClipSource *mInputClip = nullptr;
     std::ofstream *mOutputFile = nullptr;
 
     /* input parameters */
     int mValidInputFrameNum = -1;
-    int mOneVideoFrameSize  = -1;
-    int mVideoFrameWidth    = -1;
-    int mVideoFrameHeight   = -1;
-    void *mInputCbPrivate   = nullptr;
+    double mInputFps        = 0;
     feedInputCallbackFunc mFeedCbFunc = nullptr;
 
     /* output parameters */
@@ -51,8 +48,22 @@ public:
     IOStreamWriter& operator=(const IOStreamWriter&) = delete;
     virtual ~IOStreamWriter();
 
-    int setInputStream(const std::string &file_path, const int one_frame_size,
-                       const int width, const int height, feedInputCallbackFunc func = nullptr);
+    /*
+     * Plays |file_path| in a loop, see ClipSource. With |fps| > 0 frames are
+     * sent at that rate once startInput() is called, otherwise one for each
+     * feedVideoFrameFromInputStream(). Frames reach |func| without a copy.
+     */
+    int setInputStream(const std::string &file_path, const int width, const int height,
+                       AVPixelFormat format, double fps, bool preload,
+                       feedInputCallbackFunc func = nullptr);
+
+    bool hasInputStream() const { return mInputClip != nullptr; }
+    int getInputWidth() const { return mInputClip ? mInputClip->getWidth() : -1; }
+    int getInputHeight() const { return mInputClip ? mInputClip->getHeight() : -1; }
+    AVPixelFormat getInputFormat() const { return mInputClip ? mInputClip->getFormat() : AV_PIX_FMT_NONE; }
+
+    int startInput();
+    void stopInput();
 
     int setOutputStream(const std::string &file_path);
 
@@ -0,0 +1,237 @@
+// Copyright (C) 2023 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions
+// and limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "utils/IntraRecovery.h"
+
+IntraRecovery::IntraRecovery(int cycle, int windowMs, int escalateMs, int maxWaves)
+    : CTransLog("IntraRecovery"), m_cycle(cycle > 0 ? cycle : 1),
+      m_windowUs((windowMs > 0 ? windowMs : INTRA_RECOVERY_DEFAULT_WINDOW_MS) * 1000LL),
+      m_escalateUs((escalateMs > 0 ? escalateMs : INTRA_RECOVERY_DEFAULT_ESCALATE_MS) * 1000LL),
+      m_maxWaves(maxWaves > 0 ? maxWaves : INTRA_RECOVERY_DEFAULT_MAX_WAVES)
+{
+}
+
+IntraRecovery::~IntraRecovery()
+{
+    logStats();
+}
+
+void IntraRecovery::request(int64_t nowUs, bool idr)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (idr) {
+        switch (m_state) {
+        case IDR_PENDING:
+            break;
+        case REFRESH_PENDING:
+            // the recovery requests are answered by the IDR
+            m_state = IDR_PENDING;
+            break;
+        case REFRESH_SENT:
+            m_stop = true;
+            // fall through
+        default:
+            m_state = IDR_PENDING;
+            m_requestUs = nowUs;
+            m_requests = 0;
+            break;
+        }
+        m_requests++;
+        m_again = false;
+        return;
+    }
+
+    switch (m_state) {
+    case IDR_PENDING:
+    case REFRESH_PENDING:
+        m_requests++;
+        return;
+    case IDR_SENT:
+    case REFRESH_SENT:
+        if (nowUs - m_answerUs < m_windowUs) {
+            m_requests++;
+        } else if (m_state == REFRESH_SENT && nowUs - m_lossUs >= m_escalateUs) {
+            // still losing frames long after the first request
+            escalate(nowUs, m_requests + (m_again ? m_againRequests : 0) + 1);
+        } else if (!m_again) {
+            // lost after the start of the answer, another wave once it's out
+            m_again = true;
+            m_againUs = nowUs;
+            m_againRequests = 1;
+        } else {
+            m_againRequests++;
+        }
+        return;
+    case IDLE:
+        if (m_answerUs >= 0 && nowUs - m_answerUs < m_windowUs && m_last) {
+            m_last->requests++;
+            return;
+        }
+        if (m_waveEndUs >= 0 && nowUs - m_waveEndUs < m_escalateUs) {
+            // the wave is out and the decoder is not repaired
+            escalate(nowUs, 1);
+            return;
+        }
+        m_state = REFRESH_PENDING;
+        m_requestUs = nowUs;
+        m_requests = 1;
+        m_lossUs = nowUs;
+        m_lossWaves = 0;
+        m_waveEndUs = -1;
+        return;
+    }
+}
+
+// With the mutex held
+void IntraRecovery::escalate(int64_t nowUs, int requests)
+{
+    if (m_state == REFRESH_SENT)
+        m_stop = true;
+    m_state = IDR_PENDING;
+    m_requestUs = m_lossUs >= 0 ? m_lossUs : nowUs;
+    m_requests = requests;
+    m_again = false;
+    m_idr.escalations++;
+    Info("No recovery %.1f ms after the first request and %d waves, answering with an IDR\n",
+         (nowUs - m_requestUs) / 1000.0, m_lossWaves);
+}
+
+int IntraRecovery::onFrame(int64_t nowUs)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    int action = NONE;
+    if (m_stop) {
+        action |= REFRESH_STOP;
+        m_stop = false;
+    }
+
+    if (m_state == IDR_PENDING) {
+        action |= IDR;
+        m_state = IDR_SENT;
+    } else if (m_state == REFRESH_PENDING) {
+        // a new wave replaces the one ending
+        action = REFRESH_START;
+        m_state = REFRESH_SENT;
+        m_waveFrames = 0;
+        m_lossWaves++;
+    } else {
+        return action;
+    }
+
+    m_answerUs = nowUs;
+    m_peak = 0;
+    return action;
+}
+
+void IntraRecovery::onEncoded(int64_t nowUs, uint32_t size, bool key)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    bool done = false;
+    if (m_state == IDR_SENT && key) {
+        m_peak = size;
+        finish(m_idr, nowUs, "IDR");
+        // an IDR repairs any loss before it
+        m_lossUs = -1;
+        m_lossWaves = 0;
+        m_waveEndUs = -1;
+        done = true;
+    } else if (m_state == REFRESH_SENT) {
+        if (size > m_peak)
+            m_peak = size;
+        // an IDR of the GOP ends the wave as well
+        if (++m_waveFrames >= m_cycle || key) {
+            finish(m_refresh, nowUs, "intra refresh");
+            m_stop = true;
+            m_waveEndUs = nowUs;
+            done = true;
+        }
+    } else if (!key) {
+        m_usual = m_usual > 0 ? m_usual + (size - m_usual) / 16 : size;
+    }
+
+    if (done) {
+        m_state = IDLE;
+        if (m_again) {
+            if (m_lossUs < 0) {
+                m_lossUs = m_againUs;
+                m_lossWaves = 0;
+            }
+            if (m_lossWaves >= m_maxWaves || nowUs - m_lossUs >= m_escalateUs) {
+                escalate(nowUs, m_againRequests);
+            } else {
+                m_state = REFRESH_PENDING;
+                m_requestUs = m_againUs;
+                m_requests = m_againRequests;
+                m_again = false;
+            }
+        }
+    }
+}
+
+// With the mutex held
+void IntraRecovery::finish(Stats &stats, int64_t nowUs, const char *kind)
+{
+    double ratio = m_usual > 0 ? m_peak / m_usual : 0;
+
+    stats.answers++;
+    stats.requests += m_requests;
+    if ((long)m_peak > stats.peakBytes)
+        stats.peakBytes = m_peak;
+    if (ratio > 0) {
+        stats.peakRatio += ratio;
+        stats.ratioAnswers++;
+    }
+    stats.recoveryUs += nowUs - m_requestUs;
+    m_last = &stats;
+
+    Info("Recovered by %s in %.1f ms for %d requests, largest frame %u bytes, %.1f times the usual\n",
+         kind, (nowUs - m_requestUs) / 1000.0, m_requests, m_peak, ratio);
+    m_requests = 0;
+}
+
+IntraRecovery::Stats IntraRecovery::idrStats() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_idr;
+}
+
+IntraRecovery::Stats IntraRecovery::refreshStats() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_refresh;
+}
+
+void IntraRecovery::logStats()
+{
+    Stats idr = idrStats();
+    Stats refresh = refreshStats();
+    const Stats *all[] = { &idr, &refresh };
+    const char *kinds[] = { "IDR", "intra refresh" };
+
+    for (int i = 0; i < 2; i++) {
+        const Stats &st = *all[i];
+        if (!st.answers)
+            continue;
+        Info("Recovery by %s: %d answers for %d requests, %d escalated, largest frame %ld bytes, "
+             "%.1f times the usual and %.1f ms to recover on average\n",
+             kinds[i], st.answers, st.requests, st.escalations, st.peakBytes,
+             st.ratioAnswers ? st.peakRatio / st.ratioAnswers : 0.0,
+             st.recoveryUs / 1000.0 / st.answers);
+    }
+}
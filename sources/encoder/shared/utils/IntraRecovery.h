@@ -0,0 +1,125 @@
+// Copyright (C) 2023 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions
+// and limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include <stdint.h>
+#include <mutex>
+#include "utils/CTransLog.h"
+
+#define INTRA_RECOVERY_DEFAULT_WINDOW_MS    100
+#define INTRA_RECOVERY_DEFAULT_ESCALATE_MS  1000
+#define INTRA_RECOVERY_DEFAULT_MAX_WAVES    2
+
+/**
+ * Answers key frame requests after lost frames with a rolling intra
+ * refresh wave instead of an IDR, so that the intra coded blocks are
+ * spread over |cycle| frames.
+ *
+ * Recovery requests are coalesced: those coming within |window| of the
+ * start of the answer, IDR or wave, are covered by it; later ones during
+ * a wave start another one when it ends. Requests for an IDR, from a new
+ * subscriber or a reset decoder, are answered with an IDR on the next
+ * frame and end any wave.
+ *
+ * A wave may not repair the decoder, e.g. when the frames it refers to
+ * are lost as well. Recovery escalates to an IDR when a request comes
+ * within |escalate| of the end of a wave, or when waves keep being
+ * asked for |maxWaves| times or |escalate| after the first request.
+ *
+ * The size of the largest frame of each answer, relative to the usual
+ * frame size, and the time from the request to the last frame of the
+ * answer are measured for both kinds.
+ */
+class IntraRecovery : public CTransLog
+{
+public:
+    enum Action {
+        NONE          = 0,
+        IDR           = 1 << 0,   ///< encode the frame as an IDR
+        REFRESH_START = 1 << 1,   ///< start an intra refresh wave on the frame
+        REFRESH_STOP  = 1 << 2,   ///< back to the configured intra refresh
+    };
+
+    struct Stats {
+        int  answers = 0;         ///< IDRs or waves sent
+        int  requests = 0;        ///< requests they answered
+        long peakBytes = 0;       ///< largest frame of all answers
+        double peakRatio = 0;     ///< sum of the largest frame of each answer over the usual frame size
+        int  ratioAnswers = 0;    ///< answers in peakRatio, the first ones have no usual size
+        int64_t recoveryUs = 0;   ///< sum of the times from the first request to the last frame
+        int  escalations = 0;     ///< IDRs sent because waves did not recover
+    };
+
+    IntraRecovery(int cycle, int windowMs = INTRA_RECOVERY_DEFAULT_WINDOW_MS,
+                  int escalateMs = INTRA_RECOVERY_DEFAULT_ESCALATE_MS,
+                  int maxWaves = INTRA_RECOVERY_DEFAULT_MAX_WAVES);
+    IntraRecovery(const IntraRecovery&) = delete;
+    IntraRecovery& operator=(const IntraRecovery&) = delete;
+    ~IntraRecovery();
+
+    int cycle() const { return m_cycle; }
+
+    /* Ask for an IDR or, if |idr| is false, for recovery from lost frames. Any thread. */
+    void request(int64_t nowUs, bool idr);
+
+    /* What to do on the next frame sent to the encoder, a combination of Action */
+    int onFrame(int64_t nowUs);
+
+    /* Account a frame out of the encoder */
+    void onEncoded(int64_t nowUs, uint32_t size, bool key);
+
+    Stats idrStats() const;
+    Stats refreshStats() const;
+    void logStats();
+
+private:
+    enum State {
+        IDLE,
+        IDR_PENDING,        // answer on the next frame
+        IDR_SENT,           // until the IDR comes out
+        REFRESH_PENDING,
+        REFRESH_SENT,       // until the wave comes out
+    };
+
+    void finish(Stats &stats, int64_t nowUs, const char *kind);
+    void escalate(int64_t nowUs, int requests);
+
+    mutable std::mutex m_mutex;
+    const int m_cycle;
+    const int64_t m_windowUs;
+    const int64_t m_escalateUs;
+    const int m_maxWaves;
+
+    State m_state = IDLE;
+    bool m_stop = false;            // the wave has to be stopped on the next frame
+    bool m_again = false;           // requests during an answer, after its window
+    int64_t m_againUs = 0;
+    int m_againRequests = 0;
+    int64_t m_requestUs = 0;        // first request of the current answer
+    int64_t m_answerUs = -1;        // start of the last answer, for the window
+    int m_requests = 0;             // requests of the current answer
+    int m_waveFrames = 0;           // frames of the wave out of the encoder
+    uint32_t m_peak = 0;            // largest frame of the current answer
+    double m_usual = 0;             // average size of the frames outside answers
+    Stats *m_last = nullptr;        // kind of the last answer
+    int64_t m_lossUs = -1;          // first request not recovered by an IDR yet, -1 if none
+    int m_lossWaves = 0;            // waves sent since
+    int64_t m_waveEndUs = -1;       // end of the last wave since
+
+    Stats m_idr;
+    Stats m_refresh;
+};
@@ -0,0 +1,309 @@
+// Copyright (C) 2023 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions
+// and limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include <string.h>
+#include <algorithm>
+#include "utils/RgbToYuv.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define RGB2YUV_X86
+#endif
+
+extern "C" {
+#include <libavutil/error.h>
+}
+
+/* Frames from this size on are converted in row bands, 1440p and up */
+#define RGB2YUV_THREAD_PIXELS (2560 * 1440)
+#define RGB2YUV_MAX_THREADS   4
+
+/*
+ * Weights of the bytes of a pixel as laid out in memory, alpha last, with
+ * 8 fractional bits. The luma ones are unsigned, the chroma ones signed,
+ * so that each fits a byte of the SIMD multiply-add.
+ */
+struct RgbToYuv::Coeffs {
+    uint8_t y[4];
+    int8_t u[4];
+    int8_t v[4];
+};
+
+static const RgbToYuv::Coeffs kRgbaCoeffs = {
+    { 66, 129, 25, 0 }, { -38, -74, 112, 0 }, { 112, -94, -18, 0 },
+};
+
+static const RgbToYuv::Coeffs kBgraCoeffs = {
+    { 25, 129, 66, 0 }, { 112, -74, -38, 0 }, { -18, -94, 112, 0 },
+};
+
+/* Rounding and the offset of 16 */
+#define RGB2YUV_Y_ADD (128 + (16 << 8))
+
+static inline uint8_t avg_u8(int a, int b)
+{
+    return (uint8_t)((a + b + 1) >> 1);
+}
+
+static inline uint8_t luma(const uint8_t *p, const RgbToYuv::Coeffs &k)
+{
+    return (uint8_t)((k.y[0] * p[0] + k.y[1] * p[1] + k.y[2] * p[2] + RGB2YUV_Y_ADD) >> 8);
+}
+
+static inline uint8_t chroma(const uint8_t *p, const int8_t *w)
+{
+    return (uint8_t)(((w[0] * p[0] + w[1] * p[1] + w[2] * p[2] + 128) >> 8) + 128);
+}
+
+/*
+ * Converts the pixels from |x| on of two source rows. Chroma is sampled
+ * from the average of each 2x2 block, averaged vertically first, which is
+ * what the SIMD kernels do as well. |v| null writes interleaved UV to |u|.
+ */
+static void rows_c(const uint8_t *s0, const uint8_t *s1, uint8_t *y0, uint8_t *y1,
+                   uint8_t *u, uint8_t *v, int x, int width, const RgbToYuv::Coeffs &k)
+{
+    for (; x < width; x += 2) {
+        const uint8_t *a = s0 + x * 4;
+        const uint8_t *b = s1 + x * 4;
+        y0[x]     = luma(a, k);
+        y0[x + 1] = luma(a + 4, k);
+        y1[x]     = luma(b, k);
+        y1[x + 1] = luma(b + 4, k);
+
+        uint8_t c[4];
+        for (int i = 0; i < 4; i++)
+            c[i] = avg_u8(avg_u8(a[i], b[i]), avg_u8(a[i + 4], b[i + 4]));
+        if (v) {
+            u[x / 2] = chroma(c, k.u);
+            v[x / 2] = chroma(c, k.v);
+        } else {
+            u[x]     = chroma(c, k.u);
+            u[x + 1] = chroma(c, k.v);
+        }
+    }
+}
+
+static void rows_scalar(const uint8_t *s0, const uint8_t *s1, uint8_t *y0, uint8_t *y1,
+                        uint8_t *u, uint8_t *v, int width, const RgbToYuv::Coeffs &k)
+{
+    rows_c(s0, s1, y0, y1, u, v, 0, width, k);
+}
+
+#ifdef RGB2YUV_X86
+static inline int32_t pack_weights(const void *w)
+{
+    int32_t packed;
+    memcpy(&packed, w, sizeof(packed));
+    return packed;
+}
+
+/*
+ * Luma of 32 pixels. The pixels are made signed by subtracting 128, which
+ * |add| gives back with the weights unsigned. The sum then fits 16 bits,
+ * unsigned. The horizontal adds and the pack work per 128 bit lane, the
+ * final permute puts the 4 pixel groups back in order.
+ */
+__attribute__((target("avx2")))
+static inline __m256i luma_avx2(const uint8_t *s, __m256i ky, __m256i add, __m256i order)
+{
+    const __m256i sign = _mm256_set1_epi8((char)0x80);
+    __m256i m[4];
+    for (int i = 0; i < 4; i++) {
+        __m256i p = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)(s + 32 * i)), sign);
+        m[i] = _mm256_maddubs_epi16(ky, p);
+    }
+    __m256i lo = _mm256_srli_epi16(_mm256_add_epi16(_mm256_hadd_epi16(m[0], m[1]), add), 8);
+    __m256i hi = _mm256_srli_epi16(_mm256_add_epi16(_mm256_hadd_epi16(m[2], m[3]), add), 8);
+    return _mm256_permutevar8x32_epi32(_mm256_packus_epi16(lo, hi), order);
+}
+
+/* 2x2 averages of 16 pixels of two rows, as 8 pixels in order */
+__attribute__((target("avx2")))
+static inline __m256i average_avx2(const uint8_t *s0, const uint8_t *s1)
+{
+    __m256 a = _mm256_castsi256_ps(_mm256_avg_epu8(_mm256_loadu_si256((const __m256i *)s0),
+                                                   _mm256_loadu_si256((const __m256i *)s1)));
+    __m256 b = _mm256_castsi256_ps(_mm256_avg_epu8(_mm256_loadu_si256((const __m256i *)(s0 + 32)),
+                                                   _mm256_loadu_si256((const __m256i *)(s1 + 32))));
+    __m256i even = _mm256_castps_si256(_mm256_shuffle_ps(a, b, 0x88));
+    __m256i odd  = _mm256_castps_si256(_mm256_shuffle_ps(a, b, 0xdd));
+    return _mm256_permute4x64_epi64(_mm256_avg_epu8(even, odd), 0xd8);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i chroma_avx2(__m256i c0, __m256i c1, __m256i kc, __m256i round, __m256i bias)
+{
+    __m256i sum = _mm256_hadd_epi16(_mm256_maddubs_epi16(c0, kc), _mm256_maddubs_epi16(c1, kc));
+    return _mm256_add_epi16(_mm256_srai_epi16(_mm256_add_epi16(sum, round), 8), bias);
+}
+
+__attribute__((target("avx2")))
+static void rows_avx2(const uint8_t *s0, const uint8_t *s1, uint8_t *y0, uint8_t *y1,
+                      uint8_t *u, uint8_t *v, int width, const RgbToYuv::Coeffs &k)
+{
+    const __m256i ky    = _mm256_set1_epi32(pack_weights(k.y));
+    const __m256i ku    = _mm256_set1_epi32(pack_weights(k.u));
+    const __m256i kv    = _mm256_set1_epi32(pack_weights(k.v));
+    const __m256i yadd  = _mm256_set1_epi16((short)(RGB2YUV_Y_ADD +
+                                                        128 * (k.y[0] + k.y[1] + k.y[2])));
+    const __m256i round = _mm256_set1_epi16(128);
+    const __m256i bias  = _mm256_set1_epi16(128);
+    const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+
+    int x = 0;
+    for (; x + 32 <= width; x += 32) {
+        const uint8_t *a = s0 + x * 4;
+        const uint8_t *b = s1 + x * 4;
+        _mm256_storeu_si256((__m256i *)(y0 + x), luma_avx2(a, ky, yadd, order));
+        _mm256_storeu_si256((__m256i *)(y1 + x), luma_avx2(b, ky, yadd, order));
+
+        __m256i c0 = average_avx2(a, b);
+        __m256i c1 = average_avx2(a + 64, b + 64);
+        __m256i cu = chroma_avx2(c0, c1, ku, round, bias);
+        __m256i cv = chroma_avx2(c0, c1, kv, round, bias);
+        // 16 U then 16 V
+        __m256i uv = _mm256_permutevar8x32_epi32(_mm256_packus_epi16(cu, cv), order);
+        __m128i lo = _mm256_castsi256_si128(uv);
+        __m128i hi = _mm256_extracti128_si256(uv, 1);
+        if (v) {
+            _mm_storeu_si128((__m128i *)(u + x / 2), lo);
+            _mm_storeu_si128((__m128i *)(v + x / 2), hi);
+        } else {
+            _mm_storeu_si128((__m128i *)(u + x), _mm_unpacklo_epi8(lo, hi));
+            _mm_storeu_si128((__m128i *)(u + x + 16), _mm_unpackhi_epi8(lo, hi));
+        }
+    }
+    rows_c(s0, s1, y0, y1, u, v, x, width, k);
+}
+#endif
+
+RgbToYuv::RgbToYuv(int maxThreads, bool allowSimd) : CTransLog("RgbToYuv")
+{
+    mRows = rows_scalar;
+#ifdef RGB2YUV_X86
+    if (allowSimd && __builtin_cpu_supports("avx2"))
+        mRows = rows_avx2;
+#endif
+
+    if (maxThreads <= 0)
+        maxThreads = std::min<int>(RGB2YUV_MAX_THREADS, std::max(1u, std::thread::hardware_concurrency()));
+    mMaxThreads = maxThreads;
+
+    Info("%s kernel, up to %d threads\n", kernelName(), mMaxThreads);
+}
+
+RgbToYuv::~RgbToYuv()
+{
+    {
+        std::lock_guard<std::mutex> lock(mWorkMutex);
+        mStop = true;
+    }
+    mCond.notify_all();
+    for (std::thread &t : mThreads)
+        t.join();
+}
+
+const char *RgbToYuv::kernelName() const
+{
+    return mRows == rows_scalar ? "C" : "AVX2";
+}
+
+bool RgbToYuv::isSupported(AVPixelFormat src, AVPixelFormat dst, int width, int height)
+{
+    return (src == AV_PIX_FMT_RGBA || src == AV_PIX_FMT_BGRA) &&
+           (dst == AV_PIX_FMT_NV12 || dst == AV_PIX_FMT_YUV420P) &&
+           width > 0 && height > 0 && !(width & 1) && !(height & 1);
+}
+
+void RgbToYuv::worker()
+{
+    std::unique_lock<std::mutex> lock(mWorkMutex);
+    while (true) {
+        mCond.wait(lock, [this]{ return mStop || mNext < mCount; });
+        if (mStop)
+            return;
+        int i = mNext++;
+        const std::function<void(int)> *fn = mJob;
+        lock.unlock();
+        (*fn)(i);
+        lock.lock();
+        if (--mPending == 0)
+            mDone.notify_all();
+    }
+}
+
+// Runs fn(0) .. fn(n - 1), the calling thread takes part
+void RgbToYuv::runBands(int n, const std::function<void(int)> &fn)
+{
+    std::unique_lock<std::mutex> lock(mWorkMutex);
+    while ((int)mThreads.size() < n - 1)
+        mThreads.emplace_back(&RgbToYuv::worker, this);
+    mJob = &fn;
+    mNext = 0;
+    mCount = mPending = n;
+    mCond.notify_all();
+    while (mNext < mCount) {
+        int i = mNext++;
+        lock.unlock();
+        fn(i);
+        lock.lock();
+        mPending--;
+    }
+    mDone.wait(lock, [this]{ return mPending == 0; });
+    mJob = nullptr;
+    mCount = mNext = 0;
+}
+
+int RgbToYuv::convert(const uint8_t *src, int srcStride, AVPixelFormat srcFmt, int width, int height,
+                      bool flip, uint8_t *const dst[], const int dstStride[], AVPixelFormat dstFmt)
+{
+    if (!src || !dst || !isSupported(srcFmt, dstFmt, width, height) || srcStride < width * 4) {
+        Error("Unsupported conversion of %dx%d from %d to %d\n", width, height, srcFmt, dstFmt);
+        return AVERROR(EINVAL);
+    }
+
+    const Coeffs &k = srcFmt == AV_PIX_FMT_RGBA ? kRgbaCoeffs : kBgraCoeffs;
+    const bool planar = dstFmt == AV_PIX_FMT_YUV420P;
+    RowFunc rows = mRows;
+
+    auto band = [&](int first, int last) {
+        for (int i = first; i < last; i += 2) {
+            const uint8_t *s0 = src + (ptrdiff_t)srcStride * (flip ? height - 1 - i : i);
+            const uint8_t *s1 = src + (ptrdiff_t)srcStride * (flip ? height - 2 - i : i + 1);
+            uint8_t *y0 = dst[0] + (ptrdiff_t)dstStride[0] * i;
+            uint8_t *y1 = y0 + dstStride[0];
+            uint8_t *u  = dst[1] + (ptrdiff_t)dstStride[1] * (i / 2);
+            uint8_t *v  = planar ? dst[2] + (ptrdiff_t)dstStride[2] * (i / 2) : nullptr;
+            rows(s0, s1, y0, y1, u, v, width, k);
+        }
+    };
+
+    int n = 1;
+    if (mMaxThreads > 1 && width * height >= RGB2YUV_THREAD_PIXELS)
+        n = std::min(mMaxThreads, height / 16);
+    if (n <= 1) {
+        band(0, height);
+        return 0;
+    }
+
+    // Bands of an even number of rows
+    int rows_per_band = ((height / 2 + n - 1) / n) * 2;
+    runBands(n, [&](int i) {
+        band(std::min(height, i * rows_per_band), std::min(height, (i + 1) * rows_per_band));
+    });
+    return 0;
+}
@@ -0,0 +1,92 @@
+// Copyright (C) 2023 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions
+// and limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef RGB_TO_YUV_H
+#define RGB_TO_YUV_H
+
+#include <stdint.h>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "utils/CTransLog.h"
+
+extern "C" {
+#include <libavutil/pixfmt.h>
+}
+
+/*
+ * Converts RGBA or BGRA system memory frames to NV12 or I420 (BT.601,
+ * limited range) in a single pass over the source, flipping them
+ * vertically on the way if asked.
+ *
+ * The row kernel is picked at run time: AVX2 where the CPU has it, plain
+ * C otherwise. Both give the same output. Large frames are split in row
+ * bands converted in parallel.
+ */
+class RgbToYuv : public CTransLog
+{
+public:
+    /*
+     * @param maxThreads  threads of one conversion, the caller included,
+     *                    0 for up to 4 depending on the CPU count
+     * @param allowSimd   false to use the C kernel only
+     */
+    RgbToYuv(int maxThreads = 0, bool allowSimd = true);
+    RgbToYuv(const RgbToYuv&) = delete;
+    RgbToYuv& operator=(const RgbToYuv&) = delete;
+    ~RgbToYuv();
+
+    /* Width and height have to be even. */
+    static bool isSupported(AVPixelFormat src, AVPixelFormat dst, int width, int height);
+
+    /*
+     * A crop is converted by pointing |src| at its top left pixel, with
+     * |srcStride| staying the one of the whole frame.
+     *
+     * @param dst, dstStride  Y and UV planes for NV12, Y, U and V for I420
+     * @return 0 on success, AVERROR(EINVAL) for unsupported parameters
+     */
+    int convert(const uint8_t *src, int srcStride, AVPixelFormat srcFmt, int width, int height,
+                bool flip, uint8_t *const dst[], const int dstStride[], AVPixelFormat dstFmt);
+
+    const char *kernelName() const;
+
+    struct Coeffs;
+    typedef void (*RowFunc)(const uint8_t *s0, const uint8_t *s1, uint8_t *y0, uint8_t *y1,
+                            uint8_t *u, uint8_t *v, int width, const Coeffs &k);
+
+private:
+    void runBands(int n, const std::function<void(int)> &fn);
+    void worker();
+
+    RowFunc mRows;
+    int mMaxThreads;
+
+    /* Row band workers, started on first use */
+    std::mutex mWorkMutex;
+    std::condition_variable mCond;
+    std::condition_variable mDone;
+    std::vector<std::thread> mThreads;
+    const std::function<void(int)> *mJob = nullptr;
+    int mNext = 0;
+    int mCount = 0;
+    int mPending = 0;
+    bool mStop = false;
+};
+
+#endif
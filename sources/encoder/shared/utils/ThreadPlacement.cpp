@@ -0,0 +1,314 @@
+// Copyright (C) 2023 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions
+// and limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <fstream>
+#include <mutex>
+#include "utils/CTransLog.h"
+#include "utils/ThreadPlacement.h"
+
+#define PLACEMENT_NODE_GPU    (-2)
+#define PLACEMENT_MAX_NODES   256
+#define PLACEMENT_MPOL_PREFERRED 1  ///< MPOL_PREFERRED of linux/mempolicy.h
+
+namespace {
+    struct Policy {
+        bool set = false;
+        std::vector<int> cpus;  ///< cpus= or the CPUs of node=
+        int node = -1;
+        int fifo = 0;
+        bool has_nice = false;
+        int nice = 0;
+    };
+
+    const char *g_roleNames[ThreadPlacement::ROLE_NUM] = { "transcoder", "vhal", "pipe", "io" };
+
+    std::mutex g_mutex;
+    Policy g_policies[ThreadPlacement::ROLE_NUM];
+    thread_local int t_node = -1;
+    thread_local bool t_applied = false;
+
+    CTransLog &log()
+    {
+        static CTransLog s_log("ThreadPlacement");
+        return s_log;
+    }
+
+    pid_t current_tid()
+    {
+        return (pid_t)syscall(SYS_gettid);
+    }
+
+    bool read_line(const std::string &path, std::string &line)
+    {
+        std::ifstream is(path);
+        return is.good() && std::getline(is, line);
+    }
+
+    std::string format_cpus(const cpu_set_t &set)
+    {
+        std::string out;
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+            if (!CPU_ISSET(cpu, &set))
+                continue;
+            int last = cpu;
+            while (last + 1 < CPU_SETSIZE && CPU_ISSET(last + 1, &set))
+                last++;
+            if (!out.empty())
+                out += ",";
+            out += std::to_string(cpu);
+            if (last > cpu)
+                out += "-" + std::to_string(last);
+            cpu = last;
+        }
+        return out;
+    }
+
+    // NUMA node of a DRM render node, -1 if unknown
+    int render_node_numa(const char *render_dev)
+    {
+        std::string line;
+        const char *base = render_dev ? strrchr(render_dev, '/') : nullptr;
+        if (!base || !read_line(std::string("/sys/class/drm") + base + "/device/numa_node", line))
+            return -1;
+        return atoi(line.c_str());
+    }
+
+    bool parse_policy(const std::string &entry, const char *render_dev, int &role, Policy &policy)
+    {
+        std::vector<std::string> fields;
+        size_t start = 0, sep;
+        do {
+            sep = entry.find(':', start);
+            fields.push_back(entry.substr(start, sep == std::string::npos ? sep : sep - start));
+            start = sep + 1;
+        } while (sep != std::string::npos);
+
+        role = -1;
+        for (int i = 0; i < ThreadPlacement::ROLE_NUM; i++) {
+            if (fields[0] == g_roleNames[i])
+                role = i;
+        }
+        if (role < 0 && fields[0] != "all") {
+            log().Error("Unknown thread role '%s'\n", fields[0].c_str());
+            return false;
+        }
+
+        policy.set = true;
+        for (size_t i = 1; i < fields.size(); i++) {
+            size_t eq = fields[i].find('=');
+            std::string key = fields[i].substr(0, eq);
+            std::string val = eq == std::string::npos ? "" : fields[i].substr(eq + 1);
+            char *end = nullptr;
+            long num = strtol(val.c_str(), &end, 10);
+            bool is_num = !val.empty() && *end == '\0';
+
+            if (key == "cpus") {
+                if (!ThreadPlacement::parseCpuList(val, policy.cpus))
+                    goto bad_value;
+            } else if (key == "node") {
+                if (val == "gpu")
+                    policy.node = PLACEMENT_NODE_GPU;
+                else if (is_num && num >= 0 && num < PLACEMENT_MAX_NODES)
+                    policy.node = (int)num;
+                else
+                    goto bad_value;
+            } else if (key == "fifo") {
+                if (!is_num || num < sched_get_priority_min(SCHED_FIFO) || num > sched_get_priority_max(SCHED_FIFO))
+                    goto bad_value;
+                policy.fifo = (int)num;
+            } else if (key == "nice") {
+                if (!is_num || num < -20 || num > 19)
+                    goto bad_value;
+                policy.has_nice = true;
+                policy.nice = (int)num;
+            } else {
+                log().Error("Unknown thread setting '%s'\n", key.c_str());
+                return false;
+            }
+            continue;
+
+bad_value:
+            log().Error("Bad value '%s' of thread setting %s\n", val.c_str(), key.c_str());
+            return false;
+        }
+
+        if (policy.node == PLACEMENT_NODE_GPU) {
+            policy.node = render_node_numa(render_dev);
+            if (policy.node < 0)
+                log().Warn("NUMA node of %s unknown, not placing %s threads on it\n",
+                           render_dev ? render_dev : "the GPU", fields[0].c_str());
+        }
+        if (policy.node >= 0 && policy.cpus.empty()) {
+            std::string list;
+            std::string path = "/sys/devices/system/node/node" + std::to_string(policy.node) + "/cpulist";
+            if (!read_line(path, list) || !ThreadPlacement::parseCpuList(list, policy.cpus)) {
+                log().Error("Can't get the CPUs of NUMA node %d\n", policy.node);
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+bool ThreadPlacement::parseCpuList(const std::string &list, std::vector<int> &cpus)
+{
+    std::vector<int> out;
+    const char *p = list.c_str();
+    while (*p) {
+        char *end;
+        long first = strtol(p, &end, 10), last = first;
+        if (end == p)
+            return false;
+        p = end;
+        if (*p == '-') {
+            last = strtol(p + 1, &end, 10);
+            if (end == p + 1)
+                return false;
+            p = end;
+        }
+        if (first < 0 || last < first || last >= CPU_SETSIZE)
+            return false;
+        for (long cpu = first; cpu <= last; cpu++)
+            out.push_back((int)cpu);
+        if (*p == ',')
+            p++;
+        else if (*p && *p != '\n')
+            return false;
+        else if (*p == '\n')
+            break;
+    }
+    if (out.empty())
+        return false;
+    cpus.swap(out);
+    return true;
+}
+
+int ThreadPlacement::configure(const char *policy, const char *render_dev)
+{
+    Policy policies[ROLE_NUM];
+    Policy defaults;
+    std::string spec = policy ? policy : "";
+
+    size_t start = 0, sep;
+    while (start < spec.size()) {
+        sep = spec.find(';', start);
+        std::string entry = spec.substr(start, sep == std::string::npos ? sep : sep - start);
+        start = sep == std::string::npos ? spec.size() : sep + 1;
+        if (entry.empty())
+            continue;
+
+        int role;
+        Policy parsed;
+        if (!parse_policy(entry, render_dev, role, parsed))
+            return -1;
+        if (role < 0)
+            defaults = parsed;
+        else
+            policies[role] = parsed;
+    }
+
+    std::lock_guard<std::mutex> lock(g_mutex);
+    for (int i = 0; i < ROLE_NUM; i++) {
+        g_policies[i] = policies[i].set ? policies[i] : defaults;
+    }
+    if (!spec.empty())
+        log().Info("Thread policy: %s\n", spec.c_str());
+    return 0;
+}
+
+void ThreadPlacement::apply(Role role, const char *name)
+{
+    char short_name[16];
+    snprintf(short_name, sizeof(short_name), "%s", name);
+    pthread_setname_np(pthread_self(), short_name);
+    t_applied = true;
+
+    Policy policy;
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        if (role >= 0 && role < ROLE_NUM)
+            policy = g_policies[role];
+    }
+
+    pid_t tid = current_tid();
+    if (!policy.cpus.empty()) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int cpu : policy.cpus)
+            CPU_SET(cpu, &set);
+        if (sched_setaffinity(tid, sizeof(set), &set) < 0)
+            log().Warn("%s: can't set CPU affinity: %s\n", short_name, strerror(errno));
+    }
+    if (policy.node >= 0) {
+        unsigned long mask[PLACEMENT_MAX_NODES / (8 * sizeof(unsigned long))] = { 0 };
+        mask[policy.node / (8 * sizeof(unsigned long))] |= 1UL << (policy.node % (8 * sizeof(unsigned long)));
+        if (syscall(SYS_set_mempolicy, PLACEMENT_MPOL_PREFERRED, mask, PLACEMENT_MAX_NODES) < 0)
+            log().Warn("%s: can't prefer memory of node %d: %s\n", short_name, policy.node, strerror(errno));
+        else
+            t_node = policy.node;
+    }
+    if (policy.fifo > 0) {
+        struct sched_param param = {};
+        param.sched_priority = policy.fifo;
+        int ret = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+        if (ret != 0)
+            log().Warn("%s: can't set SCHED_FIFO %d: %s\n", short_name, policy.fifo, strerror(ret));
+    }
+    if (policy.has_nice && setpriority(PRIO_PROCESS, tid, policy.nice) < 0)
+        log().Warn("%s: can't set nice %d: %s\n", short_name, policy.nice, strerror(errno));
+
+    // What the thread actually got
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    sched_getaffinity(tid, sizeof(set), &set);
+    int sched_policy = SCHED_OTHER;
+    struct sched_param param = {};
+    pthread_getschedparam(pthread_self(), &sched_policy, &param);
+    errno = 0;
+    int nice = getpriority(PRIO_PROCESS, tid);
+
+    log().Info("Thread %s (tid %d, %s): cpus %s, %s %d, nice %d, memory node %s\n", short_name, (int)tid,
+               role >= 0 && role < ROLE_NUM ? g_roleNames[role] : "?", format_cpus(set).c_str(),
+               sched_policy == SCHED_FIFO ? "SCHED_FIFO" : sched_policy == SCHED_RR ? "SCHED_RR" : "SCHED_OTHER",
+               param.sched_priority, errno ? 0 : nice, t_node >= 0 ? std::to_string(t_node).c_str() : "any");
+}
+
+void ThreadPlacement::applyOnce(Role role, const char *name)
+{
+    if (!t_applied)
+        apply(role, name);
+}
+
+int ThreadPlacement::currentNode()
+{
+    return t_node;
+}
+
+int ThreadPlacement::roleNode(Role role)
+{
+    std::lock_guard<std::mutex> lock(g_mutex);
+    return role >= 0 && role < ROLE_NUM ? g_policies[role].node : -1;
+}
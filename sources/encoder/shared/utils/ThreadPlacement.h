@@ -0,0 +1,75 @@
+// Copyright (C) 2023 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions
+// and limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+/**
+ * CPU affinity, scheduling and naming of the encoder threads, by role.
+ *
+ * The policy is a list of roles separated by ';', each followed by its
+ * settings separated by ':', e.g.
+ *
+ *     transcoder:cpus=4-5:fifo=10;vhal:node=gpu:nice=-5;io:nice=10
+ *
+ * Roles are transcoder, vhal, pipe and io, or all for the defaults of the
+ * roles not listed. Settings are
+ *  - cpus=<list>   CPUs to run on, as in 0-3,8
+ *  - node=<n|gpu>  NUMA node to run on and allocate from, gpu for the node
+ *                  of the render device
+ *  - fifo=<1-99>   SCHED_FIFO priority
+ *  - nice=<n>      nice level, -20 to 19
+ *
+ * Threads apply the policy of their role themselves, when they start, and
+ * the threads they start inherit it. Every thread is named, with or without
+ * a policy.
+ */
+class ThreadPlacement
+{
+public:
+    enum Role {
+        TRANSCODER,
+        VHAL_RECEIVER,
+        PIPE_MSG,
+        IO_WRITER,
+        ROLE_NUM
+    };
+
+    /**
+     * @param policy      as above, null or empty for none
+     * @param render_dev  render node of the GPU, e.g. /dev/dri/renderD128
+     * @return 0 on success, -1 if the policy can't be parsed, nothing is
+     *         applied then
+     */
+    static int configure(const char *policy, const char *render_dev);
+
+    /* Apply the policy of |role| to the calling thread, named |name|. */
+    static void apply(Role role, const char *name);
+
+    /* apply() once per thread, for threads started by libraries */
+    static void applyOnce(Role role, const char *name);
+
+    /* NUMA node the calling thread was placed on, -1 if none */
+    static int currentNode();
+
+    /* NUMA node threads of |role| are placed on, -1 if none */
+    static int roleNode(Role role);
+
+    /* Parse a CPU list as in 0-3,8, false if malformed */
+    static bool parseCpuList(const std::string &list, std::vector<int> &cpus);
+};
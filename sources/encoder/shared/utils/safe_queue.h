@@ -19,6 +19,7 @@
 #include <condition_variable>
 #include <mutex>
 #include <queue>
+#include <vector>
 
 template <class T>
 class SafeQueue {
@@ -57,6 +58,29 @@ class SafeQueue {
         return value;
     }
 
+    // Block until at least one element is available, then move up to
+    // max_count elements to out in one go.
+    size_t popAll(std::vector<T> &out, size_t max_count) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (queue_.empty()) {
+            condition_.wait(lock);
+        }
+        size_t count = 0;
+        while (!queue_.empty() && count < max_count) {
+            out.push_back(std::move(queue_.front()));
+            queue_.pop_front();
+            count++;
+        }
+        lock.unlock();
+        condition_.notify_one();
+        return count;
+    }
+
+    size_t size() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return queue_.size();
+    }
+
     bool empty() {
         std::lock_guard<std::mutex> lock(mutex_);
         return queue_.empty();
@@ -0,0 +1,230 @@
+// Copyright (C) 2023 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions
+// and limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+// AdaptiveLadder: when it steps a 1280x720@60 encoder down on a starved
+// link and back up with hysteresis, what static content and a high QP
+// change, rebasing on a new size or framerate, and the parsing of a spec.
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "utils/AdaptiveLadder.h"
+
+#include "sim_encoder.h"
+
+namespace {
+    // An encoder at the ladder's current rung, using |usage| of its budget
+    struct Sim : SimEncoder {
+        AdaptiveLadder ladder;
+        AdaptiveLadder::Step cur;
+        std::vector<AdaptiveLadder::Step> switches;
+
+        Sim(const char *spec = nullptr) : SimEncoder(60)
+        {
+            ladder.init(spec, AdaptiveLadder::Params(), 128);
+            ladder.setBase(1280, 720, fps);
+            setStep(ladder.current());
+        }
+
+        void setStep(const AdaptiveLadder::Step &step)
+        {
+            cur = step;
+            fps = step.fps;
+        }
+
+        void run(int seconds, int budgetBps, double usage = 1.0, int qp = -1)
+        {
+            encodeFor(seconds, [&](int64_t nowUs) {
+                uint32_t size = (uint32_t)(budgetBps * usage / 8 / fps);
+                AdaptiveLadder::Step step;
+                if (ladder.update(nowUs, size, budgetBps, qp, &step)) {
+                    switches.push_back(step);
+                    setStep(step);
+                }
+            });
+        }
+
+        // The client asks for another framerate, as CTransCoder::setFramerate()
+        void setFramerate(float newFps)
+        {
+            AdaptiveLadder::Step base = ladder.base();
+            AdaptiveLadder::Step step = cur;
+            ladder.setBase(base.width, base.height, newFps, &step);
+            step.fps = newFps;
+            setStep(step);
+        }
+    };
+
+    ::testing::AssertionResult is(const AdaptiveLadder::Step &st, int w, int h, float fps)
+    {
+        if (st.width == w && st.height == h && st.fps == fps)
+            return ::testing::AssertionSuccess();
+        return ::testing::AssertionFailure() << st.width << "x" << st.height << "@" << st.fps
+                                             << " instead of " << w << "x" << h << "@" << fps;
+    }
+}
+
+TEST(AdaptiveLadderTest, StepsDownOnStarvedLink)
+{
+    Sim sim;
+    EXPECT_TRUE(is(sim.cur, 1280, 720, 60)) << "top rung";
+
+    // 1 Mbps used up: 0.018 bits per pixel at the top
+    sim.run(10, 1000000);
+    ASSERT_EQ(sim.switches.size(), 2u);
+    EXPECT_TRUE(is(sim.switches[0], 960, 536, 60)) << "smaller";
+    EXPECT_TRUE(is(sim.switches[1], 960, 536, 30)) << "slower";
+    EXPECT_EQ(sim.ladder.current().rung, 2) << "0.065 bits per pixel kept";
+
+    // down to the last rung, not below
+    sim.run(20, 300000);
+    EXPECT_TRUE(is(sim.cur, 640, 360, 30));
+    EXPECT_EQ(sim.switches.size(), 3u);
+}
+
+TEST(AdaptiveLadderTest, WaitsForTwoStarvedWindows)
+{
+    Sim sim;
+    sim.run(2, 1000000);
+    EXPECT_TRUE(sim.switches.empty()) << "not on the first starved window";
+    sim.run(1, 1000000);
+    EXPECT_EQ(sim.switches.size(), 1u) << "on the second";
+
+    // the window of the encoder restart is ignored, two more are needed
+    sim.run(2, 1000000);
+    EXPECT_EQ(sim.switches.size(), 1u) << "restart window skipped";
+    sim.run(2, 1000000);
+    EXPECT_EQ(sim.switches.size(), 2u) << "next step";
+}
+
+TEST(AdaptiveLadderTest, StaticContentKeepsRung)
+{
+    Sim sim;
+    sim.run(30, 1000000, 0.1);
+    EXPECT_TRUE(sim.switches.empty()) << "budget not used, no step";
+
+    // unless the QP says the encoder is starved anyway
+    sim.run(3, 1000000, 0.1, 45);
+    EXPECT_EQ(sim.switches.size(), 1u);
+    EXPECT_TRUE(is(sim.cur, 960, 536, 60)) << "high qp";
+}
+
+TEST(AdaptiveLadderTest, StepsUpWithHysteresis)
+{
+    Sim sim;
+    sim.run(10, 1000000);
+    EXPECT_EQ(sim.ladder.current().rung, 2) << "down";
+
+    // 3 Mbps: 0.097 at 960x536@60, above 1.5 times the floor, only
+    // 0.054 at the top
+    sim.run(4, 3000000);
+    EXPECT_EQ(sim.ladder.current().rung, 2) << "not recovered yet";
+    sim.run(2, 3000000);
+    EXPECT_TRUE(is(sim.cur, 960, 536, 60)) << "one step up";
+    sim.run(60, 3000000);
+    EXPECT_EQ(sim.ladder.current().rung, 1) << "hysteresis";
+    EXPECT_EQ(sim.switches.size(), 3u);
+
+    // not up while the QP is high
+    sim.run(60, 8000000, 1.0, 42);
+    EXPECT_EQ(sim.ladder.current().rung, 1) << "high qp";
+    sim.run(10, 8000000, 1.0, 30);
+    EXPECT_TRUE(is(sim.cur, 1280, 720, 60)) << "back to the top";
+}
+
+TEST(AdaptiveLadderTest, NoOscillationAroundFloor)
+{
+    // just under the floor at the top
+    Sim sim;
+    sim.run(120, 2600000);
+    EXPECT_EQ(sim.switches.size(), 1u);
+    EXPECT_EQ(sim.ladder.current().rung, 1) << "one step, no way back";
+}
+
+TEST(AdaptiveLadderTest, Rebase)
+{
+    Sim sim;
+    sim.run(10, 1000000);
+    AdaptiveLadder::Step step;
+    EXPECT_TRUE(sim.ladder.setBase(720, 1280, 30, &step)) << "left a lower rung";
+    EXPECT_TRUE(is(step, 720, 1280, 30)) << "switch to the top";
+    EXPECT_TRUE(is(sim.ladder.current(), 720, 1280, 30)) << "top of the new base";
+    EXPECT_TRUE(is(sim.ladder.base(), 720, 1280, 30)) << "base";
+
+    // no framerate, no ladder
+    sim.ladder.setBase(1280, 720, 0);
+    sim.setStep(AdaptiveLadder::Step{ 0, 1280, 720, 60 });
+    sim.run(10, 100000);
+    EXPECT_EQ(sim.switches.size(), 2u) << "inactive";
+}
+
+TEST(AdaptiveLadderTest, FramerateChangeOnLowerRungRestoresSize)
+{
+    Sim sim;
+    sim.run(10, 1000000);
+    ASSERT_TRUE(is(sim.cur, 960, 536, 30));
+
+    // the base size is back with the new framerate
+    sim.setFramerate(50);
+    EXPECT_TRUE(is(sim.cur, 1280, 720, 50));
+    EXPECT_EQ(sim.ladder.current().rung, 0);
+
+    // on a good link the encoder stays there, as the ladder thinks
+    sim.run(30, 8000000);
+    EXPECT_EQ(sim.switches.size(), 2u);
+    EXPECT_TRUE(is(sim.cur, 1280, 720, 50));
+    EXPECT_TRUE(is(sim.ladder.current(), 1280, 720, 50));
+
+    // and steps down from there again
+    sim.run(10, 1000000);
+    EXPECT_TRUE(is(sim.cur, 960, 536, 30));
+}
+
+TEST(AdaptiveLadderTest, FramerateChangeOnTopRungKeepsSize)
+{
+    Sim sim;
+    sim.run(5, 8000000);
+    AdaptiveLadder::Step step = { -1, 0, 0, 0 };
+    EXPECT_FALSE(sim.ladder.setBase(1280, 720, 30, &step)) << "nothing to undo";
+    EXPECT_EQ(step.rung, -1) << "step untouched";
+    EXPECT_TRUE(is(sim.ladder.current(), 1280, 720, 30));
+}
+
+TEST(AdaptiveLadderTest, ParsesSpec)
+{
+    AdaptiveLadder ladder;
+    AdaptiveLadder::Params params;
+    EXPECT_EQ(ladder.init("1,0.5@30", params, 128), 0);
+    EXPECT_LT(ladder.init("1,0.5@", params, 128), 0) << "no fps";
+    EXPECT_LT(ladder.init("1,,0.5", params, 128), 0) << "empty rung";
+    EXPECT_LT(ladder.init("1,1.5", params, 128), 0) << "upscale";
+    EXPECT_EQ(ladder.init("auto", params, 128), 0);
+
+    // rungs too small or no cheaper than the one above are left out
+    Sim sim("1,1@60,0.5,0.1");
+    sim.run(20, 100000);
+    EXPECT_EQ(sim.switches.size(), 1u);
+    EXPECT_TRUE(is(sim.cur, 640, 360, 60)) << "pruned";
+}
+
+TEST(AdaptiveLadderTest, InactiveWithoutBudget)
+{
+    // no budget, e.g. constant QP
+    Sim cqp;
+    cqp.run(10, 0);
+    EXPECT_TRUE(cqp.switches.empty());
+}
@@ -0,0 +1,269 @@
+// Copyright (C) 2023 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions
+// and limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+// Checks of the -finput clip source: Y4M header and frame parsing, raw
+// clips, and frames delivered in a loop, on demand and paced.
+
+#include <gtest/gtest.h>
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+extern "C" {
+#include <libavutil/buffer.h>
+#include <libavutil/error.h>
+}
+#include "utils/ClipSource.h"
+
+namespace {
+    const int Width = 16;
+    const int Height = 8;
+    const size_t FrameSize = Width * Height * 3 / 2;  // 4:2:0
+
+    class ClipSourceTest : public ::testing::Test
+    {
+    protected:
+        void TearDown() override
+        {
+            for (const std::string &path : paths)
+                unlink(path.c_str());
+        }
+
+        std::string Write(const std::string &data)
+        {
+            char tmpl[] = "/tmp/clip-source-test-XXXXXX";
+            int fd = mkstemp(tmpl);
+            EXPECT_GE(fd, 0);
+            EXPECT_EQ(write(fd, data.data(), data.size()), (ssize_t)data.size());
+            close(fd);
+            paths.push_back(tmpl);
+            return tmpl;
+        }
+
+        // Frame |index| of |size| bytes, all set to 'a' + |index|
+        static std::string Frame(int index, size_t size = FrameSize)
+        {
+            return std::string(size, (char)('a' + index));
+        }
+
+        static std::string Y4M(const std::string &params, int frames)
+        {
+            std::string data = "YUV4MPEG2 W" + std::to_string(Width) + " H" + std::to_string(Height) + params + "\n";
+            for (int i = 0; i < frames; i++)
+                data += "FRAME\n" + Frame(i);
+            return data;
+        }
+
+        // First byte of the frame |ref| points to, then releases it
+        static char Take(AVBufferRef *ref)
+        {
+            if (!ref)
+                return 0;
+            char c = (char)ref->data[0];
+            av_buffer_unref(&ref);
+            return c;
+        }
+
+        std::vector<std::string> paths;
+    };
+}
+
+TEST_F(ClipSourceTest, Y4MHeaderGivesSizeAndFormat)
+{
+    ClipSource clip;
+    // Format arguments are ignored for Y4M
+    ASSERT_EQ(clip.open(Write(Y4M(" F30:1 Ip A1:1 C420jpeg XYSCSS=420JPEG", 3)), 0, 0, AV_PIX_FMT_RGBA, false), 0);
+    EXPECT_EQ(clip.getWidth(), Width);
+    EXPECT_EQ(clip.getHeight(), Height);
+    EXPECT_EQ(clip.getFormat(), AV_PIX_FMT_YUV420P);
+    ASSERT_EQ(clip.getFrameCount(), 3);
+
+    for (int i = 0; i < 3; i++) {
+        AVBufferRef *ref = clip.getFrame(i);
+        ASSERT_NE(ref, nullptr);
+        EXPECT_EQ(ref->size, FrameSize);
+        EXPECT_EQ(std::string((const char *)ref->data, ref->size), Frame(i));
+        av_buffer_unref(&ref);
+    }
+}
+
+TEST_F(ClipSourceTest, Y4MAccepts420Variants)
+{
+    for (const char *params : { "", " C420", " C420jpeg", " C420paldv", " C420mpeg2" }) {
+        ClipSource clip;
+        EXPECT_EQ(clip.open(Write(Y4M(params, 1)), 0, 0, AV_PIX_FMT_NONE, false), 0) << params;
+        EXPECT_EQ(clip.getFrameCount(), 1) << params;
+    }
+}
+
+TEST_F(ClipSourceTest, Y4MRejectsOtherColorspaces)
+{
+    for (const char *params : { " C420p10", " C420p12", " C422", " C444", " C444alpha", " Cmono", " C42" }) {
+        ClipSource clip;
+        EXPECT_EQ(clip.open(Write(Y4M(params, 1)), 0, 0, AV_PIX_FMT_NONE, false), AVERROR_PATCHWELCOME) << params;
+        EXPECT_EQ(clip.getFrameCount(), 0) << params;
+    }
+}
+
+TEST_F(ClipSourceTest, Y4MRejectsBadHeaders)
+{
+    ClipSource clip;
+    EXPECT_EQ(clip.open(Write("YUV4MPEG2 W16 H8"), 0, 0, AV_PIX_FMT_NONE, false), AVERROR_INVALIDDATA);
+    EXPECT_EQ(clip.open(Write("YUV4MPEG2 H8\nFRAME\n" + Frame(0)), 0, 0, AV_PIX_FMT_NONE, false),
+              AVERROR_PATCHWELCOME);
+    EXPECT_EQ(clip.open(Write("YUV4MPEG2 W0 H8\nFRAME\n" + Frame(0)), 0, 0, AV_PIX_FMT_NONE, false),
+              AVERROR_PATCHWELCOME);
+}
+
+TEST_F(ClipSourceTest, Y4MFrameHeadersMayHaveParameters)
+{
+    std::string data = "YUV4MPEG2 W16 H8 C420\n";
+    data += "FRAME Ip XFOO=1\n" + Frame(0);
+    data += "FRAME\n" + Frame(1);
+    ClipSource clip;
+    ASSERT_EQ(clip.open(Write(data), 0, 0, AV_PIX_FMT_NONE, false), 0);
+    ASSERT_EQ(clip.getFrameCount(), 2);
+    EXPECT_EQ(Take(clip.getFrame(0)), 'a');
+    EXPECT_EQ(Take(clip.getFrame(1)), 'b');
+}
+
+TEST_F(ClipSourceTest, Y4MStopsAtIncompleteFrame)
+{
+    std::string data = Y4M("", 2) + "FRAME\n" + Frame(2, FrameSize - 1);
+    ClipSource clip;
+    ASSERT_EQ(clip.open(Write(data), 0, 0, AV_PIX_FMT_NONE, false), 0);
+    EXPECT_EQ(clip.getFrameCount(), 2);
+
+    // Junk instead of a frame header ends the clip as well
+    ClipSource junk;
+    ASSERT_EQ(junk.open(Write(Y4M("", 1) + "JUNK\n" + Frame(1)), 0, 0, AV_PIX_FMT_NONE, false), 0);
+    EXPECT_EQ(junk.getFrameCount(), 1);
+
+    ClipSource empty;
+    EXPECT_EQ(empty.open(Write(Y4M("", 0)), 0, 0, AV_PIX_FMT_NONE, false), AVERROR_INVALIDDATA);
+}
+
+TEST_F(ClipSourceTest, RawClipUsesGivenSizeAndFormat)
+{
+    // Two and a half NV12 frames
+    std::string data = Frame(0) + Frame(1) + Frame(2, FrameSize / 2);
+    ClipSource clip;
+    ASSERT_EQ(clip.open(Write(data), Width, Height, AV_PIX_FMT_NV12, false), 0);
+    EXPECT_EQ(clip.getFormat(), AV_PIX_FMT_NV12);
+    ASSERT_EQ(clip.getFrameCount(), 2);
+    EXPECT_EQ(Take(clip.getFrame(1)), 'b');
+
+    ClipSource rgba;
+    ASSERT_EQ(rgba.open(Write(Frame(0, Width * Height * 4)), Width, Height, AV_PIX_FMT_RGBA, false), 0);
+    EXPECT_EQ(rgba.getFrameCount(), 1);
+}
+
+TEST_F(ClipSourceTest, RawClipRejectsBadArguments)
+{
+    std::string path = Write(Frame(0));
+    ClipSource clip;
+    EXPECT_EQ(clip.open(path, Width, Height, AV_PIX_FMT_NONE, false), AVERROR(EINVAL));
+    EXPECT_EQ(clip.open(path, 0, Height, AV_PIX_FMT_YUV420P, false), AVERROR(EINVAL));
+    EXPECT_EQ(clip.open(path, Width * 2, Height, AV_PIX_FMT_YUV420P, false), AVERROR_INVALIDDATA);
+    EXPECT_LT(clip.open("/nonexistent/clip.yuv", Width, Height, AV_PIX_FMT_YUV420P, false), 0);
+    EXPECT_LT(clip.open(Write(""), Width, Height, AV_PIX_FMT_YUV420P, false), 0);
+
+    ASSERT_EQ(clip.open(path, Width, Height, AV_PIX_FMT_YUV420P, false), 0);
+    EXPECT_EQ(clip.open(path, Width, Height, AV_PIX_FMT_YUV420P, false), AVERROR(EINVAL));
+}
+
+TEST_F(ClipSourceTest, PreloadKeepsFrames)
+{
+    ClipSource clip;
+    ASSERT_EQ(clip.open(Write(Y4M("", 3)), 0, 0, AV_PIX_FMT_NONE, true), 0);
+    ASSERT_EQ(clip.getFrameCount(), 3);
+    for (int i = 0; i < 3; i++) {
+        AVBufferRef *ref = clip.getFrame(i);
+        ASSERT_NE(ref, nullptr);
+        EXPECT_EQ(std::string((const char *)ref->data, ref->size), Frame(i));
+        av_buffer_unref(&ref);
+    }
+}
+
+TEST_F(ClipSourceTest, FramesLoopAndOutliveTheClip)
+{
+    AVBufferRef *held = nullptr;
+    {
+        ClipSource clip;
+        ASSERT_EQ(clip.open(Write(Y4M("", 2)), 0, 0, AV_PIX_FMT_NONE, false), 0);
+        EXPECT_EQ(Take(clip.getFrame(2)), 'a');
+        EXPECT_EQ(Take(clip.getFrame(5)), 'b');
+        held = clip.getFrame(7);
+    }
+    ASSERT_NE(held, nullptr);
+    EXPECT_EQ(std::string((const char *)held->data, held->size), Frame(1));
+    av_buffer_unref(&held);
+}
+
+TEST_F(ClipSourceTest, FeedDeliversOneFramePerCall)
+{
+    ClipSource clip;
+    ASSERT_EQ(clip.open(Write(Y4M("", 2)), 0, 0, AV_PIX_FMT_NONE, false), 0);
+    EXPECT_EQ(clip.start(0, nullptr), AVERROR(EINVAL));
+
+    std::string played;
+    ASSERT_EQ(clip.start(0, [&](AVBufferRef *frame) { played += Take(frame); }), 0);
+    for (int i = 0; i < 5; i++)
+        clip.feed();
+    clip.stop();
+    EXPECT_EQ(played, "ababa");
+
+    // Stopped, nothing is delivered
+    clip.feed();
+    EXPECT_EQ(played, "ababa");
+}
+
+TEST_F(ClipSourceTest, PacedPlaybackLoops)
+{
+    ClipSource clip;
+    ASSERT_EQ(clip.open(Write(Y4M("", 3)), 0, 0, AV_PIX_FMT_NONE, false), 0);
+
+    std::mutex mutex;
+    std::string played;
+    ASSERT_EQ(clip.start(200, [&](AVBufferRef *frame) {
+        std::lock_guard<std::mutex> lock(mutex);
+        played += Take(frame);
+    }), 0);
+    // Paced playback ignores feed()
+    clip.feed();
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (std::chrono::steady_clock::now() < deadline) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (played.size() >= 7)
+                break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    clip.stop();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    ASSERT_GE(played.size(), 7u);
+    for (size_t i = 0; i < played.size(); i++)
+        EXPECT_EQ(played[i], (char)('a' + i % 3)) << i;
+}
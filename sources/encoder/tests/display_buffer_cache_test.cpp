@@ -0,0 +1,247 @@
+// Copyright (C) 2023 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions
+// and limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+// Checks of the display buffer cache with a renderer counting imports.
+// Buffers are memfds standing in for dma-bufs, handed over with a new fd
+// each time as libvhal does.
+
+#include <gtest/gtest.h>
+
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include <set>
+#include <vector>
+
+#include "display_buffer_cache.h"
+
+using namespace vhal::client;
+
+namespace {
+    class FakeRenderer : public DisplayRenderer
+    {
+    public:
+        bool init(char *name, encoder_info_t *info) override { return true; }
+        void deinit() override {}
+
+        disp_res_t* createDispRes(cros_gralloc_handle_t handle) override
+        {
+            imports++;
+            disp_res_t *res = new disp_res_t();
+            res->width = handle->width;
+            res->height = handle->height;
+            live.insert(res);
+            return res;
+        }
+
+        void destroyDispRes(disp_res_t *res) override
+        {
+            EXPECT_EQ(live.erase(res), 1u) << "destroy of a resource that is not live";
+            delete res;
+        }
+
+        void drawDispRes(disp_res_t *res, int client_id, int client_count,
+                         std::unique_ptr<display_control_t> ctrl) override {}
+        void setVideoMode(int mode_info) override {}
+        void beginFrame() override {}
+        void endFrame() override {}
+        void retireFrame() override {}
+        void flushDelayDelRes() override {}
+        int getCropFlag() override { return 0; }
+        void ChangeResolution(int width, int height) override {}
+
+        int imports = 0;
+        std::set<disp_res_t*> live;
+    };
+
+    // A cache whose kcmp fails, as on kernels without it or when seccomp
+    // denies it
+    class NoKcmpCache : public DisplayBufferCache
+    {
+    public:
+        using DisplayBufferCache::DisplayBufferCache;
+
+    protected:
+        bool sameFile(int fd1, int fd2) override
+        {
+            return DisplayBufferCache::sameFile(-1, fd2);
+        }
+    };
+
+    // A buffer sent by Android, with its own fd
+    struct Handle
+    {
+        cros_gralloc_handle h = {};
+
+        Handle(int buffer, uint32_t width, uint32_t height, uint32_t stride = 0)
+        {
+            for (int i = 0; i < 4; i++)
+                h.fds[i] = -1;
+            h.fds[0] = buffer >= 0 ? dup(buffer) : -1;
+            h.width = width;
+            h.height = height;
+            h.strides[0] = stride ? stride : width * 4;
+            h.format = 0x34324241;  // AB24
+        }
+        ~Handle() { if (h.fds[0] >= 0) close(h.fds[0]); }
+        cros_gralloc_handle_t get() const { return &h; }
+    };
+
+    // Buffers are memfds standing in for dma-bufs
+    class DisplayBufferCacheTest : public ::testing::Test
+    {
+    protected:
+        void TearDown() override
+        {
+            for (int fd : buffers)
+                close(fd);
+        }
+
+        int NewBuffer()
+        {
+            int fd = (int)syscall(SYS_memfd_create, "display-buffer-cache-test", 0);
+            EXPECT_GE(fd, 0);
+            buffers.push_back(fd);
+            return fd;
+        }
+
+        FakeRenderer renderer;
+        std::vector<int> buffers;
+    };
+}
+
+TEST_F(DisplayBufferCacheTest, ReusesBuffersCreatedAgain)
+{
+    DisplayBufferCache cache(2);
+    int a = NewBuffer(), b = NewBuffer();
+
+    disp_res_t *ra, *rb;
+    {
+        Handle ha(a, 1280, 720), hb(b, 1280, 720);
+        ra = cache.acquire(&renderer, ha.get());
+        rb = cache.acquire(&renderer, hb.get());
+        ASSERT_NE(ra, nullptr);
+        ASSERT_NE(rb, nullptr);
+        EXPECT_NE(ra, rb);
+        EXPECT_EQ(renderer.imports, 2);
+        cache.release(&renderer, ra);
+        cache.release(&renderer, rb);
+    }
+    EXPECT_EQ(renderer.live.size(), 2u) << "idle kept";
+
+    // created again with new fds
+    Handle ha(a, 1280, 720), hb(b, 1280, 720);
+    EXPECT_EQ(cache.acquire(&renderer, ha.get()), ra);
+    EXPECT_EQ(cache.acquire(&renderer, hb.get()), rb);
+    EXPECT_EQ(renderer.imports, 2);
+    EXPECT_EQ(cache.stats().hits, 2);
+    EXPECT_EQ(ra->local_handle, &ha.get()->base);
+    EXPECT_EQ(ra->prime_fds[0], ha.get()->fds[0]);
+
+    // same buffer, other layout
+    Handle ha2(a, 1248, 704, 4992);
+    disp_res_t *ra2 = cache.acquire(&renderer, ha2.get());
+    ASSERT_NE(ra2, nullptr);
+    EXPECT_NE(ra2, ra);
+    EXPECT_EQ(renderer.imports, 3);
+
+    cache.release(&renderer, ra);
+    cache.release(&renderer, rb);
+    cache.release(&renderer, ra2);
+    cache.clear(&renderer);
+    EXPECT_TRUE(renderer.live.empty());
+    EXPECT_EQ(cache.stats().unverified, 0);
+}
+
+TEST_F(DisplayBufferCacheTest, EvictsLeastRecentlyUsed)
+{
+    DisplayBufferCache cache(2);
+    int bufs[3] = { NewBuffer(), NewBuffer(), NewBuffer() };
+    disp_res_t *res[3];
+
+    for (int i = 0; i < 3; i++) {
+        Handle h(bufs[i], 720, 1280);
+        res[i] = cache.acquire(&renderer, h.get());
+    }
+    // a shared buffer stays until its last handle goes
+    Handle again(bufs[0], 720, 1280);
+    EXPECT_EQ(cache.acquire(&renderer, again.get()), res[0]);
+    cache.release(&renderer, res[0]);
+    EXPECT_EQ(renderer.live.count(res[0]), 1u) << "still in use";
+
+    for (int i = 0; i < 3; i++)
+        cache.release(&renderer, res[i]);
+    EXPECT_EQ(cache.stats().evictions, 1);
+    EXPECT_EQ(renderer.live.count(res[0]), 0u);
+    EXPECT_EQ(renderer.live.size(), 2u) << "max idle kept";
+
+    Handle h(bufs[0], 720, 1280);
+    disp_res_t *r = cache.acquire(&renderer, h.get());
+    EXPECT_EQ(renderer.imports, 4) << "evicted imported again";
+    cache.release(&renderer, r);
+    cache.clear(&renderer);
+}
+
+TEST_F(DisplayBufferCacheTest, BuffersWithoutIdentityAreNotCached)
+{
+    DisplayBufferCache cache;
+    Handle h(-1, 1280, 720);
+
+    disp_res_t *r1 = cache.acquire(&renderer, h.get());
+    cache.release(&renderer, r1);
+    disp_res_t *r2 = cache.acquire(&renderer, h.get());
+    EXPECT_EQ(renderer.imports, 2);
+    EXPECT_EQ(cache.stats().uncached, 2);
+    cache.release(&renderer, r2);
+    EXPECT_TRUE(renderer.live.empty()) << "destroyed on release";
+}
+
+TEST_F(DisplayBufferCacheTest, UncheckedBufferIsAMiss)
+{
+    NoKcmpCache cache(2);
+    int a = NewBuffer();
+
+    disp_res_t *first;
+    {
+        Handle h(a, 1280, 720);
+        first = cache.acquire(&renderer, h.get());
+        ASSERT_NE(first, nullptr);
+        cache.release(&renderer, first);
+    }
+
+    // idle: replaced by a new import
+    Handle h1(a, 1280, 720);
+    disp_res_t *second = cache.acquire(&renderer, h1.get());
+    ASSERT_NE(second, nullptr);
+    EXPECT_EQ(renderer.imports, 2);
+    EXPECT_EQ(renderer.live.count(first), 0u);
+    EXPECT_EQ(cache.stats().hits, 0);
+
+    // in use: imported for this handle only
+    Handle h2(a, 1280, 720);
+    disp_res_t *third = cache.acquire(&renderer, h2.get());
+    ASSERT_NE(third, nullptr);
+    EXPECT_NE(third, second);
+    EXPECT_EQ(renderer.imports, 3);
+    EXPECT_EQ(cache.stats().uncached, 1);
+    EXPECT_EQ(cache.stats().unverified, 2);
+
+    cache.release(&renderer, third);
+    EXPECT_EQ(renderer.live.count(third), 0u);
+    cache.release(&renderer, second);
+    cache.clear(&renderer);
+    EXPECT_TRUE(renderer.live.empty());
+}
@@ -0,0 +1,215 @@
+// Copyright (C) 2023 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions
+// and limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+// Checks of the flight recorder ring: recording starts at a key frame,
+// whole GOPs are evicted by age and by size, and the snapshot holds the
+// recorded bytes and their metadata.
+
+#include <gtest/gtest.h>
+
+#include <dirent.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+}
+#include "utils/FlightRecorder.h"
+
+namespace {
+    const int Fps = 30;
+    const int64_t FrameUs = 1000000 / Fps;
+
+    class FlightRecorderTest : public ::testing::Test
+    {
+    protected:
+        void SetUp() override
+        {
+            char tmpl[] = "/tmp/flight-recorder-test-XXXXXX";
+            ASSERT_NE(mkdtemp(tmpl), nullptr);
+            dir = tmpl;
+        }
+
+        void TearDown() override
+        {
+            for (const std::string &name : Files())
+                unlink((dir + "/" + name).c_str());
+            rmdir(dir.c_str());
+        }
+
+        std::unique_ptr<FlightRecorder> Create(int seconds, size_t maxBytes)
+        {
+            std::unique_ptr<FlightRecorder> recorder(new FlightRecorder(seconds, maxBytes, (dir + "/").c_str()));
+            recorder->reset(AV_CODEC_ID_H264, 640, 480, Fps);
+            return recorder;
+        }
+
+        // Frame |index| of |size| bytes, all set to the low byte of |index|,
+        // released by the caller as the encode loop does
+        int Push(FlightRecorder *recorder, int index, int size, bool key)
+        {
+            AVPacket pkt;
+            if (av_new_packet(&pkt, size) < 0)
+                return AVERROR(ENOMEM);
+            memset(pkt.data, index & 0xff, size);
+            pkt.pts = index;
+            pkt.flags = key ? AV_PKT_FLAG_KEY : 0;
+
+            FlightRecorder::FrameInfo info = {};
+            info.timestamp_us = index * FrameUs;
+            info.pts = index;
+            info.size = size;
+            info.key_frame = key;
+            int ret = recorder->push(&pkt, info);
+            av_packet_unref(&pkt);
+            return ret;
+        }
+
+        // GOPs of |gop| frames from frame |first|
+        void PushGops(FlightRecorder *recorder, int first, int frames, int gop, int size)
+        {
+            for (int i = first; i < first + frames; i++)
+                ASSERT_EQ(Push(recorder, i, size, i % gop == 0), 0);
+        }
+
+        std::vector<std::string> Files() const
+        {
+            std::vector<std::string> names;
+            DIR *d = opendir(dir.c_str());
+            if (!d)
+                return names;
+            while (struct dirent *e = readdir(d)) {
+                if (e->d_name[0] != '.')
+                    names.push_back(e->d_name);
+            }
+            closedir(d);
+            return names;
+        }
+
+        std::string Read(const char *ext) const
+        {
+            for (const std::string &name : Files()) {
+                if (name.size() > strlen(ext) && name.compare(name.size() - strlen(ext), std::string::npos, ext) == 0) {
+                    std::ifstream in(dir + "/" + name, std::ios::binary);
+                    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+                }
+            }
+            return std::string();
+        }
+
+        // pts of the frames in the snapshot metadata
+        std::vector<int> SnapshotPts() const
+        {
+            std::vector<int> pts;
+            std::istringstream csv(Read(".csv"));
+            std::string line;
+            std::getline(csv, line);
+            while (std::getline(csv, line)) {
+                int index, p;
+                long long ts;
+                if (sscanf(line.c_str(), "%d,%lld,%d", &index, &ts, &p) == 3)
+                    pts.push_back(p);
+            }
+            return pts;
+        }
+
+        std::string dir;
+    };
+}
+
+TEST_F(FlightRecorderTest, StartsAtKeyFrame)
+{
+    auto recorder = Create(10, 1 << 20);
+    EXPECT_EQ(Push(recorder.get(), 0, 100, false), 0);
+    EXPECT_EQ(recorder->snapshot(), AVERROR(EAGAIN));
+
+    EXPECT_EQ(Push(recorder.get(), 1, 100, true), 0);
+    EXPECT_EQ(Push(recorder.get(), 2, 100, false), 0);
+    EXPECT_EQ(recorder->snapshot(), 0);
+    recorder.reset();
+
+    EXPECT_EQ(SnapshotPts(), std::vector<int>({ 1, 2 }));
+}
+
+TEST_F(FlightRecorderTest, EvictsOldGopsByAge)
+{
+    // one second GOPs for five seconds, two seconds kept
+    auto recorder = Create(2, 1 << 20);
+    PushGops(recorder.get(), 0, 5 * Fps, Fps, 100);
+    ASSERT_EQ(recorder->snapshot(), 0);
+    recorder.reset();
+
+    std::vector<int> pts = SnapshotPts();
+    ASSERT_FALSE(pts.empty());
+    // whole GOPs covering at least two seconds: the GOP at 2 s stays as
+    // the ones after it only span 1.97 s
+    EXPECT_EQ(pts.front(), 2 * Fps);
+    EXPECT_EQ(pts.back(), 5 * Fps - 1);
+}
+
+TEST_F(FlightRecorderTest, EvictsOldGopsBySize)
+{
+    // room for two and a half GOPs of 1 KB frames
+    auto recorder = Create(60, 2500 * Fps);
+    PushGops(recorder.get(), 0, 5 * Fps, Fps, 1000);
+    ASSERT_EQ(recorder->snapshot(), 0);
+    recorder.reset();
+
+    std::vector<int> pts = SnapshotPts();
+    ASSERT_EQ(pts.size(), size_t(2 * Fps));
+    EXPECT_EQ(pts.front(), 3 * Fps);
+}
+
+TEST_F(FlightRecorderTest, RestartsAfterOversizedGop)
+{
+    auto recorder = Create(60, 10 * 1000);
+    // a GOP of 20 KB cannot be kept whole
+    PushGops(recorder.get(), 0, 20, 100, 1000);
+    EXPECT_EQ(recorder->snapshot(), AVERROR(EAGAIN));
+
+    EXPECT_EQ(Push(recorder.get(), 20, 1000, false), 0);
+    EXPECT_EQ(Push(recorder.get(), 21, 1000, true), 0);
+    EXPECT_EQ(recorder->snapshot(), 0);
+    recorder.reset();
+
+    EXPECT_EQ(SnapshotPts(), std::vector<int>({ 21 }));
+}
+
+TEST_F(FlightRecorderTest, DumpsRecordedBytes)
+{
+    auto recorder = Create(10, 1 << 20);
+    std::string expected;
+    for (int i = 0; i < 10; i++) {
+        int size = 50 + i;
+        ASSERT_EQ(Push(recorder.get(), i, size, i == 0), 0);
+        expected.append(size, char(i));
+    }
+    ASSERT_EQ(recorder->snapshot(), 0);
+
+    // later packets do not change the snapshot taken
+    ASSERT_EQ(Push(recorder.get(), 10, 100, false), 0);
+    recorder.reset();
+
+    EXPECT_EQ(Read(".264"), expected);
+    EXPECT_EQ(SnapshotPts().size(), 10u);
+}
@@ -0,0 +1,114 @@
+// Copyright (C) 2023 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions
+// and limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+// FramePool: growth up to the high watermark, trimming back to the low
+// one, the statistics kept on the way, and frames still held when the pool
+// goes away or is initialized again.
+
+#include <gtest/gtest.h>
+
+#include <string.h>
+
+#include <vector>
+
+#include "utils/FramePool.h"
+
+namespace {
+    const size_t FrameSize = 1280 * 720 * 4;
+
+    // With and without huge pages
+    class FramePoolTest : public ::testing::TestWithParam<bool>
+    {
+    };
+}
+
+TEST_P(FramePoolTest, Watermarks)
+{
+    FramePool pool;
+    ASSERT_EQ(pool.init(FrameSize, 2, 4, -1, GetParam()), 0);
+    EXPECT_EQ(pool.frameSize(), FrameSize);
+
+    FramePool::Stats st = pool.stats();
+    EXPECT_EQ(st.allocated, 2);
+    EXPECT_EQ(st.inUse, 0);
+
+    std::vector<AVBufferRef *> bufs;
+    for (int i = 0; i < 4; i++) {
+        AVBufferRef *buf = pool.get();
+        ASSERT_NE(buf, nullptr);
+        EXPECT_EQ((size_t)buf->size, FrameSize);
+        memset(buf->data, i, FrameSize);
+        bufs.push_back(buf);
+    }
+    EXPECT_EQ(pool.get(), nullptr) << "high watermark";
+
+    st = pool.stats();
+    EXPECT_EQ(st.allocated, 4);
+    EXPECT_EQ(st.inUse, 4);
+    EXPECT_EQ(st.peakInUse, 4);
+    EXPECT_EQ(st.gets, 4u);
+    EXPECT_EQ(st.misses, 1u);
+    EXPECT_EQ(st.grows, 2u);
+
+    // back to the low watermark, the frames over it are released
+    for (AVBufferRef *&buf : bufs)
+        av_buffer_unref(&buf);
+    st = pool.stats();
+    EXPECT_EQ(st.allocated, 2);
+    EXPECT_EQ(st.inUse, 0);
+    EXPECT_EQ(st.trims, 2u);
+
+    // idle frames are reused
+    AVBufferRef *buf = pool.get();
+    ASSERT_NE(buf, nullptr);
+    st = pool.stats();
+    EXPECT_EQ(st.allocated, 2);
+    EXPECT_EQ(st.grows, 2u);
+    av_buffer_unref(&buf);
+}
+
+// Huge pages are asked for but not required, the test passes on systems
+// without a huge page reserve
+INSTANTIATE_TEST_SUITE_P(HugePages, FramePoolTest, ::testing::Bool());
+
+TEST(FramePoolLifetimeTest, FramesOutliveThePool)
+{
+    AVBufferRef *buf;
+    {
+        FramePool pool;
+        ASSERT_EQ(pool.init(4096, 1, 2, -1, false), 0);
+        buf = pool.get();
+    }
+    ASSERT_NE(buf, nullptr);
+    memset(buf->data, 0x5a, buf->size);
+    av_buffer_unref(&buf);
+}
+
+TEST(FramePoolLifetimeTest, ReinitKeepsOldFrames)
+{
+    FramePool pool;
+    ASSERT_EQ(pool.init(4096, 1, 2, -1, false), 0);
+    AVBufferRef *old = pool.get();
+    ASSERT_EQ(pool.init(8192, 1, 2, -1, false), 0);
+    AVBufferRef *buf = pool.get();
+    ASSERT_NE(buf, nullptr);
+    EXPECT_EQ((size_t)buf->size, 8192u);
+    FramePool::Stats st = pool.stats();
+    EXPECT_EQ(st.allocated, 1);
+    EXPECT_EQ(st.inUse, 1);
+    av_buffer_unref(&old);
+    av_buffer_unref(&buf);
+}
@@ -0,0 +1,246 @@
+// Copyright (C) 2023 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions
+// and limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+// IntraRecovery: how key frame requests are answered at 60 fps, with one
+// intra refresh wave for a burst, an IDR for IDR requests, a new wave for
+// a loss after the window, an IDR when waves do not recover, and the peaks
+// and recovery times counted for IDRs and waves.
+
+#include <gtest/gtest.h>
+
+#include "utils/IntraRecovery.h"
+
+#include "sim_encoder.h"
+
+namespace {
+    const int64_t FRAME_US = SimEncoder(60).frameUs();
+    // Sizes are arbitrary, only the accounting of them is checked
+    const uint32_t USUAL = 10000;
+    const uint32_t KEY_SIZE = 40000;
+    const uint32_t WAVE_SIZE = 15000;
+
+    // An encoder refreshing over |cycle| frames
+    struct Sim : SimEncoder {
+        IntraRecovery recovery;
+        int waveLeft = 0;
+        int idrs = 0, waves = 0, stops = 0;
+
+        Sim(int cycle, int escalateMs = INTRA_RECOVERY_DEFAULT_ESCALATE_MS,
+            int maxWaves = INTRA_RECOVERY_DEFAULT_MAX_WAVES)
+            : SimEncoder(60),
+              recovery(cycle, INTRA_RECOVERY_DEFAULT_WINDOW_MS, escalateMs, maxWaves) {}
+
+        void run(int frames)
+        {
+            encodeFrames(frames, [&](int64_t nowUs) {
+                int action = recovery.onFrame(nowUs);
+                bool key = action & IntraRecovery::IDR;
+                if (key) {
+                    idrs++;
+                    waveLeft = 0;
+                }
+                if (action & IntraRecovery::REFRESH_START) {
+                    waves++;
+                    waveLeft = recovery.cycle();
+                }
+                if (action & IntraRecovery::REFRESH_STOP)
+                    stops++;
+
+                uint32_t size = key ? KEY_SIZE : waveLeft > 0 ? WAVE_SIZE : USUAL;
+                if (waveLeft > 0)
+                    waveLeft--;
+                recovery.onEncoded(nowUs, size, key);
+            });
+        }
+
+        void lose(int requests, int64_t apartUs = 10000)
+        {
+            for (int i = 0; i < requests; i++)
+                recovery.request(nowUs + i * apartUs, false);
+        }
+    };
+}
+
+TEST(IntraRecoveryTest, BurstIsCoalesced)
+{
+    Sim sim(8);
+    sim.run(30);
+    sim.lose(5);
+    sim.run(20);
+    IntraRecovery::Stats st = sim.recovery.refreshStats();
+    EXPECT_EQ(sim.waves, 1);
+    EXPECT_EQ(sim.idrs, 0);
+    EXPECT_EQ(st.answers, 1);
+    EXPECT_EQ(st.requests, 5);
+    EXPECT_EQ(sim.stops, 1);
+}
+
+TEST(IntraRecoveryTest, LateRequestInTheWindowIsCoalesced)
+{
+    // within the window of the answer, after it's out
+    Sim sim(2);
+    sim.run(30);
+    sim.lose(1);
+    sim.run(3);
+    sim.lose(1);
+    sim.run(10);
+    EXPECT_EQ(sim.waves, 1);
+    EXPECT_EQ(sim.idrs, 0);
+    EXPECT_EQ(sim.recovery.refreshStats().requests, 2);
+}
+
+TEST(IntraRecoveryTest, IdrAnswersBoth)
+{
+    Sim sim(8);
+    sim.run(30);
+    sim.recovery.request(sim.nowUs, true);
+    sim.lose(3);
+    sim.run(5);
+    EXPECT_EQ(sim.idrs, 1);
+    EXPECT_EQ(sim.waves, 0);
+    EXPECT_EQ(sim.recovery.idrStats().requests, 4);
+    EXPECT_EQ(sim.recovery.idrStats().escalations, 0);
+}
+
+TEST(IntraRecoveryTest, IdrEndsTheWave)
+{
+    // a subscriber joins during a wave
+    Sim sim(8);
+    sim.run(30);
+    sim.lose(1);
+    sim.run(2);
+    sim.recovery.request(sim.nowUs, true);
+    int action = sim.recovery.onFrame(sim.nowUs);
+    EXPECT_EQ(action, IntraRecovery::IDR | IntraRecovery::REFRESH_STOP);
+    sim.recovery.onEncoded(sim.nowUs, KEY_SIZE, true);
+    sim.run(20);
+    EXPECT_EQ(sim.recovery.idrStats().answers, 1);
+    EXPECT_EQ(sim.recovery.refreshStats().answers, 0);
+}
+
+TEST(IntraRecoveryTest, LossDuringWaveGivesAnotherWave)
+{
+    Sim sim(30);
+    sim.run(30);
+    sim.lose(1);
+    sim.run(10);
+    // lost again after the window, in the middle of the wave
+    sim.lose(2);
+    sim.run(60);
+    EXPECT_EQ(sim.waves, 2);
+    EXPECT_EQ(sim.idrs, 0);
+    EXPECT_EQ(sim.recovery.refreshStats().requests, 3);
+}
+
+TEST(IntraRecoveryTest, RequestAfterWaveEscalates)
+{
+    Sim sim(8);
+    sim.run(30);
+    sim.lose(1);
+    sim.run(20);
+    // the wave is out and the decoder still asks
+    sim.lose(1);
+    sim.run(5);
+    EXPECT_EQ(sim.waves, 1);
+    EXPECT_EQ(sim.idrs, 1);
+
+    IntraRecovery::Stats idr = sim.recovery.idrStats();
+    EXPECT_EQ(idr.answers, 1);
+    EXPECT_EQ(idr.escalations, 1);
+    // measured from the first request of the loss
+    EXPECT_GE(idr.recoveryUs, 20 * FRAME_US);
+
+    // the IDR repaired it, a later loss starts with a wave again
+    sim.run(30);
+    sim.lose(1);
+    sim.run(20);
+    EXPECT_EQ(sim.waves, 2);
+    EXPECT_EQ(sim.idrs, 1);
+}
+
+TEST(IntraRecoveryTest, RequestLongAfterWaveIsANewLoss)
+{
+    Sim sim(8);
+    sim.run(30);
+    sim.lose(1);
+    sim.run(20 + 60);
+    sim.lose(1);
+    sim.run(20);
+    EXPECT_EQ(sim.waves, 2);
+    EXPECT_EQ(sim.idrs, 0);
+    EXPECT_EQ(sim.recovery.idrStats().escalations, 0);
+}
+
+TEST(IntraRecoveryTest, TooManyWavesEscalate)
+{
+    // escalation by time out of the way
+    Sim sim(30, 10000, 2);
+    sim.run(30);
+    sim.lose(1);
+    sim.run(10);
+    sim.lose(1);
+    sim.run(30);
+    EXPECT_EQ(sim.waves, 2);
+    // lost during the second wave
+    sim.lose(1);
+    sim.run(30);
+    EXPECT_EQ(sim.waves, 2);
+    EXPECT_EQ(sim.idrs, 1);
+    EXPECT_EQ(sim.recovery.idrStats().escalations, 1);
+    EXPECT_EQ(sim.recovery.refreshStats().answers, 2);
+}
+
+TEST(IntraRecoveryTest, LongLossEscalatesDuringWave)
+{
+    Sim sim(120);
+    sim.run(30);
+    sim.lose(1);
+    sim.run(70);
+    // over a second after the first request, the wave is not waited for
+    sim.lose(1);
+    int action = sim.recovery.onFrame(sim.nowUs);
+    EXPECT_EQ(action, IntraRecovery::IDR | IntraRecovery::REFRESH_STOP);
+    sim.recovery.onEncoded(sim.nowUs, KEY_SIZE, true);
+
+    IntraRecovery::Stats idr = sim.recovery.idrStats();
+    EXPECT_EQ(idr.answers, 1);
+    EXPECT_EQ(idr.requests, 2);
+    EXPECT_EQ(idr.escalations, 1);
+    EXPECT_EQ(sim.recovery.refreshStats().answers, 0);
+}
+
+TEST(IntraRecoveryTest, Stats)
+{
+    Sim sim(8);
+    sim.run(60);
+    sim.recovery.request(sim.nowUs, true);
+    sim.run(60);
+    sim.lose(1);
+    sim.run(60);
+
+    IntraRecovery::Stats idr = sim.recovery.idrStats();
+    IntraRecovery::Stats refresh = sim.recovery.refreshStats();
+    EXPECT_EQ(idr.answers, 1);
+    EXPECT_EQ(refresh.answers, 1);
+    EXPECT_EQ(idr.peakBytes, KEY_SIZE);
+    EXPECT_EQ(refresh.peakBytes, WAVE_SIZE);
+    EXPECT_EQ(idr.ratioAnswers, 1);
+    EXPECT_DOUBLE_EQ(idr.peakRatio, (double)KEY_SIZE / USUAL);
+    EXPECT_EQ(refresh.ratioAnswers, 1);
+    EXPECT_DOUBLE_EQ(refresh.peakRatio, (double)WAVE_SIZE / USUAL);
+    EXPECT_LT(idr.recoveryUs, FRAME_US);
+    EXPECT_GE(refresh.recoveryUs, 7 * FRAME_US);
+}
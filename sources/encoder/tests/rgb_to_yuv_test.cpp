@@ -0,0 +1,252 @@
+// Copyright (C) 2023 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions
+// and limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+// RgbToYuv: RGBA/BGRA to NV12/I420 conversion of system memory frames.
+//
+// The SIMD kernel, when the CPU has one, and the row band threading have to
+// give the same bytes as the C kernel on one thread, which is checked
+// against floating point BT.601 within rounding. Flip and crop are checked
+// by converting a flipped or cropped copy of the source.
+//
+// The disabled Bench test times the conversion of a frame of each size
+// against a plain copy of the RGBA frame, the copy the packet generation
+// did before. Run it with --gtest_also_run_disabled_tests.
+
+#include <gtest/gtest.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <tuple>
+#include <vector>
+
+#include "utils/RgbToYuv.h"
+
+using namespace std::chrono;
+
+namespace {
+    struct Frame
+    {
+        int width, height;
+        AVPixelFormat format;
+        std::vector<uint8_t> data;
+        uint8_t *planes[3];
+        int strides[3];
+
+        Frame(int w, int h, AVPixelFormat fmt) : width(w), height(h), format(fmt)
+        {
+            // some padding at the end of each row
+            strides[0] = w + 16;
+            strides[1] = fmt == AV_PIX_FMT_NV12 ? w + 16 : w / 2 + 8;
+            strides[2] = fmt == AV_PIX_FMT_NV12 ? 0 : w / 2 + 8;
+            size_t y = (size_t)strides[0] * h, c = (size_t)strides[1] * h / 2;
+            data.assign(y + 2 * c, 0xee);
+            planes[0] = data.data();
+            planes[1] = planes[0] + y;
+            planes[2] = planes[1] + c;
+        }
+    };
+
+    std::vector<uint8_t> make_source(int w, int h, unsigned seed)
+    {
+        std::vector<uint8_t> rgba((size_t)w * h * 4);
+        srand(seed);
+        for (size_t i = 0; i < rgba.size(); i++) {
+            // smooth gradients with some noise, and a few saturated pixels
+            size_t px = i / 4;
+            int x = px % w, y = px / w;
+            int v = (x * 3 + y * 5 + (int)(i % 4) * 60) & 0xff;
+            rgba[i] = (rand() % 97 == 0) ? (rand() & 1) * 255 : (uint8_t)(v ^ (rand() & 7));
+        }
+        return rgba;
+    }
+
+    bool same(const Frame &a, const Frame &b)
+    {
+        for (int y = 0; y < a.height; y++) {
+            if (memcmp(a.planes[0] + (size_t)a.strides[0] * y, b.planes[0] + (size_t)b.strides[0] * y, a.width))
+                return false;
+        }
+        int cw = a.format == AV_PIX_FMT_NV12 ? a.width : a.width / 2;
+        int nplanes = a.format == AV_PIX_FMT_NV12 ? 2 : 3;
+        for (int p = 1; p < nplanes; p++) {
+            for (int y = 0; y < a.height / 2; y++) {
+                if (memcmp(a.planes[p] + (size_t)a.strides[p] * y, b.planes[p] + (size_t)b.strides[p] * y, cw))
+                    return false;
+            }
+        }
+        return true;
+    }
+
+    // Largest difference to floating point BT.601, limited range
+    int reference_error(const std::vector<uint8_t> &src, AVPixelFormat sf, const Frame &f)
+    {
+        int ri = sf == AV_PIX_FMT_RGBA ? 0 : 2, bi = 2 - ri;
+        int err = 0;
+        for (int y = 0; y < f.height; y++) {
+            for (int x = 0; x < f.width; x++) {
+                const uint8_t *p = &src[((size_t)y * f.width + x) * 4];
+                double l = 16 + (65.481 * p[ri] + 128.553 * p[1] + 24.966 * p[bi]) / 255;
+                err = std::max(err, abs(f.planes[0][(size_t)f.strides[0] * y + x] - (int)(l + 0.5)));
+            }
+        }
+        for (int y = 0; y < f.height / 2; y++) {
+            for (int x = 0; x < f.width / 2; x++) {
+                double r = 0, g = 0, b = 0;
+                for (int i = 0; i < 4; i++) {
+                    const uint8_t *p = &src[((size_t)(2 * y + i / 2) * f.width + 2 * x + i % 2) * 4];
+                    r += p[ri] / 4.0;
+                    g += p[1] / 4.0;
+                    b += p[bi] / 4.0;
+                }
+                int u = (int)(128 + (-37.797 * r - 74.203 * g + 112.0 * b) / 255 + 0.5);
+                int v = (int)(128 + (112.0 * r - 93.786 * g - 18.214 * b) / 255 + 0.5);
+                int cu, cv;
+                if (f.format == AV_PIX_FMT_NV12) {
+                    cu = f.planes[1][(size_t)f.strides[1] * y + 2 * x];
+                    cv = f.planes[1][(size_t)f.strides[1] * y + 2 * x + 1];
+                } else {
+                    cu = f.planes[1][(size_t)f.strides[1] * y + x];
+                    cv = f.planes[2][(size_t)f.strides[2] * y + x];
+                }
+                err = std::max(err, std::max(abs(cu - u), abs(cv - v)));
+            }
+        }
+        return err;
+    }
+
+    void bench(int w, int h, int threads, int frames)
+    {
+        std::vector<uint8_t> src = make_source(w, h, 1);
+        std::vector<uint8_t> copy(src.size());
+        Frame f(w, h, AV_PIX_FMT_NV12);
+        RgbToYuv conv(threads);
+
+        auto t0 = steady_clock::now();
+        for (int i = 0; i < frames; i++)
+            memcpy(copy.data(), src.data(), src.size());
+        auto t1 = steady_clock::now();
+        for (int i = 0; i < frames; i++)
+            conv.convert(src.data(), w * 4, AV_PIX_FMT_RGBA, w, h, i & 1, f.planes, f.strides, AV_PIX_FMT_NV12);
+        auto t2 = steady_clock::now();
+
+        printf("%dx%d %s x%d: copy %.3f ms, convert to nv12 %.3f ms per frame\n", w, h, conv.kernelName(),
+               threads, duration<double, std::milli>(t1 - t0).count() / frames,
+               duration<double, std::milli>(t2 - t1).count() / frames);
+    }
+}
+
+// Frame width and height
+class RgbToYuvTest : public ::testing::TestWithParam<std::tuple<int, int>>
+{
+};
+
+TEST_P(RgbToYuvTest, MatchesCKernel)
+{
+    int w = std::get<0>(GetParam()), h = std::get<1>(GetParam());
+    RgbToYuv c_kernel(1, false);
+    RgbToYuv simd(1);
+    RgbToYuv threaded(4);
+    const AVPixelFormat srcs[] = { AV_PIX_FMT_RGBA, AV_PIX_FMT_BGRA };
+    const AVPixelFormat dsts[] = { AV_PIX_FMT_NV12, AV_PIX_FMT_YUV420P };
+    std::vector<uint8_t> src = make_source(w, h, w * 31 + h);
+
+    for (AVPixelFormat sf : srcs) {
+        for (AVPixelFormat df : dsts) {
+            SCOPED_TRACE(testing::Message() << "src " << sf << " dst " << df);
+            Frame ref(w, h, df), a(w, h, df), b(w, h, df);
+            ASSERT_EQ(c_kernel.convert(src.data(), w * 4, sf, w, h, false, ref.planes, ref.strides, df), 0);
+            EXPECT_LE(reference_error(src, sf, ref), 2);
+
+            simd.convert(src.data(), w * 4, sf, w, h, false, a.planes, a.strides, df);
+            EXPECT_TRUE(same(ref, a)) << simd.kernelName();
+            threaded.convert(src.data(), w * 4, sf, w, h, false, b.planes, b.strides, df);
+            EXPECT_TRUE(same(ref, b)) << "row bands";
+        }
+    }
+}
+
+TEST_P(RgbToYuvTest, Flip)
+{
+    int w = std::get<0>(GetParam()), h = std::get<1>(GetParam());
+    RgbToYuv c_kernel(1, false);
+    RgbToYuv threaded(4);
+    std::vector<uint8_t> src = make_source(w, h, w * 31 + h);
+
+    // same as converting the rows in reverse order
+    std::vector<uint8_t> flipped(src.size());
+    for (int y = 0; y < h; y++)
+        memcpy(&flipped[(size_t)y * w * 4], &src[(size_t)(h - 1 - y) * w * 4], w * 4);
+    for (AVPixelFormat sf : { AV_PIX_FMT_RGBA, AV_PIX_FMT_BGRA }) {
+        for (AVPixelFormat df : { AV_PIX_FMT_NV12, AV_PIX_FMT_YUV420P }) {
+            Frame fr(w, h, df), ff(w, h, df);
+            c_kernel.convert(flipped.data(), w * 4, sf, w, h, false, fr.planes, fr.strides, df);
+            threaded.convert(src.data(), w * 4, sf, w, h, true, ff.planes, ff.strides, df);
+            EXPECT_TRUE(same(fr, ff)) << "src " << sf << " dst " << df;
+        }
+    }
+}
+
+TEST_P(RgbToYuvTest, Crop)
+{
+    int w = std::get<0>(GetParam()), h = std::get<1>(GetParam());
+    int cx = 6, cy = 4, cw = w - 10, ch = h - 8;
+    if (cw < 2 || ch < 2)
+        GTEST_SKIP() << "too small to crop";
+
+    RgbToYuv c_kernel(1, false);
+    RgbToYuv simd(1);
+    std::vector<uint8_t> src = make_source(w, h, w * 31 + h);
+
+    // same as converting a copy of the cropped region
+    std::vector<uint8_t> cropped((size_t)cw * ch * 4);
+    for (int y = 0; y < ch; y++)
+        memcpy(&cropped[(size_t)y * cw * 4], &src[((size_t)(y + cy) * w + cx) * 4], cw * 4);
+    for (AVPixelFormat sf : { AV_PIX_FMT_RGBA, AV_PIX_FMT_BGRA }) {
+        for (AVPixelFormat df : { AV_PIX_FMT_NV12, AV_PIX_FMT_YUV420P }) {
+            Frame cr(cw, ch, df), cc(cw, ch, df);
+            c_kernel.convert(cropped.data(), cw * 4, sf, cw, ch, false, cr.planes, cr.strides, df);
+            simd.convert(&src[((size_t)cy * w + cx) * 4], w * 4, sf, cw, ch, false,
+                         cc.planes, cc.strides, df);
+            EXPECT_TRUE(same(cr, cc)) << "src " << sf << " dst " << df;
+        }
+    }
+}
+
+TEST_P(RgbToYuvTest, RejectsOddWidth)
+{
+    int w = std::get<0>(GetParam()), h = std::get<1>(GetParam());
+    RgbToYuv simd(1);
+    std::vector<uint8_t> src = make_source(w, h, 1);
+    Frame f(w, h, AV_PIX_FMT_NV12);
+    EXPECT_NE(simd.convert(src.data(), w * 4, AV_PIX_FMT_RGBA, w - 1, h, false, f.planes, f.strides,
+                           AV_PIX_FMT_NV12), 0);
+}
+
+INSTANTIATE_TEST_SUITE_P(Sizes, RgbToYuvTest,
+                         ::testing::Values(std::make_tuple(2, 2), std::make_tuple(30, 6), std::make_tuple(64, 2),
+                                           std::make_tuple(96, 34), std::make_tuple(126, 10),
+                                           std::make_tuple(720, 1280), std::make_tuple(2560, 1440)));
+
+TEST(RgbToYuvBench, DISABLED_Bench)
+{
+    bench(1280, 720, 1, 200);
+    bench(1920, 1080, 1, 100);
+    bench(3840, 2160, 1, 30);
+    bench(3840, 2160, 4, 30);
+}
@@ -0,0 +1,50 @@
+// Copyright (C) 2023 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions
+// and limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include <stdint.h>
+
+// The clock of a simulated encoder: frames come at |fps|, which a test may
+// change between frames, and |nowUs| is the time of the next one. The
+// encoding itself is up to the test, passed as a callback taking that time.
+struct SimEncoder {
+    float fps;
+    int64_t nowUs = 0;
+
+    explicit SimEncoder(float fps) : fps(fps) {}
+
+    int64_t frameUs() const { return (int64_t)(1000000 / fps); }
+
+    template <typename Encode>
+    void encodeFrames(int frames, Encode encode)
+    {
+        for (int i = 0; i < frames; i++) {
+            encode(nowUs);
+            nowUs += frameUs();
+        }
+    }
+
+    template <typename Encode>
+    void encodeFor(int seconds, Encode encode)
+    {
+        int64_t endUs = nowUs + seconds * 1000000LL;
+        while (nowUs < endUs) {
+            encode(nowUs);
+            nowUs += frameUs();
+        }
+    }
+};
@@ -0,0 +1,89 @@
+// Copyright (C) 2023 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions
+// and limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+// Checks of the TCAE frame drop decisions: a run of drops while the delay
+// is over the target, and frames the caller encodes anyway not counted as
+// dropped.
+
+#include <gtest/gtest.h>
+
+#include "CTcaeWrapper.h"
+
+namespace {
+    const uint32_t TargetDelayMs = 100;
+    const uint32_t FrameSize = 10000;
+
+    class FrameDropTest : public ::testing::Test
+    {
+    protected:
+        void SetUp() override
+        {
+            ASSERT_EQ(tcae.Initialize(TargetDelayMs, 0, TCAE_RC_NETPRED, true), 0);
+            ASSERT_EQ(tcae.SetFps(60), 0);
+        }
+
+        // Feedback of an encoded frame that took |delayMs| to arrive
+        void Feed(uint32_t delayMs)
+        {
+            tcae.UpdateEncodedSize(FrameSize);
+            tcae.UpdateClientFeedback(delayMs * 1000, FrameSize);
+        }
+
+        // Frames dropped in a row from now on, at most |max|
+        int Drops(int max = 10)
+        {
+            for (int i = 0; i < max; i++) {
+                bool drop = false;
+                tcae.GetTargetSize(&drop);
+                if (!drop)
+                    return i;
+            }
+            return max;
+        }
+
+        CTcaeWrapper tcae;
+    };
+}
+
+TEST_F(FrameDropTest, NoDropUnderTheTarget)
+{
+    Feed(TargetDelayMs / 2);
+    EXPECT_EQ(Drops(), 0);
+}
+
+TEST_F(FrameDropTest, DropsInProportionToTheDelay)
+{
+    // twice the target, two frames to catch up
+    Feed(2 * TargetDelayMs);
+    EXPECT_EQ(Drops(), 2);
+}
+
+TEST_F(FrameDropTest, KeptFrameIsNotCountedAsDropped)
+{
+    Feed(2 * TargetDelayMs);
+    // a forced key frame, encoded whatever is predicted
+    EXPECT_GT(tcae.GetTargetSize(nullptr), 0u);
+    EXPECT_EQ(Drops(), 2);
+}
+
+TEST_F(FrameDropTest, KeptFrameEndsTheRun)
+{
+    Feed(2 * TargetDelayMs);
+    EXPECT_EQ(Drops(1), 1);
+    EXPECT_GT(tcae.GetTargetSize(nullptr), 0u);
+    // the kept frame was sent, the delay still asks for two drops
+    EXPECT_EQ(Drops(), 2);
+}
@@ -0,0 +1,140 @@
+// Copyright (C) 2023 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions
+// and limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+// Microbenchmark for NetPred client feedback processing.
+//
+// Simulates a number of sessions, each receiving client feedback at a given
+// rate, and reports the cost of NetPred::UpdateSizeAndDelay() per feedback
+// and the share of one CPU core needed to keep up with all sessions.
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <chrono>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "net_pred.h"
+
+using namespace std::chrono;
+
+namespace {
+    int g_sessions = 1000;
+    int g_fps = 240;
+    int g_seconds = 10;
+    int g_window = 100;
+
+    struct Session
+    {
+        std::unique_ptr<NetPred> pred;
+        double msPerKB;    // inverse bandwidth of the simulated link
+        double baseDelay;  // propagation delay of the simulated link, ms
+    };
+}
+
+static void usage(const char* app)
+{
+    printf("usage: %s [options]\n", app);
+    printf("  -s, --sessions <n>  number of sessions (default: %d)\n", g_sessions);
+    printf("  -f, --fps <n>       feedback rate per session, Hz (default: %d)\n", g_fps);
+    printf("  -t, --seconds <n>   simulated duration, seconds (default: %d)\n", g_seconds);
+    printf("  -w, --window <n>    NetPred recorded length (default: %d)\n", g_window);
+}
+
+int main(int argc, char* argv[])
+{
+    static const struct option long_opts[] = {
+        { "sessions", required_argument, nullptr, 's' },
+        { "fps",      required_argument, nullptr, 'f' },
+        { "seconds",  required_argument, nullptr, 't' },
+        { "window",   required_argument, nullptr, 'w' },
+        { "help",     no_argument,       nullptr, 'h' },
+        { nullptr,    0,                 nullptr, 0 },
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "s:f:t:w:h", long_opts, nullptr)) != -1) {
+        switch (opt) {
+        case 's': g_sessions = atoi(optarg); break;
+        case 'f': g_fps = atoi(optarg); break;
+        case 't': g_seconds = atoi(optarg); break;
+        case 'w': g_window = atoi(optarg); break;
+        case 'h': usage(argv[0]); return 0;
+        default: usage(argv[0]); return -1;
+        }
+    }
+
+    if (g_sessions <= 0 || g_fps <= 0 || g_seconds <= 0 || g_window <= 0) {
+        usage(argv[0]);
+        return -1;
+    }
+
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+
+    std::vector<Session> sessions(g_sessions);
+    for (auto& s : sessions) {
+        s.pred.reset(new NetPred());
+        s.pred->SetMaxTargetSize(50000);
+        s.pred->SetMinTargetSize(5000);
+        s.pred->SetRecordedLen(g_window);
+        s.pred->SetTargetDelay(60);
+        s.pred->SetFPS(g_fps);
+        s.msPerKB = 0.1 + 2.0 * uniform(rng);
+        s.baseDelay = 1.0 + 10.0 * uniform(rng);
+    }
+
+    // Pre-generate jitter so that the timed loop measures NetPred only
+    std::vector<double> jitter(4096);
+    for (auto& j : jitter)
+        j = 3.0 * uniform(rng);
+
+    const uint64_t frames = uint64_t(g_fps) * g_seconds;
+    uint64_t updates = 0;
+    uint64_t checksum = 0;
+    size_t j = 0;
+
+    auto start = steady_clock::now();
+    for (uint64_t frame = 0; frame < frames; frame++) {
+        for (auto& s : sessions) {
+            uint32_t size = s.pred->GetNextFrameSize();
+            double delay = ceil(s.baseDelay + s.msPerKB * size / 1000.0 + jitter[j]);
+            j = (j + 1) % jitter.size();
+
+            s.pred->UpdateSizeAndDelay(size, size, delay);
+            checksum += s.pred->GetNextFrameSize();
+            updates++;
+        }
+    }
+    auto elapsed = duration_cast<nanoseconds>(steady_clock::now() - start).count();
+
+    double nsPerUpdate = double(elapsed) / double(updates);
+    double requiredPerSec = double(g_sessions) * g_fps;
+    double coreShare = requiredPerSec * nsPerUpdate / 1e9;
+
+    printf("sessions:          %d\n", g_sessions);
+    printf("feedback rate:     %d Hz\n", g_fps);
+    printf("window:            %d\n", g_window);
+    printf("updates:           %llu\n", (unsigned long long)updates);
+    printf("elapsed:           %.3f s\n", elapsed / 1e9);
+    printf("per update:        %.1f ns\n", nsPerUpdate);
+    printf("real-time load:    %.2f%% of one core\n", 100.0 * coreShare);
+    printf("checksum:          %llu\n", (unsigned long long)checksum);
+
+    return 0;
+}
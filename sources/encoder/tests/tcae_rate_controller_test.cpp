@@ -0,0 +1,192 @@
+// Copyright (C) 2023 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions
+// and limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+// Checks of the TCAE rate controllers on synthetic links: step down when
+// the capacity drops, back up when it returns, and for the delay-gradient
+// controller, one decrease per queue rather than one per feedback.
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <deque>
+#include <memory>
+#include <string>
+
+#include "rate_controller.h"
+#include "enc_frame_settings_predictor.h"
+#include "delay_gradient_controller.h"
+
+namespace {
+    const double Fps = 60.0;
+    const double TargetDelayMs = 100.0;
+
+    void Configure(RateController *rc)
+    {
+        rc->SetFPS(Fps);
+        rc->SetTargetDelay(TargetDelayMs);
+        rc->SetMinTargetSize(2000);
+        rc->SetMaxTargetSize(200000);
+        rc->SetRecordedLen(100);
+    }
+
+    // A FIFO link of |capacity| bytes per second and 20 ms one way, with the
+    // feedback of each frame back one way after its last packet. Encoded
+    // sizes are paired with the feedback as PredictorTcaeImpl does.
+    class Link
+    {
+    public:
+        Link(RateController *rc, double capacity) : capacity(capacity), m_rc(rc) {}
+
+        // Rate sent in bytes per second and mean feedback delay over |seconds|
+        void Run(double seconds, double *rate, double *delayMs)
+        {
+            double end = m_now + seconds, bytes = 0, delays = 0;
+            int frames = 0, feedbacks = 0;
+
+            while (m_now < end) {
+                while (!m_pending.empty() && m_pending.front().at <= m_now) {
+                    uint32_t encoded = 0;
+                    if (!m_encoded.empty()) {
+                        encoded = m_encoded.front();
+                        m_encoded.pop_front();
+                    }
+                    m_rc->UpdateNetworkState(m_pending.front().data, encoded);
+                    delays += m_pending.front().data.lastPacketDelayInUs / 1000.0;
+                    feedbacks++;
+                    m_pending.pop_front();
+                }
+                for (uint32_t encoded : m_encoded)
+                    m_rc->UpdateEncodedSize(encoded);
+                m_encoded.clear();
+
+                uint32_t size = m_rc->GetNextFrameSize();
+                m_encoded.push_back(size);
+
+                double start = std::max(m_now, m_linkFree);
+                double first = start + std::min(size, 1200u) / capacity;
+                double last = start + size / capacity;
+                m_linkFree = last;
+
+                PerFrameNetworkData_t data = {};
+                data.firstPacketDelayInUs = uint32_t((first - m_now + BaseDelay) * 1e6);
+                data.lastPacketDelayInUs = uint32_t((last - m_now + BaseDelay) * 1e6);
+                data.transmittedDataSizeInBytes = size;
+                m_pending.push_back({ last + 2 * BaseDelay, data });
+
+                bytes += size;
+                frames++;
+                m_now += 1 / Fps;
+            }
+            *rate = bytes / frames * Fps;
+            *delayMs = feedbacks ? delays / feedbacks : 0;
+        }
+
+        double capacity;
+
+    private:
+        static constexpr double BaseDelay = 0.02;
+
+        struct Pending {
+            double at;
+            PerFrameNetworkData_t data;
+        };
+
+        RateController *m_rc;
+        double m_now = 0;
+        double m_linkFree = 0;
+        std::deque<Pending> m_pending;
+        std::deque<uint32_t> m_encoded;
+    };
+
+    class RateControllerTest : public ::testing::TestWithParam<const char*>
+    {
+    protected:
+        void SetUp() override
+        {
+            tcaeRateController type;
+            ASSERT_TRUE(GetRateControllerByName(GetParam(), &type));
+            rc = CreateRateController(type);
+            ASSERT_TRUE(rc);
+            Configure(rc.get());
+        }
+
+        std::unique_ptr<RateController> rc;
+    };
+
+    // Feedback of a 10 KB frame with |delayMs| to a delay-gradient controller
+    void Feed(DelayGradientController *rc, double delayMs)
+    {
+        PerFrameNetworkData_t data = {};
+        data.lastPacketDelayInUs = uint32_t(delayMs * 1000);
+        data.transmittedDataSizeInBytes = 10000;
+        rc->UpdateNetworkState(data, 10000);
+    }
+}
+
+TEST_P(RateControllerTest, StepsDownAndBackUp)
+{
+    Link link(rc.get(), 3e6);
+    double rate, delay;
+    link.Run(10, &rate, &delay);
+
+    link.capacity = 0.6e6;
+    link.Run(5, &rate, &delay);
+    double congested;
+    link.Run(5, &congested, &delay);
+    EXPECT_LT(congested, 1.05 * link.capacity);
+    EXPECT_LT(delay, 1.5 * TargetDelayMs);
+
+    link.capacity = 3e6;
+    link.Run(15, &rate, &delay);
+    EXPECT_GT(rate, 1.3 * congested);
+    EXPECT_LT(delay, 1.5 * TargetDelayMs);
+}
+
+INSTANTIATE_TEST_SUITE_P(Tcae, RateControllerTest, ::testing::Values("netpred", "gcc", "bbr"),
+    [](const ::testing::TestParamInfo<const char*>& info) { return std::string(info.param); });
+
+TEST(DelayGradientTest, CutsOnceWhileQueueDrains)
+{
+    DelayGradientController rc;
+    Configure(&rc);
+    for (int i = 0; i < 120; i++)
+        Feed(&rc, 20);
+    uint32_t before = rc.GetNextFrameSize();
+
+    // a burst queued, then drained over ten frames, all above the target
+    Feed(&rc, 200);
+    uint32_t cut = rc.GetNextFrameSize();
+    EXPECT_LT(cut, before);
+
+    for (int delay = 190; delay >= 110; delay -= 10)
+        Feed(&rc, delay);
+    EXPECT_GE(rc.GetNextFrameSize(), cut);
+}
+
+TEST(DelayGradientTest, KeepsCuttingWhileQueueGrows)
+{
+    DelayGradientController rc;
+    Configure(&rc);
+    for (int i = 0; i < 120; i++)
+        Feed(&rc, 20);
+    uint32_t before = rc.GetNextFrameSize();
+
+    // the queue grows by 10 ms a frame for a second
+    for (int i = 0; i < 60; i++)
+        Feed(&rc, 110 + 10 * i);
+
+    EXPECT_LT(rc.GetNextFrameSize(), before * 0.85 * 0.85);
+}
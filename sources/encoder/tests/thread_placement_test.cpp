@@ -0,0 +1,134 @@
+// Copyright (C) 2023 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions
+// and limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+// ThreadPlacement: role policies parsed from the command line, and applied
+// to the calling thread for what needs no privileges, i.e. the affinity,
+// the nice value and the thread name.
+
+#include <gtest/gtest.h>
+
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "utils/ThreadPlacement.h"
+
+namespace {
+    class ThreadPlacementTest : public ::testing::Test
+    {
+    protected:
+        void TearDown() override
+        {
+            ThreadPlacement::configure(nullptr, nullptr);
+        }
+    };
+
+    int current_nice()
+    {
+        return getpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid));
+    }
+
+    std::string current_name()
+    {
+        char name[16] = {};
+        pthread_getname_np(pthread_self(), name, sizeof(name));
+        return name;
+    }
+}
+
+TEST_F(ThreadPlacementTest, ParsesCpuLists)
+{
+    std::vector<int> cpus;
+    EXPECT_TRUE(ThreadPlacement::parseCpuList("0-3,8,10-11\n", cpus));
+    EXPECT_EQ(cpus, std::vector<int>({ 0, 1, 2, 3, 8, 10, 11 }));
+    EXPECT_TRUE(ThreadPlacement::parseCpuList("5", cpus));
+    EXPECT_EQ(cpus, std::vector<int>({ 5 }));
+}
+
+TEST_F(ThreadPlacementTest, RejectsBadCpuLists)
+{
+    for (const char *list : { "", "a", "3-1", "1,,2", "1-", "-1", "0-99999" }) {
+        std::vector<int> cpus = { 7 };
+        EXPECT_FALSE(ThreadPlacement::parseCpuList(list, cpus)) << list;
+        EXPECT_EQ(cpus, std::vector<int>({ 7 })) << list;
+    }
+}
+
+TEST_F(ThreadPlacementTest, ConfiguresPolicies)
+{
+    EXPECT_EQ(ThreadPlacement::configure(nullptr, nullptr), 0);
+    EXPECT_EQ(ThreadPlacement::configure("", nullptr), 0);
+    EXPECT_EQ(ThreadPlacement::configure("transcoder:cpus=0:fifo=10;vhal:nice=-5;all:nice=3", nullptr), 0);
+}
+
+TEST_F(ThreadPlacementTest, RejectsBadPolicies)
+{
+    for (const char *policy : { "encoder:nice=1", "io:nice=20", "io:fifo=0", "io:cpus=x", "io:node=-1",
+                                "io:speed=1", "io:nice" })
+        EXPECT_LT(ThreadPlacement::configure(policy, nullptr), 0) << policy;
+}
+
+TEST_F(ThreadPlacementTest, AppliesAffinityNiceAndName)
+{
+    cpu_set_t allowed;
+    sched_getaffinity(0, sizeof(allowed), &allowed);
+    int cpu = 0;
+    while (!CPU_ISSET(cpu, &allowed))
+        cpu++;
+
+    std::string policy = "io:cpus=" + std::to_string(cpu) + ":nice=7";
+    ASSERT_EQ(ThreadPlacement::configure(policy.c_str(), "/dev/dri/renderD128"), 0);
+
+    std::thread([cpu] {
+        ThreadPlacement::apply(ThreadPlacement::IO_WRITER, "icr-test-io-thread");
+
+        cpu_set_t set;
+        sched_getaffinity(0, sizeof(set), &set);
+        EXPECT_EQ(CPU_COUNT(&set), 1);
+        EXPECT_TRUE(CPU_ISSET(cpu, &set));
+        EXPECT_EQ(current_nice(), 7);
+        EXPECT_EQ(current_name(), "icr-test-io-thr");
+        EXPECT_EQ(ThreadPlacement::currentNode(), -1);
+
+        // applied once only
+        ThreadPlacement::applyOnce(ThreadPlacement::TRANSCODER, "other");
+        EXPECT_EQ(current_name(), "icr-test-io-thr");
+    }).join();
+}
+
+TEST_F(ThreadPlacementTest, RolesWithoutPolicyAreOnlyNamed)
+{
+    ASSERT_EQ(ThreadPlacement::configure("io:nice=7", nullptr), 0);
+
+    cpu_set_t allowed;
+    sched_getaffinity(0, sizeof(allowed), &allowed);
+    int nice = current_nice();
+    std::thread([&allowed, nice] {
+        ThreadPlacement::applyOnce(ThreadPlacement::PIPE_MSG, "icr-test-pipe");
+        cpu_set_t set;
+        sched_getaffinity(0, sizeof(set), &set);
+        EXPECT_TRUE(CPU_EQUAL(&set, &allowed));
+        EXPECT_EQ(current_nice(), nice);
+        EXPECT_EQ(current_name(), "icr-test-pipe");
+    }).join();
+}
@@ -0,0 +1,782 @@
+// Copyright (C) 2023 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions
+// and limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+// Replays VHAL display events recorded by aic-emu (tests/aic-emu/*.yml).
+//
+// The events Android sends to the display server, CREATE_BUFFER,
+// REMOVE_BUFFER and DISPLAY_REQ, are fed into
+// DisplayServerVHAL::CommandHandler() by a stand-in for libvhal's
+// VirtualHwcReceiver, at the recorded pace or as fast as possible. The
+// renderer behind the display server imports buffers into system memory
+// surfaces and encodes displayed frames with a libavcodec software
+// encoder, so neither Android nor a GPU is needed.
+//
+// Reported are the handling time of each event type next to the one
+// recorded (request to ack), the cost of buffer creation and removal,
+// and the encode latency of displayed frames.
+//
+// Each recorded buffer is backed by a memfd standing in for its dma-buf,
+// sent with a new fd on each CREATE_BUFFER as over the libvhal socket, so
+// the display server's buffer cache recognizes buffers created again.
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavutil/opt.h>
+}
+
+#include "display_server_vhal.h"
+
+using namespace std::chrono;
+using namespace vhal::client;
+
+namespace {
+    const char *g_encoder = "mpeg4";
+    bool g_realtime = false;
+    int g_loops = 1;
+    long g_max_events = 0;
+
+    enum EventType {
+        EVENT_CREATE_BUFFER,
+        EVENT_REMOVE_BUFFER,
+        EVENT_DISPLAY_REQ,
+        EVENT_OTHER,
+        EVENT_TYPES,
+    };
+
+    const char *kEventNames[EVENT_TYPES] = {
+        "CREATE_BUFFER", "REMOVE_BUFFER", "DISPLAY_REQ", "other",
+    };
+
+    // Buffer description of a CREATE_BUFFER event
+    struct BufferDesc
+    {
+        int numFds = 0;
+        int numInts = 0;
+        int fds[4] = {};
+        uint32_t strides[4] = {};
+        uint32_t offsets[4] = {};
+        uint32_t sizes[4] = {};
+        uint32_t format_modifiers[8] = {};
+        uint32_t width = 0;
+        uint32_t height = 0;
+        uint32_t format = 0;
+        int droid_format = 0;
+    };
+
+    // Event received from Android
+    struct Event
+    {
+        EventType type;
+        uint64_t ts_us;          // recorded time
+        uint64_t remote_handle;
+        int64_t recorded_us;     // request to ack in the recording, -1 if unknown
+        int desc;                // index of the buffer description, -1 if none
+    };
+
+    struct Recording
+    {
+        std::vector<Event> events;
+        std::vector<BufferDesc> descs;
+        long skipped = 0;        // events not going to the display server
+    };
+
+    double percentile(std::vector<double> &v, double p)
+    {
+        if (v.empty())
+            return 0.0;
+        size_t i = std::min(v.size() - 1, size_t(p * v.size()));
+        std::nth_element(v.begin(), v.begin() + i, v.end());
+        return v[i];
+    }
+
+    // Parses "[a, b, c]" into up to |n| values
+    template <typename T>
+    void parse_array(const std::string &value, T *out, int n)
+    {
+        const char *p = value.c_str();
+        for (int i = 0; i < n && *p; i++) {
+            while (*p && (*p == '[' || *p == ' ' || *p == ','))
+                p++;
+            char *end = nullptr;
+            long long v = strtoll(p, &end, 0);
+            if (end == p)
+                break;
+            out[i] = (T)v;
+            p = end;
+        }
+    }
+
+    EventType event_type(const std::string &name)
+    {
+        if (name == "VHAL_DD_EVENT_CREATE_BUFFER")
+            return EVENT_CREATE_BUFFER;
+        if (name == "VHAL_DD_EVENT_REMOVE_BUFFER")
+            return EVENT_REMOVE_BUFFER;
+        if (name == "VHAL_DD_EVENT_DISPLAY_REQ")
+            return EVENT_DISPLAY_REQ;
+        return EVENT_OTHER;
+    }
+
+    // The recordings are a stream of YAML documents, one per event, with
+    // unique keys for the fields used here; a line parser is enough.
+    bool load_recording(const char *path, Recording *rec)
+    {
+        std::ifstream in(path);
+        if (!in) {
+            fprintf(stderr, "cannot open %s\n", path);
+            return false;
+        }
+
+        std::map<std::string, std::string> fields;
+        std::map<uint64_t, size_t> pending;  // display requests waiting for their ack
+        auto flush = [&]() {
+            if (fields.empty())
+                return;
+            std::string name = fields["eventName"];
+            bool receive = fields["direction"] == "receive";
+            uint64_t ts = strtoull(fields["timeStampUs"].c_str(), nullptr, 10);
+            uint64_t handle = strtoull(fields["remote_handle"].c_str(), nullptr, 10);
+            EventType type = event_type(name);
+
+            if (name == "VHAL_DD_EVENT_DISPLAY_ACK") {
+                auto it = pending.find(handle);
+                if (it != pending.end()) {
+                    Event &req = rec->events[it->second];
+                    req.recorded_us = (int64_t)(ts - req.ts_us);
+                    pending.erase(it);
+                }
+            } else if (!receive || type == EVENT_OTHER) {
+                rec->skipped++;
+            } else {
+                Event ev = { type, ts, handle, -1, -1 };
+                if (type == EVENT_CREATE_BUFFER) {
+                    BufferDesc d;
+                    d.numFds = atoi(fields["numFds"].c_str());
+                    d.numInts = atoi(fields["numInts"].c_str());
+                    parse_array(fields["fds"], d.fds, 4);
+                    parse_array(fields["strides"], d.strides, 4);
+                    parse_array(fields["offsets"], d.offsets, 4);
+                    parse_array(fields["sizes"], d.sizes, 4);
+                    parse_array(fields["format_modifiers"], d.format_modifiers, 8);
+                    d.width = strtoul(fields["width"].c_str(), nullptr, 10);
+                    d.height = strtoul(fields["height"].c_str(), nullptr, 10);
+                    d.format = strtoul(fields["format"].c_str(), nullptr, 10);
+                    d.droid_format = atoi(fields["droid_format"].c_str());
+                    ev.desc = (int)rec->descs.size();
+                    rec->descs.push_back(d);
+                }
+                if (type == EVENT_DISPLAY_REQ)
+                    pending[handle] = rec->events.size();
+                rec->events.push_back(ev);
+            }
+            fields.clear();
+        };
+
+        std::string line;
+        while (std::getline(in, line)) {
+            if (line.compare(0, 3, "---") == 0) {
+                flush();
+                continue;
+            }
+            size_t key = line.find_first_not_of(' ');
+            size_t colon = line.find(':');
+            if (key == std::string::npos || line[key] == '#' || colon == std::string::npos || colon < key)
+                continue;
+            size_t value = line.find_first_not_of(' ', colon + 1);
+            if (value == std::string::npos)
+                continue;
+            fields[line.substr(key, colon - key)] = line.substr(value);
+        }
+        flush();
+        return !rec->events.empty();
+    }
+
+    uint64_t now_ns()
+    {
+        return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+    }
+
+    // Software encoder fed RGBA frames from a queue, on its own thread as
+    // the encoder is behind the renderer.
+    class SoftwareEncoder
+    {
+    public:
+        explicit SoftwareEncoder(const char *name) : m_name(name)
+        {
+            m_thread = std::thread(&SoftwareEncoder::Run, this);
+        }
+
+        ~SoftwareEncoder()
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_stop = true;
+            }
+            m_cond.notify_one();
+            m_thread.join();
+            Close();
+        }
+
+        // Copies the frame, drops it if two are already waiting
+        void Submit(const uint8_t *rgba, int stride, int width, int height)
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            if (m_queue.size() >= 2) {
+                m_dropped++;
+                return;
+            }
+            Frame f;
+            if (!m_free.empty()) {
+                f = std::move(m_free.back());
+                m_free.pop_back();
+            }
+            f.width = width & ~1;
+            f.height = height & ~1;
+            f.stride = width * 4;
+            f.rgba.resize((size_t)f.stride * height);
+            for (int y = 0; y < height; y++)
+                memcpy(&f.rgba[(size_t)y * f.stride], rgba + (size_t)y * stride, f.stride);
+            f.submitted_ns = now_ns();
+            m_queue.push_back(std::move(f));
+            m_cond.notify_one();
+        }
+
+        // Waits for the queued frames to be encoded
+        void Drain()
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_idle.wait(lock, [this] { return m_queue.empty() && !m_busy; });
+        }
+
+        std::vector<double> latency_ms;
+        long encoded = 0;
+        long reopened = 0;
+        uint64_t bytes = 0;
+        bool failed = false;
+
+        long Dropped()
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_dropped;
+        }
+
+    private:
+        struct Frame
+        {
+            std::vector<uint8_t> rgba;
+            int width = 0, height = 0, stride = 0;
+            uint64_t submitted_ns = 0;
+        };
+
+        void Run()
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            while (true) {
+                m_cond.wait(lock, [this] { return m_stop || !m_queue.empty(); });
+                if (m_queue.empty())
+                    break;
+                Frame f = std::move(m_queue.front());
+                m_queue.pop_front();
+                m_busy = true;
+                lock.unlock();
+
+                Encode(f);
+
+                lock.lock();
+                m_free.push_back(std::move(f));
+                m_busy = false;
+                if (m_queue.empty())
+                    m_idle.notify_all();
+            }
+        }
+
+        bool Open(int width, int height)
+        {
+            Close();
+            const AVCodec *codec = avcodec_find_encoder_by_name(m_name);
+            if (!codec) {
+                fprintf(stderr, "encoder %s not found\n", m_name);
+                return false;
+            }
+            m_ctx = avcodec_alloc_context3(codec);
+            m_ctx->width = width;
+            m_ctx->height = height;
+            m_ctx->pix_fmt = AV_PIX_FMT_YUV420P;
+            m_ctx->time_base = { 1, 60 };
+            m_ctx->gop_size = 120;
+            m_ctx->max_b_frames = 0;
+            m_ctx->bit_rate = 4000000;
+            av_opt_set(m_ctx->priv_data, "preset", "ultrafast", 0);
+            av_opt_set(m_ctx->priv_data, "tune", "zerolatency", 0);
+            if (avcodec_open2(m_ctx, codec, nullptr) < 0) {
+                fprintf(stderr, "cannot open encoder %s at %dx%d\n", m_name, width, height);
+                Close();
+                return false;
+            }
+            m_frame = av_frame_alloc();
+            m_frame->width = width;
+            m_frame->height = height;
+            m_frame->format = AV_PIX_FMT_YUV420P;
+            m_packet = av_packet_alloc();
+            if (av_frame_get_buffer(m_frame, 0) < 0) {
+                Close();
+                return false;
+            }
+            reopened++;
+            return true;
+        }
+
+        void Close()
+        {
+            avcodec_free_context(&m_ctx);
+            av_frame_free(&m_frame);
+            av_packet_free(&m_packet);
+        }
+
+        // BT.601 limited range, two rows at a time
+        void ToI420(const Frame &f)
+        {
+            for (int y = 0; y < f.height; y += 2) {
+                const uint8_t *s0 = &f.rgba[(size_t)y * f.stride];
+                const uint8_t *s1 = s0 + f.stride;
+                uint8_t *y0 = m_frame->data[0] + (size_t)y * m_frame->linesize[0];
+                uint8_t *y1 = y0 + m_frame->linesize[0];
+                uint8_t *u = m_frame->data[1] + (size_t)(y / 2) * m_frame->linesize[1];
+                uint8_t *v = m_frame->data[2] + (size_t)(y / 2) * m_frame->linesize[2];
+                for (int x = 0; x < f.width; x += 2) {
+                    int r = 0, g = 0, b = 0;
+                    for (int i = 0; i < 4; i++) {
+                        const uint8_t *p = (i < 2 ? s0 : s1) + (x + (i & 1)) * 4;
+                        uint8_t *out = (i < 2 ? y0 : y1) + x + (i & 1);
+                        *out = (uint8_t)(((66 * p[0] + 129 * p[1] + 25 * p[2] + 128) >> 8) + 16);
+                        r += p[0];
+                        g += p[1];
+                        b += p[2];
+                    }
+                    r /= 4;
+                    g /= 4;
+                    b /= 4;
+                    u[x / 2] = (uint8_t)(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+                    v[x / 2] = (uint8_t)(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+                }
+            }
+        }
+
+        void Encode(const Frame &f)
+        {
+            if (failed)
+                return;
+            if (!m_ctx || m_ctx->width != f.width || m_ctx->height != f.height) {
+                if (!Open(f.width, f.height)) {
+                    failed = true;
+                    return;
+                }
+            }
+            if (av_frame_make_writable(m_frame) < 0)
+                return;
+            ToI420(f);
+            m_frame->pts = m_pts++;
+            if (avcodec_send_frame(m_ctx, m_frame) < 0)
+                return;
+            while (avcodec_receive_packet(m_ctx, m_packet) == 0) {
+                bytes += m_packet->size;
+                av_packet_unref(m_packet);
+            }
+            latency_ms.push_back((now_ns() - f.submitted_ns) / 1e6);
+            encoded++;
+        }
+
+        const char *m_name;
+        AVCodecContext *m_ctx = nullptr;
+        AVFrame *m_frame = nullptr;
+        AVPacket *m_packet = nullptr;
+        int64_t m_pts = 0;
+
+        std::mutex m_mutex;
+        std::condition_variable m_cond;
+        std::condition_variable m_idle;
+        std::deque<Frame> m_queue;
+        std::vector<Frame> m_free;
+        std::thread m_thread;
+        long m_dropped = 0;
+        bool m_busy = false;
+        bool m_stop = false;
+    };
+
+    // Renderer with buffers imported into system memory surfaces. A
+    // displayed buffer is drawn into (a band moves down the frame) and
+    // handed to the software encoder.
+    class ReplayRenderer : public DisplayRenderer
+    {
+    public:
+        explicit ReplayRenderer(SoftwareEncoder *encoder) : m_encoder(encoder) {}
+
+        bool init(char *name, encoder_info_t *info) override { return true; }
+        void deinit() override {}
+
+        disp_res_t* createDispRes(cros_gralloc_handle_t handle) override
+        {
+            disp_res_t *res = new disp_res_t();
+            res->local_handle = &handle->base;
+            res->width = handle->width;
+            res->height = handle->height;
+            res->drm_format = handle->format;
+            res->android_format = handle->droid_format;
+            for (int i = 0; i < MAX_HANDLE_COUNT; i++) {
+                res->prime_fds[i] = handle->fds[i];
+                res->strides[i] = handle->strides[i];
+                res->offsets[i] = handle->offsets[i];
+            }
+            int stride = res->strides[0] ? res->strides[0] : res->width * 4;
+
+            irr_surface_t *surface = new irr_surface_t();
+            surface->info.width = res->width;
+            surface->info.height = res->height;
+            surface->info.format = res->drm_format;
+            surface->info.stride[0] = stride;
+            surface->info.data_size = stride * res->height;
+            surface->info.pdata = new unsigned char[surface->info.data_size];
+            // Touch the pages as an import would
+            memset(surface->info.pdata, 0x40, surface->info.data_size);
+            surface->ref_count = 1;
+            res->surface = surface;
+            surface_bytes += surface->info.data_size;
+            imports++;
+            return res;
+        }
+
+        void destroyDispRes(disp_res_t *res) override
+        {
+            if (!res)
+                return;
+            if (res->surface) {
+                delete[] res->surface->info.pdata;
+                delete res->surface;
+            }
+            delete res;
+        }
+
+        void drawDispRes(disp_res_t *res, int client_id, int client_count,
+                         std::unique_ptr<display_control_t> ctrl) override
+        {
+            irr_surface_t *s = res->surface;
+            int band = std::max(1, s->info.height / 16);
+            int y0 = (int)(m_frames++ % 16) * band;
+            for (int y = y0; y < std::min(y0 + band, s->info.height); y++)
+                memset(s->info.pdata + (size_t)y * s->info.stride[0], (int)(m_frames & 0xff), s->info.width * 4);
+            if (m_encoder)
+                m_encoder->Submit(s->info.pdata, s->info.stride[0], s->info.width, s->info.height);
+        }
+
+        void setVideoMode(int mode_info) override {}
+        void beginFrame() override {}
+        void endFrame() override {}
+        void retireFrame() override {}
+        void flushDelayDelRes() override {}
+        int getCropFlag() override { return 0; }
+        void ChangeResolution(int width, int height) override { resolution_changes++; }
+
+        uint64_t surface_bytes = 0;
+        long imports = 0;
+        long resolution_changes = 0;
+
+    private:
+        SoftwareEncoder *m_encoder;
+        uint64_t m_frames = 0;
+    };
+
+    // Display server whose events come from the replay instead of libvhal
+    class ReplayDisplayServer : public DisplayServerVHAL
+    {
+    public:
+        ReplayDisplayServer(DisplayRenderer *renderer, uint32_t width, uint32_t height)
+        {
+            m_renderer = renderer;
+            m_curWidth = width;
+            m_curHeight = height;
+        }
+
+        ~ReplayDisplayServer()
+        {
+            for (auto &it : m_dispReses)
+                m_bufferCache.release(m_renderer, it.second);
+            m_dispReses.clear();
+            m_bufferCache.clear(m_renderer);
+            m_renderer = nullptr;
+        }
+
+        void Handle(CommandType cmd, const frame_info_t *frame) { CommandHandler(cmd, frame); }
+        size_t Buffers() const { return m_dispReses.size(); }
+        const DisplayBufferCache::Stats &CacheStats() const { return m_bufferCache.stats(); }
+    };
+
+    // Stand-in for VirtualHwcReceiver: keeps a local handle per remote
+    // buffer and calls the handler for each event, as libvhal does.
+    class ReplayHwcReceiver
+    {
+    public:
+        using Handler = std::function<void(CommandType cmd, const frame_info_t *frame)>;
+
+        ReplayHwcReceiver(const Recording &rec, Handler handler) : m_rec(rec), m_handler(std::move(handler)) {}
+
+        ~ReplayHwcReceiver()
+        {
+            for (auto &it : m_handles)
+                close(it.second->fds[0]);
+            for (auto &it : m_buffers)
+                close(it.second);
+        }
+
+        // Returns false for an event the handler is not called for
+        bool Dispatch(const Event &ev)
+        {
+            frame_info_t frame{};
+            switch (ev.type) {
+            case EVENT_CREATE_BUFFER: {
+                std::unique_ptr<cros_gralloc_handle> &h = m_handles[ev.remote_handle];
+                if (h)
+                    close(h->fds[0]);
+                h.reset(new cros_gralloc_handle());
+                const BufferDesc &d = m_rec.descs[ev.desc];
+                h->base.version = sizeof(h->base);
+                h->base.numFds = d.numFds;
+                h->base.numInts = d.numInts;
+                for (int i = 0; i < 4; i++) {
+                    h->fds[i] = -1;
+                    h->strides[i] = d.strides[i];
+                    h->offsets[i] = d.offsets[i];
+                    h->sizes[i] = d.sizes[i];
+                }
+                for (int i = 0; i < 8; i++)
+                    h->format_modifiers[i] = d.format_modifiers[i];
+                h->width = d.width;
+                h->height = d.height;
+                h->format = d.format;
+                h->droid_format = d.droid_format;
+                h->fds[0] = dup(Buffer(ev.remote_handle));
+                frame.handle = h.get();
+                m_handler(FRAME_CREATE, &frame);
+                return true;
+            }
+            case EVENT_REMOVE_BUFFER: {
+                auto it = m_handles.find(ev.remote_handle);
+                if (it == m_handles.end())
+                    return false;
+                frame.handle = it->second.get();
+                m_handler(FRAME_REMOVE, &frame);
+                close(it->second->fds[0]);
+                m_handles.erase(it);
+                return true;
+            }
+            case EVENT_DISPLAY_REQ: {
+                auto it = m_handles.find(ev.remote_handle);
+                if (it == m_handles.end())
+                    return false;
+                frame.handle = it->second.get();
+                m_handler(FRAME_DISPLAY, &frame);
+                return true;
+            }
+            default:
+                return false;
+            }
+        }
+
+    private:
+        // The stand-in dma-buf of a remote buffer, it lives as long as the receiver
+        int Buffer(uint64_t remote_handle)
+        {
+            auto it = m_buffers.find(remote_handle);
+            if (it != m_buffers.end())
+                return it->second;
+            int fd = (int)syscall(SYS_memfd_create, "vhal-replay-buffer", 0);
+            m_buffers[remote_handle] = fd;
+            return fd;
+        }
+
+        const Recording &m_rec;
+        Handler m_handler;
+        std::map<uint64_t, std::unique_ptr<cros_gralloc_handle>> m_handles;
+        std::map<uint64_t, int> m_buffers;
+    };
+
+    struct Stats
+    {
+        std::vector<double> handle_us[EVENT_TYPES];
+        std::vector<double> recorded_us[EVENT_TYPES];
+        long unmatched = 0;
+    };
+
+    void report_latency(const char *name, std::vector<double> &v)
+    {
+        if (v.empty())
+            return;
+        double sum = 0;
+        for (double x : v)
+            sum += x;
+        double mean = sum / v.size();
+        printf("  %-24s n=%-7zu mean=%9.1f p50=%9.1f p95=%9.1f p99=%9.1f max=%9.1f\n", name, v.size(),
+               mean, percentile(v, 0.5), percentile(v, 0.95), percentile(v, 0.99), percentile(v, 1.0));
+    }
+
+    int replay(const char *path)
+    {
+        Recording rec;
+        if (!load_recording(path, &rec)) {
+            fprintf(stderr, "%s: no events\n", path);
+            return -1;
+        }
+
+        uint32_t width = 0, height = 0;
+        if (!rec.descs.empty()) {
+            width = rec.descs[0].width;
+            height = rec.descs[0].height;
+        }
+
+        std::unique_ptr<SoftwareEncoder> encoder;
+        if (strcmp(g_encoder, "none") != 0)
+            encoder.reset(new SoftwareEncoder(g_encoder));
+        ReplayRenderer renderer(encoder.get());
+        Stats stats;
+        long dispatched = 0;
+        DisplayBufferCache::Stats cache;
+        uint64_t start = now_ns();
+        {
+            ReplayDisplayServer server(&renderer, width, height);
+            ReplayHwcReceiver receiver(rec, [&server](CommandType cmd, const frame_info_t *frame) {
+                server.Handle(cmd, frame);
+            });
+
+            for (int loop = 0; loop < g_loops; loop++) {
+                auto loop_start = steady_clock::now();
+                for (const Event &ev : rec.events) {
+                    if (g_max_events > 0 && dispatched >= g_max_events)
+                        break;
+                    if (g_realtime)
+                        std::this_thread::sleep_until(loop_start + microseconds(ev.ts_us - rec.events[0].ts_us));
+                    uint64_t t0 = now_ns();
+                    if (!receiver.Dispatch(ev)) {
+                        stats.unmatched++;
+                        continue;
+                    }
+                    stats.handle_us[ev.type].push_back((now_ns() - t0) / 1e3);
+                    if (ev.recorded_us >= 0)
+                        stats.recorded_us[ev.type].push_back((double)ev.recorded_us);
+                    dispatched++;
+                }
+            }
+            if (encoder)
+                encoder->Drain();
+            cache = server.CacheStats();
+        }
+        double elapsed = (now_ns() - start) / 1e9;
+
+        printf("%s\n", path);
+        printf("  events %ld in %.3f s (%.0f/s), %ld without a buffer, %ld not for the display server\n",
+               dispatched, elapsed, dispatched / elapsed, stats.unmatched, rec.skipped);
+        printf(" handling us:\n");
+        for (int t = 0; t < EVENT_OTHER; t++)
+            report_latency(kEventNames[t], stats.handle_us[t]);
+        printf(" recorded request to ack us:\n");
+        report_latency(kEventNames[EVENT_DISPLAY_REQ], stats.recorded_us[EVENT_DISPLAY_REQ]);
+
+        double churn_us = 0;
+        for (double x : stats.handle_us[EVENT_CREATE_BUFFER])
+            churn_us += x;
+        for (double x : stats.handle_us[EVENT_REMOVE_BUFFER])
+            churn_us += x;
+        printf(" buffer churn: %zu created, %zu removed, %.1f ms total, %.1f MiB of surfaces, %ld resolution changes\n",
+               stats.handle_us[EVENT_CREATE_BUFFER].size(), stats.handle_us[EVENT_REMOVE_BUFFER].size(),
+               churn_us / 1e3, renderer.surface_bytes / 1048576.0, renderer.resolution_changes);
+        printf(" buffer imports: %ld for %zu created, %ld reused from the cache, %ld evicted\n",
+               renderer.imports, stats.handle_us[EVENT_CREATE_BUFFER].size(), cache.hits, cache.evictions);
+        if (encoder) {
+            printf(" encode (%s) ms: %ld frames, %ld dropped, %ld opens, %.1f KiB/frame\n", g_encoder,
+                   encoder->encoded, encoder->Dropped(), encoder->reopened,
+                   encoder->encoded ? encoder->bytes / 1024.0 / encoder->encoded : 0.0);
+            report_latency("latency", encoder->latency_ms);
+            if (encoder->failed)
+                return -1;
+        }
+        return 0;
+    }
+}
+
+static void usage(const char* app)
+{
+    printf("usage: %s [options] <recording.yml>...\n", app);
+    printf("  -r, --realtime        replay at the recorded pace (default: as fast as possible)\n");
+    printf("  -e, --encoder <name>  libavcodec encoder, or none (default: %s)\n", g_encoder);
+    printf("  -l, --loops <n>       replay each recording n times (default: %d)\n", g_loops);
+    printf("  -n, --max-events <n>  stop after n events per recording (default: all)\n");
+}
+
+int main(int argc, char* argv[])
+{
+    static const struct option long_opts[] = {
+        { "realtime",   no_argument,       nullptr, 'r' },
+        { "encoder",    required_argument, nullptr, 'e' },
+        { "loops",      required_argument, nullptr, 'l' },
+        { "max-events", required_argument, nullptr, 'n' },
+        { "help",       no_argument,       nullptr, 'h' },
+        { nullptr,      0,                 nullptr, 0 },
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "re:l:n:h", long_opts, nullptr)) != -1) {
+        switch (opt) {
+        case 'r': g_realtime = true; break;
+        case 'e': g_encoder = optarg; break;
+        case 'l': g_loops = atoi(optarg); break;
+        case 'n': g_max_events = atol(optarg); break;
+        case 'h': usage(argv[0]); return 0;
+        default: usage(argv[0]); return -1;
+        }
+    }
+
+    if (optind >= argc || g_loops <= 0 || g_max_events < 0) {
+        usage(argv[0]);
+        return -1;
+    }
+
+    int ret = 0;
+    for (int i = optind; i < argc; i++) {
+        if (replay(argv[i]) < 0)
+            ret = 1;
+    }
+    return ret;
+}
@@ -24,11 +24,22 @@
  */
 #include "dpipe.h"
 
+#include <errno.h>
 #include <string.h>
 #include <chrono>
 #include <map>
 #include <mutex>
 #include <string>
+#include <thread>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#elif defined WIN32
+#include <malloc.h>
+#endif
 
 using namespace std;
 using namespace std::chrono;
@@ -37,6 +48,115 @@ using namespace std::chrono;
 static std::mutex dpipemap_mutex;
 static map<string,dpipe_t*> dpipemap;
 
+/** Regions at least this large are backed by transparent huge pages if possible */
+#define DPIPE_HUGEPAGE_SIZE    (2 << 20)
+
+static int
+ring_init(dpipe_ring_t *ring, int nframe) {
+    size_t capacity = 1;
+    while(capacity < (size_t) nframe)
+        capacity <<= 1;
+    if((ring->slots = new (nothrow) dpipe_ring_t::slot_s[capacity]) == NULL)
+        return -1;
+    for(size_t i = 0; i < capacity; i++) {
+        ring->slots[i].seq.store(i, memory_order_relaxed);
+        ring->slots[i].buffer = NULL;
+    }
+    ring->mask = capacity - 1;
+    ring->head.store(0, memory_order_relaxed);
+    ring->tail.store(0, memory_order_relaxed);
+    return 0;
+}
+
+/*
+ * Bounded MPMC queue (D. Vyukov). A slot is free for position pos when its
+ * sequence equals pos, and holds the buffer stored at pos when its sequence
+ * equals pos + 1.
+ *
+ * The ring holds at most the buffers of its pipe, so it is never full when
+ * a buffer is pushed. A slot that is not free yet still belongs to a
+ * consumer that took its buffer but has not released the slot, possibly
+ * preempted in between: wait for it rather than lose the buffer.
+ */
+static void
+ring_push(dpipe_ring_t *ring, dpipe_buffer_t *buffer) {
+    dpipe_ring_t::slot_s *slot;
+    size_t pos = ring->tail.load(memory_order_relaxed);
+    for(;;) {
+        slot = &ring->slots[pos & ring->mask];
+        size_t seq = slot->seq.load(memory_order_acquire);
+        intptr_t diff = (intptr_t) seq - (intptr_t) pos;
+        if(diff == 0) {
+            if(ring->tail.compare_exchange_weak(pos, pos + 1, memory_order_relaxed))
+                break;
+        } else if(diff < 0) {
+            this_thread::yield();    // slot being released
+            pos = ring->tail.load(memory_order_relaxed);
+        } else {
+            pos = ring->tail.load(memory_order_relaxed);
+        }
+    }
+    slot->buffer = buffer;
+    slot->seq.store(pos + 1, memory_order_release);
+}
+
+static dpipe_buffer_t *
+ring_pop(dpipe_ring_t *ring) {
+    dpipe_ring_t::slot_s *slot;
+    dpipe_buffer_t *buffer;
+    size_t pos = ring->head.load(memory_order_relaxed);
+    for(;;) {
+        slot = &ring->slots[pos & ring->mask];
+        size_t seq = slot->seq.load(memory_order_acquire);
+        intptr_t diff = (intptr_t) seq - (intptr_t) (pos + 1);
+        if(diff == 0) {
+            if(ring->head.compare_exchange_weak(pos, pos + 1, memory_order_relaxed))
+                break;
+        } else if(diff < 0) {
+            return NULL;    // empty
+        } else {
+            pos = ring->head.load(memory_order_relaxed);
+        }
+    }
+    buffer = slot->buffer;
+    slot->seq.store(pos + ring->mask + 1, memory_order_release);
+    return buffer;
+}
+
+static void *
+region_alloc(size_t size) {
+    void *ptr = NULL;
+#ifdef __linux__
+    ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(ptr == MAP_FAILED)
+        return NULL;
+#ifdef MADV_HUGEPAGE
+    // best effort, fewer TLB misses when converting large frames
+    if(size >= DPIPE_HUGEPAGE_SIZE)
+        madvise(ptr, size, MADV_HUGEPAGE);
+#endif
+#elif defined WIN32
+    ptr = _aligned_malloc(size, DPIPE_ALIGNMENT);
+#else
+    if(posix_memalign(&ptr, DPIPE_ALIGNMENT, size) != 0)
+        ptr = NULL;
+#endif
+    return ptr;
+}
+
+static void
+region_free(void *ptr, size_t size) {
+    if(ptr == NULL)
+        return;
+#ifdef __linux__
+    munmap(ptr, size);
+#elif defined WIN32
+    _aligned_free(ptr);
+#else
+    free(ptr);
+#endif
+}
+
 /**
  * Create and register a new video pipe.
  *
@@ -47,11 +167,14 @@ static map<string,dpipe_t*> dpipemap;
  * @return Pointer to a created dpipe, or NULL on failure
  *
  * Note: dpipe_create() also returns NULL if the requesting name is existed.
+ * All frame buffers are carved from one region, each of them starts
+ * at a DPIPE_ALIGNMENT boundary.
  */
 dpipe_t *
 dpipe_create(int id, const char *name, int nframe, int maxframesize) {
     int i;
     dpipe_t *dpipe;
+    size_t stride;
     // sanity checks
     if(name == NULL || id < 0 || nframe <= 0 || maxframesize <= 0)
         return NULL;
@@ -59,26 +182,29 @@ dpipe_create(int id, const char *name, int nframe, int maxframesize) {
     if((dpipe = dpipe_lookup(name)) != NULL)
         return NULL;
     // allocate the space
-    dpipe = new dpipe_t{};
+    dpipe = new (nothrow) dpipe_t{};
     if(dpipe == NULL)
         return NULL;
     //
     dpipe->channel_id = id;
     if((dpipe->name = strdup(name)) == NULL)
         goto err_create;
+    if(ring_init(&dpipe->in, nframe) < 0 || ring_init(&dpipe->out, nframe) < 0)
+        goto err_create;
     // alloc and init frame buffers
+    stride = ((size_t) maxframesize + DPIPE_ALIGNMENT - 1) & ~((size_t) DPIPE_ALIGNMENT - 1);
+    dpipe->region_size = stride * nframe;
+    if((dpipe->region = region_alloc(dpipe->region_size)) == NULL)
+        goto err_create;
+    if((dpipe->buffers = new (nothrow) dpipe_buffer_t[nframe]) == NULL)
+        goto err_create;
+    dpipe->nbuffers = nframe;
     for(i = 0; i < nframe; i++) {
-        dpipe_buffer_t* dbuffer;
-        if((dbuffer = (dpipe_buffer_t*) malloc(sizeof(dpipe_buffer_t))) == NULL)
-            goto err_create;
-        if(ga_malloc(maxframesize, &dbuffer->internal, &dbuffer->offset) < 0) {
-            free(dbuffer);
-            goto err_create;
-        }
-        dbuffer->pointer = (void*) (((char*) dbuffer->internal) + dbuffer->offset);
-        dbuffer->next = dpipe->in;
-        dpipe->in = dbuffer;
-        dpipe->in_count++;
+        dpipe_buffer_t *dbuffer = &dpipe->buffers[i];
+        dbuffer->internal = ((char*) dpipe->region) + stride * i;
+        dbuffer->offset = 0;
+        dbuffer->pointer = dbuffer->internal;
+        ring_push(&dpipe->in, dbuffer);
     }
     //
     {
@@ -86,7 +212,7 @@ dpipe_create(int id, const char *name, int nframe, int maxframesize) {
         dpipemap[dpipe->name] = dpipe;
     }
     ga_logger(Severity::INFO, "dpipe: '%s' initialized, %d frames, framesize = %d\n",
-        dpipe->name, dpipe->in_count, maxframesize);
+        dpipe->name, dpipe->nbuffers, maxframesize);
     return dpipe;
     // failure cases
 err_create:
@@ -118,7 +244,6 @@ dpipe_lookup(const char *name) {
  */
 int
 dpipe_destroy(dpipe_t *dpipe) {
-    dpipe_buffer_t *vbuf, *next;
     if(dpipe == NULL)
         return 0;
     if(dpipe->name) {
@@ -129,16 +254,10 @@ dpipe_destroy(dpipe_t *dpipe) {
         free(dpipe->name);
     }
     //
-    for(vbuf = dpipe->in; vbuf != NULL; vbuf = next) {
-        next = vbuf->next;
-        free(vbuf->internal);
-        free(vbuf);
-    }
-    for(vbuf = dpipe->out; vbuf != NULL; vbuf = next) {
-        next = vbuf->next;
-        free(vbuf->internal);
-        free(vbuf);
-    }
+    delete[] dpipe->in.slots;
+    delete[] dpipe->out.slots;
+    delete[] dpipe->buffers;
+    region_free(dpipe->region, dpipe->region_size);
     //
     delete dpipe;
     return 0;
@@ -159,29 +278,12 @@ dpipe_destroy(dpipe_t *dpipe) {
  */
 dpipe_buffer_t *
 dpipe_get(dpipe_t *dpipe) {
-    dpipe_buffer_t *vbuf = NULL;
-    //
-    std::lock_guard<std::mutex> lock(dpipe->io_mutex);
-    if(dpipe->in != NULL) {
-        // quick path: has available frame buffers
-        if((vbuf = dpipe->in) != NULL) {
-            dpipe->in = vbuf->next;
-            vbuf->next = NULL;
-            dpipe->in_count--;
-        }
-    } else {
-        // no available buffers: drop the eldest frame buffer from output pool
-        if((vbuf = dpipe->out) != NULL) {
-            dpipe->out = vbuf->next;
-            vbuf->next = NULL;
-            if(dpipe->out == NULL) {
-                dpipe->out_tail = NULL;
-            }
-            dpipe->out_count--;
-        }
-    }
-    //
-    return vbuf;
+    dpipe_buffer_t *vbuf;
+    // quick path: has available frame buffers
+    if((vbuf = ring_pop(&dpipe->in)) != NULL)
+        return vbuf;
+    // no available buffers: drop the eldest frame buffer from output pool
+    return ring_pop(&dpipe->out);
 }
 
 /**
@@ -192,13 +294,23 @@ dpipe_get(dpipe_t *dpipe) {
  */
 void
 dpipe_put(dpipe_t *dpipe, dpipe_buffer_t *buffer) {
-    std::lock_guard<std::mutex> lock(dpipe->io_mutex);
-    buffer->next = dpipe->in;
-    dpipe->in = buffer;
-    dpipe->in_count++;
+    ring_push(&dpipe->in, buffer);
     return;
 }
 
+#ifdef __linux__
+static int
+futex_wait(std::atomic<uint32_t> *addr, uint32_t val, const struct timespec *abstime) {
+    // absolute CLOCK_REALTIME timeout, same clock as the callers' abstime
+    return syscall(SYS_futex, reinterpret_cast<uint32_t*>(addr),
+        FUTEX_WAIT_BITSET_PRIVATE | FUTEX_CLOCK_REALTIME, val, abstime, NULL, FUTEX_BITSET_MATCH_ANY);
+}
+
+static void
+futex_wake_one(std::atomic<uint32_t> *addr) {
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(addr), FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+}
+#else
 static nanoseconds timespec2dur(const timespec& ts)
 {
     auto dur = seconds{ts.tv_sec} + nanoseconds{ts.tv_nsec};
@@ -210,6 +322,7 @@ static time_point<system_clock, nanoseconds> timespec2tp(const timespec& ts)
     return time_point<system_clock, nanoseconds>{
         duration_cast<system_clock::duration>(timespec2dur(ts)) };
 }
+#endif
 
 /**
  * Load a frame from the output pool of the pipe
@@ -222,30 +335,41 @@ static time_point<system_clock, nanoseconds> timespec2tp(const timespec& ts)
  * If \a abstime is NULL, this function blocks until a frame buffer
  * is available in the output pool.
  * If \a abstime is given, it returns NULL on timed out.
+ *
+ * The caller only enters the kernel when the output pool is empty.
  */
 dpipe_buffer_t *
 dpipe_load(dpipe_t *dpipe, const struct timespec *abstime) {
-    dpipe_buffer_t *vbuf = NULL;
+    dpipe_buffer_t *vbuf;
     int failed = 0;
     //
-    std::unique_lock<std::mutex> lock(dpipe->io_mutex);
-again:
-    if(dpipe->out != NULL) {
-        vbuf = dpipe->out;
-        dpipe->out = vbuf->next;
-        vbuf->next = NULL;
-        if(dpipe->out == NULL)
-            dpipe->out_tail = NULL;
-        dpipe->out_count--;
-    } else if(abstime == NULL) {
-        // no frame buffered
-        dpipe->cond.wait(lock);
-        goto again;
-    } else if(failed == 0) {
-        dpipe->cond.wait_until(lock, timespec2tp(*abstime));
-        failed = 1;
-        goto again;
+    if((vbuf = ring_pop(&dpipe->out)) != NULL)
+        return vbuf;
+    //
+    dpipe->waiters.fetch_add(1);
+    atomic_thread_fence(memory_order_seq_cst);
+    for(;;) {
+        // dpipe_store() bumps wakeups after its push once it sees a waiter,
+        // so a frame stored after this snapshot never goes unnoticed
+        uint32_t wakeups = dpipe->wakeups.load();
+        if((vbuf = ring_pop(&dpipe->out)) != NULL || failed)
+            break;
+#ifdef __linux__
+        if(futex_wait(&dpipe->wakeups, wakeups, abstime) < 0 && errno == ETIMEDOUT)
+            failed = 1;
+#else
+        {
+            std::unique_lock<std::mutex> lock(dpipe->wait_mutex);
+            if(dpipe->wakeups.load() == wakeups) {
+                if(abstime == NULL)
+                    dpipe->cond.wait(lock);
+                else if(dpipe->cond.wait_until(lock, timespec2tp(*abstime)) == cv_status::timeout)
+                    failed = 1;
+            }
+        }
+#endif
     }
+    dpipe->waiters.fetch_sub(1);
     //
     return vbuf;
 }
@@ -261,19 +385,7 @@ again:
  */
 dpipe_buffer_t *
 dpipe_load_nowait(dpipe_t *dpipe) {
-    dpipe_buffer_t *vbuf = NULL;
-    //
-    std::lock_guard<std::mutex> lock(dpipe->io_mutex);
-    if(dpipe->out != NULL) {
-        vbuf = dpipe->out;
-        dpipe->out = vbuf->next;
-        vbuf->next = NULL;
-        if(dpipe->out == NULL)
-            dpipe->out_tail = NULL;
-        dpipe->out_count--;
-    }
-    //
-    return vbuf;
+    return ring_pop(&dpipe->out);
 }
 
 /**
@@ -285,18 +397,21 @@ dpipe_load_nowait(dpipe_t *dpipe) {
  */
 void
 dpipe_store(dpipe_t *dpipe, dpipe_buffer_t *buffer) {
-    std::lock_guard<std::mutex> lock(dpipe->io_mutex);
     // put at the end
-    if(dpipe->out_tail != NULL) {
-        dpipe->out_tail->next = buffer;
-        dpipe->out_tail = buffer;
-    } else {
-        dpipe->out = dpipe->out_tail = buffer;
-    }
-    buffer->next = NULL;
-    dpipe->out_count++;
+    ring_push(&dpipe->out, buffer);
+    // pairs with fetch_add(waiters) in dpipe_load()
+    atomic_thread_fence(memory_order_seq_cst);
+    if(dpipe->waiters.load(memory_order_relaxed) == 0)
+        return;
     //
+    dpipe->wakeups.fetch_add(1);
+#ifdef __linux__
+    futex_wake_one(&dpipe->wakeups);
+#else
+    {
+        std::lock_guard<std::mutex> lock(dpipe->wait_mutex);
+    }
     dpipe->cond.notify_one();
+#endif
     return;
 }
-
@@ -28,33 +28,60 @@
 
 #include <stdio.h>
 
+#include <atomic>
 #include <condition_variable>
 #include <mutex>
 
 #include "ga-common.h"
 
+/** Alignment of frame buffers and ring slots, one cache line */
+#define DPIPE_ALIGNMENT    64
+
 /**
  * structure for buffering a frame
  */
 typedef struct dpipe_buffer_s {
-    void *pointer;        /**< pointer to a frame buffer. Aligned to 8-byte address: is equivalent to internal + offset */
-    void *internal;        /**< internal pointer to the allocated buffer space. Used with malloc() and free(). */
+    void *pointer;        /**< pointer to a frame buffer. Aligned to DPIPE_ALIGNMENT: is equivalent to internal + offset */
+    void *internal;        /**< internal pointer to the buffer space, owned by the dpipe */
     int offset;        /**< data pointer offset from internal */
-    struct dpipe_buffer_s *next;    /**< pointer to the next dpipe frame buffer */
 }    dpipe_buffer_t;
 
+/**
+ * Bounded ring of frame buffer pointers. Any number of threads may push
+ * and pop concurrently; with one producer and one consumer every operation
+ * is a single uncontended compare-and-swap. Its capacity is at least the
+ * number of buffers of the pipe, but a pop releases its slot only after
+ * taking the buffer: a push onto a slot still being released by a
+ * preempted consumer waits for it, it never fails.
+ */
+typedef struct dpipe_ring_s {
+    struct alignas(DPIPE_ALIGNMENT) slot_s {
+        std::atomic<size_t> seq;    /**< slot sequence, tells whether the slot is free or occupied for a position */
+        dpipe_buffer_t *buffer;
+    }    *slots;
+    size_t mask;            /**< capacity - 1, capacity is 2^n */
+    alignas(DPIPE_ALIGNMENT) std::atomic<size_t> head;    /**< next position to pop */
+    alignas(DPIPE_ALIGNMENT) std::atomic<size_t> tail;    /**< next position to push */
+}    dpipe_ring_t;
+
 typedef struct dpipe_s {
     int channel_id;        /**< channel id for the dpipe */
     char *name;        /**< name of the dpipe */
     //
-    std::condition_variable cond;    /**< pthread condition */
+    dpipe_ring_t in;        /**< input pool: free frame buffers */
+    dpipe_ring_t out;        /**< output pool: occupied frame buffers, in store order */
+    //
+    dpipe_buffer_t *buffers;    /**< all frame buffers of the pipe */
+    int nbuffers;            /**< number of frame buffers */
+    void *region;            /**< memory backing all frame buffers */
+    size_t region_size;        /**< size of \a region in bytes */
     //
-    std::mutex io_mutex;        /**< dpipe i/o pool operation mutex */
-    dpipe_buffer_t *in;        /**< input pool: pointer to the first frame buffer in input pool (free frames) */
-    dpipe_buffer_t *out;        /**< output pool: pointer to the first frame buffer in output pool (occupied frames) */
-    dpipe_buffer_t *out_tail;    /**< output pool: pointer to the last frame buffer in output pool (occupied frames) */
-    int in_count;            /**< number of unused frame buffers */
-    int out_count;            /**< number of occupied frames */
+    alignas(DPIPE_ALIGNMENT) std::atomic<int> waiters;    /**< number of threads blocked in dpipe_load() */
+    std::atomic<uint32_t> wakeups;    /**< bumped on dpipe_store() when there are waiters, futex word */
+#ifndef __linux__
+    std::mutex wait_mutex;        /**< fallback wait, only used when a thread has to block */
+    std::condition_variable cond;
+#endif
 }    dpipe_t;
 
 EXPORT dpipe_t *    dpipe_create(int id, const char *name, int nframe, int maxframesize);
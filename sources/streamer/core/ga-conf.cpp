@@ -29,8 +29,14 @@
 #include <string.h>
 #include <limits.h>
 #include <errno.h>
+#include <atomic>
 #include <map>
+#include <mutex>
+#include <new>
+#include <set>
+#include <shared_mutex>
 #include <string>
+#include <vector>
 #include <filesystem>
 
 #include "ga-common.h"
@@ -42,6 +48,67 @@ using namespace std;
 /** Global variables used to store loaded configurations */
 static map<string,gaConfVar> ga_vars;
 static map<string,gaConfVar>::iterator ga_vmi = ga_vars.begin();
+/** Protects ga_vars, a reload may replace it while other threads read */
+static std::shared_mutex ga_vars_lock;
+/** Parameters set at runtime, they keep precedence over a reloaded file */
+static map<string,gaConfVar> ga_runtime_vars;
+/** Bumped on every change, snapshots built from an older one are stale */
+static std::atomic<unsigned long> ga_generation(1);
+
+/**
+ * Configuration of one session served by the process. Its parameters
+ * override the global ones for the threads the session is bound to.
+ */
+struct ga_conf_session_s {
+    int id;
+    map<string,string> vars;
+    std::shared_ptr<const ga_conf_snapshot_t> snapshot;
+};
+
+/** Snapshot of the global configuration */
+static std::shared_ptr<const ga_conf_snapshot_t> ga_snapshot;
+/** Serializes snapshot rebuilds, protects sessions and subscribers */
+static std::mutex ga_snapshot_lock;
+static std::set<ga_conf_session_t*> ga_sessions;
+
+struct ga_conf_subscriber {
+    int id;
+    ga_conf_notify_t notify;
+    void *arg;
+};
+static vector<ga_conf_subscriber> ga_subscribers;
+static int ga_subscriber_id = 0;
+/** Held while subscribers are called, unsubscribing waits for it */
+static std::recursive_mutex ga_notify_lock;
+
+/** Keys of the typed parameters */
+static const char *ga_schema_keys[] = {
+#define GA_CONF_KEY(type, field, key, defval) key,
+    GA_CONF_SCHEMA(GA_CONF_KEY)
+#undef GA_CONF_KEY
+};
+
+static int ga_conf_load_file(map<string,gaConfVar> &vars, const char *filename);
+
+/** Session bound to the calling thread, NULL to use the global configuration */
+static thread_local ga_conf_session_t *ga_session = NULL;
+
+/**
+ * Look up a parameter in the session bound to the calling thread.
+ * This is an internal function.
+ *
+ * @param key [in] The parameter to be loaded.
+ * @return Pointer to the value, or NULL if the session does not override it.
+ */
+static const string *
+ga_conf_session_lookup(const char *key) {
+    map<string,string>::iterator mi;
+    if(ga_session == NULL)
+        return NULL;
+    if((mi = ga_session->vars.find(key)) == ga_session->vars.end())
+        return NULL;
+    return &mi->second;
+}
 
 /**
  * Trim a configuration string. This is an internal function.
@@ -108,7 +175,7 @@ ga_conf_trim(char *buf) {
  * @return 0 on success, or -1 on error.
  */
 static int
-ga_conf_parse(const char *filename, int lineno, char *buf) {
+ga_conf_parse(map<string,gaConfVar> &vars, const char *filename, int lineno, char *buf) {
     char *option, *token; //, *saveptr;
     char *leftbracket, *rightbracket;
     gaConfVar gcv;
@@ -138,7 +205,7 @@ ga_conf_parse(const char *filename, int lineno, char *buf) {
         }
         std::string incPathStr = incPath.string();
         ga_logger(Severity::INFO, "# include: %s\n", incPathStr.c_str());
-        return ga_conf_load(incPathStr.c_str());
+        return ga_conf_load_file(vars, incPathStr.c_str());
     }
     // check if its a map
     if((leftbracket = strchr(option, '[')) != NULL) {
@@ -167,26 +234,23 @@ ga_conf_parse(const char *filename, int lineno, char *buf) {
     // its a map
     if(leftbracket != NULL) {
         //ga_logger(Severity::INFO, "%s[%s] = %s\n", option, leftbracket, token);
-        ga_vars[option][leftbracket] = token;
+        vars[option][leftbracket] = token;
     } else {
         //ga_logger(Severity::INFO, "%s = %s\n", option, token);
-        ga_vars[option] = token;
+        vars[option] = token;
     }
     return 0;
 }
 
 /**
- * Load a configuration file.
+ * Parse a configuration file into \a vars. This is an internal function.
  *
+ * @param vars [out] The parameters loaded from the file are added here.
  * @param filename [in] The configuration pathname
- * @return 0 on success, or -1 on error.
- *
- * The given configuration file is parsed and loaded into the system.
- * Other system components can then read the loaded parameters using
- * functions exported from this file.
+ * @return The number of lines read, or -1 on error.
  */
-int
-ga_conf_load(const char *filename) {
+static int
+ga_conf_load_file(map<string,gaConfVar> &vars, const char *filename) {
     FILE *fp;
     char buf[8192];
     int lineno = 0;
@@ -198,7 +262,7 @@ ga_conf_load(const char *filename) {
     }
     while(fgets(buf, sizeof(buf), fp) != NULL) {
         lineno++;
-        if(ga_conf_parse(filename, lineno, buf) < 0) {
+        if(ga_conf_parse(vars, filename, lineno, buf) < 0) {
             fclose(fp);
             return -1;
         }
@@ -207,13 +271,125 @@ ga_conf_load(const char *filename) {
     return lineno;
 }
 
+/**
+ * Distance between two parameter names, capped to 3.
+ * This is an internal function.
+ */
+static int
+ga_conf_key_distance(const string &a, const string &b) {
+    vector<int> prev(b.size() + 1), cur(b.size() + 1);
+    for(size_t j = 0; j <= b.size(); j++)
+        prev[j] = (int) j;
+    for(size_t i = 1; i <= a.size(); i++) {
+        cur[0] = (int) i;
+        for(size_t j = 1; j <= b.size(); j++) {
+            int subst = prev[j-1] + (a[i-1] == b[j-1] ? 0 : 1);
+            cur[j] = std::min(subst, std::min(prev[j], cur[j-1]) + 1);
+        }
+        prev.swap(cur);
+    }
+    return std::min(prev[b.size()], 3);
+}
+
+/**
+ * Report parameters that look like a misspelled typed parameter, they
+ * would silently be ignored otherwise. This is an internal function.
+ */
+static void
+ga_conf_check_keys() {
+    std::shared_lock<std::shared_mutex> lock(ga_vars_lock);
+    for(auto &var : ga_vars) {
+        const string &key = var.first;
+        const char *guess = NULL;
+        bool known = false;
+        for(const char *schema_key : ga_schema_keys) {
+            if(key == schema_key) {
+                known = true;
+                break;
+            }
+            if(key.size() > 4 && ga_conf_key_distance(key, schema_key) <= 2)
+                guess = schema_key;
+        }
+        if(!known && guess != NULL)
+            ga_logger(Severity::WARNING, "# unknown parameter '%s', did you mean '%s'?\n", key.c_str(), guess);
+    }
+}
+
+/**
+ * Load a configuration file.
+ *
+ * @param filename [in] The configuration pathname
+ * @return 0 on success, or -1 on error.
+ *
+ * The given configuration file is parsed and loaded into the system.
+ * Other system components can then read the loaded parameters using
+ * functions exported from this file.
+ */
+int
+ga_conf_load(const char *filename) {
+    int ret;
+    {
+        std::unique_lock<std::shared_mutex> lock(ga_vars_lock);
+        ret = ga_conf_load_file(ga_vars, filename);
+    }
+    ga_generation++;
+    if(ret >= 0)
+        ga_conf_check_keys();
+    return ret;
+}
+
+/**
+ * Reload a configuration file while the system is running.
+ *
+ * @param filename [in] The configuration pathname
+ * @return 0 on success, or -1 on error.
+ *
+ * The file replaces the loaded configuration as a whole, parameters set
+ * with \em ga_conf_writev() keep their values. On error the loaded
+ * configuration is left untouched. Snapshots are rebuilt and subscribers
+ * notified of the changes, see \em ga_conf_snapshot_reload().
+ */
+int
+ga_conf_reload(const char *filename) {
+    map<string,gaConfVar> vars;
+    if(ga_conf_load_file(vars, filename) < 0) {
+        ga_logger(Severity::ERR, "# %s: reload failed, configuration unchanged.\n",
+            filename ? filename : "(null)");
+        return -1;
+    }
+    {
+        std::unique_lock<std::shared_mutex> lock(ga_vars_lock);
+        for(auto &var : ga_runtime_vars) {
+            gaConfVar &rv = var.second;
+            if(rv.msize() == 0) {
+                vars[var.first] = rv.value();
+                continue;
+            }
+            rv.mreset();
+            for(string k = rv.mkey(); k != ""; k = rv.mnextkey())
+                vars[var.first][k] = rv[k];
+        }
+        ga_vars.swap(vars);
+        ga_vmi = ga_vars.begin();
+    }
+    ga_generation++;
+    ga_conf_check_keys();
+    ga_logger(Severity::INFO, "# %s: configuration reloaded.\n", filename);
+    return ga_conf_snapshot_reload() < 0 ? -1 : 0;
+}
+
 /**
  * Clear all loaded configuration.
  */
 void
 ga_conf_clear() {
-    ga_vars.clear();
-    ga_vmi = ga_vars.begin();
+    {
+        std::unique_lock<std::shared_mutex> lock(ga_vars_lock);
+        ga_vars.clear();
+        ga_runtime_vars.clear();
+        ga_vmi = ga_vars.begin();
+    }
+    ga_generation++;
     return;
 }
 
@@ -232,16 +408,22 @@ ga_conf_clear() {
 char *
 ga_conf_readv(const char *key, char *store, size_t slen) {
     map<string,gaConfVar>::iterator mi;
-    if((mi = ga_vars.find(key)) == ga_vars.end())
-        return NULL;
-    if(mi->second.value().c_str() == NULL)
-        return NULL;
+    string value;
+    const string *override = ga_conf_session_lookup(key);
+    if(override != NULL) {
+        value = *override;
+    } else {
+        std::shared_lock<std::shared_mutex> lock(ga_vars_lock);
+        if((mi = ga_vars.find(key)) == ga_vars.end())
+            return NULL;
+        value = mi->second.value();
+    }
     if(store == NULL)
-        return strdup(mi->second.value().c_str());
-    if (mi->second.value().length() >= slen) {
+        return strdup(value.c_str());
+    if (value.length() >= slen) {
         return NULL;
     }
-    strncpy(store, mi->second.value().c_str(), slen);
+    strncpy(store, value.c_str(), slen);
     return store;
 }
 
@@ -253,6 +435,10 @@ ga_conf_readv(const char *key, char *store, size_t slen) {
  */
 std::string ga_conf_readstr(const char *key) {
     map<string,gaConfVar>::iterator mi;
+    const string *value = ga_conf_session_lookup(key);
+    if(value != NULL)
+        return *value;
+    std::shared_lock<std::shared_mutex> lock(ga_vars_lock);
     if((mi = ga_vars.find(key)) == ga_vars.end())
         return std::string();
     if(mi->second.value().c_str() == NULL)
@@ -449,7 +635,12 @@ ga_conf_readbool(const char *key, int defval) {
  */
 int
 ga_conf_writev(const char *key, const char *value) {
-    ga_vars[key] = value;
+    {
+        std::unique_lock<std::shared_mutex> lock(ga_vars_lock);
+        ga_vars[key] = value;
+        ga_runtime_vars[key] = value;
+    }
+    ga_generation++;
     return 0;
 }
 
@@ -463,7 +654,12 @@ ga_conf_writev(const char *key, const char *value) {
  */
 void
 ga_conf_erase(const char *key) {
-    ga_vars.erase(key);
+    {
+        std::unique_lock<std::shared_mutex> lock(ga_vars_lock);
+        ga_vars.erase(key);
+        ga_runtime_vars.erase(key);
+    }
+    ga_generation++;
     return;
 }
 
@@ -491,6 +687,7 @@ ga_conf_ismap(const char *key) {
 int
 ga_conf_haskey(const char *mapname, const char *key) {
     map<string,gaConfVar>::iterator mi;
+    std::shared_lock<std::shared_mutex> lock(ga_vars_lock);
     if((mi = ga_vars.find(mapname)) == ga_vars.end())
         return 0;
     return mi->second.haskey(key);
@@ -505,6 +702,7 @@ ga_conf_haskey(const char *mapname, const char *key) {
 int
 ga_conf_mapsize(const char *mapname) {
     map<string,gaConfVar>::iterator mi;
+    std::shared_lock<std::shared_mutex> lock(ga_vars_lock);
     if((mi = ga_vars.find(mapname)) == ga_vars.end())
         return 0;
     return mi->second.msize();
@@ -526,9 +724,10 @@ ga_conf_mapsize(const char *mapname) {
 char *
 ga_conf_mapreadv(const char *mapname, const char *key, char *store, int slen) {
     map<string,gaConfVar>::iterator mi;
+    std::shared_lock<std::shared_mutex> lock(ga_vars_lock);
     if((mi = ga_vars.find(mapname)) == ga_vars.end())
         return NULL;
-    if((mi->second)[key] == "")
+    if(!mi->second.haskey(key) || (mi->second)[key] == "")
         return NULL;
     if(store == NULL)
         return strdup((mi->second)[key].c_str());
@@ -633,7 +832,12 @@ ga_conf_mapreadbool(const char *mapname, const char *key, int defval) {
  */
 int
 ga_conf_mapwritev(const char *mapname, const char *key, const char *value) {
-    ga_vars[mapname][key] = value;
+    {
+        std::unique_lock<std::shared_mutex> lock(ga_vars_lock);
+        ga_vars[mapname][key] = value;
+        ga_runtime_vars[mapname][key] = value;
+    }
+    ga_generation++;
     return 0;
 }
 
@@ -649,9 +853,14 @@ ga_conf_mapwritev(const char *mapname, const char *key, const char *value) {
 void
 ga_conf_maperase(const char *mapname, const char *key) {
     map<string,gaConfVar>::iterator mi;
-    if((mi = ga_vars.find(mapname)) == ga_vars.end())
-        return;
-    ga_vars.erase(mi);
+    {
+        std::unique_lock<std::shared_mutex> lock(ga_vars_lock);
+        if((mi = ga_vars.find(mapname)) == ga_vars.end())
+            return;
+        ga_vars.erase(mi);
+        ga_runtime_vars.erase(mapname);
+    }
+    ga_generation++;
     return;
 }
 
@@ -666,6 +875,7 @@ ga_conf_maperase(const char *mapname, const char *key) {
 void
 ga_conf_mapreset(const char *mapname) {
     map<string,gaConfVar>::iterator mi;
+    std::unique_lock<std::shared_mutex> lock(ga_vars_lock);
     if((mi = ga_vars.find(mapname)) == ga_vars.end())
         return;
     mi->second.mreset();
@@ -687,6 +897,7 @@ ga_conf_mapreset(const char *mapname) {
 char *
 ga_conf_mapkey(const char *mapname, char *keystore, int klen) {
     map<string,gaConfVar>::iterator mi;
+    std::unique_lock<std::shared_mutex> lock(ga_vars_lock);
     if((mi = ga_vars.find(mapname)) == ga_vars.end())
         return NULL;
     if(mi->second.mkey() == "")
@@ -712,6 +923,7 @@ ga_conf_mapkey(const char *mapname, char *keystore, int klen) {
 char *
 ga_conf_mapvalue(const char *mapname, char *valstore, int vlen) {
     map<string,gaConfVar>::iterator mi;
+    std::unique_lock<std::shared_mutex> lock(ga_vars_lock);
     if((mi = ga_vars.find(mapname)) == ga_vars.end())
         return NULL;
     if(mi->second.mkey() == "")
@@ -738,6 +950,7 @@ char *
 ga_conf_mapnextkey(const char *mapname, char *keystore, int klen) {
     map<string,gaConfVar>::iterator mi;
     string k = "";
+    std::unique_lock<std::shared_mutex> lock(ga_vars_lock);
     //
     if((mi = ga_vars.find(mapname)) == ga_vars.end())
         return NULL;
@@ -756,6 +969,7 @@ ga_conf_mapnextkey(const char *mapname, char *keystore, int klen) {
  * This function is used to enumerate all runtime configurations.
  */
 void ga_conf_reset() {
+    std::unique_lock<std::shared_mutex> lock(ga_vars_lock);
     ga_vmi = ga_vars.begin();
 }
 
@@ -767,6 +981,7 @@ void ga_conf_reset() {
  * This function is used to enumerate all runtime configurations.
  */
 const char *ga_conf_key() {
+    std::unique_lock<std::shared_mutex> lock(ga_vars_lock);
     if(ga_vmi == ga_vars.end())
         return NULL;
     return ga_vmi->first.c_str();
@@ -780,6 +995,7 @@ const char *ga_conf_key() {
  * This function is used to enumerate all runtime configurations.
  */
 const char *ga_conf_nextkey() {
+    std::unique_lock<std::shared_mutex> lock(ga_vars_lock);
     if(ga_vmi == ga_vars.end())
         return NULL;
     // move forward
@@ -789,3 +1005,323 @@ const char *ga_conf_nextkey() {
         return NULL;
     return ga_vmi->first.c_str();
 }
+
+/**
+ * Create the configuration of a session. Parameters not set in the
+ * session fall back to the global configuration.
+ *
+ * @param id [in] Identifier of the session, e.g. its Android instance.
+ * @return Pointer to the session, or NULL on error.
+ */
+ga_conf_session_t *
+ga_conf_session_create(int id) {
+    ga_conf_session_t *session = new (std::nothrow) ga_conf_session_t;
+    if(session == NULL)
+        return NULL;
+    session->id = id;
+    std::lock_guard<std::mutex> lock(ga_snapshot_lock);
+    ga_sessions.insert(session);
+    return session;
+}
+
+/**
+ * Release the configuration of a session.
+ *
+ * @param session [in,out] The session, set to NULL on return.
+ *
+ * The session must not be bound to any thread anymore.
+ */
+void
+ga_conf_session_destroy(ga_conf_session_t **session) {
+    if(session == NULL || *session == NULL)
+        return;
+    {
+        std::lock_guard<std::mutex> lock(ga_snapshot_lock);
+        ga_sessions.erase(*session);
+    }
+    delete *session;
+    *session = NULL;
+}
+
+/**
+ * Get the identifier of a session.
+ *
+ * @param session [in] The session.
+ * @return The identifier passed to \em ga_conf_session_create, or -1 for NULL.
+ */
+int
+ga_conf_session_id(const ga_conf_session_t *session) {
+    return session ? session->id : -1;
+}
+
+/**
+ * Set a parameter of a session.
+ *
+ * @param session [in] The session.
+ * @param key [in] The parameter name.
+ * @param value [in] The parameter value.
+ * @return 0 on success, or -1 on error.
+ *
+ * Sessions are expected to be filled in before they are bound to threads.
+ */
+int
+ga_conf_session_writev(ga_conf_session_t *session, const char *key, const char *value) {
+    if(session == NULL || key == NULL || value == NULL)
+        return -1;
+    session->vars[key] = value;
+    ga_generation++;
+    return 0;
+}
+
+/**
+ * Bind a session to the calling thread. Reads on this thread see the
+ * parameters of the session first.
+ *
+ * @param session [in] The session, or NULL to use the global configuration only.
+ * @return The session bound before.
+ */
+ga_conf_session_t *
+ga_conf_session_bind(ga_conf_session_t *session) {
+    ga_conf_session_t *prev = ga_session;
+    ga_session = session;
+    return prev;
+}
+
+/**
+ * Get the session bound to the calling thread.
+ *
+ * @return The session, or NULL if none is bound.
+ */
+ga_conf_session_t *
+ga_conf_session_current() {
+    return ga_session;
+}
+
+/**
+ * Look up a typed parameter, the session's value first.
+ * This is an internal function.
+ */
+static bool
+ga_conf_schema_lookup(const ga_conf_session_t *session, const char *key, string &value) {
+    map<string,string>::const_iterator si;
+    map<string,gaConfVar>::iterator mi;
+    if(session != NULL && (si = session->vars.find(key)) != session->vars.end()) {
+        value = si->second;
+        return true;
+    }
+    if((mi = ga_vars.find(key)) == ga_vars.end())
+        return false;
+    value = mi->second.value();
+    return !value.empty();
+}
+
+/**
+ * Parse typed parameters. These are internal functions.
+ *
+ * @return 0 on success, or -1 if the value is malformed and the default is used.
+ */
+static int
+ga_conf_field_int(const char *key, const string &value, int defval, int *field) {
+    char *endptr = NULL;
+    errno = 0;
+    long v = strtol(value.c_str(), &endptr, 0);
+    if(errno == ERANGE || v > INT_MAX || v < INT_MIN || endptr == value.c_str() || *endptr != '\0') {
+        ga_logger(Severity::ERR, "# %s: '%s' is not an integer, using %d.\n", key, value.c_str(), defval);
+        *field = defval;
+        return -1;
+    }
+    *field = (int) v;
+    return 0;
+}
+
+static int
+ga_conf_field_bool(const char *key, const string &value, int defval, bool *field) {
+    int v = ga_conf_boolval(value.c_str(), -1);
+    if(v < 0) {
+        ga_logger(Severity::ERR, "# %s: '%s' is not a boolean, using %d.\n", key, value.c_str(), defval);
+        *field = defval != 0;
+        return -1;
+    }
+    *field = v != 0;
+    return 0;
+}
+
+static int
+ga_conf_field_str(const char *key, const string &value, const char *defval, string *field) {
+    *field = value;
+    return 0;
+}
+
+/**
+ * Build the snapshot of a session, or of the global configuration.
+ * This is an internal function.
+ *
+ * @param session [in] The session, or NULL.
+ * @param generation [in] Configuration generation the snapshot is built from.
+ * @param errors [out] Number of malformed parameters.
+ * @return The snapshot.
+ */
+static std::shared_ptr<ga_conf_snapshot_t>
+ga_conf_snapshot_build(const ga_conf_session_t *session, unsigned long generation, int *errors) {
+    auto snap = std::make_shared<ga_conf_snapshot_t>();
+    string value;
+    std::shared_lock<std::shared_mutex> lock(ga_vars_lock);
+#define GA_CONF_BUILD(type, field, key, defval)                                 \
+    if(ga_conf_schema_lookup(session, key, value))                              \
+        *errors += -ga_conf_field_##type(key, value, defval, &snap->field);     \
+    else                                                                        \
+        snap->field = defval;
+    GA_CONF_SCHEMA(GA_CONF_BUILD)
+#undef GA_CONF_BUILD
+    snap->session = ga_conf_session_id(session);
+    snap->generation = generation;
+    return snap;
+}
+
+/**
+ * Compare the typed parameters of two snapshots. This is an internal function.
+ */
+static bool
+ga_conf_snapshot_equal(const ga_conf_snapshot_t *a, const ga_conf_snapshot_t *b) {
+#define GA_CONF_EQUAL(type, field, key, defval) \
+    if(a->field != b->field)                    \
+        return false;
+    GA_CONF_SCHEMA(GA_CONF_EQUAL)
+#undef GA_CONF_EQUAL
+    return true;
+}
+
+typedef std::pair<std::shared_ptr<const ga_conf_snapshot_t>,
+        std::shared_ptr<const ga_conf_snapshot_t>> ga_conf_change_t;
+
+/**
+ * Rebuild the snapshot of a session, or of the global configuration, if
+ * it is stale. This is an internal function, ga_snapshot_lock is held.
+ *
+ * @param session [in] The session, or NULL.
+ * @param changes [out] Replaced snapshots whose parameters changed.
+ * @param errors [out] Number of malformed parameters.
+ * @return The current snapshot.
+ */
+static std::shared_ptr<const ga_conf_snapshot_t>
+ga_conf_snapshot_refresh(ga_conf_session_t *session, vector<ga_conf_change_t> &changes, int *errors) {
+    std::shared_ptr<const ga_conf_snapshot_t> *slot = session ? &session->snapshot : &ga_snapshot;
+    std::shared_ptr<const ga_conf_snapshot_t> prev = std::atomic_load(slot);
+    unsigned long generation = ga_generation.load();
+    if(prev && prev->generation == generation)
+        return prev;
+    std::shared_ptr<const ga_conf_snapshot_t> cur = ga_conf_snapshot_build(session, generation, errors);
+    std::atomic_store(slot, cur);
+    if(prev && !ga_conf_snapshot_equal(prev.get(), cur.get()))
+        changes.push_back(ga_conf_change_t(prev, cur));
+    return cur;
+}
+
+/**
+ * Call subscribers for changed snapshots, without holding any lock.
+ * This is an internal function.
+ */
+static void
+ga_conf_snapshot_notify(const vector<ga_conf_change_t> &changes) {
+    vector<ga_conf_subscriber> subscribers;
+    if(changes.empty())
+        return;
+    std::lock_guard<std::recursive_mutex> notify_lock(ga_notify_lock);
+    {
+        std::lock_guard<std::mutex> lock(ga_snapshot_lock);
+        subscribers = ga_subscribers;
+    }
+    for(auto &change : changes) {
+        for(auto &sub : subscribers)
+            sub.notify(change.first.get(), change.second.get(), sub.arg);
+    }
+}
+
+/**
+ * Get the typed parameters of the session bound to the calling thread,
+ * or of the global configuration.
+ *
+ * @return The current snapshot, never NULL.
+ *
+ * This is cheap when nothing changed since the last call, and meant
+ * to be used on live paths instead of \em ga_conf_read*(). A change of
+ * the configuration is picked up by the next call.
+ */
+std::shared_ptr<const ga_conf_snapshot_t>
+ga_conf_snapshot() {
+    ga_conf_session_t *session = ga_session;
+    std::shared_ptr<const ga_conf_snapshot_t> snap =
+        std::atomic_load(session ? &session->snapshot : &ga_snapshot);
+    if(snap && snap->generation == ga_generation.load())
+        return snap;
+    //
+    vector<ga_conf_change_t> changes;
+    int errors = 0;
+    {
+        std::lock_guard<std::mutex> lock(ga_snapshot_lock);
+        snap = ga_conf_snapshot_refresh(session, changes, &errors);
+    }
+    ga_conf_snapshot_notify(changes);
+    return snap;
+}
+
+/**
+ * Rebuild the snapshots of the global configuration and of all sessions,
+ * and notify subscribers of the changes.
+ *
+ * @return 0 on success, or -1 if malformed parameters were replaced by
+ *    their defaults.
+ *
+ * Call this after changing the configuration, e.g. with
+ * \em ga_conf_reload(), to apply the change right away.
+ */
+int
+ga_conf_snapshot_reload() {
+    vector<ga_conf_change_t> changes;
+    int errors = 0;
+    {
+        std::lock_guard<std::mutex> lock(ga_snapshot_lock);
+        ga_conf_snapshot_refresh(NULL, changes, &errors);
+        for(ga_conf_session_t *session : ga_sessions)
+            ga_conf_snapshot_refresh(session, changes, &errors);
+    }
+    ga_conf_snapshot_notify(changes);
+    return errors > 0 ? -1 : 0;
+}
+
+/**
+ * Get notified when typed parameters change.
+ *
+ * @param notify [in] Called with the replaced and the new snapshot, on the
+ *    thread that applied the change. It may read the configuration.
+ * @param arg [in] Passed to \a notify.
+ * @return Identifier for \em ga_conf_snapshot_unsubscribe(), or -1 on error.
+ */
+int
+ga_conf_snapshot_subscribe(ga_conf_notify_t notify, void *arg) {
+    if(notify == NULL)
+        return -1;
+    std::lock_guard<std::mutex> lock(ga_snapshot_lock);
+    ga_conf_subscriber sub = { ++ga_subscriber_id, notify, arg };
+    ga_subscribers.push_back(sub);
+    return sub.id;
+}
+
+/**
+ * Stop notifications.
+ *
+ * @param id [in] Identifier returned by \em ga_conf_snapshot_subscribe().
+ *
+ * Returns once a notification in progress on another thread is done.
+ */
+void
+ga_conf_snapshot_unsubscribe(int id) {
+    std::lock_guard<std::recursive_mutex> notify_lock(ga_notify_lock);
+    std::lock_guard<std::mutex> lock(ga_snapshot_lock);
+    for(auto it = ga_subscribers.begin(); it != ga_subscribers.end(); it++) {
+        if(it->id == id) {
+            ga_subscribers.erase(it);
+            break;
+        }
+    }
+}
@@ -27,10 +27,12 @@
 #define __GA_CONF_H__
 
 #include "ga-common.h"
+#include <memory>
 #include <string>
 
 // laod config from file
 EXPORT int ga_conf_load(const char *filename);
+EXPORT int ga_conf_reload(const char *filename);
 EXPORT void ga_conf_clear();
 
 // operations with key/value pair
@@ -66,4 +68,91 @@ EXPORT void ga_conf_reset();
 EXPORT const char *ga_conf_key();
 EXPORT const char *ga_conf_nextkey();
 
+// per-session overrides, visible to the threads a session is bound to
+typedef struct ga_conf_session_s ga_conf_session_t;
+
+EXPORT ga_conf_session_t *ga_conf_session_create(int id);
+EXPORT void ga_conf_session_destroy(ga_conf_session_t **session);
+EXPORT int ga_conf_session_id(const ga_conf_session_t *session);
+EXPORT int ga_conf_session_writev(ga_conf_session_t *session, const char *key, const char *value);
+EXPORT ga_conf_session_t *ga_conf_session_bind(ga_conf_session_t *session);
+EXPORT ga_conf_session_t *ga_conf_session_current();
+
+/**
+ * Binds a session to the calling thread for the lifetime of the object
+ * and restores the previous binding afterwards.
+ */
+class ga_conf_session_scope {
+public:
+    explicit ga_conf_session_scope(ga_conf_session_t *session)
+        : prev(ga_conf_session_bind(session)) {}
+    ~ga_conf_session_scope() { ga_conf_session_bind(prev); }
+    ga_conf_session_scope(const ga_conf_session_scope&) = delete;
+    ga_conf_session_scope& operator=(const ga_conf_session_scope&) = delete;
+private:
+    ga_conf_session_t *prev;
+};
+
+/**
+ * Typed parameters, declared once: X(type, field, key, default).
+ * They are parsed into a ga_conf_snapshot_t, so that code on live paths
+ * reads a struct field instead of looking up and parsing a string.
+ * Types are int, bool and str.
+ */
+#define GA_CONF_SCHEMA(X) \
+    X(str,  aic_workdir,                 "aic-workdir",                 "") \
+    X(int,  android_session,             "android-session",             0) \
+    X(int,  audio_ring_depth,            "audio-ring-depth",            3) \
+    X(bool, av_bundle,                   "av-bundle",                   1) \
+    X(int,  client_clones,               "client-clones",               0) \
+    X(str,  client_peer_id,              "client-peer-id",              "") \
+    X(str,  coturn_ip,                   "coturn-ip",                   "") \
+    X(str,  coturn_password,             "coturn-password",             "") \
+    X(str,  coturn_port,                 "coturn-port",                 "") \
+    X(str,  coturn_username,             "coturn-username",             "") \
+    X(bool, enable_audio,                "enable-audio",                1) \
+    X(bool, enable_multi_user,           "enable-multi-user",           0) \
+    X(int,  enable_render_drc,           "enable-render-drc",           0) \
+    X(bool, get_hw_capability,           "get-hw-capability",           1) \
+    X(int,  ice_port_max,                "ice-port-max",                0) \
+    X(int,  ice_port_min,                "ice-port-min",                0) \
+    X(int,  input_coalesce_ms,           "input-coalesce-ms",           0) \
+    X(bool, k8s,                         "k8s",                         0) \
+    X(bool, measure_latency,             "measure-latency",             0) \
+    X(int,  number_of_cameras_supported, "number-of-cameras-supported", 0) \
+    X(str,  owt_loglevel,                "owt-loglevel",                "") \
+    X(str,  server_peer_id,              "server-peer-id",              "") \
+    X(str,  signaling_server_host,       "signaling-server-host",       "") \
+    X(str,  signaling_server_port,       "signaling-server-port",       "") \
+    X(int,  user,                        "user",                        0) \
+    X(str,  video_codec,                 "video-codec",                 "") \
+    X(int,  video_fps,                   "video-fps",                   0) \
+    X(int,  video_res_height,            "video-res-height",            0) \
+    X(int,  video_res_width,             "video-res-width",             0) \
+    X(int,  virtual_input_num,           "virtual-input-num",           0)
+
+#define GA_CONF_TYPE_int  int
+#define GA_CONF_TYPE_bool bool
+#define GA_CONF_TYPE_str  std::string
+
+/**
+ * Immutable view of the typed parameters of the global configuration or
+ * of one session. A new snapshot replaces the old one when parameters
+ * change, holders of the old one keep a consistent view.
+ */
+typedef struct ga_conf_snapshot_s {
+#define GA_CONF_FIELD(type, field, key, defval) GA_CONF_TYPE_##type field;
+    GA_CONF_SCHEMA(GA_CONF_FIELD)
+#undef GA_CONF_FIELD
+    int session;                /**< Session id, -1 for the global configuration */
+    unsigned long generation;   /**< Configuration generation it was built from */
+} ga_conf_snapshot_t;
+
+typedef void (*ga_conf_notify_t)(const ga_conf_snapshot_t *prev, const ga_conf_snapshot_t *cur, void *arg);
+
+EXPORT std::shared_ptr<const ga_conf_snapshot_t> ga_conf_snapshot();
+EXPORT int ga_conf_snapshot_reload();
+EXPORT int ga_conf_snapshot_subscribe(ga_conf_notify_t notify, void *arg);
+EXPORT void ga_conf_snapshot_unsubscribe(int id);
+
 #endif /* __GA_CONF_H__ */
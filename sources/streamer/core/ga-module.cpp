@@ -24,12 +24,15 @@
  */
 
 #include <limits.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
 #include <map>
+#include <mutex>
 #include <thread>
+#include <vector>
 #ifndef WIN32
 #include <dlfcn.h>
 #endif
@@ -324,6 +327,29 @@ ga_module_ioctl(ga_module_t *m, int command, int argsize, void *arg) {
     return m->ioctl(command, argsize, arg);
 }
 
+/**
+ * Wrapper for module's ioctl() interface of a channel.
+ *
+ * @param m [in] Pointer to a module instance.
+ * @param channelId [in] The channel, i.e., session, the command is for.
+ * @param command [in] The ioctl() command.
+ * @param argsize [in] The size of the argument.
+ * @param arg [in] Pointer to the argument.
+ *
+ * Modules serving a single session only implement \em ioctl(), which
+ * is used for channel 0.
+ */
+int
+ga_module_ioctl_channel(ga_module_t *m, int channelId, int command, int argsize, void *arg) {
+    if(m == NULL)
+        return GA_IOCTL_ERR_NULLMODULE;
+    if(m->ioctl_channel != NULL)
+        return m->ioctl_channel(channelId, command, argsize, arg);
+    if(channelId != 0)
+        return GA_IOCTL_ERR_BADID;
+    return ga_module_ioctl(m, command, argsize, arg);
+}
+
 /**
  * Wrapper for module's notify() interface.
  *
@@ -415,11 +441,77 @@ ga_init_packet(ga_packet_t* pkt) {
     pkt->stream_index = 0;
     pkt->side_data  = nullptr;
     pkt->side_data_elems = 0;
+    pkt->side_data_used  = 0;
     pkt->duration   = 0;
     pkt->pos        = -1;
     pkt->convergence_duration = 0;
 }
 
+// Side data too large for the packet comes from free lists of blocks,
+// one per power of two size class. Larger blocks are not pooled.
+#define SIDE_DATA_POOL_MIN_SHIFT   8    // 256 bytes
+#define SIDE_DATA_POOL_CLASSES     9    // up to 64 KiB
+#define SIDE_DATA_POOL_MAX_FREE    16   // free blocks kept per class
+
+typedef struct side_data_block_s {
+    int size_class;             // -1 if not pooled
+    alignas(16) uint8_t data[1];
+} side_data_block_t;
+
+static struct side_data_pool_s {
+    std::mutex mutex;
+    std::vector<side_data_block_t*> free_list[SIDE_DATA_POOL_CLASSES];
+
+    ~side_data_pool_s() {
+        for (auto& list : free_list)
+            for (side_data_block_t* block : list)
+                free(block);
+    }
+} side_data_pool;
+
+static side_data_block_t*
+side_data_block_get(size_t size) {
+    int size_class = 0;
+    while (size_class < SIDE_DATA_POOL_CLASSES && size > (size_t(1) << (SIDE_DATA_POOL_MIN_SHIFT + size_class)))
+        size_class++;
+    if (size_class == SIDE_DATA_POOL_CLASSES) {
+        side_data_block_t* block = (side_data_block_t*)malloc(offsetof(side_data_block_t, data) + size);
+        if (block)
+            block->size_class = -1;
+        return block;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(side_data_pool.mutex);
+        std::vector<side_data_block_t*>& free_list = side_data_pool.free_list[size_class];
+        if (!free_list.empty()) {
+            side_data_block_t* block = free_list.back();
+            free_list.pop_back();
+            return block;
+        }
+    }
+    size_t bytes = offsetof(side_data_block_t, data) + (size_t(1) << (SIDE_DATA_POOL_MIN_SHIFT + size_class));
+    side_data_block_t* block = (side_data_block_t*)malloc(bytes);
+    if (block)
+        block->size_class = size_class;
+    return block;
+}
+
+static void
+side_data_block_put(side_data_block_t* block) {
+    if (block->size_class >= 0) {
+        std::lock_guard<std::mutex> lock(side_data_pool.mutex);
+        std::vector<side_data_block_t*>& free_list = side_data_pool.free_list[block->size_class];
+        if (free_list.capacity() == 0)
+            free_list.reserve(SIDE_DATA_POOL_MAX_FREE);
+        if (free_list.size() < SIDE_DATA_POOL_MAX_FREE) {
+            free_list.push_back(block);
+            return;
+        }
+    }
+    free(block);
+}
+
 /**
  * Allocate new side information of a packet.
  *
@@ -427,6 +519,10 @@ ga_init_packet(ga_packet_t* pkt) {
  * @param type [in]     Side informaiton type.
  * @param size [in]     Side information size.
  *
+ * The first GA_PACKET_SIDE_DATA_INLINE_ELEMS entries and up to
+ * GA_PACKET_SIDE_DATA_INLINE_SIZE bytes are stored in the packet, larger
+ * side data in pooled blocks.
+ *
  * This function is used to replace libavcodec av_packet_new_side_data.
  */
 uint8_t*
@@ -443,23 +539,45 @@ ga_packet_new_side_data(ga_packet_t* pkt, ga_packet_side_data_type type, int siz
         return nullptr;
     }
 
-    ga_packet_side_data_t* more_side_data = (ga_packet_side_data_t*)realloc(pkt->side_data, (static_cast<size_t>(elems) + 1) * sizeof(*pkt->side_data));
-    if (more_side_data == nullptr) {
-        ga_logger(Severity::ERR, "ga_packet_new_side_data: Failed to allocate more side data.\n");
-        return nullptr;
+    if (elems < GA_PACKET_SIDE_DATA_INLINE_ELEMS) {
+        pkt->side_data = pkt->side_data_inline;
+    } else {
+        ga_packet_side_data_t* more_side_data;
+        if (pkt->side_data == pkt->side_data_inline) {
+            more_side_data = (ga_packet_side_data_t*)malloc((static_cast<size_t>(elems) + 1) * sizeof(*pkt->side_data));
+            if (more_side_data)
+                memcpy(more_side_data, pkt->side_data_inline, sizeof(pkt->side_data_inline));
+        } else {
+            more_side_data = (ga_packet_side_data_t*)realloc(pkt->side_data, (static_cast<size_t>(elems) + 1) * sizeof(*pkt->side_data));
+        }
+        if (more_side_data == nullptr) {
+            ga_logger(Severity::ERR, "ga_packet_new_side_data: Failed to allocate more side data.\n");
+            return nullptr;
+        }
+        pkt->side_data = more_side_data;
     }
-    pkt->side_data = more_side_data;
 
-    pkt->side_data[elems].data = (uint8_t*)malloc(static_cast<size_t>(size) + GA_INPUT_BUFFER_PADDING_SIZE);
-    if (pkt->side_data[elems].data == nullptr) {
-        ga_logger(Severity::ERR, "ga_packet_new_side_data: Failed to allocate new side data.\n");
-        return nullptr;
+    ga_packet_side_data_t* sd = &pkt->side_data[elems];
+    size_t bytes = static_cast<size_t>(size) + GA_INPUT_BUFFER_PADDING_SIZE;
+    size_t offset = (static_cast<size_t>(pkt->side_data_used) + 15) & ~size_t(15);
+    if (offset + bytes <= sizeof(pkt->side_data_storage)) {
+        sd->data  = pkt->side_data_storage + offset;
+        sd->block = nullptr;
+        pkt->side_data_used = (int)(offset + bytes);
+    } else {
+        side_data_block_t* block = side_data_block_get(bytes);
+        if (block == nullptr) {
+            ga_logger(Severity::ERR, "ga_packet_new_side_data: Failed to allocate new side data.\n");
+            return nullptr;
+        }
+        sd->data  = block->data;
+        sd->block = block;
     }
-    pkt->side_data[elems].size = size;
-    pkt->side_data[elems].type = type;
+    sd->size = size;
+    sd->type = type;
     pkt->side_data_elems++;
 
-    return pkt->side_data[elems].data;
+    return sd->data;
 }
 
 /**
@@ -477,9 +595,134 @@ ga_packet_free_side_data(ga_packet_t* pkt) {
     }
 
     for (int i = 0; i < pkt->side_data_elems; ++i) {
-        free(pkt->side_data[i].data);
+        if (pkt->side_data[i].block)
+            side_data_block_put(static_cast<side_data_block_t*>(pkt->side_data[i].block));
+    }
+    if (pkt->side_data != pkt->side_data_inline)
+        free(pkt->side_data);
+    pkt->side_data = nullptr;
+    pkt->side_data_elems = 0;
+    pkt->side_data_used = 0;
+}
+
+static void
+ga_buffer_pool_release(ga_buffer_pool_t* pool) {
+    if (pool->refcount.fetch_sub(1, std::memory_order_acq_rel) != 1)
+        return;
+    for (ga_buffer_t* buf : pool->free_list)
+        delete buf;
+    delete pool;
+}
+
+/**
+ * Create a pool of reference counted buffers.
+ *
+ * @param max_free [in] Number of released buffers kept for reuse.
+ * @return The pool, or nullptr on failure.
+ */
+ga_buffer_pool_t*
+ga_buffer_pool_create(int max_free) {
+    ga_buffer_pool_t* pool = new (std::nothrow) ga_buffer_pool_t;
+    if (pool == nullptr) {
+        ga_logger(Severity::ERR, "ga_buffer_pool_create: Failed to allocate pool.\n");
+        return nullptr;
+    }
+    pool->max_free = max_free;
+    pool->free_list.reserve(max_free);
+    pool->refcount = 1;
+    return pool;
+}
+
+/**
+ * Release the owner reference of a pool.
+ *
+ * @param pool [in,out] The pool, set to nullptr.
+ *
+ * Buffers still referenced stay valid, the pool is freed with the last of them.
+ */
+void
+ga_buffer_pool_destroy(ga_buffer_pool_t** pool) {
+    if (pool == nullptr || *pool == nullptr)
+        return;
+    ga_buffer_pool_release(*pool);
+    *pool = nullptr;
+}
+
+/**
+ * Get a buffer of a given payload size from the pool.
+ *
+ * @param pool [in] The pool.
+ * @param size [in] Payload size in bytes.
+ * @return Buffer holding one reference, or nullptr on failure.
+ *
+ * The payload content is undefined. A recycled buffer only allocates when
+ * \a size exceeds its capacity.
+ */
+ga_buffer_t*
+ga_buffer_pool_get(ga_buffer_pool_t* pool, int size) {
+    ga_buffer_t* buf = nullptr;
+    if (pool == nullptr || size < 0) {
+        ga_logger(Severity::ERR, "ga_buffer_pool_get: Invalid argument.\n");
+        return nullptr;
+    }
+    {
+        std::lock_guard<std::mutex> lock(pool->mutex);
+        if (!pool->free_list.empty()) {
+            buf = pool->free_list.back();
+            pool->free_list.pop_back();
+        }
+    }
+    if (buf == nullptr) {
+        buf = new (std::nothrow) ga_buffer_t;
+        if (buf == nullptr) {
+            ga_logger(Severity::ERR, "ga_buffer_pool_get: Failed to allocate buffer.\n");
+            return nullptr;
+        }
+        buf->pool = pool;
+    }
+    buf->data.resize(size);
+    buf->refcount = 1;
+    pool->refcount.fetch_add(1, std::memory_order_relaxed);
+    return buf;
+}
+
+/**
+ * Take a new reference to a buffer.
+ *
+ * @param buf [in] The buffer.
+ * @return \a buf
+ */
+ga_buffer_t*
+ga_buffer_ref(ga_buffer_t* buf) {
+    if (buf)
+        buf->refcount.fetch_add(1, std::memory_order_relaxed);
+    return buf;
+}
+
+/**
+ * Release a reference to a buffer. The last reference returns it to its pool.
+ *
+ * @param buf [in,out] The buffer, set to nullptr.
+ */
+void
+ga_buffer_unref(ga_buffer_t** buf) {
+    if (buf == nullptr || *buf == nullptr)
+        return;
+    ga_buffer_t* b = *buf;
+    *buf = nullptr;
+    if (b->refcount.fetch_sub(1, std::memory_order_acq_rel) != 1)
+        return;
+
+    ga_buffer_pool_t* pool = b->pool;
+    {
+        std::lock_guard<std::mutex> lock(pool->mutex);
+        if ((int)pool->free_list.size() < pool->max_free) {
+            pool->free_list.push_back(b);
+            b = nullptr;
+        }
     }
-    free(pkt->side_data);
+    delete b;
+    ga_buffer_pool_release(pool);
 }
 
 /**
@@ -27,7 +27,10 @@
 #define __GA_MODULE__
 
 #include "ga-common.h"
+#include <atomic>
 #include <memory>
+#include <mutex>
+#include <vector>
 #include "cursor.h"
 #include "QoSMgt.h"
 
@@ -58,7 +61,7 @@ enum ga_ioctl_commands {
     GA_IOCTL_NULL = 0,        /**< Not used */
     GA_IOCTL_RECONFIGURE,        /**< Reconfiguration */
     GA_IOCTL_RECONFIGURE_DELTAQP,
-    GA_IOCTL_REQUEST_KEYFRAME,    /**< Request a key frame. This starts encoding. */
+    GA_IOCTL_REQUEST_KEYFRAME,    /**< Request a key frame, with an optional ga_ioctl_keyframe_t. This starts encoding. */
     GA_IOCTL_GET_CREDIT_BYTES,
     GA_IOCTL_SET_MAX_BPS,
     GA_IOCTL_GETSPS = 0x100,    /**< Get SPS: for H.264 and H.265 */
@@ -70,6 +73,9 @@ enum ga_ioctl_commands {
     GA_IOCTL_PAUSE,            /**< Pause processing. */
     GA_IOCTL_CHANGE_RENDER_RESOLUTION, /**< Change the resolution in render */
     GA_IOCTL_SET_VIDEO_ALPHA,   /**< Set video alpha mode in render */
+    GA_IOCTL_GET_RECV_STATS,    /**< Get receive statistics of an encoded stream */
+    GA_IOCTL_ADD_SESSION,       /**< Serve one more session on its own channel */
+    GA_IOCTL_REMOVE_SESSION,    /**< Stop serving the session of a channel */
     GA_IOCTL_CUSTOM = 0x40000000    /**< For user customization */
 };
 
@@ -123,6 +129,10 @@ typedef struct ga_ioctl_maxbps_s {
     int max_bps;  /** <Max available bps */
 } ga_ioctl_maxbps_t;
 
+typedef struct ga_ioctl_keyframe_s {
+    int recovery;  /** <Frames were lost, no IDR needed if the encoder can refresh otherwise */
+} ga_ioctl_keyframe_t;
+
 typedef struct ga_ioctl_clevent_s {
     struct timeval timeevent;  /** < event for the time*/
 } ga_ioctl_clevent_t;
@@ -135,6 +145,28 @@ typedef struct ga_ioctl_framestats_s {
     long packet_loss;
 } ga_ioctl_framestats_t;
 
+/**
+ * Parameter for ioctl()'s receive statistics command. Averages and
+ * maximums cover the last statistics window, counters are totals.
+ */
+typedef struct ga_ioctl_recvstats_s {
+    long frames;            /**< Frames received */
+    long jitter_us;         /**< Smoothed inter-arrival jitter */
+    long assembly_avg_us;   /**< Average time to receive a whole frame */
+    long assembly_max_us;   /**< Maximum time to receive a whole frame */
+    long timeouts;          /**< Frames not received within the deadline */
+    long reconnects;        /**< Connections re-established after a failure */
+} ga_ioctl_recvstats_t;
+
+/**
+ * Parameter for ioctl()'s session commands. Each session is served on
+ * its own channel and reads its configuration from \a conf.
+ */
+typedef struct ga_ioctl_session_s {
+    int channel;                        /**< Channel id of the session, 0 is the default session */
+    struct ga_conf_session_s *conf;     /**< Configuration of the session, NULL for the global one */
+} ga_ioctl_session_t;
+
 typedef struct ga_ioctl_resolution_s {
     int width;
     int height;
@@ -143,6 +175,8 @@ typedef struct ga_ioctl_resolution_s {
 // Data structures and functions to replace AVPacket
 #define GA_NOPTS_VALUE          ((int64_t)UINT64_C(0x8000000000000000))
 #define GA_INPUT_BUFFER_PADDING_SIZE 32
+#define GA_PACKET_SIDE_DATA_INLINE_ELEMS 2      /**< Side data entries held in the packet */
+#define GA_PACKET_SIDE_DATA_INLINE_SIZE  128    /**< Side data bytes held in the packet, padding included */
 
 /**
  * Enumeration for types of a packet side data. (Replace AVPacketSideDataType)
@@ -159,6 +193,7 @@ typedef struct ga_packet_side_data_s {
     uint8_t* data = nullptr;
     int      size = 0;
     ga_packet_side_data_type type;
+    void*    block = nullptr;     /**< Pool block holding \a data, nullptr if held in the packet */
 } ga_packet_side_data_t;
 
 typedef enum {
@@ -167,11 +202,45 @@ typedef enum {
     GA_PKT_FLAG_CORRUPT = 0x2,   // equal to AV_PKT_FLAG_CORRUPT
 } ga_packet_flags_t;
 
+/**
+ * Reference counted frame buffer, recycled through a ga_buffer_pool_t.
+ * (Replace AVBufferRef)
+ *
+ * \a data is a std::vector so that sinks taking a vector, such as the OWT
+ * stream provider, can use the payload without a copy. Its size is the
+ * payload size, the capacity is kept when the buffer is recycled.
+ */
+typedef struct ga_buffer_s {
+    std::vector<uint8_t> data;        /**< Payload */
+    std::atomic<int> refcount{0};
+    struct ga_buffer_pool_s* pool = nullptr;
+} ga_buffer_t;
+
+/**
+ * Pool of frame buffers, so that steady state streaming does not allocate.
+ */
+typedef struct ga_buffer_pool_s {
+    std::mutex mutex;
+    std::vector<ga_buffer_t*> free_list;    /**< Buffers ready for reuse */
+    int max_free = 0;            /**< Free buffers kept, the rest are released */
+    std::atomic<int> refcount{0};        /**< One for the owner plus one per outstanding buffer */
+} ga_buffer_pool_t;
+
+EXPORT ga_buffer_pool_t* ga_buffer_pool_create(int max_free);
+EXPORT void ga_buffer_pool_destroy(ga_buffer_pool_t** pool);
+EXPORT ga_buffer_t* ga_buffer_pool_get(ga_buffer_pool_t* pool, int size);
+EXPORT ga_buffer_t* ga_buffer_ref(ga_buffer_t* buf);
+EXPORT void ga_buffer_unref(ga_buffer_t** buf);
+
 /**
  * Data strucure to represent a packet data. (Replace AVPacket)
+ *
+ * Small side data, such as FrameMetaData, is stored in the packet itself
+ * and larger side data comes from a pool, so that steady state streaming
+ * does not allocate. A packet holding side data must not be copied.
  */
 typedef struct ga_packet_s {
-    void* buf = nullptr;
+    void* buf = nullptr;              /**< ga_buffer_t owning \a data, or nullptr if not refcounted */
     int64_t   pts       = GA_NOPTS_VALUE; /**< Presentation timestamp */
     int64_t   dts       = GA_NOPTS_VALUE; /**< Decompression timestamp */
     uint8_t*  data      = nullptr;        /**< Compressed data */
@@ -183,6 +252,9 @@ typedef struct ga_packet_s {
     int       duration  = 0;              /**< Duration of this packet */
     int64_t   pos       = -1;             /**< byte position in stream, -1 if unknown */
     int64_t   convergence_duration = 0;   /**< Time difference */
+    ga_packet_side_data_t side_data_inline[GA_PACKET_SIDE_DATA_INLINE_ELEMS]; /**< First side data entries */
+    alignas(16) uint8_t side_data_storage[GA_PACKET_SIDE_DATA_INLINE_SIZE];  /**< Payload of small side data */
+    int       side_data_used = 0;         /**< Bytes of \a side_data_storage in use */
 } ga_packet_t;
 
 EXPORT void ga_init_packet(ga_packet_t* pkt);
@@ -222,6 +294,7 @@ typedef struct ga_module_s {
     int (*send_cursor)(std::shared_ptr<CURSOR_DATA> cursorInfo, struct timeval *ptv);  /**< Pointer to the send cusor function: sink only */
 #endif
     int (*send_qos)(std::shared_ptr<QosInfo> qosInfo); /** Pointer to the send qos function: sink only */
+    int (*ioctl_channel)(int channelId, int command, int argsize, void *arg);    /**< Pointer to ioctl function of a channel: multi-session modules only */
 
     void * privdata;        /**< Private data of this module */
 }    ga_module_t;
@@ -256,6 +329,7 @@ EXPORT int ga_module_start(ga_module_t *m, void *arg);
 EXPORT int ga_module_stop(ga_module_t *m, void *arg);
 EXPORT int ga_module_deinit(ga_module_t *m, void *arg);
 EXPORT int ga_module_ioctl(ga_module_t *m, int command, int argsize, void *arg);
+EXPORT int ga_module_ioctl_channel(ga_module_t *m, int channelId, int command, int argsize, void *arg);
 EXPORT int ga_module_notify(ga_module_t *m, void *arg);
 EXPORT void * ga_module_raw(ga_module_t *m, void *arg, int *size);
 EXPORT int ga_module_send_packet(ga_module_t *m, const char *prefix, int channelId, ga_packet_t *pkt, int64_t encoderPts, struct timeval *ptv);
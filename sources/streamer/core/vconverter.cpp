@@ -24,16 +24,60 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <list>
 #include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 #include "ga-common.h"
 #include "ga-conf.h"
 
 #include "vconverter.h"
 
+extern "C" {
+#include <libavutil/buffer.h>
+#include <libavutil/frame.h>
+#include <libavutil/pixdesc.h>
+}
+
+/* sws_receive_slice() converts a part of the destination frame */
+#if LIBSWSCALE_VERSION_INT >= AV_VERSION_INT(6, 1, 100)
+#define VCONV_SLICE_THREADS
+#endif
+
+#define    VCONV_MAX_THREADS    8        /* most threads of one conversion */
+#define    VCONV_SLICE_MIN_PIXELS    (1920 * 1080)    /* smallest frame converted by slices */
+#define    VCONV_SLICE_MIN_ROWS    64        /* smallest slice */
+
 using namespace std;
 
-static map<struct vconvcfg, struct SwsContext *> ga_converters;
+/**
+ * Converters of one configuration. A context is used by one thread at
+ * a time: idle contexts are handed out by acquire_frame_converter() and
+ * come back with release_frame_converter(). The context returned by
+ * create_frame_converter() is kept apart and is never evicted.
+ */
+struct vconv_entry {
+    vector<struct SwsContext *> idle;    /**< contexts not in use */
+    int busy;            /**< contexts handed out */
+    struct SwsContext *shared;    /**< context of create_frame_converter() */
+    list<struct vconvcfg>::iterator lru;    /**< position in the LRU list */
+};
+
+/* The mutex guards the bookkeeping only, contexts are created, used
+ * and freed without holding it. */
+static mutex ga_converters_mutex;
+static map<struct vconvcfg, struct vconv_entry> ga_converters;
+static list<struct vconvcfg> ga_converters_lru;    /* most recently used first */
+static map<struct SwsContext *, struct vconvcfg> ga_converters_busy;
+static size_t ga_converters_idle = 0;
+static size_t ga_converters_limit = VCONV_CACHE_SIZE;
 
 /**
  * Implement operator< for \a vconvcfg data structure.
@@ -56,26 +100,98 @@ bool operator<(struct vconvcfg a, struct vconvcfg b) {
     if(a.dst_height > b.dst_height)    return false;
     if(a.dst_fmt < b.dst_fmt)    return true;
     if(a.dst_fmt > b.dst_fmt)    return false;
+    if(a.flags < b.flags)    return true;
+    if(a.flags > b.flags)    return false;
     /* all fields are equal */
     return false;
 }
 
+static struct vconvcfg
+make_frame_converter_cfg(int srcw, int srch, AVPixelFormat srcfmt,
+        int dstw, int dsth, AVPixelFormat dstfmt, int flags) {
+    struct vconvcfg ccfg;
+    //
+    ccfg.src_width = srcw;
+    ccfg.src_height = srch;
+    ccfg.src_fmt = srcfmt;
+    ccfg.dst_width = dstw;
+    ccfg.dst_height = dsth;
+    ccfg.dst_fmt = dstfmt;
+    ccfg.flags = flags;
+    //
+    return ccfg;
+}
+
+static struct SwsContext *
+new_frame_converter(struct vconvcfg *ccfg) {
+    struct SwsContext *ctx;
+    //
+    if((ctx = sws_getContext(ccfg->src_width, ccfg->src_height, ccfg->src_fmt,
+                 ccfg->dst_width, ccfg->dst_height, ccfg->dst_fmt,
+                 ccfg->flags, NULL, NULL, NULL)) == NULL) {
+        ga_logger(Severity::ERR, "Frame converter failed: from (%d,%d)[%d] -> (%d,%d)[%d] flags 0x%x\n",
+            ccfg->src_width, ccfg->src_height, (int) ccfg->src_fmt,
+            ccfg->dst_width, ccfg->dst_height, (int) ccfg->dst_fmt, ccfg->flags);
+        return NULL;
+    }
+    ga_logger(Severity::INFO, "Frame converter created: from (%d,%d)[%d] -> (%d,%d)[%d] flags 0x%x\n",
+        ccfg->src_width, ccfg->src_height, (int) ccfg->src_fmt,
+        ccfg->dst_width, ccfg->dst_height, (int) ccfg->dst_fmt, ccfg->flags);
+    return ctx;
+}
+
 /**
- * Look up an existing converter. This is an internal function.
- *
- * @param ccfg [in] Pointer to a prepared \a vconvcfg data structure.
- * @return Pointer to the \a SwsContext structure of the converter,
- *    or NULL if not found.
+ * Get the entry of a configuration and mark it as the most recently
+ * used one. The entry is created if it does not exist.
+ * Called with \a ga_converters_mutex held.
  */
-static struct SwsContext *
-lookup_frame_converter_internal(struct vconvcfg *ccfg) {
-    map<struct vconvcfg, struct SwsContext *>::iterator mi;
+static struct vconv_entry &
+touch_frame_converter_locked(struct vconvcfg *ccfg) {
+    map<struct vconvcfg, struct vconv_entry>::iterator mi;
     //
-    if((mi = ga_converters.find(*ccfg)) != ga_converters.end()) {
-        return mi->second;
+    if((mi = ga_converters.find(*ccfg)) == ga_converters.end()) {
+        mi = ga_converters.insert(make_pair(*ccfg, vconv_entry())).first;
+        mi->second.busy = 0;
+        mi->second.shared = NULL;
+        ga_converters_lru.push_front(*ccfg);
+        mi->second.lru = ga_converters_lru.begin();
+    } else {
+        ga_converters_lru.splice(ga_converters_lru.begin(), ga_converters_lru, mi->second.lru);
     }
+    return mi->second;
+}
+
+/**
+ * Evict idle contexts, least recently used first, until the cache
+ * bound is met. Called with \a ga_converters_mutex held, the evicted
+ * contexts are returned in \a freed.
+ */
+static void
+evict_frame_converters_locked(vector<struct SwsContext *> *freed) {
+    list<struct vconvcfg>::iterator li = ga_converters_lru.end();
     //
-    return NULL;
+    while(ga_converters_idle > ga_converters_limit && li != ga_converters_lru.begin()) {
+        map<struct vconvcfg, struct vconv_entry>::iterator mi;
+        --li;
+        mi = ga_converters.find(*li);
+        struct vconv_entry &e = mi->second;
+        while(!e.idle.empty() && ga_converters_idle > ga_converters_limit) {
+            freed->push_back(e.idle.back());
+            e.idle.pop_back();
+            ga_converters_idle--;
+        }
+        if(e.idle.empty() && e.busy == 0 && e.shared == NULL) {
+            ga_converters.erase(mi);
+            li = ga_converters_lru.erase(li);
+        }
+    }
+}
+
+static void
+free_frame_converters(vector<struct SwsContext *> *freed) {
+    for(struct SwsContext *ctx : *freed)
+        sws_freeContext(ctx);
+    freed->clear();
 }
 
 /**
@@ -89,19 +205,21 @@ lookup_frame_converter_internal(struct vconvcfg *ccfg) {
  * @param dstfmt [in] Video destination frame pixel format.
  * @return Pointer to the \a SwsContext structure of the converter,
  *    or NULL if not found.
+ *
+ * Only converters made by create_frame_converter() are looked up.
  */
 struct SwsContext *
 lookup_frame_converter(int srcw, int srch, AVPixelFormat srcfmt, int dstw, int dsth, AVPixelFormat dstfmt) {
-    struct vconvcfg ccfg;
+    struct vconvcfg ccfg = make_frame_converter_cfg(srcw, srch, srcfmt,
+                    dstw, dsth, dstfmt, VCONV_DEFAULT_FLAGS);
+    map<struct vconvcfg, struct vconv_entry>::iterator mi;
+    lock_guard<mutex> lock(ga_converters_mutex);
     //
-    ccfg.src_width = srcw;
-    ccfg.src_height = srch;
-    ccfg.src_fmt = srcfmt;
-    ccfg.dst_width = dstw;
-    ccfg.dst_height = dsth;
-    ccfg.dst_fmt = dstfmt;
+    if((mi = ga_converters.find(ccfg)) != ga_converters.end()) {
+        return mi->second.shared;
+    }
     //
-    return lookup_frame_converter_internal(&ccfg);
+    return NULL;
 }
 
 /**
@@ -118,33 +236,330 @@ lookup_frame_converter(int srcw, int srch, AVPixelFormat srcfmt, int dstw, int d
  *
  * This function does not create duplicated converters.
  * An existing converter is returned if it has already been created.
+ * The converter uses \a VCONV_DEFAULT_FLAGS.
  */
 struct SwsContext *
 create_frame_converter(int srcw, int srch, AVPixelFormat srcfmt,
          int dstw, int dsth, AVPixelFormat dstfmt) {
-    map<struct vconvcfg, struct SwsContext *>::iterator mi;
-    struct vconvcfg ccfg;
+    return create_frame_converter_flags(srcw, srch, srcfmt,
+            dstw, dsth, dstfmt, VCONV_DEFAULT_FLAGS);
+}
+
+/**
+ * Create a video frame converter with the given scaler flags.
+ *
+ * @param flags [in] Scaler quality and flags, SWS_*.
+ * @return Pointer to the \a SwsContext structure of the converter,
+ *    or NULL if it fails on creating a converter.
+ *
+ * Like create_frame_converter(), the converter is shared by all callers
+ * asking for the same configuration and is kept until exit. Threads
+ * converting concurrently should use acquire_frame_converter() instead.
+ */
+struct SwsContext *
+create_frame_converter_flags(int srcw, int srch, AVPixelFormat srcfmt,
+         int dstw, int dsth, AVPixelFormat dstfmt, int flags) {
+    struct vconvcfg ccfg = make_frame_converter_cfg(srcw, srch, srcfmt,
+                    dstw, dsth, dstfmt, flags);
     struct SwsContext *ctx;
     //
-    ccfg.src_width = srcw;
-    ccfg.src_height = srch;
-    ccfg.src_fmt = srcfmt;
-    ccfg.dst_width = dstw;
-    ccfg.dst_height = dsth;
-    ccfg.dst_fmt = dstfmt;
-    //
-    if((ctx = lookup_frame_converter_internal(&ccfg)) != NULL)
-        return ctx;
+    do {
+        lock_guard<mutex> lock(ga_converters_mutex);
+        struct vconv_entry &e = touch_frame_converter_locked(&ccfg);
+        if(e.shared != NULL)
+            return e.shared;
+    } while(0);
     //
-    if((ctx = sws_getContext(srcw, srch, srcfmt,
-                 dstw, dsth, dstfmt,
-                 SWS_BICUBIC, NULL, NULL, NULL)) == NULL) {
+    if((ctx = new_frame_converter(&ccfg)) == NULL)
         return NULL;
+    //
+    lock_guard<mutex> lock(ga_converters_mutex);
+    struct vconv_entry &e = touch_frame_converter_locked(&ccfg);
+    if(e.shared != NULL) {
+        /* created by another thread meanwhile */
+        sws_freeContext(ctx);
+        return e.shared;
     }
-    ga_converters[ccfg] = ctx;
-    ga_logger(Severity::INFO, "Frame converter created: from (%d,%d)[%d] -> (%d,%d)[%d]\n",
-        (int) srcw, (int) srch, (int) srcfmt,
-        (int) dstw, (int) dsth, (int) dstfmt);
+    e.shared = ctx;
+    return ctx;
+}
+
+/**
+ * Get a converter for exclusive use by the calling thread.
+ *
+ * @param flags [in] Scaler quality and flags, SWS_*.
+ * @return Pointer to the \a SwsContext structure of the converter,
+ *    or NULL if it fails on creating a converter.
+ *
+ * An idle converter of the same configuration is reused if there is
+ * one, a new one is created otherwise. The converter must be given back
+ * with release_frame_converter(). At most \a VCONV_CACHE_SIZE idle
+ * converters are kept, see set_frame_converter_cache_size().
+ */
+struct SwsContext *
+acquire_frame_converter(int srcw, int srch, AVPixelFormat srcfmt,
+        int dstw, int dsth, AVPixelFormat dstfmt, int flags) {
+    struct vconvcfg ccfg = make_frame_converter_cfg(srcw, srch, srcfmt,
+                    dstw, dsth, dstfmt, flags);
+    struct SwsContext *ctx = NULL;
+    //
+    do {
+        lock_guard<mutex> lock(ga_converters_mutex);
+        struct vconv_entry &e = touch_frame_converter_locked(&ccfg);
+        if(!e.idle.empty()) {
+            ctx = e.idle.back();
+            e.idle.pop_back();
+            ga_converters_idle--;
+            e.busy++;
+            ga_converters_busy[ctx] = ccfg;
+            return ctx;
+        }
+    } while(0);
     //
+    if((ctx = new_frame_converter(&ccfg)) == NULL)
+        return NULL;
+    //
+    lock_guard<mutex> lock(ga_converters_mutex);
+    touch_frame_converter_locked(&ccfg).busy++;
+    ga_converters_busy[ctx] = ccfg;
     return ctx;
 }
+
+/**
+ * Give back a converter of acquire_frame_converter().
+ *
+ * @param ctx [in] The converter.
+ */
+void
+release_frame_converter(struct SwsContext *ctx) {
+    map<struct SwsContext *, struct vconvcfg>::iterator bi;
+    map<struct vconvcfg, struct vconv_entry>::iterator mi;
+    vector<struct SwsContext *> freed;
+    //
+    if(ctx == NULL)
+        return;
+    do {
+        lock_guard<mutex> lock(ga_converters_mutex);
+        if((bi = ga_converters_busy.find(ctx)) == ga_converters_busy.end()) {
+            ga_logger(Severity::WARNING, "Frame converter %p was not acquired\n", ctx);
+            return;
+        }
+        /* an entry with busy contexts is never evicted */
+        mi = ga_converters.find(bi->second);
+        ga_converters_busy.erase(bi);
+        mi->second.busy--;
+        mi->second.idle.push_back(ctx);
+        ga_converters_idle++;
+        evict_frame_converters_locked(&freed);
+    } while(0);
+    free_frame_converters(&freed);
+}
+
+/**
+ * Set the bound on the idle converters kept for reuse.
+ *
+ * @param size [in] Number of idle converters, 0 keeps none.
+ */
+void
+set_frame_converter_cache_size(int size) {
+    vector<struct SwsContext *> freed;
+    //
+    do {
+        lock_guard<mutex> lock(ga_converters_mutex);
+        ga_converters_limit = size > 0 ? size : 0;
+        evict_frame_converters_locked(&freed);
+    } while(0);
+    free_frame_converters(&freed);
+}
+
+#ifdef VCONV_SLICE_THREADS
+/**
+ * Workers of the slice-parallel conversion. Threads are started on
+ * first use and kept until exit.
+ */
+static struct vconv_workers {
+    mutex run_mutex;    /* one parallel conversion at a time */
+    mutex work_mutex;
+    condition_variable cond;
+    condition_variable done;
+    vector<thread> threads;
+    const function<void(int)> *job = NULL;
+    int next = 0;
+    int count = 0;
+    int pending = 0;
+    bool stop = false;
+
+    ~vconv_workers() {
+        do {
+            lock_guard<mutex> lock(work_mutex);
+            stop = true;
+        } while(0);
+        cond.notify_all();
+        for(thread &t : threads)
+            t.join();
+    }
+
+    void worker() {
+        unique_lock<mutex> lock(work_mutex);
+        while(true) {
+            cond.wait(lock, [this]{ return stop || next < count; });
+            if(stop)
+                return;
+            int i = next++;
+            const function<void(int)> *fn = job;
+            lock.unlock();
+            (*fn)(i);
+            lock.lock();
+            if(--pending == 0)
+                done.notify_all();
+        }
+    }
+
+    /* Run fn(0) .. fn(n - 1), the calling thread takes part */
+    void run(int n, const function<void(int)> &fn) {
+        lock_guard<mutex> run_lock(run_mutex);
+        unique_lock<mutex> lock(work_mutex);
+        while((int) threads.size() < n - 1)
+            threads.emplace_back(&vconv_workers::worker, this);
+        job = &fn;
+        next = 0;
+        count = pending = n;
+        cond.notify_all();
+        while(next < count) {
+            int i = next++;
+            lock.unlock();
+            fn(i);
+            lock.lock();
+            pending--;
+        }
+        done.wait(lock, [this]{ return pending == 0; });
+        job = NULL;
+        count = next = 0;
+    }
+} ga_converter_workers;
+
+static void
+vconv_buffer_free(void *opaque, uint8_t *data) {
+    /* frame data is owned by the caller of convert_frame() */
+}
+
+/**
+ * Describe caller owned planes as a reference counted frame, without
+ * copying them, as sws_frame_start() takes references.
+ */
+static AVFrame *
+wrap_frame(const uint8_t * const data[], const int stride[], int w, int h, AVPixelFormat fmt) {
+    AVFrame *frame;
+    int planes = av_pix_fmt_count_planes(fmt);
+    //
+    if(planes <= 0 || (frame = av_frame_alloc()) == NULL)
+        return NULL;
+    for(int i = 0; i < planes && i < 4; i++) {
+        frame->data[i] = (uint8_t *) data[i];
+        frame->linesize[i] = stride[i];
+    }
+    frame->width = w;
+    frame->height = h;
+    frame->format = fmt;
+    frame->buf[0] = av_buffer_create(frame->data[0], abs(stride[0]) * h,
+                vconv_buffer_free, NULL, 0);
+    if(frame->buf[0] == NULL) {
+        av_frame_free(&frame);
+        return NULL;
+    }
+    return frame;
+}
+
+/**
+ * Convert a frame with one converter per thread, each one writing a
+ * horizontal slice of the destination from the whole source.
+ */
+static int
+convert_frame_sliced(const uint8_t * const src[], const int srcstride[],
+        int srcw, int srch, AVPixelFormat srcfmt,
+        uint8_t * const dst[], const int dststride[],
+        int dstw, int dsth, AVPixelFormat dstfmt,
+        int flags, int threads) {
+    struct SwsContext *ctx[VCONV_MAX_THREADS];
+    AVFrame *srcframe = NULL, *dstframe = NULL;
+    atomic<bool> failed(false);
+    int k, n = 0, align, slice, ret = -1;
+    //
+    for(n = 0; n < threads; n++) {
+        if((ctx[n] = acquire_frame_converter(srcw, srch, srcfmt,
+                    dstw, dsth, dstfmt, flags)) == NULL)
+            goto quit;
+    }
+    if((srcframe = wrap_frame(src, srcstride, srcw, srch, srcfmt)) == NULL
+    || (dstframe = wrap_frame(dst, dststride, dstw, dsth, dstfmt)) == NULL)
+        goto quit;
+    //
+    align = sws_receive_slice_alignment(ctx[0]);
+    slice = (dsth + threads - 1) / threads;
+    slice = (slice + align - 1) / align * align;
+    ga_converter_workers.run(threads, [&](int i) {
+        int y = i * slice;
+        int h = min(slice, dsth - y);
+        if(h <= 0)
+            return;
+        if(sws_frame_start(ctx[i], dstframe, srcframe) < 0
+        || sws_send_slice(ctx[i], 0, srch) < 0
+        || sws_receive_slice(ctx[i], y, h) < 0)
+            failed = true;
+        sws_frame_end(ctx[i]);
+    });
+    ret = failed ? -1 : dsth;
+quit:
+    av_frame_free(&srcframe);
+    av_frame_free(&dstframe);
+    for(k = 0; k < n; k++)
+        release_frame_converter(ctx[k]);
+    return ret;
+}
+#endif
+
+/**
+ * Convert a video frame.
+ *
+ * @param src [in] Planes of the source frame.
+ * @param srcstride [in] Line sizes of the source planes.
+ * @param dst [in] Planes of the destination frame.
+ * @param dststride [in] Line sizes of the destination planes.
+ * @param flags [in] Scaler quality and flags, SWS_*.
+ * @param threads [in] Number of threads, 0 to pick one from the frame size.
+ * @return Height of the converted frame, or -1 on error.
+ *
+ * Converters come from acquire_frame_converter(), so this function may
+ * be called from several threads. Large frames are converted in
+ * horizontal slices on several threads; the result is the same as the
+ * one of a single converter.
+ */
+int
+convert_frame(const uint8_t * const src[], const int srcstride[],
+        int srcw, int srch, AVPixelFormat srcfmt,
+        uint8_t * const dst[], const int dststride[],
+        int dstw, int dsth, AVPixelFormat dstfmt,
+        int flags, int threads) {
+    struct SwsContext *ctx;
+    int ret;
+    //
+    if(threads <= 0) {
+        threads = 1;
+        if((long long) dstw * dsth >= VCONV_SLICE_MIN_PIXELS)
+            threads = min((int) thread::hardware_concurrency(), dsth / VCONV_SLICE_MIN_ROWS);
+    }
+    threads = max(1, min(threads, VCONV_MAX_THREADS));
+#ifdef VCONV_SLICE_THREADS
+    if(threads > 1) {
+        return convert_frame_sliced(src, srcstride, srcw, srch, srcfmt,
+                dst, dststride, dstw, dsth, dstfmt, flags, threads);
+    }
+#endif
+    if((ctx = acquire_frame_converter(srcw, srch, srcfmt,
+                dstw, dsth, dstfmt, flags)) == NULL)
+        return -1;
+    ret = sws_scale(ctx, src, srcstride, 0, srch, dst, dststride);
+    release_frame_converter(ctx);
+    return ret;
+}
+
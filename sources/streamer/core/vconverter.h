@@ -26,6 +26,8 @@
 #ifndef __VCONVERTER_H__
 #define __VCONVERTER_H__
 
+#include "ga-common.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -38,6 +40,11 @@ extern "C" {
 }
 #endif
 
+/** Default scaler flags, used by the functions which don't take flags */
+#define VCONV_DEFAULT_FLAGS    SWS_BICUBIC
+/** Default bound on the idle converters kept by the cache */
+#define VCONV_CACHE_SIZE    16
+
 /**
  * Structure used to look up an existing converter
  */
@@ -48,11 +55,28 @@ struct vconvcfg {
     int dst_width;        /**< destination video frame width */
     int dst_height;        /**< destination video frame height */
     AVPixelFormat dst_fmt;    /**< destination video frame pixel format */
+    int flags;        /**< scaler quality and flags, SWS_* */
 };
 
 EXPORT struct SwsContext * lookup_frame_converter(int srcw, int srch, AVPixelFormat srcfmt, int dstw, int dsth, AVPixelFormat dstfmt);
 EXPORT struct SwsContext * create_frame_converter(
         int srcw, int srch, AVPixelFormat srcfmt,
         int dstw, int dsth, AVPixelFormat dstfmt);
+EXPORT struct SwsContext * create_frame_converter_flags(
+        int srcw, int srch, AVPixelFormat srcfmt,
+        int dstw, int dsth, AVPixelFormat dstfmt, int flags);
+
+EXPORT struct SwsContext * acquire_frame_converter(
+        int srcw, int srch, AVPixelFormat srcfmt,
+        int dstw, int dsth, AVPixelFormat dstfmt, int flags);
+EXPORT void release_frame_converter(struct SwsContext *ctx);
+EXPORT void set_frame_converter_cache_size(int size);
+
+EXPORT int convert_frame(
+        const uint8_t * const src[], const int srcstride[],
+        int srcw, int srch, AVPixelFormat srcfmt,
+        uint8_t * const dst[], const int dststride[],
+        int dstw, int dsth, AVPixelFormat dstfmt,
+        int flags, int threads);
 
 #endif
@@ -403,7 +403,8 @@ video_source_setup_ex(vsource_config_t *config, int nConfig) {
             ga_logger(Severity::ERR, "video source: init pipeline failed.\n");
             return -1;
         }
-        for(data = gPipe[idx]->in; data != NULL; data = data->next) {
+        for(int i = 0; i < gPipe[idx]->nbuffers; i++) {
+            data = &gPipe[idx]->buffers[i];
             if(vsource_frame_init(idx, (vsource_frame_t*) data->pointer) == NULL) {
                 ga_logger(Severity::ERR, "video source: init faile failed.\n");
                 return -1;
@@ -0,0 +1,261 @@
+// Copyright (C) 2023 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions
+// and limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+#include "ga-common.h"
+#include "CIrrvReactor.h"
+
+#define LOG_PREFIX "irrv-receiver: reactor: "
+
+#define MAX_EVENTS 64
+
+static int64_t
+now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}
+
+CIrrvReactor&
+CIrrvReactor::instance() {
+    static CIrrvReactor reactor;
+    return reactor;
+}
+
+CIrrvReactor::~CIrrvReactor() {
+    shutdown();
+}
+
+void
+CIrrvReactor::add(Handler* handler) {
+    std::lock_guard<std::mutex> life(m_lifecycle);
+
+    if (!m_thread.joinable()) {
+        m_epoll = epoll_create1(EPOLL_CLOEXEC);
+        m_wakeup = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (m_epoll < 0 || m_wakeup < 0) {
+            ga_logger(Severity::ERR, LOG_PREFIX "failed to create epoll: %s\n", strerror(errno));
+            shutdown();
+            throw std::runtime_error("irrv-receiver: failed to create epoll");
+        }
+        struct epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.ptr = nullptr;    // wakeup
+        epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_wakeup, &ev);
+
+        m_stop = false;
+        m_thread = std::thread(&CIrrvReactor::run, this);
+        ga_logger(Severity::INFO, LOG_PREFIX "started\n");
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_handlers[handler] = Entry();
+    }
+    wakeup();
+}
+
+void
+CIrrvReactor::remove(Handler* handler) {
+    std::lock_guard<std::mutex> life(m_lifecycle);
+    bool last = false;
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        auto it = m_handlers.find(handler);
+        if (it == m_handlers.end())
+            return;
+        // not dispatched anymore, but it may be running right now and
+        // change its socket
+        it->second.removed = true;
+        m_cv.wait(lock, [&]{ return m_calling != handler; });
+        if (it->second.fd >= 0)
+            epoll_ctl(m_epoll, EPOLL_CTL_DEL, it->second.fd, nullptr);
+        m_handlers.erase(it);
+        last = m_handlers.empty();
+    }
+    if (last)
+        shutdown();
+}
+
+void
+CIrrvReactor::shutdown() {
+    if (m_thread.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        wakeup();
+        m_thread.join();
+        ga_logger(Severity::INFO, LOG_PREFIX "stopped\n");
+    }
+    if (m_wakeup >= 0) {
+        close(m_wakeup);
+        m_wakeup = -1;
+    }
+    if (m_epoll >= 0) {
+        close(m_epoll);
+        m_epoll = -1;
+    }
+}
+
+void
+CIrrvReactor::wakeup() {
+    uint64_t one = 1;
+    if (m_wakeup >= 0 && write(m_wakeup, &one, sizeof(one)) < 0 && errno != EAGAIN)
+        ga_logger(Severity::WARNING, LOG_PREFIX "wakeup failed: %s\n", strerror(errno));
+}
+
+// Follow the handler's socket after a call, it may have disconnected,
+// reconnected or finished connecting. Done on the reactor thread right
+// after the call, before any other handler runs.
+void
+CIrrvReactor::sync_fd(Handler* handler, Entry& entry) {
+    int fd = handler->fd();
+    uint32_t events = EPOLLIN;
+    if (fd >= 0 && handler->want_writable())
+        events |= EPOLLOUT;
+    if (fd == entry.fd && events == entry.events)
+        return;
+
+    struct epoll_event ev{};
+    ev.events = events;
+    ev.data.ptr = handler;
+    if (fd >= 0 && fd == entry.fd) {
+        if (epoll_ctl(m_epoll, EPOLL_CTL_MOD, fd, &ev) == 0) {
+            entry.events = events;
+            return;
+        }
+        ga_logger(Severity::ERR, LOG_PREFIX "failed to watch fd %d: %s\n", fd, strerror(errno));
+    }
+    if (entry.fd >= 0)
+        epoll_ctl(m_epoll, EPOLL_CTL_DEL, entry.fd, nullptr);
+    entry.fd = -1;
+    entry.events = 0;
+    if (fd >= 0) {
+        if (epoll_ctl(m_epoll, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            ga_logger(Severity::ERR, LOG_PREFIX "failed to watch fd %d: %s\n", fd, strerror(errno));
+            return;
+        }
+        entry.fd = fd;
+        entry.events = events;
+    }
+}
+
+// Call a handler without holding m_mutex, unless it was removed meanwhile
+void
+CIrrvReactor::dispatch(Handler* handler, Call call) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_handlers.find(handler);
+        if (m_stop || it == m_handlers.end() || it->second.removed)
+            return;
+        m_calling = handler;
+    }
+
+    switch (call) {
+    case Call::Readable:
+        handler->on_readable();
+        break;
+    case Call::Writable:
+        handler->on_writable();
+        break;
+    case Call::Idle:
+        handler->on_idle();
+        break;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_calling = nullptr;
+        // still there, remove() waits for the call to return
+        auto it = m_handlers.find(handler);
+        if (it != m_handlers.end())
+            sync_fd(handler, it->second);
+    }
+    m_cv.notify_all();
+}
+
+void
+CIrrvReactor::run() {
+    struct epoll_event events[MAX_EVENTS];
+    std::vector<Handler*> idle;
+
+    for (;;) {
+        int timeout = IDLE_INTERVAL_MS;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            int64_t now = now_ms();
+            for (auto& it : m_handlers) {
+                int64_t left = it.second.idle_ms + IDLE_INTERVAL_MS - now;
+                timeout = (int)std::max<int64_t>(0, std::min<int64_t>(timeout, left));
+            }
+        }
+
+        int n = epoll_wait(m_epoll, events, MAX_EVENTS, timeout);
+        if (n < 0) {
+            if (errno != EINTR) {
+                ga_logger(Severity::ERR, LOG_PREFIX "epoll_wait failed: %s\n", strerror(errno));
+                usleep(IDLE_INTERVAL_MS * 1000);
+            }
+            n = 0;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_stop)
+                break;
+        }
+
+        for (int i = 0; i < n; i++) {
+            Handler* handler = static_cast<Handler*>(events[i].data.ptr);
+            if (!handler) {
+                uint64_t count;
+                while (read(m_wakeup, &count, sizeof(count)) > 0)
+                    ;
+                continue;
+            }
+            // a failed connect reports EPOLLERR, the handler finds out on write
+            if (events[i].events & (EPOLLOUT | EPOLLERR))
+                dispatch(handler, Call::Writable);
+            if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLRDHUP))
+                dispatch(handler, Call::Readable);
+        }
+
+        idle.clear();
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            int64_t now = now_ms();
+            for (auto& it : m_handlers) {
+                if (now - it.second.idle_ms < IDLE_INTERVAL_MS)
+                    continue;
+                it.second.idle_ms = now;
+                idle.push_back(it.first);
+            }
+        }
+        for (Handler* handler : idle)
+            dispatch(handler, Call::Idle);
+    }
+}
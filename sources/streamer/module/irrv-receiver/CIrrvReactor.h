@@ -0,0 +1,98 @@
+// Copyright (C) 2023 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions
+// and limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef CIRRVREACTOR_H
+#define CIRRVREACTOR_H
+
+#include <stdint.h>
+
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <thread>
+
+/**
+ * Single epoll thread serving the IRRV connections of all sessions in
+ * the process. Handlers are called on that thread only, one at a time
+ * and without any reactor lock held. They must not block: a handler
+ * waiting on its socket stalls every other session.
+ */
+class CIrrvReactor {
+public:
+    class Handler {
+    public:
+        virtual ~Handler() = default;
+        /** Socket to wait on, -1 while not connected */
+        virtual int fd() = 0;
+        /** Also wait for the socket to be writable, while connecting */
+        virtual bool want_writable() { return false; }
+        /** Socket is readable, receive what has arrived */
+        virtual void on_readable() = 0;
+        /** Socket is writable */
+        virtual void on_writable() {}
+        /** Called about every IDLE_INTERVAL_MS, checks timeouts and reconnects */
+        virtual void on_idle() = 0;
+    };
+
+    /** Period of on_idle() calls */
+    static const int IDLE_INTERVAL_MS = 100;
+
+    static CIrrvReactor& instance();
+
+    CIrrvReactor(const CIrrvReactor&) = delete;
+    CIrrvReactor& operator=(const CIrrvReactor&) = delete;
+
+    /**
+     * Start serving a handler. Throws an exception on failure.
+     */
+    void add(Handler* handler);
+    /**
+     * Stop serving a handler. Returns once the handler is not called
+     * anymore. Must not be called from a handler.
+     */
+    void remove(Handler* handler);
+
+private:
+    struct Entry {
+        int fd = -1;            // socket registered in epoll
+        uint32_t events = 0;    // events it is registered for
+        int64_t idle_ms = 0;    // last on_idle() call
+        bool removed = false;   // being removed, not called anymore
+    };
+
+    enum class Call { Readable, Writable, Idle };
+
+    CIrrvReactor() = default;
+    ~CIrrvReactor();
+
+    void run();
+    void wakeup();
+    void dispatch(Handler* handler, Call call);
+    void sync_fd(Handler* handler, Entry& entry);
+    void shutdown();
+
+    std::mutex m_lifecycle;     // serializes add() and remove()
+    std::mutex m_mutex;         // guards the handlers, not held while they are called
+    std::condition_variable m_cv;
+    std::map<Handler*, Entry> m_handlers;
+    Handler* m_calling = nullptr;   // handler being called, remove() waits for it
+    std::thread m_thread;
+    bool m_stop = false;
+    int m_epoll = -1;
+    int m_wakeup = -1;
+};
+
+#endif /* CIRRVREACTOR_H */
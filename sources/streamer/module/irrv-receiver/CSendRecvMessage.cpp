@@ -14,11 +14,14 @@
 //
 // SPDX-License-Identifier: Apache-2.0
 
+#include <errno.h>
 #include <fcntl.h>
 #include <poll.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <algorithm>
 #include <string>
 #include <sstream>
 
@@ -42,12 +45,55 @@ using namespace std;
 
 #define LOG_PREFIX "irrv-receiver: "
 
-CSendRecvMessage::CSendRecvMessage(bool startEncoderImmediately) {
+// Frames in flight between the receiver and the sink, usually just one
+#define FRAME_POOL_SIZE 4
+
+// Frames waiting for a slow sink before the receiver starts dropping
+#define MAX_QUEUED_FRAMES 8
+
+// Time for a whole event to arrive once its first byte is readable,
+// checked by on_idle()
+#define DEFAULT_RECV_TIMEOUT_MS 500
+
+// Time for a connection to be established, and between attempts
+#define CONNECT_TIMEOUT_MS 1000
+#define RECONNECT_INTERVAL_MS 1000
+
+// recv() calls per readable event, so that a busy session leaves room to
+// the others; the rest is read on the next event
+#define MAX_READS_PER_CALL 16
+
+// Period of the averages reported in the receive statistics
+#define RECV_STATS_WINDOW_US 5000000
+
+static int64_t
+now_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+static uint64_t
+wall_ms() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1000ULL + tv.tv_usec / 1000;
+}
+
+CSendRecvMessage::CSendRecvMessage(bool startEncoderImmediately, int channel, ga_conf_session_t* conf) {
+    ga_conf_session_scope scope(conf);
+
+    m_channel                  = channel;
+    m_conf                     = conf;
     m_bEnableAlphaTransmission = false;
     m_width                    = 0;
     m_height                   = 0;
     m_format                   = 0;
     m_bStartEncoderImmediately  = startEncoderImmediately;
+    m_framePool                = ga_buffer_pool_create(FRAME_POOL_SIZE);
+    m_recvTimeoutMs            = ga_conf_readint("irrv-recv-timeout-ms");
+    if (m_recvTimeoutMs <= 0)
+        m_recvTimeoutMs = DEFAULT_RECV_TIMEOUT_MS;
 
     std::string fileName = ga_conf_readstr("video-bs-file");
     if (!fileName.empty()) {
@@ -57,6 +103,8 @@ CSendRecvMessage::CSendRecvMessage(bool startEncoderImmediately) {
         }
     }
     ga_logger(Severity::INFO, LOG_PREFIX "video-bs-file: %s\n", fileName.c_str());
+
+    reset_pending();
 }
 
 CSendRecvMessage::~CSendRecvMessage() {
@@ -65,74 +113,57 @@ CSendRecvMessage::~CSendRecvMessage() {
     if (m_client >= 0) {
         close(m_client);
     }
+    ga_buffer_unref(&m_pending.payload);
     if (m_encout) {
         fclose(m_encout);
     }
+    ga_buffer_pool_destroy(&m_framePool);
 }
 
 void CSendRecvMessage::start() {
-    if (m_thread.joinable())
+    if (m_started)
         return;
 
-    {
-        std::lock_guard<std::mutex> lock(m_mutex);
-        m_stop = false;
-    }
-    m_thread = std::thread([this]{
-        while(1) {
-            run();
-            {
-                std::lock_guard<std::mutex> lock(m_mutex);
-                if (m_stop) break;
-            }
+    m_senderStop = false;
+    m_sender = std::thread(&CSendRecvMessage::sender_run, this);
+    try {
+        CIrrvReactor::instance().add(this);
+    } catch (...) {
+        {
+            std::lock_guard<std::mutex> lock(m_queueMutex);
+            m_senderStop = true;
         }
-    });
+        m_queueCv.notify_all();
+        m_sender.join();
+        throw;
+    }
+    m_started = true;
 }
 
 void CSendRecvMessage::stop() {
-    if (m_thread.joinable()) {
-        {
-            std::lock_guard<std::mutex> lock(m_mutex);
-            m_stop = true;
-        }
-        m_thread.join();
+    if (!m_started)
+        return;
+
+    CIrrvReactor::instance().remove(this);
+    {
+        std::lock_guard<std::mutex> lock(m_queueMutex);
+        m_senderStop = true;
     }
-}
+    m_queueCv.notify_all();
+    m_sender.join();
 
-void CSendRecvMessage::run() {
-    recv_es_stream();
+    for (QueuedFrame& f : m_queue)
+        ga_buffer_unref(&f.buf);
+    m_queue.clear();
+    m_started = false;
 }
 
 bool CSendRecvMessage::irrv_sock_client_init() {
     std::lock_guard<std::mutex> lock(m_mutex);
     if (m_client < 0) {
         m_client = sock_client_init();
-
-        if (m_bStartEncoderImmediately && m_client >= 0 && disconnect != sock_client_check_connect(m_client, 0))
-        {
-            ga_logger(Severity::INFO, LOG_PREFIX "IRRV_CTRL_START\n");
-            irrv_vctrl_event_t ctrl_ev;
-            memset(&ctrl_ev, 0, sizeof(ctrl_ev));
-            ctrl_ev.event.magic    = IRRV_MAGIC;
-            ctrl_ev.event.type     = IRRV_EVENT_VCTRL;
-            ctrl_ev.event.size     = sizeof(ctrl_ev);
-            ctrl_ev.event.value    = 0;
-            ctrl_ev.info.ctrl_type = IRRV_CTRL_START;
-            ctrl_ev.info.value     = 1;
-
-            sock_client_send(m_client, &ctrl_ev, sizeof(ctrl_ev));
-
-            ga_logger(Severity::INFO, LOG_PREFIX "IRRV_CTRL_KEYFRAME_SETTING\n");
-            memset(&ctrl_ev, 0, sizeof(ctrl_ev));
-            ctrl_ev.event.magic    = IRRV_MAGIC;
-            ctrl_ev.event.type     = IRRV_EVENT_VCTRL;
-            ctrl_ev.event.size     = sizeof(ctrl_ev);
-            ctrl_ev.event.value    = 0;
-            ctrl_ev.info.ctrl_type = IRRV_CTRL_KEYFRAME_SETTING;
-            ctrl_ev.info.value     = 1;
-
-            sock_client_send(m_client, &ctrl_ev, sizeof(ctrl_ev));
-        }
+        m_connecting = (m_client >= 0);
+        m_connectStartMs = now_us() / 1000;
     }
 
     return (m_client < 0)? false: true;
@@ -144,6 +175,7 @@ void CSendRecvMessage::irrv_sock_client_disconnect() {
         close(m_client);
         m_client = -1;
     }
+    m_connecting = false;
 }
 
 void CSendRecvMessage::irrv_send_authentication()
@@ -200,6 +232,7 @@ const char* irrv_ctrl_type(int type)
     IRRV_CASE(IRRV_CTRL_MAX_BITRATE_SETTING);
     IRRV_CASE(IRRV_CTRL_SKIP_FRAME_SETTING);
     IRRV_CASE(IRRV_CTRL_CLIENT_FEEDBACK);
+    IRRV_CASE(IRRV_CTRL_FLIGHT_RECORDER_SNAPSHOT);
     default:
         return "unknown";
     }
@@ -208,7 +241,7 @@ const char* irrv_ctrl_type(int type)
 int CSendRecvMessage::irrv_op(irrv_vctrl_t& ctrl) {
     std::lock_guard<std::mutex> lock(m_mutex);
 
-    if (m_client < 0) {
+    if (m_client < 0 || m_connecting) {
       ga_logger(Severity::WARNING, LOG_PREFIX "failed to send %s: not connected to server\n",
         irrv_ctrl_type(ctrl.ctrl_type));
       return -1;
@@ -230,7 +263,7 @@ int CSendRecvMessage::irrv_op(irrv_vctrl_t& ctrl) {
 int CSendRecvMessage::irrv_op(std::vector<irrv_vctrl_event_t>& ctrls) {
     std::lock_guard<std::mutex> lock(m_mutex);
 
-    if (m_client < 0) {
+    if (m_client < 0 || m_connecting) {
       ga_logger(Severity::WARNING,
         LOG_PREFIX "failed to send ctrl array (first ctrl: %s): not connected to server\n",
         irrv_ctrl_type(ctrls[0].info.ctrl_type));
@@ -431,6 +464,9 @@ bool CSendRecvMessage::private_pipe_connect()
     if (m_privatePipe >= 0)
         return true;
 
+    // called from the sink's threads
+    ga_conf_session_scope scope(m_conf);
+
     int session_id = ga_conf_readint("android-session");
     int user_id = ga_conf_readint("user");
 
@@ -468,179 +504,410 @@ void CSendRecvMessage::private_pipe_disconnect()
     }
 }
 
-void CSendRecvMessage::recv_es_stream() {
-    if (!irrv_sock_client_init()) {
-        ga_logger(Severity::INFO, LOG_PREFIX "failed connect to server, will retry in 1 second\n");
-        usleep(1000000);
+void CSendRecvMessage::reset_connection()
+{
+    irrv_sock_client_disconnect();
+    private_pipe_disconnect();
+    // the stream is out of sync after a partial event
+    reset_pending();
+    m_bUnexpectedDisconnect = true;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_ready = false;
+    }
+}
+
+void CSendRecvMessage::reset_pending()
+{
+    ga_buffer_unref(&m_pending.payload);
+    m_pending = PendingEvent();
+    expect(PendingEvent::Header, &m_pending.head, sizeof(m_pending.head));
+}
+
+void CSendRecvMessage::expect(PendingEvent::Stage stage, void* dst, size_t size)
+{
+    m_pending.stage = stage;
+    m_pending.dst   = (uint8_t*)dst;
+    m_pending.left  = size;
+}
+
+void CSendRecvMessage::update_recv_stats(int64_t arrival_us, int64_t assembly_us)
+{
+    std::lock_guard<std::mutex> lock(m_statsMutex);
+    RecvStats& s = m_stats;
+
+    // Jitter is the smoothed change of the inter-arrival time, in the
+    // spirit of RFC 3550 but without sender timestamps
+    if (s.last_arrival_us) {
+        int64_t interval_us = arrival_us - s.last_arrival_us;
+        if (s.last_interval_us) {
+            double d = (double)std::llabs(interval_us - s.last_interval_us);
+            s.jitter_us += (d - s.jitter_us) / 16.0;
+        }
+        s.last_interval_us = interval_us;
+    }
+    s.last_arrival_us = arrival_us;
+    s.frames++;
+
+    if (!s.window_start_us)
+        s.window_start_us = arrival_us;
+    s.window_frames++;
+    s.window_assembly_us += assembly_us;
+    s.window_assembly_max_us = std::max(s.window_assembly_max_us, assembly_us);
+
+    if (arrival_us - s.window_start_us >= RECV_STATS_WINDOW_US) {
+        s.assembly_avg_us = s.window_assembly_us / s.window_frames;
+        s.assembly_max_us = s.window_assembly_max_us;
+        ga_logger(Severity::DBG, LOG_PREFIX "recv stats: frames=%llu fps=%.1f jitter=%.0fus assembly avg=%lldus max=%lldus timeouts=%llu reconnects=%llu\n",
+            (unsigned long long)s.frames, s.window_frames * 1e6 / (arrival_us - s.window_start_us), s.jitter_us,
+            (long long)s.assembly_avg_us, (long long)s.assembly_max_us,
+            (unsigned long long)s.timeouts, (unsigned long long)s.reconnects);
+        s.window_start_us = arrival_us;
+        s.window_frames = 0;
+        s.window_assembly_us = 0;
+        s.window_assembly_max_us = 0;
+    }
+}
+
+void CSendRecvMessage::get_recv_stats(ga_ioctl_recvstats_t* stats)
+{
+    std::lock_guard<std::mutex> lock(m_statsMutex);
+    stats->frames          = (long)m_stats.frames;
+    stats->jitter_us       = (long)m_stats.jitter_us;
+    stats->assembly_avg_us = (long)m_stats.assembly_avg_us;
+    stats->assembly_max_us = (long)m_stats.assembly_max_us;
+    stats->timeouts        = (long)m_stats.timeouts;
+    stats->reconnects      = (long)m_stats.reconnects;
+}
+
+int CSendRecvMessage::fd() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_client;
+}
+
+bool CSendRecvMessage::want_writable() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_connecting;
+}
+
+void CSendRecvMessage::on_idle() {
+    ga_conf_session_scope scope(m_conf);
+    int64_t now = now_us();
+
+    if (m_client < 0) {
+        if (now / 1000 < m_nextConnectMs)
+            return;
+        m_nextConnectMs = now / 1000 + RECONNECT_INTERVAL_MS;
+        if (!irrv_sock_client_init())
+            ga_logger(Severity::INFO, LOG_PREFIX "failed connect to server, will retry in 1 second\n");
+        return;
+    }
+
+    if (m_connecting) {
+        if (now / 1000 - m_connectStartMs >= CONNECT_TIMEOUT_MS) {
+            ga_logger(Severity::INFO, LOG_PREFIX "connection to server timed out, will retry in 1 second\n");
+            irrv_sock_client_disconnect();
+        }
+        return;
+    }
+
+    // The whole event, header and payload, has to arrive within the
+    // timeout, counted from its first byte
+    if (m_pending.first_byte_us && now - m_pending.first_byte_us > m_recvTimeoutMs * 1000LL) {
+        ga_logger(Severity::WARNING, LOG_PREFIX "event not received within %d ms, reconnecting\n", m_recvTimeoutMs);
+        {
+            std::lock_guard<std::mutex> lock(m_statsMutex);
+            m_stats.timeouts++;
+        }
+        reset_connection();
+    }
+}
+
+void CSendRecvMessage::on_writable() {
+    ga_conf_session_scope scope(m_conf);
+    if (m_connecting)
+        on_connected();
+}
+
+void CSendRecvMessage::on_connected() {
+    if (sock_client_connect_result(m_client) < 0) {
+        ga_logger(Severity::INFO, LOG_PREFIX "failed connect to server: %s, will retry in 1 second\n", strerror(errno));
+        irrv_sock_client_disconnect();
         return;
     }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_connecting = false;
+    }
+    ga_logger(Severity::INFO, LOG_PREFIX "connected to server\n");
+
+    if (m_bStartEncoderImmediately) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        ga_logger(Severity::INFO, LOG_PREFIX "IRRV_CTRL_START\n");
+        irrv_vctrl_event_t ctrl_ev;
+        memset(&ctrl_ev, 0, sizeof(ctrl_ev));
+        ctrl_ev.event.magic    = IRRV_MAGIC;
+        ctrl_ev.event.type     = IRRV_EVENT_VCTRL;
+        ctrl_ev.event.size     = sizeof(ctrl_ev);
+        ctrl_ev.event.value    = 0;
+        ctrl_ev.info.ctrl_type = IRRV_CTRL_START;
+        ctrl_ev.info.value     = 1;
+
+        sock_client_send(m_client, &ctrl_ev, sizeof(ctrl_ev));
+
+        ga_logger(Severity::INFO, LOG_PREFIX "IRRV_CTRL_KEYFRAME_SETTING\n");
+        memset(&ctrl_ev, 0, sizeof(ctrl_ev));
+        ctrl_ev.event.magic    = IRRV_MAGIC;
+        ctrl_ev.event.type     = IRRV_EVENT_VCTRL;
+        ctrl_ev.event.size     = sizeof(ctrl_ev);
+        ctrl_ev.event.value    = 0;
+        ctrl_ev.info.ctrl_type = IRRV_CTRL_KEYFRAME_SETTING;
+        ctrl_ev.info.value     = 1;
+
+        sock_client_send(m_client, &ctrl_ev, sizeof(ctrl_ev));
+    }
 
     if (m_bUnexpectedDisconnect) {
         irrv_set_encodestart();
-        irrv_set_keyframe();
+        // frames were lost in the gap, a restarted encoder begins with an IDR anyway
+        irrv_request_recovery();
         m_bUnexpectedDisconnect = false;
+        std::lock_guard<std::mutex> lock(m_statsMutex);
+        m_stats.reconnects++;
+        // the gap does not count as jitter
+        m_stats.last_arrival_us = 0;
+        m_stats.last_interval_us = 0;
     }
+}
 
-    struct timeval encBeginTv, encEndTv;
-    struct timeval pkttv;
-    uint64_t encode_start_ms, capture_time_ms, encode_end_ms;
-
-    gettimeofday(&encBeginTv, NULL);
-    encode_start_ms = encBeginTv.tv_sec * 1000 + encBeginTv.tv_usec / 1000 - 5;
-    capture_time_ms = encode_start_ms;
-    bool last_slice = true;
+void CSendRecvMessage::on_readable() {
+    ga_conf_session_scope scope(m_conf);
 
-    if (m_client >= 0) {
-        struct pollfd fd{};
-        fd.fd = m_client;
-        fd.events = POLLIN;
+    // a failed connect is handled by on_writable()
+    if (m_client < 0 || m_connecting)
+        return;
 
-        int ret = poll(&fd, 1, 1000); // each 1 second
+    for (int i = 0; i < MAX_READS_PER_CALL; i++) {
+        ssize_t ret = recv(m_client, m_pending.dst, m_pending.left, MSG_DONTWAIT);
         if (ret < 0) {
-            ga_logger(Severity::ERR, LOG_PREFIX "can't receive data: %s\n", strerror(errno));
-            ga_logger(Severity::ERR, LOG_PREFIX "disconnected\n");
-            close(m_client);
-            m_client = -1;
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                return;
+            ga_logger(Severity::ERR, LOG_PREFIX "can't receive data: %s, reconnecting\n", strerror(errno));
+            reset_connection();
             return;
         }
         if (ret == 0) {
-            //timeout
-            ga_logger(Severity::DBG, LOG_PREFIX "timeout, no data posted\n");
+            ga_logger(Severity::WARNING, LOG_PREFIX "connection closed by server, reconnecting\n");
+            reset_connection();
             return;
         }
 
-        irrv_event_t ev{};
-        ret = sock_client_recv(m_client, &ev, sizeof(ev));
-        if (ret < 0)
+        if (!m_pending.first_byte_us) {
+            m_pending.first_byte_us = now_us();
+            m_pending.begin_ms = wall_ms() - 5;
+        }
+        m_pending.dst  += ret;
+        m_pending.left -= ret;
+        if (!m_pending.left && !on_part_received())
             return;
+    }
+}
+
+// Handle a complete part of the pending event and set up the next one.
+// Returns false if the connection was reset.
+bool CSendRecvMessage::on_part_received() {
+    irrv_event_t& ev = m_pending.head;
 
+    if (m_pending.stage == PendingEvent::Header) {
         switch (ev.type) {
             case IRRV_EVENT_VHEAD:
-            {
-                ga_logger(Severity::INFO, LOG_PREFIX "IRRV_EVENT_VHEAD\n");
-                irrv_vhead_t head{};
-
                 static_assert((sizeof(irrv_vhead_event_t) - sizeof(irrv_event_t)) == sizeof(irrv_vhead_t));
-                ret = sock_client_recv(m_client, &head, sizeof(irrv_vhead_t));
-                if (ret < 0)
-                    return;
-
-                ga_logger(Severity::INFO, LOG_PREFIX "width=%d, height=%d, format=%d\n", head.width, head.height, head.format);
-
-                m_width  = head.width;
-                m_height = head.height;
-                m_format = head.format;
-
-                if (head.auth) {
-                    irrv_send_authentication();
-                }
-
-                irrv_vhead_event_t head_ev_ack;
-                memset(&head_ev_ack, 0, sizeof(head_ev_ack));
-                head_ev_ack.event.magic = IRRV_MAGIC;
-                head_ev_ack.event.type  = IRRV_EVENT_VHEAD_ACK;
-                head_ev_ack.event.size  = sizeof(head_ev_ack);
-                head_ev_ack.event.value = 1;
-                head_ev_ack.info.flags  = IRRV_STREAM_VIDEO_ONLY;
-                head_ev_ack.info.width  = head.width;
-                head_ev_ack.info.height = head.height;
-                head_ev_ack.info.format = head.format;
-                sock_client_send(m_client, &head_ev_ack, sizeof(head_ev_ack));
+                expect(PendingEvent::Body, &m_pending.body.vhead, sizeof(irrv_vhead_t));
+                return true;
+            case IRRV_EVENT_VAUTH_ACK:
+                static_assert((sizeof(irrv_vauth_event_t) - sizeof(irrv_event_t)) == sizeof(irrv_vauth_t));
+                expect(PendingEvent::Body, &m_pending.body.vauth, sizeof(irrv_vauth_t));
+                return true;
+            case IRRV_EVENT_VFRAME:
+                static_assert((sizeof(irrv_vframe_event_t) - sizeof(irrv_event_t)) == sizeof(irrv_vframe_t));
+                expect(PendingEvent::Body, &m_pending.body.vframe, sizeof(irrv_vframe_t));
+                return true;
+            default:
+                ga_logger(Severity::WARNING, LOG_PREFIX "unknown event, ev.type = %x\n", ev.type);
+                reset_connection();
+                return false;
+        }
+    }
 
-                m_ready = true;
-                m_cv.notify_all();
-                break;
+    if (m_pending.stage == PendingEvent::Payload) {
+        on_frame_received();
+        reset_pending();
+        return true;
+    }
+
+    switch (ev.type) {
+        case IRRV_EVENT_VHEAD:
+        {
+            ga_logger(Severity::INFO, LOG_PREFIX "IRRV_EVENT_VHEAD\n");
+            const irrv_vhead_t& head = m_pending.body.vhead;
+            ga_logger(Severity::INFO, LOG_PREFIX "width=%d, height=%d, format=%d\n", head.width, head.height, head.format);
+
+            m_width  = head.width;
+            m_height = head.height;
+            m_format = head.format;
+
+            if (head.auth) {
+                irrv_send_authentication();
             }
-            case IRRV_EVENT_VAUTH_ACK:
+
+            irrv_vhead_event_t head_ev_ack;
+            memset(&head_ev_ack, 0, sizeof(head_ev_ack));
+            head_ev_ack.event.magic = IRRV_MAGIC;
+            head_ev_ack.event.type  = IRRV_EVENT_VHEAD_ACK;
+            head_ev_ack.event.size  = sizeof(head_ev_ack);
+            head_ev_ack.event.value = 1;
+            head_ev_ack.info.flags  = IRRV_STREAM_VIDEO_ONLY;
+            head_ev_ack.info.width  = head.width;
+            head_ev_ack.info.height = head.height;
+            head_ev_ack.info.format = head.format;
+            sock_client_send(m_client, &head_ev_ack, sizeof(head_ev_ack));
+
             {
-                ga_logger(Severity::INFO, LOG_PREFIX "IRRV_EVENT_VAUTH_ACK\n");
-                irrv_vauth_t auth{};
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_ready = true;
+            }
+            m_cv.notify_all();
+            break;
+        }
+        case IRRV_EVENT_VAUTH_ACK:
+        {
+            ga_logger(Severity::INFO, LOG_PREFIX "IRRV_EVENT_VAUTH_ACK\n");
+            if(AUTH_PASSED == m_pending.body.vauth.result) {
+                ga_logger(Severity::INFO, LOG_PREFIX "authentication passed!\n");
+            } else if (AUTH_FAILED == m_pending.body.vauth.result) {
+                ga_logger(Severity::INFO, LOG_PREFIX "authentication failed!\n");
+            }
+            break;
+        }
+        case IRRV_EVENT_VFRAME:
+        {
+            ga_logger(Severity::DBG, LOG_PREFIX "IRRV_EVENT_VFRAME\n");
+            const irrv_vframe_t& frame = m_pending.body.vframe;
+            ga_logger(Severity::DBG, LOG_PREFIX "data_size=%d, video_size=%d, alpha_size=%d, flags=%d\n",
+                frame.data_size, frame.video_size, frame.alpha_size, frame.flags);
+
+            if (!frame.data_size || frame.data_size < frame.video_size || frame.data_size > 4*m_width*m_height) {
+                ga_logger(Severity::ERR, LOG_PREFIX "broken frame, reconnecting\n");
+                reset_connection();
+                return false;
+            }
 
-                static_assert((sizeof(irrv_vauth_event_t) - sizeof(irrv_event_t)) == sizeof(irrv_vauth_t));
-                ret = sock_client_recv(m_client, &auth, sizeof(irrv_vauth_t));
-                if (ret < 0)
-                    return;
-
-                if(AUTH_PASSED == auth.result) {
-                    ga_logger(Severity::INFO, LOG_PREFIX "authentication passed!\n");
-                } else if (AUTH_FAILED == auth.result) {
-                    ga_logger(Severity::INFO, LOG_PREFIX "authentication failed!\n");
-                }
-                break;
+            // data_size include video_size and alpha_size if the transmission data including alpha data.
+            m_pending.payload = ga_buffer_pool_get(m_framePool, frame.data_size);
+            if (!m_pending.payload) {
+                reset_connection();
+                return false;
             }
-            case IRRV_EVENT_VFRAME:
-            {
-                ga_logger(Severity::DBG, LOG_PREFIX "IRRV_EVENT_VFRAME\n");
-                irrv_vframe_t frame{};
+            expect(PendingEvent::Payload, m_pending.payload->data.data(), frame.data_size);
+            return true;
+        }
+    }
+    reset_pending();
+    return true;
+}
 
-                static_assert((sizeof(irrv_vframe_event_t) - sizeof(irrv_event_t)) == sizeof(irrv_vframe_t));
-                ret = sock_client_recv(m_client, &frame, sizeof(irrv_vframe_t));
-                if (ret < 0)
-                    return;
-
-                ga_logger(Severity::DBG, LOG_PREFIX "data_size=%d, video_size=%d, alpha_size=%d, flags=%d\n",
-                    frame.data_size, frame.video_size, frame.alpha_size, frame.flags);
-
-                if (!frame.data_size || frame.data_size < frame.video_size || frame.data_size > 4*m_width*m_height) {
-                    ga_logger(Severity::ERR, "broken frame\n");
-                    return;
-                }
-
-                m_frameData.resize(frame.data_size);
-                uint8_t* p       = &m_frameData[0];
-                int left_size = frame.data_size;  // data_size include video_size and alpha_size if the transmission data including alpha data.
-                while (left_size > 0) {
-                    ret = sock_client_recv(m_client, p, left_size);
-                    if (ret > 0) {
-                        p += ret;
-                        left_size -= ret;
-                    }
-                }
-
-                if (m_encout) {
-                    if (m_bEnableAlphaTransmission && frame.video_size && frame.alpha_size > 0) {
-                        fwrite(&m_frameData[0], 1, frame.video_size, m_encout);
-                    }
-                    else {
-                        fwrite(&m_frameData[0], 1, frame.data_size, m_encout);
-                    }
-                }
-
-                gettimeofday(&encEndTv, NULL);
-                encode_end_ms = encEndTv.tv_sec * 1000 + encEndTv.tv_usec / 1000;
-
-                // send frame by webrtc
-                ga_packet_t pkt;
-                ga_init_packet(&pkt);
-                pkt.data = &m_frameData[0];
-                pkt.size = frame.data_size;
-                pkt.flags = (int)frame.flags;
-                pkt.pts = 0;
-
-                FrameMetaData* sp = (FrameMetaData*)ga_packet_new_side_data(&pkt, ga_packet_side_data_type::GA_PACKET_DATA_NEW_EXTRADATA, sizeof(FrameMetaData));
-                if (sp) {
-                    sp->encode_end_ms   = encode_end_ms;
-                    sp->encode_start_ms = encode_start_ms;
-                    sp->last_slice      = last_slice;
-                    sp->capture_time_ms = capture_time_ms;
-
-                    if (encoder_send_packet("video-encoder", 0, &pkt, pkt.pts, &pkttv) < 0) {
-                        ga_logger(Severity::ERR, LOG_PREFIX "encoder_send_packet() error!\n");
-                        return;
-                    }
-
-                    ga_packet_free_side_data(&pkt);
-                }
+void CSendRecvMessage::on_frame_received() {
+    const irrv_vframe_t& frame = m_pending.body.vframe;
+
+    int64_t arrival_us = now_us();
+    update_recv_stats(arrival_us, arrival_us - m_pending.first_byte_us);
+
+    if (m_encout) {
+        const uint8_t* data = m_pending.payload->data.data();
+        if (m_bEnableAlphaTransmission && frame.video_size && frame.alpha_size > 0) {
+            fwrite(data, 1, frame.video_size, m_encout);
+        }
+        else {
+            fwrite(data, 1, frame.data_size, m_encout);
+        }
+    }
+
+    QueuedFrame f;
+    f.buf             = m_pending.payload;
+    f.size            = (int)frame.data_size;
+    f.flags           = (int)frame.flags;
+    f.encode_start_ms = m_pending.begin_ms;
+    f.encode_end_ms   = wall_ms();
+    m_pending.payload = nullptr;
+
+    // A frame missing in the stream breaks the following ones, so once the
+    // queue overflows everything goes until the requested key frame
+    bool queued = false;
+    bool overflow = false;
+    {
+        std::lock_guard<std::mutex> lock(m_queueMutex);
+        if (m_waitKeyFrame && !(f.flags & IRRV_VFRAME_FLAG_KEY)) {
+            // dropped
+        } else if (m_queue.size() >= MAX_QUEUED_FRAMES) {
+            overflow = !m_waitKeyFrame;
+            m_waitKeyFrame = true;
+        } else {
+            m_waitKeyFrame = false;
+            m_queue.push_back(f);
+            queued = true;
+        }
+    }
+    if (queued) {
+        m_queueCv.notify_one();
+        return;
+    }
+    ga_buffer_unref(&f.buf);
+    if (overflow) {
+        ga_logger(Severity::WARNING, LOG_PREFIX "sink is %d frames behind, dropping frames until the next key frame\n",
+            MAX_QUEUED_FRAMES);
+        irrv_set_keyframe();
+    }
+}
+
+void CSendRecvMessage::sender_run() {
+    ga_conf_session_scope scope(m_conf);
+
+    for (;;) {
+        QueuedFrame f;
+        {
+            std::unique_lock<std::mutex> lock(m_queueMutex);
+            m_queueCv.wait(lock, [this]{ return m_senderStop || !m_queue.empty(); });
+            if (m_senderStop)
                 break;
+            f = m_queue.front();
+            m_queue.pop_front();
+        }
+
+        // send frame by webrtc, the sink takes its own reference
+        // to the buffer if it keeps the frame beyond the call
+        ga_packet_t pkt;
+        ga_init_packet(&pkt);
+        pkt.buf  = f.buf;
+        pkt.data = f.buf->data.data();
+        pkt.size = f.size;
+        pkt.flags = f.flags;
+        pkt.pts = 0;
+
+        FrameMetaData* sp = (FrameMetaData*)ga_packet_new_side_data(&pkt, ga_packet_side_data_type::GA_PACKET_DATA_NEW_EXTRADATA, sizeof(FrameMetaData));
+        if (sp) {
+            sp->encode_end_ms   = f.encode_end_ms;
+            sp->encode_start_ms = f.encode_start_ms;
+            sp->last_slice      = true;
+            sp->capture_time_ms = f.encode_start_ms;
+
+            struct timeval pkttv;
+            if (encoder_send_packet("video-encoder", m_channel, &pkt, pkt.pts, &pkttv) < 0) {
+                ga_logger(Severity::ERR, LOG_PREFIX "encoder_send_packet() error!\n");
             }
-            default:
-                ga_logger(Severity::WARNING, LOG_PREFIX "recv_es_stream: unknown event, ev.type = %x\n", ev.type);
-                irrv_sock_client_disconnect();
-                private_pipe_disconnect();
-                m_bUnexpectedDisconnect = true;
-                m_ready = false;
-                break;
+            ga_packet_free_side_data(&pkt);
         }
+        ga_buffer_unref(&f.buf);
     }
 }
-
@@ -18,13 +18,20 @@
 #define CSENDRECVMESSAGE_H
 
 #include <condition_variable>
+#include <deque>
 #include <mutex>
 #include <thread>
 #include <vector>
 
+#include "CIrrvReactor.h"
 #include "sock_client.h"
 #include "irrv/irrv_protocol.h"
 
+struct ga_buffer_s;
+struct ga_buffer_pool_s;
+struct ga_conf_session_s;
+struct ga_ioctl_recvstats_s;
+
 enum nal_unit_type_e
 {
     NAL_UNKNOWN = 0,
@@ -71,10 +78,14 @@ typedef struct AVRoI2 {
 
 const char* irrv_ctrl_type(int type);
 
-class CSendRecvMessage {
+class CSendRecvMessage : public CIrrvReactor::Handler {
 public:
 
-    CSendRecvMessage(bool startEncoderImmediately = false);
+    /**
+     * Receiver of one session. Its packets are sent on \a channel and its
+     * configuration is read from \a conf, or the global one if nullptr.
+     */
+    CSendRecvMessage(bool startEncoderImmediately = false, int channel = 0, struct ga_conf_session_s* conf = nullptr);
     CSendRecvMessage(const CSendRecvMessage&) = delete;
     CSendRecvMessage& operator=(const CSendRecvMessage&) = delete;
 
@@ -82,7 +93,8 @@ public:
 
     /* Control functions */
     /**
-     * Start the process. Throws an exception on failure.
+     * Start receiving on the shared receiver thread and sending to the sink
+     * on a thread of this session. Throws an exception on failure.
      */
     void start();
     /**
@@ -131,11 +143,13 @@ public:
     inline int irrv_set_encodestop()
     { return irrv_op<IRRV_CTRL_STOP>(); }
 
-    // TODO: ICR actually handles ctrl.value somehow passing it to
-    // pipeline components. As of now we use ctrl.value=1, need to
-    // check what the value ultimately is used for.
+    // IDR, for a new subscriber or a reset decoder
     inline int irrv_set_keyframe()
-    { return irrv_op<IRRV_CTRL_KEYFRAME_SETTING>(1); }
+    { return irrv_op<IRRV_CTRL_KEYFRAME_SETTING>(IRRV_KEYFRAME_IDR); }
+
+    // Lost frames, the encoder may answer with an intra refresh wave
+    inline int irrv_request_recovery()
+    { return irrv_op<IRRV_CTRL_KEYFRAME_SETTING>(IRRV_KEYFRAME_RECOVERY); }
 
     inline int irrv_set_bitrate(unsigned int value)
     { return irrv_op<IRRV_CTRL_BITRATE_SETTING>(value); }
@@ -200,10 +214,76 @@ public:
     void pipe_set_resolution_change(uint32_t width, uint32_t height);
 
     void pipe_set_video_alpha(uint32_t action);
-private:
-    void run();
 
-    void recv_es_stream();
+    void get_recv_stats(struct ga_ioctl_recvstats_s* stats);
+private:
+    struct RecvStats {
+        uint64_t frames = 0;
+        uint64_t timeouts = 0;
+        uint64_t reconnects = 0;
+        double   jitter_us = 0;
+        int64_t  last_arrival_us = 0;
+        int64_t  last_interval_us = 0;
+        int64_t  assembly_avg_us = 0;         // of the last complete window
+        int64_t  assembly_max_us = 0;
+        int64_t  window_start_us = 0;
+        uint64_t window_frames = 0;
+        int64_t  window_assembly_us = 0;
+        int64_t  window_assembly_max_us = 0;
+    };
+
+    // Event being received. Its parts are read as they arrive, the
+    // reactor thread never waits for the rest.
+    struct PendingEvent {
+        enum Stage { Header, Body, Payload };
+        Stage stage = Header;
+        irrv_event_t head{};
+        union {
+            irrv_vhead_t  vhead;
+            irrv_vauth_t  vauth;
+            irrv_vframe_t vframe;
+        } body{};
+        struct ga_buffer_s* payload = nullptr;  // frame data, from m_framePool
+        uint8_t* dst = nullptr;                 // where the next bytes go
+        size_t left = 0;                        // bytes missing from the current part
+        int64_t first_byte_us = 0;              // 0 until the event started arriving
+        uint64_t begin_ms = 0;                  // wall clock time of the first byte
+    };
+
+    // Frame received, waiting for the sender thread
+    struct QueuedFrame {
+        struct ga_buffer_s* buf;
+        int size;
+        int flags;
+        uint64_t encode_start_ms;
+        uint64_t encode_end_ms;
+    };
+
+    int fd() override;
+
+    bool want_writable() override;
+
+    void on_readable() override;
+
+    void on_writable() override;
+
+    void on_idle() override;
+
+    void on_connected();
+
+    void expect(PendingEvent::Stage stage, void* dst, size_t size);
+
+    bool on_part_received();
+
+    void on_frame_received();
+
+    void reset_pending();
+
+    void reset_connection();
+
+    void update_recv_stats(int64_t arrival_us, int64_t assembly_us);
+
+    void sender_run();
 
     bool irrv_sock_client_init();
 
@@ -216,15 +296,32 @@ private:
     void private_pipe_disconnect();
 private:
     volatile bool m_ready = false;
-    volatile bool m_stop = false;
-    std::thread m_thread;
+    bool m_started = false;
+    int m_channel = 0;
+    struct ga_conf_session_s* m_conf = nullptr;
     std::mutex m_mutex;
     std::condition_variable m_cv;
-    std::vector<uint8_t> m_frameData;
+    struct ga_buffer_pool_s* m_framePool = nullptr; // frames are received into pooled buffers handed to the sink
     int m_client = -1; // IRRV socket fd
+    bool m_connecting = false; // m_client is not connected yet
+    int64_t m_connectStartMs = 0;
+    int64_t m_nextConnectMs = 0; // no connection attempt before
+    int m_recvTimeoutMs = 0; // deadline for one event, from its first byte
+    PendingEvent m_pending;
+    std::mutex m_statsMutex;
+    RecvStats m_stats;
     FILE* m_encout = nullptr;
     bool  m_bEnableAlphaTransmission;
 
+    // Frames are handed to the sink on the session's own thread, so a slow
+    // sink only delays its own session
+    std::thread m_sender;
+    std::mutex m_queueMutex;
+    std::condition_variable m_queueCv;
+    std::deque<QueuedFrame> m_queue;
+    bool m_senderStop = false;
+    bool m_waitKeyFrame = false; // frames were dropped, drop until the next key frame
+
     unsigned int m_width;
     unsigned int m_height;
     unsigned int m_format;
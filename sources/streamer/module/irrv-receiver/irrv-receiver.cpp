@@ -14,7 +14,10 @@
 //
 // SPDX-License-Identifier: Apache-2.0
 
+#include <map>
 #include <memory>
+#include <mutex>
+#include <vector>
 
 #include <strings.h>
 
@@ -27,51 +30,189 @@
 #define LOG_PREFIX "irrv-receiver: "
 
 namespace {
-    std::unique_ptr<CSendRecvMessage> pCSendRecvMessage;
+    // Sessions served by the process, by channel. Channel 0 is created by
+    // init() from the configuration bound at that time, others are added
+    // with GA_IOCTL_ADD_SESSION.
+    //
+    // Receivers are started, stopped and destroyed without holding the
+    // lock: that waits for their sender threads, which may be in the sink
+    // calling back into ioctl().
+    struct Session {
+        ga_conf_session_t* conf = nullptr;
+        std::shared_ptr<CSendRecvMessage> msg;
+    };
+    std::mutex sessions_mutex;
+    std::map<int, Session> sessions;
+    bool initialized = false;
+    bool started = false;
+
+    std::shared_ptr<CSendRecvMessage> session_get(int channel) {
+        std::lock_guard<std::mutex> lock(sessions_mutex);
+        auto it = sessions.find(channel);
+        return (it == sessions.end())? nullptr: it->second.msg;
+    }
+
+    std::vector<std::shared_ptr<CSendRecvMessage>> session_all() {
+        std::lock_guard<std::mutex> lock(sessions_mutex);
+        std::vector<std::shared_ptr<CSendRecvMessage>> all;
+        for (auto& it : sessions) {
+            if (it.second.msg)
+                all.push_back(it.second.msg);
+        }
+        return all;
+    }
+
+    std::shared_ptr<CSendRecvMessage> session_create(int channel, ga_conf_session_t* conf) {
+        ga_conf_session_scope scope(conf);
+        int icr_start = ga_conf_readint("icr-start-immediately");
+        return std::make_shared<CSendRecvMessage>(icr_start == 1, channel, conf);
+    }
 }
 
 static int irrv_receiver_init(void *arg)
 {
-    int icr_start = ga_conf_readint("icr-start-immediately");
-    try {
-        pCSendRecvMessage = std::make_unique<CSendRecvMessage>(icr_start == 1);
-    } catch(...) {
-        ga_logger(Severity::ERR, LOG_PREFIX "failed to init\n");
-        return 1;
+    std::vector<std::shared_ptr<CSendRecvMessage>> old;
+    int ret = 0;
+    {
+        std::lock_guard<std::mutex> lock(sessions_mutex);
+        if (sessions.find(0) == sessions.end())
+            sessions[0].conf = ga_conf_session_current();
+        try {
+            for (auto& it : sessions) {
+                if (it.second.msg)
+                    old.push_back(std::move(it.second.msg));
+                it.second.msg = session_create(it.first, it.second.conf);
+            }
+            initialized = true;
+            ga_logger(Severity::INFO, LOG_PREFIX "initialized %zu session(s)\n", sessions.size());
+        } catch(...) {
+            ga_logger(Severity::ERR, LOG_PREFIX "failed to init\n");
+            ret = 1;
+        }
     }
-    ga_logger(Severity::INFO, LOG_PREFIX "initialized\n");
-    return 0;
+    for (auto& msg : old)
+        msg->stop();
+    return ret;
 }
 
 static int irrv_receiver_deinit(void *arg)
 {
-    pCSendRecvMessage.reset();
+    std::vector<std::shared_ptr<CSendRecvMessage>> old;
+    {
+        std::lock_guard<std::mutex> lock(sessions_mutex);
+        for (auto& it : sessions) {
+            if (it.second.msg)
+                old.push_back(std::move(it.second.msg));
+        }
+        initialized = false;
+    }
+    // stop first, so the last reference is never dropped on the receiver thread
+    for (auto& msg : old)
+        msg->stop();
     return 0;
 }
 
 static int irrv_receiver_start(void *arg)
 {
     try {
-        pCSendRecvMessage->start();
+        for (auto& msg : session_all())
+            msg->start();
     } catch(...) {
         ga_logger(Severity::ERR, LOG_PREFIX "failed to start\n");
         return 1;
     }
+    {
+        std::lock_guard<std::mutex> lock(sessions_mutex);
+        started = true;
+    }
     ga_logger(Severity::INFO, LOG_PREFIX "all started\n");
     return 0;
 }
 
 static int irrv_receiver_stop(void *arg)
 {
-    pCSendRecvMessage->irrv_set_encodestop();
-    pCSendRecvMessage->stop();
+    {
+        std::lock_guard<std::mutex> lock(sessions_mutex);
+        started = false;
+    }
+    for (auto& msg : session_all()) {
+        msg->irrv_set_encodestop();
+        msg->stop();
+    }
     ga_logger(Severity::INFO, LOG_PREFIX "all stopped\n");
     return 0;
 }
 
-static int irrv_receiver_ioctl(int command, int argsize, void *arg) {
+static int irrv_receiver_add_session(const ga_ioctl_session_t* session)
+{
+    std::shared_ptr<CSendRecvMessage> msg;
+    bool start = false;
+    {
+        std::lock_guard<std::mutex> lock(sessions_mutex);
+        if (sessions.find(session->channel) != sessions.end()) {
+            ga_logger(Severity::ERR, LOG_PREFIX "session on channel %d exists\n", session->channel);
+            return GA_IOCTL_ERR_BADID;
+        }
+        try {
+            if (initialized)
+                msg = session_create(session->channel, session->conf);
+        } catch(...) {
+            ga_logger(Severity::ERR, LOG_PREFIX "failed to add session on channel %d\n", session->channel);
+            return GA_IOCTL_ERR_GENERAL;
+        }
+        sessions[session->channel] = { session->conf, msg };
+        start = started && msg;
+    }
+    if (start) {
+        try {
+            msg->start();
+        } catch(...) {
+            ga_logger(Severity::ERR, LOG_PREFIX "failed to start session on channel %d\n", session->channel);
+        }
+    }
+    ga_logger(Severity::INFO, LOG_PREFIX "session %d added on channel %d\n",
+        ga_conf_session_id(session->conf), session->channel);
+    return GA_IOCTL_ERR_NONE;
+}
+
+static int irrv_receiver_remove_session(const ga_ioctl_session_t* session)
+{
+    std::shared_ptr<CSendRecvMessage> msg;
+    {
+        std::lock_guard<std::mutex> lock(sessions_mutex);
+        auto it = sessions.find(session->channel);
+        if (it == sessions.end())
+            return GA_IOCTL_ERR_BADID;
+        msg = std::move(it->second.msg);
+        sessions.erase(it);
+    }
+    if (msg) {
+        msg->irrv_set_encodestop();
+        msg->stop();
+    }
+    ga_logger(Severity::INFO, LOG_PREFIX "session on channel %d removed\n", session->channel);
+    return GA_IOCTL_ERR_NONE;
+}
+
+static int irrv_receiver_ioctl_channel(int channel, int command, int argsize, void *arg) {
     int ret = 0;
 
+    switch(command) {
+    case GA_IOCTL_ADD_SESSION:
+    case GA_IOCTL_REMOVE_SESSION:
+        if (argsize != sizeof(ga_ioctl_session_t) || !arg)
+            return GA_IOCTL_ERR_INVALID_ARGUMENT;
+        if (command == GA_IOCTL_ADD_SESSION)
+            return irrv_receiver_add_session((ga_ioctl_session_t*)arg);
+        return irrv_receiver_remove_session((ga_ioctl_session_t*)arg);
+    default:
+        break;
+    }
+
+    std::shared_ptr<CSendRecvMessage> pCSendRecvMessage = session_get(channel);
+    if (!pCSendRecvMessage)
+        return GA_IOCTL_ERR_NOTINITIALIZED;
+
     switch(command) {
     case GA_IOCTL_UPDATE_FRAME_STATS:
         ga_logger(Severity::DBG, LOG_PREFIX "GA_IOCTL_UPDATE_FRAME_STATS\n");
@@ -83,7 +224,10 @@ static int irrv_receiver_ioctl(int command, int argsize, void *arg) {
     case GA_IOCTL_REQUEST_KEYFRAME:
         ga_logger(Severity::INFO, LOG_PREFIX "GA_IOCTL_REQUEST_KEYFRAME\n");
         pCSendRecvMessage->irrv_set_encodestart();
-        pCSendRecvMessage->irrv_set_keyframe();
+        if (argsize == sizeof(ga_ioctl_keyframe_t) && arg && ((ga_ioctl_keyframe_t*)arg)->recovery)
+            pCSendRecvMessage->irrv_request_recovery();
+        else
+            pCSendRecvMessage->irrv_set_keyframe();
         break;
     case GA_IOCTL_PAUSE:
         ga_logger(Severity::INFO, LOG_PREFIX "GA_IOCTL_PAUSE\n");
@@ -103,6 +247,13 @@ static int irrv_receiver_ioctl(int command, int argsize, void *arg) {
             pCSendRecvMessage->pipe_set_video_alpha(action);
         }
         break;
+    case GA_IOCTL_GET_RECV_STATS:
+        if (argsize != sizeof(ga_ioctl_recvstats_t) || !arg) {
+            ret = GA_IOCTL_ERR_INVALID_ARGUMENT;
+            break;
+        }
+        pCSendRecvMessage->get_recv_stats((ga_ioctl_recvstats_t*)arg);
+        break;
     default:
         ga_logger(Severity::DBG, LOG_PREFIX "GA_IOCTL_<unknown>: %d\n", command);
         ret = GA_IOCTL_ERR_NOTSUPPORTED;
@@ -112,6 +263,10 @@ static int irrv_receiver_ioctl(int command, int argsize, void *arg) {
     return ret;
 }
 
+static int irrv_receiver_ioctl(int command, int argsize, void *arg) {
+    return irrv_receiver_ioctl_channel(0, command, argsize, arg);
+}
+
 ga_module_t *
 module_load() {
         static ga_module_t m;
@@ -126,5 +281,6 @@ module_load() {
         m.deinit = irrv_receiver_deinit;
         //
         m.ioctl = irrv_receiver_ioctl;
+        m.ioctl_channel = irrv_receiver_ioctl_channel;
         return &m;
 }
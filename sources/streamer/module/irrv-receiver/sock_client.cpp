@@ -72,12 +72,6 @@ int sock_client_init() {
     serv_addr_in.sin_family = AF_INET;
     serv_addr_in.sin_port   = htons(icr_port);
     inet_pton(AF_INET, icr_ip.c_str(), &serv_addr_in.sin_addr);
-    int ret = connect(fd, (struct sockaddr *)&serv_addr_in, sizeof(struct sockaddr_in));
-    if (ret < 0) {
-        ga_logger(Severity::ERR, LOG_PREFIX "failed to connect\n");
-        close(fd);
-        return -1;
-    }
 
     int flag = 1;
     if (ioctl(fd, FIONBIO, &flag) < 0) {
@@ -86,10 +80,30 @@ int sock_client_init() {
         return -1;
     }
 
-    ga_logger(Severity::INFO, LOG_PREFIX "initializing %s:%d: SUCCESS\n)", icr_ip.c_str(), icr_port);
+    int ret = connect(fd, (struct sockaddr *)&serv_addr_in, sizeof(struct sockaddr_in));
+    if (ret < 0 && errno != EINPROGRESS) {
+        ga_logger(Severity::ERR, LOG_PREFIX "failed to connect: %s\n", strerror(errno));
+        close(fd);
+        return -1;
+    }
+
+    ga_logger(Severity::INFO, LOG_PREFIX "initializing %s:%d: %s\n", icr_ip.c_str(), icr_port,
+        (ret < 0)? "connecting": "SUCCESS");
     return fd;
 }
 
+int sock_client_connect_result(int fd) {
+    int err = 0;
+    socklen_t len = sizeof(err);
+    if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len) < 0)
+        return -1;
+    if (err) {
+        errno = err;
+        return -1;
+    }
+    return 0;
+}
+
 sock_conn_status_t sock_client_check_connect(int fd, int timeout_ms) {
     sock_conn_status_t result = normal;
     int nsel                  = 0;
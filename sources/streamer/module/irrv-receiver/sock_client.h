@@ -25,8 +25,17 @@ extern "C" {
 
 #define SOCK_BUFFER_SIZE   (2 * 1024 * 1024)
 
+    /*
+     * Start connecting to the ICR configured for the calling thread's
+     * session. Returns a non-blocking socket, possibly still connecting,
+     * or -1 on error. Completion is reported by the socket becoming
+     * writable, sock_client_connect_result() tells the outcome.
+     */
     int sock_client_init();
 
+    /* 0 once connected, -1 with errno set if the connection failed */
+    int sock_client_connect_result(int fd);
+
     sock_conn_status_t sock_client_check_connect(int fd, int timeout_ms);
 
     int sock_client_send(int fd, const void* data, size_t datalen);
@@ -72,8 +72,9 @@ AudioPlayer::AudioPlayer(int instance_id, CommandHandler CmdHandler)
         }
     };
     int user_id = -1;
-    if (ga_conf_readbool("enable-multi-user", 0) != 0) {
-        user_id = ga_conf_readint("user");
+    auto conf = ga_conf_snapshot();
+    if (conf->enable_multi_user) {
+        user_id = conf->user;
     }
     audio_sink = std::make_unique<vhal::client::audio::AudioSink>(conn_info, callback, user_id);
 }
@@ -39,7 +39,8 @@ std::vector<vhal::client::VideoSink::camera_info_t>
 CameraClientHandler::processClientCameraMsg(const std::string &json_message)
 {
   // camera_info would come irrespective of get-hw-capability value.
-  bool get_hw_capability = ga_conf_readbool("get-hw-capability", 1);
+  auto conf = ga_conf_snapshot();
+  bool get_hw_capability = conf->get_hw_capability;
   int numOfCamerasRequested = 0;
 
   json j = json::parse(json_message);
@@ -56,7 +57,7 @@ CameraClientHandler::processClientCameraMsg(const std::string &json_message)
     // real client camera capability to do customizations in the camera info.
     ga_logger(Severity::WARNING, TAG "Enabled debugging option, "
               "hence read from camera configuration file camera.conf\n");
-    numOfCamerasRequested = ga_conf_readint("number-of-cameras-supported");
+    numOfCamerasRequested = conf->number_of_cameras_supported;
   }
 
   if (numOfCamerasRequested == 0) {
@@ -97,7 +98,7 @@ CameraClientHandler::processClientCameraMsg(const std::string &json_message)
     camera_id = camera_info[i].cameraId = i;
 
     // Set codec type of the camera input that needs to be used for camera frame compression.
-    codec_type = ga_conf_readstr("video-codec");
+    codec_type = conf->video_codec;
     if (ga_is_h265(codec_type)) {
       camera_info[i].codec_type = vhal::client::VideoSink::VideoCodecType::kH265;
       ga_logger(Severity::INFO, "selected H265 codec\n");
@@ -60,8 +60,9 @@ void CommandChannelHandler::processClientMsg(const std::string &json_message) co
   if (event_param["pkg"].is_string()) {
     std::string pkg = event_param["pkg"];
     if (!pkg.empty()) {
-      if (ga_conf_readbool("enable-multi-user", 0) != 0) {
-        int userId = ga_conf_readint("user");
+      auto conf = ga_conf_snapshot();
+      if (conf->enable_multi_user) {
+        int userId = conf->user;
         Send(MsgType::kActivityMonitor, "0:" + pkg + ":" + std::to_string(userId));
       } else {
         Send(MsgType::kActivityMonitor, "0:" + pkg);
@@ -46,8 +46,9 @@ public:
     EncodedVideoDispatcher(int instance_id, CommandHandler cmd_handler)
       : mCmdHandler(std::move(cmd_handler))
     {
-        std::string socket_dir = ga_conf_readstr("aic-workdir");
-        if (ga_conf_readbool("k8s", 0) == 0) {
+        auto conf = ga_conf_snapshot();
+        std::string socket_dir = conf->aic_workdir;
+        if (!conf->k8s) {
             socket_dir += "/ipc";
         }
         ga_logger(Severity::INFO, "[video_capture] VideoSink socketDir:%s instance#%d\n",
@@ -80,8 +81,8 @@ public:
             }
         };
         int user_id = -1;
-        if (ga_conf_readbool("enable-multi-user", 0) != 0) {
-            user_id = ga_conf_readint("user");
+        if (conf->enable_multi_user) {
+            user_id = conf->user;
         }
         video_sink_ = std::make_shared<vhal::client::VideoSink>(conn_info, callback, user_id);
         camera_client_handler_ = std::make_shared<CameraClientHandler>(video_sink_);
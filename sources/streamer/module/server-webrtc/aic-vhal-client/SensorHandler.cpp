@@ -39,9 +39,10 @@ SensorHandler::SensorHandler(int instanceId, CommandHandler cmdHandler)
 {
     mInstanceId = instanceId;
     mCmdHandler = std::move(cmdHandler);
-    std::string socketDir = ga_conf_readstr("aic-workdir");
+    auto conf = ga_conf_snapshot();
+    std::string socketDir = conf->aic_workdir;
 
-    if (ga_conf_readbool("k8s", 0) == 0) {
+    if (!conf->k8s) {
         socketDir += "/ipc"; // Docker environment
     }
 
@@ -51,16 +52,16 @@ SensorHandler::SensorHandler(int instanceId, CommandHandler cmdHandler)
         processVHALCtrlMsg(ctrlPkt);
     };
 
-    int width = ga_conf_readint("video-res-width");
-    int height = ga_conf_readint("video-res-height");
+    int width = conf->video_res_width;
+    int height = conf->video_res_height;
     if (width < height) {
         mOrientation = portraitOrientation;
     } else {
         mOrientation = landscapeOrientation;
     }
     int32_t userId = -1;
-    if (ga_conf_readbool("enable-multi-user", 0) != 0) {
-        userId = ga_conf_readint("user");
+    if (conf->enable_multi_user) {
+        userId = conf->user;
     }
     sensorHALIface = std::make_unique<SensorInterface>(conn_info, callback, userId);
 }
@@ -23,10 +23,11 @@ namespace android {
 static inline std::string ip()
 {
   std::string address;
-  if (ga_conf_readbool("k8s", 0) == 1) {
+  auto conf = ga_conf_snapshot();
+  if (conf->k8s) {
     address = "127.0.0.1";
   } else {
-    int session = ga_conf_readint("android-session");
+    int session = conf->android_session;
     if (session < 0)
       session = 0;
     address = "172.100." +
@@ -17,6 +17,7 @@
 #include <iostream>
 #include <iomanip>
 #include <cstring>
+#include <algorithm>
 
 #include "android-common.h"
 #include "android_audio_core.h"
@@ -45,26 +46,23 @@ AudioFrameGenerator::AudioFrameGenerator(int instanceId, CommandHandler cmd_hand
                 "sample_rate:%u | buffer_size:%d\n",
                 ctrl_msg.asci.channel_count, ctrl_msg.asci.format, ctrl_msg.asci.frame_count,
                 ctrl_msg.asci.sample_rate, mRecBufLen10ms);
-            for (int i = 0; i < MAX_QUEUE_SIZE; i++) {
-                if (mBufferPool[i]) {
-                    delete[] mBufferPool[i];
-                    mBufferPool[i] = nullptr;
+            {// Scope for the ring reconfiguration with mRingMutex
+                std::lock_guard<std::mutex> lock(mRingMutex);
+                if (mSockBuffer) {
+                    delete[] mSockBuffer;
+                    mSockBuffer = nullptr;
                 }
-            }
-
-            if (mSockBuffer) {
-                delete[] mSockBuffer;
-                mSockBuffer = nullptr;
-            }
-            if (mRecBufLen10ms > 0) {
-                for (int i = 0; i < MAX_QUEUE_SIZE; i++) {
-                    mBufferPool[i] = new uint8_t[mRecBufLen10ms];
+                if (mRecBufLen10ms > 0) {
+                    mRing.Configure(mRecBufLen10ms, mRingDepth);
+                    mSockBuffer = new uint8_t[mRecBufLen10ms];
+                } else {
+                    mRing.Configure(0, 0);
+                    ga_logger(Severity::ERR, TAG "Audio buffer length(%d) is incorrect\n",
+                    mRecBufLen10ms);
+                    break;
                 }
-                mSockBuffer = new uint8_t[mRecBufLen10ms];
-            } else {
-                ga_logger(Severity::ERR, TAG "Audio buffer length(%d) is incorrect\n",
-                mRecBufLen10ms);
-                break;
+                mOverrun = false;
+                mReportedOverruns = mReportedUnderruns = 0;
             }
             break;
         case vhal::client::audio::Command::kClose:
@@ -81,24 +79,17 @@ AudioFrameGenerator::AudioFrameGenerator(int instanceId, CommandHandler cmd_hand
                 else {
                     ga_logger(Severity::DBG, TAG "ReadDataPacket() success, read: %lu\n", read);
                 }
-                {// Scope for mBufferIdsQ access with mBufferMutex
-                    std::unique_lock<std::mutex> lock(mBufferMutex);
-                    if (mBufferIdsQ.size() == MAX_QUEUE_SIZE){
-                        if (!mBufferFull) {
-                            ga_logger(Severity::WARNING, TAG "Buffer Queue Full, Skip until available\n");
-                            mBufferFull = true;
-                        }
-                        break;
-                    }
-                    if (mBufferFull) {
-                        ga_logger(Severity::INFO, TAG "Buffer Queue available\n");
-                        mBufferFull = false;
+                // Never waits for the pull, a full ring drops the frame
+                if (!mRing.Push(mSockBuffer)) {
+                    if (!mOverrun) {
+                        ga_logger(Severity::WARNING, TAG "Audio ring full, skip until available\n");
+                        mOverrun = true;
                     }
-                    auto* buffer = mBufferPool[mBufferIdToPush];
-                    memcpy(buffer, mSockBuffer, mRecBufLen10ms);
-                    mBufferIdsQ.push(mBufferIdToPush);
-                    mBufferIdToPush = (mBufferIdToPush + 1) % MAX_QUEUE_SIZE;
+                } else if (mOverrun) {
+                    ga_logger(Severity::INFO, TAG "Audio ring available\n");
+                    mOverrun = false;
                 }
+                ReportRing();
             } else {
                 ga_logger(Severity::ERR, TAG "Audio data size %d is incorrect\n",
                   ctrl_msg.data_size);
@@ -120,20 +111,17 @@ AudioFrameGenerator::AudioFrameGenerator(int instanceId, CommandHandler cmd_hand
         }
     };
     int user_id = -1;
-    if (ga_conf_readbool("enable-multi-user", 0) != 0) {
-        user_id = ga_conf_readint("user");
+    auto conf = ga_conf_snapshot();
+    mRingDepth = std::max(1, conf->audio_ring_depth);
+    mReportTime = std::chrono::steady_clock::now();
+    if (conf->enable_multi_user) {
+        user_id = conf->user;
     }
     audio_source = std::make_unique<vhal::client::audio::AudioSource>(conn_info, callback, user_id);
 }
 
 AudioFrameGenerator::~AudioFrameGenerator() {
     std::unique_lock<std::mutex> lock(mMutex);
-    for (int i = 0; i < MAX_QUEUE_SIZE; i++) {
-        if (mBufferPool[i]) {
-            delete[] mBufferPool[i];
-            mBufferPool[i] = nullptr;
-        }
-    }
     if (mSockBuffer) {
         delete[] mSockBuffer;
     }
@@ -141,17 +129,16 @@ AudioFrameGenerator::~AudioFrameGenerator() {
 
 uint32_t AudioFrameGenerator::GenerateFramesForNext10Ms(uint8_t *frame_buffer,
                                                         const uint32_t capacity) {
-    if (capacity < (uint32_t)mRecBufLen10ms) {
-        ga_logger(Severity::ERR, TAG " audio: the capacity is too small\n");
-        return 0;
-    }
-    {// Scope for mBufferIdsQ access with mBufferMutex
-        std::unique_lock<std::mutex> lock(mBufferMutex);
-        if ((mBufferIdsQ.size() > 0) && (mRecBufLen10ms > 0)) {
-            auto* buffer = mBufferPool[mBufferIdsQ.front()];
-            mBufferIdsQ.pop();
-            memcpy(frame_buffer, buffer, mRecBufLen10ms);
-            return mRecBufLen10ms;
+    {// Scope for mRing access, skipped while it is reconfigured
+        std::unique_lock<std::mutex> lock(mRingMutex, std::try_to_lock);
+        if (lock.owns_lock() && mRing.FrameSize() > 0) {
+            if (capacity < mRing.FrameSize()) {
+                ga_logger(Severity::ERR, TAG " audio: the capacity is too small\n");
+                return 0;
+            }
+            // An underrun is only counted while the stream plays
+            if (!(mVhalStreamStopped && mRing.Empty()) && mRing.Pop(frame_buffer))
+                return mRing.FrameSize();
         }
     }
     if (mVhalStreamStopped) {
@@ -161,6 +148,21 @@ uint32_t AudioFrameGenerator::GenerateFramesForNext10Ms(uint8_t *frame_buffer,
     return 0;
 }
 
+void AudioFrameGenerator::ReportRing() {
+    auto now = std::chrono::steady_clock::now();
+    if (now - mReportTime < std::chrono::seconds(10))
+        return;
+    mReportTime = now;
+    uint64_t overruns = mRing.Overruns(), underruns = mRing.Underruns();
+    if (overruns != mReportedOverruns || underruns != mReportedUnderruns) {
+        ga_logger(Severity::INFO, TAG "audio ring: depth %zu, %llu frames, %llu overruns, %llu underruns\n",
+                  mRing.Depth(), (unsigned long long)mRing.Pushed(),
+                  (unsigned long long)overruns, (unsigned long long)underruns);
+        mReportedOverruns = overruns;
+        mReportedUnderruns = underruns;
+    }
+}
+
 int AudioFrameGenerator::GetSampleRate() {
     ga_logger(Severity::DBG, TAG " audio: sample_rate=%d\n", mSampleRate);
     return mSampleRate;
@@ -17,12 +17,13 @@
 #ifndef AUDIO_FRAME_GENERATOR_H
 #define AUDIO_FRAME_GENERATOR_H
 
+#include <atomic>
+#include <chrono>
 #include <mutex>
 #include <fstream>
-#include <queue>
 #include "owt/base/framegeneratorinterface.h"
 #include "audio_source.h"
-#define MAX_QUEUE_SIZE 3
+#include "ga-audio-ring.h"
 
 using CommandHandler = std::function<void(uint32_t cmd)>;
 
@@ -47,14 +48,20 @@ protected:
     int mChannelNumber = 2;
     int mSampleRate = 48000;
     int mRecBufLen10ms = 1920;
-    uint8_t* mBufferPool[MAX_QUEUE_SIZE] = { nullptr };
-    std::queue<int> mBufferIdsQ;
-    int mBufferIdToPush = 0;
     uint8_t* mSockBuffer = nullptr;
-    std::mutex mBufferMutex;
+    // 10 ms frames from the socket reader to the WebRTC audio pull
+    ga::webrtc::AudioRing mRing;
+    size_t mRingDepth = 3;
+    // Held while the ring is reconfigured, the pull only tries it
+    std::mutex mRingMutex;
     std::mutex mMutex;
     //This variable keeps track if the audio stream from the vHAL is in standby mode.
-    bool mVhalStreamStopped = true;
-    bool mBufferFull = false;
+    std::atomic<bool> mVhalStreamStopped{true};
+    bool mOverrun = false;
+    std::chrono::steady_clock::time_point mReportTime;
+    uint64_t mReportedOverruns = 0;
+    uint64_t mReportedUnderruns = 0;
+
+    void ReportRing();
 };
 #endif // AUDIO_FRAME_GENERATOR_H
@@ -0,0 +1,74 @@
+// Copyright (C) 2023 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions
+// and limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "ga-audio-ring.h"
+
+#include <string.h>
+
+namespace ga {
+namespace webrtc {
+
+bool AudioRing::Configure(size_t frame_size, size_t depth) {
+  buffer_.reset();
+  storage_    = nullptr;
+  frame_size_ = slot_size_ = depth_ = 0;
+  head_       = tail_ = 0;
+  tail_cache_ = head_cache_ = 0;
+  pushed_     = popped_ = overruns_ = underruns_ = 0;
+  if (frame_size == 0 || depth == 0)
+    return false;
+
+  slot_size_ = (frame_size + kCacheLine - 1) / kCacheLine * kCacheLine;
+  buffer_.reset(new uint8_t[slot_size_ * depth + kCacheLine - 1]);
+  uintptr_t p = reinterpret_cast<uintptr_t>(buffer_.get());
+  storage_    = buffer_.get() + (kCacheLine - p % kCacheLine) % kCacheLine;
+  frame_size_ = frame_size;
+  depth_      = depth;
+  return true;
+}
+
+bool AudioRing::Push(const uint8_t *frame) {
+  uint64_t head = head_.load(std::memory_order_relaxed);
+  if (head - tail_cache_ >= depth_) {
+    tail_cache_ = tail_.load(std::memory_order_acquire);
+    if (head - tail_cache_ >= depth_) {
+      Count(overruns_);
+      return false;
+    }
+  }
+  memcpy(Slot(head), frame, frame_size_);
+  head_.store(head + 1, std::memory_order_release);
+  Count(pushed_);
+  return true;
+}
+
+bool AudioRing::Pop(uint8_t *frame) {
+  uint64_t tail = tail_.load(std::memory_order_relaxed);
+  if (tail == head_cache_) {
+    head_cache_ = head_.load(std::memory_order_acquire);
+    if (tail == head_cache_) {
+      Count(underruns_);
+      return false;
+    }
+  }
+  memcpy(frame, Slot(tail), frame_size_);
+  tail_.store(tail + 1, std::memory_order_release);
+  Count(popped_);
+  return true;
+}
+
+} // namespace webrtc
+} // namespace ga
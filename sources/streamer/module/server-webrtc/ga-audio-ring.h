@@ -0,0 +1,99 @@
+// Copyright (C) 2023 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions
+// and limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <memory>
+
+namespace ga {
+namespace webrtc {
+
+/// Single producer, single consumer ring of fixed size audio frames.
+///
+/// Frames are copied in and out of preallocated slots. Push() and Pop()
+/// never block nor allocate: a push into a full ring drops the frame and
+/// counts an overrun, a pop from an empty ring counts an underrun. The
+/// indices of each side live on their own cache line.
+///
+/// Configure() reallocates the slots and must not run concurrently with
+/// Push() or Pop().
+class AudioRing {
+public:
+  static constexpr size_t kCacheLine = 64;
+
+  AudioRing() = default;
+  ~AudioRing() = default;
+
+  AudioRing(const AudioRing&) = delete;
+  AudioRing& operator=(const AudioRing&) = delete;
+
+  /// Allocates |depth| slots of |frame_size| bytes, drops queued frames
+  /// and clears the counters. Returns false if either is 0.
+  bool Configure(size_t frame_size, size_t depth);
+
+  /// Producer side. Copies |frame_size| bytes of |frame|.
+  bool Push(const uint8_t *frame);
+  /// Consumer side. Copies |frame_size| bytes to |frame|.
+  bool Pop(uint8_t *frame);
+
+  size_t FrameSize() const { return frame_size_; }
+  size_t Depth() const { return depth_; }
+  /// Frames queued, exact from either side
+  size_t Size() const {
+    return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire);
+  }
+  bool Empty() const { return Size() == 0; }
+
+  uint64_t Pushed() const { return pushed_.load(std::memory_order_relaxed); }
+  uint64_t Popped() const { return popped_.load(std::memory_order_relaxed); }
+  uint64_t Overruns() const { return overruns_.load(std::memory_order_relaxed); }
+  uint64_t Underruns() const { return underruns_.load(std::memory_order_relaxed); }
+
+private:
+  // Counters have a single writer, no read-modify-write needed
+  static void Count(std::atomic<uint64_t> &counter) {
+    counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  }
+
+  uint8_t *Slot(uint64_t index) const {
+    return storage_ + (index % depth_) * slot_size_;
+  }
+
+  std::unique_ptr<uint8_t[]> buffer_;
+  uint8_t *storage_  = nullptr;  // slots, cache line aligned in buffer_
+  size_t frame_size_ = 0;
+  size_t slot_size_  = 0;  // frame size rounded up to a cache line
+  size_t depth_      = 0;
+
+  // Written by the producer
+  alignas(kCacheLine) std::atomic<uint64_t> head_{0};
+  uint64_t tail_cache_ = 0;  // last tail seen by the producer
+  std::atomic<uint64_t> pushed_{0};
+  std::atomic<uint64_t> overruns_{0};
+
+  // Written by the consumer
+  alignas(kCacheLine) std::atomic<uint64_t> tail_{0};
+  uint64_t head_cache_ = 0;  // last head seen by the consumer
+  std::atomic<uint64_t> popped_{0};
+  std::atomic<uint64_t> underruns_{0};
+};
+
+} // namespace webrtc
+} // namespace ga
@@ -0,0 +1,181 @@
+// Copyright (C) 2023 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions
+// and limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "ga-control-record.h"
+
+namespace ga {
+namespace webrtc {
+
+namespace {
+
+// Value of a base64 character, -1 if not one
+int Base64Value(char c) {
+  if (c >= 'A' && c <= 'Z') return c - 'A';
+  if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+  if (c >= '0' && c <= '9') return c - '0' + 52;
+  if (c == '+') return 62;
+  if (c == '/') return 63;
+  return -1;
+}
+
+// Decode base64 with optional padding. Returns the decoded size, or -1 if
+// the input is not canonical base64 or does not fit |out|.
+int Base64Decode(const char *in, size_t in_size, uint8_t *out, size_t out_size) {
+  size_t padding = 0;
+  while (in_size > 0 && in[in_size - 1] == '=') {
+    in_size--;
+    padding++;
+  }
+  // Padding only completes the last group
+  if (padding > 0 && (padding > 2 || (in_size + padding) % 4 != 0))
+    return -1;
+  if (in_size % 4 == 1 || in_size / 4 * 3 + (in_size % 4 ? in_size % 4 - 1 : 0) > out_size)
+    return -1;
+
+  size_t n = 0;
+  uint32_t acc = 0;
+  int bits = 0;
+  for (size_t i = 0; i < in_size; i++) {
+    int v = Base64Value(in[i]);
+    if (v < 0)
+      return -1;
+    acc = (acc << 6) | (uint32_t)v;
+    bits += 6;
+    if (bits >= 8) {
+      bits -= 8;
+      out[n++] = (uint8_t)(acc >> bits);
+    }
+  }
+  // Bits left over from the last character must be zero
+  if (acc & ((1u << bits) - 1))
+    return -1;
+  return (int)n;
+}
+
+uint32_t ReadU32(const uint8_t *p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+uint64_t ReadU64(const uint8_t *p) {
+  return (uint64_t)ReadU32(p) | ((uint64_t)ReadU32(p + 4) << 32);
+}
+
+void WriteU64(uint8_t *p, uint64_t v) {
+  for (int i = 0; i < 8; i++)
+    p[i] = (uint8_t)(v >> (8 * i));
+}
+
+} // namespace
+
+bool ParseControlRecord(const std::string &message, ControlRecord *record) {
+  if (!IsControlRecord(message))
+    return false;
+  int size = Base64Decode(message.data() + 1, message.size() - 1,
+                          record->buffer, sizeof(record->buffer));
+  if (size < 2)
+    return false;
+
+  const uint8_t *p   = record->buffer;
+  const uint8_t *end = p + size;
+  record->type       = p[0];
+  record->flags      = p[1];
+  record->latency_ms = 0;
+  record->data       = nullptr;
+  record->data_size  = 0;
+  p += 2;
+
+  size_t fixed = 0;
+  switch (record->type) {
+  case kRecordFrameStats: fixed = 20; break;
+  case kRecordMouseMove:  fixed = 8;  break;
+  case kRecordMouseDown:
+  case kRecordMouseUp:    fixed = 9;  break;
+  case kRecordKeyDown:
+  case kRecordKeyUp:      fixed = 4;  break;
+  case kRecordTouch:
+  case kRecordJoystick:   fixed = 1;  break;
+  default:
+    return false;
+  }
+  if (record->HasLatency())
+    fixed += 8;
+  if ((size_t)(end - p) < fixed)
+    return false;
+
+  switch (record->type) {
+  case kRecordFrameStats:
+    record->framestats.ts          = (int32_t)ReadU32(p);
+    record->framestats.size        = (int32_t)ReadU32(p + 4);
+    record->framestats.delay       = (int32_t)ReadU32(p + 8);
+    record->framestats.start_delay = (int32_t)ReadU32(p + 12);
+    record->framestats.packet_loss = (int32_t)ReadU32(p + 16);
+    p += 20;
+    break;
+  case kRecordMouseMove:
+    record->mouse.x     = (int32_t)ReadU32(p);
+    record->mouse.y     = (int32_t)ReadU32(p + 4);
+    record->mouse.which = 0;
+    p += 8;
+    break;
+  case kRecordMouseDown:
+  case kRecordMouseUp:
+    record->mouse.x     = (int32_t)ReadU32(p);
+    record->mouse.y     = (int32_t)ReadU32(p + 4);
+    record->mouse.which = p[8];
+    p += 9;
+    break;
+  case kRecordKeyDown:
+  case kRecordKeyUp:
+    record->key.which = ReadU32(p);
+    p += 4;
+    break;
+  case kRecordTouch:
+  case kRecordJoystick:
+    record->input.id = p[0];
+    p += 1;
+    break;
+  }
+  if (record->HasLatency()) {
+    record->latency_ms = ReadU64(p);
+    p += 8;
+  }
+  // Touch and joystick commands take the rest of the record
+  if (record->type == kRecordTouch || record->type == kRecordJoystick) {
+    record->data      = reinterpret_cast<const char *>(p);
+    record->data_size = end - p;
+  } else if (p != end) {
+    return false;
+  }
+  return true;
+}
+
+size_t WriteLatencyRecord(const LatencyRecord &latency, uint8_t *out, size_t size) {
+  size_t needed = latency.has_client ? kLatencyRecordMaxSize : 10;
+  if (size < needed)
+    return 0;
+  out[0] = kRecordLatency;
+  out[1] = latency.has_client ? kRecordHasClient : 0;
+  WriteU64(out + 2, latency.encode_time_ms);
+  if (latency.has_client) {
+    WriteU64(out + 10, latency.client_send_time_ms);
+    WriteU64(out + 18, latency.server_received_time_ms);
+    WriteU64(out + 26, latency.server_render_time_ms);
+  }
+  return needed;
+}
+
+} // namespace webrtc
+} // namespace ga
@@ -0,0 +1,110 @@
+// Copyright (C) 2023 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions
+// and limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+namespace ga {
+namespace webrtc {
+
+/// Compact encoding of the control messages sent at frame or input rate,
+/// see "Compact Control Records" in doc/control_protocol_spec.rst.
+///
+/// A record is a type byte, a flags byte and fixed little-endian fields.
+/// The data channel carries text only, so there a record is sent as
+/// kControlRecordTag followed by its base64. Frame side data carries the
+/// record bytes as they are.
+enum ControlRecordType : uint8_t {
+  kRecordFrameStats = 1,
+  kRecordMouseMove  = 2,
+  kRecordMouseDown  = 3,
+  kRecordMouseUp    = 4,
+  kRecordKeyDown    = 5,
+  kRecordKeyUp      = 6,
+  kRecordTouch      = 7,
+  kRecordJoystick   = 8,
+  kRecordLatency    = 16,  // E2E latency frame side data
+};
+
+enum ControlRecordFlags : uint8_t {
+  kRecordHasLatency = 0x01,  // E2ELatency follows the fixed fields
+  kRecordHasClient  = 0x02,  // latency record carries the client timings
+};
+
+constexpr char   kControlRecordTag     = '!';
+constexpr int    kControlRecordVersion = 1;
+constexpr size_t kControlRecordMaxSize = 1024;  // decoded bytes
+constexpr size_t kLatencyRecordMaxSize = 34;
+
+/// One decoded record. Parsing does not allocate: command strings of touch
+/// and joystick records point into |buffer|.
+struct ControlRecord {
+  uint8_t  type  = 0;
+  uint8_t  flags = 0;
+  union {
+    struct {
+      int32_t ts;
+      int32_t size;
+      int32_t delay;
+      int32_t start_delay;
+      int32_t packet_loss;
+    } framestats;
+    struct {
+      int32_t x;
+      int32_t y;
+      uint8_t which;
+    } mouse;
+    struct {
+      uint32_t which;
+    } key;
+    struct {
+      uint8_t id;  // tID of touch, jID of joystick
+    } input;
+  };
+  uint64_t    latency_ms = 0;  // E2ELatency, valid with kRecordHasLatency
+  const char *data       = nullptr;
+  size_t      data_size  = 0;
+  uint8_t     buffer[kControlRecordMaxSize];
+
+  bool HasLatency() const { return (flags & kRecordHasLatency) != 0; }
+};
+
+/// Timings of the E2E latency side data, JSON keys in comments.
+struct LatencyRecord {
+  uint64_t encode_time_ms          = 0;  // serverEncodeFrameTime
+  bool     has_client              = false;
+  uint64_t client_send_time_ms     = 0;  // clientSendLatencyTime
+  uint64_t server_received_time_ms = 0;  // serverReceivedLatencyTime
+  uint64_t server_render_time_ms   = 0;  // serverRenderClientInputTime
+};
+
+inline bool IsControlRecord(const std::string &message) {
+  return !message.empty() && message[0] == kControlRecordTag;
+}
+
+/// Decode a tagged data channel message. Returns false if the message is
+/// malformed or of an unknown type.
+bool ParseControlRecord(const std::string &message, ControlRecord *record);
+
+/// Write a latency record to |out|. Returns the record size, 0 if |size| is
+/// too small.
+size_t WriteLatencyRecord(const LatencyRecord &latency, uint8_t *out, size_t size);
+
+} // namespace webrtc
+} // namespace ga
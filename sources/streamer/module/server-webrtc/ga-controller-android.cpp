@@ -29,14 +29,15 @@ ga::webrtc::AndroidController::AndroidController(
       game_height_(game_height),
       video_width_(video_width),
       video_height_(video_height) {
-  int session = ga_conf_readint("android-session");
+  auto conf = ga_conf_snapshot();
+  int session = conf->android_session;
   if (session < 0)
     session = 0;
 
   std::string prefix_socket;
   std::string prefix_status;
   vhal::client::UnixConnectionInfo uci;
-  int virtualInputNum = ga_conf_readint("virtual-input-num");
+  int virtualInputNum = conf->virtual_input_num;
   if (virtualInputNum < 1){
     virtualInputNum = 1;
   }
@@ -45,17 +46,17 @@ ga::webrtc::AndroidController::AndroidController(
   }
   if (inputDev.empty()){
     std::unique_ptr<vhal::client::VirtualInputReceiver> tempVirtualInputReceiver = nullptr;
-    prefix_socket = ga_conf_readstr("aic-workdir");
-    prefix_status = ga_conf_readstr("aic-workdir");
-    if (ga_conf_readbool("k8s", 0) == 1) {
+    prefix_socket = conf->aic_workdir;
+    prefix_status = conf->aic_workdir;
+    if (conf->k8s) {
       prefix_socket += std::string("/input-pipe");
       prefix_status += std::string("/.input-status");
     } else {
       prefix_socket += "/ipc/input-pipe" + std::to_string(session);
       prefix_status += "/ipc/.input-status" + std::to_string(session);
     }
-    if (ga_conf_readbool("enable-multi-user", 0) != 0) {
-      int userId = ga_conf_readint("user");
+    if (conf->enable_multi_user) {
+      int userId = conf->user;
       prefix_socket += "-";
       prefix_socket += std::to_string(userId);
       prefix_status += "-" + std::to_string(userId);
@@ -69,6 +70,23 @@ ga::webrtc::AndroidController::AndroidController(
     }
   }
 
+  // Moves are written as they come unless coalescing is configured,
+  // a negative window coalesces over one display frame.
+  int window_ms = conf->input_coalesce_ms;
+  if (window_ms < 0) {
+    int fps = conf->video_fps > 0 ? conf->video_fps : 60;
+    window_ms = 1000 / fps;
+  }
+  ga_logger(Severity::INFO, "input coalescing window: %d ms\n", window_ms);
+  batcher_ = std::make_unique<InputBatcher>(inputDev.size(), window_ms,
+    [this](size_t device, const std::string &commands) {
+      ssize_t sts = 0;
+      std::string err;
+      std::tie(sts, err) = inputDev[device]->onInputMessage(commands);
+      if (sts < 0)
+        ga_logger(Severity::ERR, "Failed to pass input message: %s\n", err.c_str());
+    });
+
   if (getenv("OLD_INPUT_PROTOCOL")) {
     ga_logger(Severity::WARNING, "old input device protocol in use!\n");
     abs_gameWidth = 1920;
@@ -100,111 +118,143 @@ void ga::webrtc::AndroidController::PushClientEvent(const std::string &json_mess
   std::string event_type = j["data"]["event"];
   if (event_type == "mousemove") {
     json event_param = j["data"]["parameters"];
-    int32_t x = event_param["x"];
-    int32_t y = event_param["y"];
-    ga_logger(Severity::DBG, "mousemove: x=%d, y=%d\n", x, y);
-
-    if (is_mouse)
-    {
-        abs_x += x;
-        abs_y += y;
-        if (abs_x < 0) abs_x = 0;
-        if (abs_y < 0) abs_y = 0;
-        if (abs_x > abs_gameWidth) abs_x = abs_gameWidth;
-        if (abs_y > abs_gameHeight) abs_y = abs_gameHeight;
-    }
-    else
-    {
-        abs_x = x;
-        abs_y = y;
-    }
-
-    if (is_pressed)
-    {
-        char cmd[512];
-        sprintf(cmd, "m 0 %d %d 255\n",  game_offset_x + TranslateX(), game_offset_y + TranslateY());
-        inputDev[0]->onInputMessage(cmd);
-        inputDev[0]->onInputMessage("c\n");
-    }
+    MouseMove(event_param["x"], event_param["y"]);
   } else if (event_type == "mousedown") {
     // Mouse click.
-    // sdlmsg_t m;
     json event_param = j["data"]["parameters"];
     if(event_param.size() < 3)
       return;
-    int32_t x = event_param["x"];
-    int32_t y = event_param["y"];
-    ga_logger(Severity::DBG, "mousedown: x=%d, y=%d\n", x, y);
-
-    if (x > 4 || y > 4)
-    {
-        is_mouse = false;
-    }
-    else
-    {
-        is_mouse = true;
-    }
-
-    if (!is_mouse)
-    {
-        abs_x = x;
-        abs_y = y;
-    }
-
-    is_pressed = true;
-
-    char cmd[512];
-
-    sprintf(cmd, "d 0 %d %d 255\n", TranslateX() + game_offset_x, TranslateY() + game_offset_y);
-    inputDev[0]->onInputMessage(cmd);
-    inputDev[0]->onInputMessage("c\n");
+    MouseDown(event_param["x"], event_param["y"]);
   } else if (event_type == "mouseup") {
-    ga_logger(Severity::DBG, "mouseup\n");
-    is_pressed = false;
-    is_mouse = true;
-    inputDev[0]->onInputMessage("u 0\n");
-    inputDev[0]->onInputMessage("c\n");
+    MouseUp();
   } else if (event_type == "touch") {
     json event_param = j["data"]["parameters"];
     std::string data = event_param["data"];
-    ga_logger(Severity::DBG, "touch data: %s\n", data.c_str());
-    unsigned int tId = event_param["tID"];
-    if (tId >= inputDev.size()){
-      ga_logger(Severity::ERR, "tID out of scope. tID = %d\n", tId);
-      return;
-    }
-
-    if (android::is_atrace_enabled()) {
-      std::string::size_type upIndex = data.find("u ");
-      if (upIndex != std::string::npos) {
-        static int nS1TouchCount = 0;
-        nS1TouchCount++;
-        std::string str = "atou S1 ID: " + std::to_string(nS1TouchCount);
-        android::atrace_begin(str);
-        android::atrace_end();
-      }
-    }
-    ssize_t sts = 0;
-    std::string err;
-    std::tie(sts, err) = inputDev[tId]->onInputMessage(data);
-    if (sts < 0)
-      ga_logger(Severity::ERR, "Failed to pass 'touch' input message: %s\n", err.c_str());
+    Touch(event_param["tID"], data);
   } else if (event_type == "joystick") {
     json event_param = j["data"]["parameters"];
     std::string data = event_param["data"];
-    ga_logger(Severity::DBG, "joystick data: %s\n", data.c_str());
-    unsigned int jId = event_param["jID"];
-    if (jId>= inputDev.size() ) {
-      ga_logger(Severity::ERR, "jID out of scope. jID = %d\n", jId);
-      return;
-    }
-    ssize_t sts = 0;
-    std::string err;
-    std::tie(sts, err) = inputDev[jId]->onJoystickMessage(data);
-    if (sts < 0)
-      ga_logger(Severity::ERR, "Failed to pass 'joystick' input message: %s\n", err.c_str());
+    Joystick(event_param["jID"], data);
   } else {
     ga_logger(Severity::DBG, "unknown event type: %s\n", event_type.c_str());
   }
   return;
 }
+
+void ga::webrtc::AndroidController::PushClientRecord(const ControlRecord &record) {
+  switch (record.type) {
+  case kRecordMouseMove:
+    MouseMove(record.mouse.x, record.mouse.y);
+    break;
+  case kRecordMouseDown:
+    MouseDown(record.mouse.x, record.mouse.y);
+    break;
+  case kRecordMouseUp:
+    MouseUp();
+    break;
+  case kRecordTouch:
+    // Reuses the capacity of the previous command, no allocation per event.
+    input_command_.assign(record.data, record.data_size);
+    Touch(record.input.id, input_command_);
+    break;
+  case kRecordJoystick:
+    input_command_.assign(record.data, record.data_size);
+    Joystick(record.input.id, input_command_);
+    break;
+  default:
+    ga_logger(Severity::DBG, "unhandled record type: %d\n", record.type);
+    break;
+  }
+}
+
+void ga::webrtc::AndroidController::MouseMove(int32_t x, int32_t y) {
+  ga_logger(Severity::DBG, "mousemove: x=%d, y=%d\n", x, y);
+
+  if (is_mouse)
+  {
+      abs_x += x;
+      abs_y += y;
+      if (abs_x < 0) abs_x = 0;
+      if (abs_y < 0) abs_y = 0;
+      if (abs_x > abs_gameWidth) abs_x = abs_gameWidth;
+      if (abs_y > abs_gameHeight) abs_y = abs_gameHeight;
+  }
+  else
+  {
+      abs_x = x;
+      abs_y = y;
+  }
+
+  if (is_pressed)
+  {
+      char cmd[64];
+      int n = snprintf(cmd, sizeof(cmd), "m 0 %d %d 255\nc\n",  game_offset_x + TranslateX(), game_offset_y + TranslateY());
+      batcher_->Push(0, cmd, n);
+  }
+}
+
+void ga::webrtc::AndroidController::MouseDown(int32_t x, int32_t y) {
+  ga_logger(Severity::DBG, "mousedown: x=%d, y=%d\n", x, y);
+
+  if (x > 4 || y > 4)
+  {
+      is_mouse = false;
+  }
+  else
+  {
+      is_mouse = true;
+  }
+
+  if (!is_mouse)
+  {
+      abs_x = x;
+      abs_y = y;
+  }
+
+  is_pressed = true;
+
+  char cmd[64];
+
+  int n = snprintf(cmd, sizeof(cmd), "d 0 %d %d 255\nc\n", TranslateX() + game_offset_x, TranslateY() + game_offset_y);
+  batcher_->Push(0, cmd, n);
+}
+
+void ga::webrtc::AndroidController::MouseUp() {
+  ga_logger(Severity::DBG, "mouseup\n");
+  is_pressed = false;
+  is_mouse = true;
+  batcher_->Push(0, "u 0\nc\n", 6);
+}
+
+void ga::webrtc::AndroidController::Touch(unsigned int tId, const std::string &data) {
+  ga_logger(Severity::DBG, "touch data: %s\n", data.c_str());
+  if (tId >= inputDev.size()){
+    ga_logger(Severity::ERR, "tID out of scope. tID = %d\n", tId);
+    return;
+  }
+
+  if (android::is_atrace_enabled()) {
+    std::string::size_type upIndex = data.find("u ");
+    if (upIndex != std::string::npos) {
+      static int nS1TouchCount = 0;
+      nS1TouchCount++;
+      std::string str = "atou S1 ID: " + std::to_string(nS1TouchCount);
+      android::atrace_begin(str);
+      android::atrace_end();
+    }
+  }
+  batcher_->Push(tId, data);
+}
+
+void ga::webrtc::AndroidController::Joystick(unsigned int jId, const std::string &data) {
+  ga_logger(Severity::DBG, "joystick data: %s\n", data.c_str());
+  if (jId>= inputDev.size() ) {
+    ga_logger(Severity::ERR, "jID out of scope. jID = %d\n", jId);
+    return;
+  }
+  ssize_t sts = 0;
+  std::string err;
+  std::tie(sts, err) = inputDev[jId]->onJoystickMessage(data);
+  if (sts < 0)
+    ga_logger(Severity::ERR, "Failed to pass 'joystick' input message: %s\n", err.c_str());
+}
@@ -20,6 +20,7 @@
 #include <vector>
 
 #include "ga-controller.h"
+#include "ga-input-batcher.h"
 #include "virtual_input_receiver.h"
 
 namespace ga {
@@ -33,8 +34,15 @@ public:
   virtual ~AndroidController() = default;
 
   void PushClientEvent(const std::string &jsonMessage) override;
+  void PushClientRecord(const ControlRecord &record) override;
 
 private:
+  void MouseMove(int32_t x, int32_t y);
+  void MouseDown(int32_t x, int32_t y);
+  void MouseUp();
+  void Touch(unsigned int tId, const std::string &data);
+  void Joystick(unsigned int jId, const std::string &data);
+
   inline int TranslateX()
   {
     return (getenv("OLD_INPUT_PROTOCOL"))? (double)abs_x/abs_gameWidth * 32767: abs_x;
@@ -60,6 +68,8 @@ private:
   uint32_t video_height_;
 
   std::vector<std::unique_ptr<vhal::client::VirtualInputReceiver>> inputDev;
+  std::string input_command_;  // Command of the last compact touch or joystick record.
+  std::unique_ptr<InputBatcher> batcher_;  // Writes to inputDev, destroyed first.
 };
 
 } // namespace webrtc
@@ -173,6 +173,44 @@ void ga::webrtc::SdlController::PushClientEvent(const std::string &json_message)
   }
 }
 
+void ga::webrtc::SdlController::PushClientRecord(const ControlRecord &record) {
+  sdlmsg_t msg;
+  sdlmsg_t *sdl = ConvertToSdlMessage(record, &msg);
+  if(sdl != NULL) {
+    sdlmsg_replay(sdl);
+  }
+}
+
+sdlmsg_t *
+ga::webrtc::SdlController::ConvertToSdlMessage(const ControlRecord &record, sdlmsg_t *m) {
+  switch (record.type) {
+  case kRecordMouseMove: {
+    MousePosition p = CalcuateMousePosition(record.mouse.x, record.mouse.y, display_width_, display_height_);
+    return sdlmsg_mousemotion(m, p.x, p.y, 0, 0, 0, 0);
+  }
+  case kRecordMouseDown:
+  case kRecordMouseUp: {
+    MousePosition p = CalcuateMousePosition(record.mouse.x, record.mouse.y, display_width_, display_height_);
+    UpdateMousePosition(p);
+    mouse_is_pressed_ = (record.type == kRecordMouseDown);
+    return sdlmsg_mousekey(m, mouse_is_pressed_, record.mouse.which, p.x, p.y);
+  }
+  case kRecordKeyDown:
+  case kRecordKeyUp: {
+#ifdef E2ELATENCY_TELEMETRY_ENABLED
+    m->latency_msg = record.HasLatency() ? record.latency_ms : 0;
+#endif
+    auto key = key_map.find(record.key.which);
+    if (key == key_map.end())
+      return nullptr;
+    return sdlmsg_keyboard(m, (record.type == kRecordKeyDown ? 1 : 0), key->second.second,
+                           key->second.first, 0, 0);
+  }
+  default:
+    return nullptr;
+  }
+}
+
 sdlmsg_t *
 ga::webrtc::SdlController::ConvertToSdlMessage(const std::string &json_message, sdlmsg_t *m) {
   json j = json::parse(json_message);
@@ -32,11 +32,13 @@ public:
   virtual ~SdlController() = default;
 
   void PushClientEvent(const std::string &jsonMessage) override;
+  void PushClientRecord(const ControlRecord &record) override;
 
 private:
   enum class FitMode : unsigned short { Fit, Stretch };
 
   sdlmsg_t *ConvertToSdlMessage(const std::string &jsonMessage, sdlmsg_t *m);
+  sdlmsg_t *ConvertToSdlMessage(const ControlRecord &record, sdlmsg_t *m);
  // Set padding_x_ and padding_y_ based on game resolution at server side and
  // renderer resolution at client side. We assume the game is always in the
  // center of video element.
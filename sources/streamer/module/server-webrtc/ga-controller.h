@@ -18,10 +18,12 @@
 
 #include <string>
 
+#include "ga-control-record.h"
+
 namespace ga {
 namespace webrtc {
 
-/// This class handles JSON mouse/keyboard events
+/// This class handles JSON and compact mouse/keyboard events
 class Controller {
 public:
   struct MousePosition {
@@ -31,6 +33,7 @@ public:
 
   virtual ~Controller(){}
   virtual void PushClientEvent(const std::string &jsonMessage) = 0;
+  virtual void PushClientRecord(const ControlRecord &record) = 0;
 };
 
 } // namespace webrtc
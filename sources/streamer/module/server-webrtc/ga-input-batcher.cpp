@@ -0,0 +1,215 @@
+// Copyright (C) 2023 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions
+// and limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "ga-input-batcher.h"
+
+#include <stdlib.h>
+
+#include <algorithm>
+
+#include "ga-common.h"
+
+using namespace std::chrono;
+
+// Period of the statistics log
+#define REPORT_INTERVAL_S 10
+
+// Most contacts a move only push is parsed for
+#define MAX_MOVES 16
+
+namespace ga {
+namespace webrtc {
+
+namespace {
+
+struct Line {
+  const char *p;
+  size_t      size;
+};
+
+// Split a push into lines. Returns true if it is made of moves and ends
+// with a commit, |moves| then holds the move lines and |contacts| their
+// contact ids.
+bool ParseMoves(const char *commands, size_t size, Line *moves, int *contacts, size_t *count) {
+  const char *p   = commands;
+  const char *end = commands + size;
+  bool committed  = false;
+  *count = 0;
+  while (p < end) {
+    const char *eol = std::find(p, end, '\n');
+    size_t n = eol - p;
+    if (n > 0) {
+      if (committed)
+        return false;  // commands after the commit
+      if (n == 1 && p[0] == 'c') {
+        committed = true;
+      } else if (n > 2 && p[0] == 'm' && p[1] == ' ' && *count < MAX_MOVES) {
+        char *next = nullptr;
+        long contact = strtol(p + 2, &next, 10);
+        if (next == p + 2 || next >= eol)
+          return false;
+        moves[*count]    = { p, n };
+        contacts[*count] = (int)contact;
+        (*count)++;
+      } else {
+        return false;
+      }
+    }
+    p = eol + 1;
+  }
+  return committed && *count > 0;
+}
+
+} // namespace
+
+InputBatcher::InputBatcher(size_t devices, int window_ms, Writer writer)
+    : window_ms_(std::max(0, window_ms)),
+      writer_(std::move(writer)),
+      devices_(devices),
+      report_time_(Clock::now()) {
+  if (window_ms_ > 0)
+    thread_ = std::thread(&InputBatcher::Run, this);
+}
+
+InputBatcher::~InputBatcher() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  cond_.notify_one();
+  if (thread_.joinable())
+    thread_.join();
+
+  // Deliver the last positions
+  std::lock_guard<std::mutex> lock(mutex_);
+  Clock::time_point now = Clock::now();
+  for (size_t i = 0; i < devices_.size(); i++) {
+    if (!devices_[i].pending)
+      continue;
+    buffer_.clear();
+    FlushLocked(i, now, &buffer_);
+    writer_(i, buffer_);
+  }
+}
+
+void InputBatcher::Push(size_t device, const char *commands, size_t size) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (device >= devices_.size() || size == 0)
+    return;
+  pushes_++;
+
+  Device &d = devices_[device];
+  Clock::time_point now = Clock::now();
+  Line moves[MAX_MOVES];
+  int contacts[MAX_MOVES];
+  size_t count = 0;
+  bool moves_only = window_ms_ > 0 && ParseMoves(commands, size, moves, contacts, &count);
+  if (moves_only && (d.pending || now - d.last_write < milliseconds(window_ms_))) {
+    // Keep the latest position of each contact until the window ends
+    for (size_t i = 0; i < count; i++) {
+      std::string &line = d.moves[contacts[i]];
+      if (!line.empty())
+        coalesced_++;
+      line.assign(moves[i].p, moves[i].size);
+    }
+    if (!d.pending) {
+      d.pending       = true;
+      d.first_pending = now;
+      cond_.notify_one();
+    }
+    return;
+  }
+
+  // Pending moves go first, then the commands, in one write
+  buffer_.clear();
+  FlushLocked(device, now, &buffer_);
+  buffer_.append(commands, size);
+  if (buffer_.back() != '\n')
+    buffer_ += '\n';
+  if (moves_only)
+    d.last_write = now;
+  writer_(device, buffer_);
+  writes_++;
+  ReportLocked(now);
+}
+
+void InputBatcher::FlushLocked(size_t device, Clock::time_point now, std::string *out) {
+  Device &d = devices_[device];
+  if (!d.pending)
+    return;
+  // Lines are cleared, not erased, their capacity is reused
+  for (auto &it : d.moves) {
+    if (it.second.empty())
+      continue;
+    out->append(it.second);
+    *out += '\n';
+    it.second.clear();
+  }
+  *out += "c\n";
+  d.pending    = false;
+  d.last_write = now;
+
+  double ms = duration<double, std::milli>(now - d.first_pending).count();
+  held_++;
+  held_ms_ += ms;
+  held_max_ms_ = std::max(held_max_ms_, ms);
+}
+
+void InputBatcher::Run() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!stop_) {
+    Clock::time_point deadline = Clock::time_point::max();
+    for (auto &d : devices_) {
+      if (d.pending)
+        deadline = std::min(deadline, d.last_write + milliseconds(window_ms_));
+    }
+    if (deadline == Clock::time_point::max())
+      cond_.wait(lock);
+    else
+      cond_.wait_until(lock, deadline);
+    if (stop_)
+      break;
+
+    Clock::time_point now = Clock::now();
+    for (size_t i = 0; i < devices_.size(); i++) {
+      Device &d = devices_[i];
+      if (!d.pending || now < d.last_write + milliseconds(window_ms_))
+        continue;
+      buffer_.clear();
+      FlushLocked(i, now, &buffer_);
+      writer_(i, buffer_);
+      writes_++;
+    }
+    ReportLocked(now);
+  }
+}
+
+void InputBatcher::ReportLocked(Clock::time_point now) {
+  if (now - report_time_ < seconds(REPORT_INTERVAL_S))
+    return;
+  if (pushes_ > 0) {
+    ga_logger(Severity::INFO, "input-batcher: window %d ms: %llu events, %llu writes, %llu moves coalesced, "
+              "%llu delayed writes avg %.1f ms max %.1f ms\n", window_ms_,
+              (unsigned long long)pushes_, (unsigned long long)writes_, (unsigned long long)coalesced_,
+              (unsigned long long)held_, held_ ? held_ms_ / held_ : 0.0, held_max_ms_);
+  }
+  report_time_ = now;
+  pushes_ = writes_ = coalesced_ = held_ = 0;
+  held_ms_ = held_max_ms_ = 0;
+}
+
+} // namespace webrtc
+} // namespace ga
@@ -0,0 +1,92 @@
+// Copyright (C) 2023 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions
+// and limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace ga {
+namespace webrtc {
+
+/// Batches minitouch commands on their way to the virtual input devices.
+///
+/// Every Push() results in at most one write, commands and their commit
+/// together. Pushes made only of moves ("m" lines and a "c" commit) are
+/// coalesced per contact: the first move after a quiet window is written
+/// right away, later ones only keep the latest position of each contact
+/// and are written once per window. Any other command first writes the
+/// pending moves, so the order of events is kept.
+class InputBatcher {
+public:
+  using Clock  = std::chrono::steady_clock;
+  /// Writes commands to device |device|, called with the batcher locked.
+  using Writer = std::function<void(size_t device, const std::string &commands)>;
+
+  /// |window_ms| 0 disables coalescing, commands are still batched.
+  InputBatcher(size_t devices, int window_ms, Writer writer);
+  ~InputBatcher();
+
+  InputBatcher(const InputBatcher&) = delete;
+  InputBatcher& operator=(const InputBatcher&) = delete;
+
+  void Push(size_t device, const char *commands, size_t size);
+  void Push(size_t device, const std::string &commands) {
+    Push(device, commands.data(), commands.size());
+  }
+
+  int WindowMs() const { return window_ms_; }
+
+private:
+  struct Device {
+    std::map<int, std::string> moves;  // pending move line per contact
+    Clock::time_point first_pending;   // oldest coalesced move
+    Clock::time_point last_write;      // last write of moves
+    bool pending = false;
+  };
+
+  void Run();
+  void FlushLocked(size_t device, Clock::time_point now, std::string *out);
+  void ReportLocked(Clock::time_point now);
+
+  const int    window_ms_;
+  const Writer writer_;
+
+  std::mutex              mutex_;
+  std::condition_variable cond_;
+  std::vector<Device>     devices_;
+  std::string             buffer_;  // reused for every write
+  std::thread             thread_;
+  bool                    stop_ = false;
+
+  // Statistics, reported every few seconds
+  Clock::time_point report_time_;
+  uint64_t pushes_    = 0;
+  uint64_t writes_    = 0;
+  uint64_t coalesced_ = 0;  // moves replaced by a newer one before a write
+  uint64_t held_      = 0;  // writes of moves delayed by the window
+  double   held_ms_   = 0;
+  double   held_max_ms_ = 0;
+};
+
+} // namespace webrtc
+} // namespace ga
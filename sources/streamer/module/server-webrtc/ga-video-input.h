@@ -18,9 +18,11 @@ namespace webrtc {
 /// This class interfaces with encoder in ga.
 class GAVideoEncoder {
  public:
-  GAVideoEncoder() = default;
+  // |channel| selects the session on the video encoder module.
+  explicit GAVideoEncoder(int channel = 0) : channel_(channel) {}
   virtual ~GAVideoEncoder() = default;
-  void RequestKeyFrame();
+  // |recovery| for lost frames, answered with an intra refresh if the encoder is set for it
+  void RequestKeyFrame(bool recovery = false);
   void Pause();
   void SetMaxBps(int64_t bps);
 #ifdef WIN32
@@ -29,6 +31,11 @@ class GAVideoEncoder {
   void SetFrameStats(long f_ts, long f_size, long f_delay, long f_start_delay, long p_loss);
   void ChangeRenderResolution(int width, int height);
   void SetVideoAlpha(uint32_t action);
+
+ private:
+  int Ioctl(int command, int argsize, void* arg);
+
+  int channel_;
 };
 
 }  // namespace webrtc
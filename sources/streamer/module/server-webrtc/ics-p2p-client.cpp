@@ -19,6 +19,7 @@
 #include "ga-conf.h"
 #include "ga-cursor.h"
 #include "ga-qos.h"
+#include "ga-control-record.h"
 #include "encoder-common.h"
 #ifdef WIN32
 #include "ga-audio-input.h"
@@ -65,8 +66,9 @@ using namespace ga::webrtc;
 static const bool g_bEnableOwtStats = false;
 
 static std::string get_p2p_server() {
-  std::string host = ga_conf_readstr("signaling-server-host");
-  std::string port = ga_conf_readstr("signaling-server-port");
+  auto conf = ga_conf_snapshot();
+  std::string host = conf->signaling_server_host;
+  std::string port = conf->signaling_server_port;
 
   if (host.empty()) {
     host = "127.0.0.1";
@@ -82,9 +84,10 @@ static std::string get_p2p_server() {
 }
 
 static int32_t get_android_session() {
+  auto conf = ga_conf_snapshot();
   int32_t session = -1;
-  if (ga_conf_readbool("k8s", 0) == 0) {
-    session = ga_conf_readint("android-session");
+  if (!conf->k8s) {
+    session = conf->android_session;
     if (session < 0)
       session = 0;
   }
@@ -200,6 +203,31 @@ void ICSP2PClient::RegisterCallbacks() {
 #endif
 }
 
+// Compact counterpart of the framestats and input branches of
+// OnMessageReceived(). Decodes into a stack record, nothing is allocated.
+void ICSP2PClient::OnControlRecord(const std::string &message) {
+  ControlRecord record;
+  if (!ParseControlRecord(message, &record)) {
+    ga_logger(Severity::WARNING, "ics-p2p-client: malformed control record of %zu bytes\n", message.size());
+    return;
+  }
+#ifdef E2ELATENCY_TELEMETRY_ENABLED
+  if (record.HasLatency()) {
+    HandleLatencyMessage(record.latency_ms);
+  }
+#endif
+  if (record.type == kRecordFrameStats) {
+    ga_logger(Severity::DBG, "ics-p2p-client: OnControlRecord: f_ts=%d, f_size=%d, f_delay=%d, f_start_delay=%d, p_loss=%d\n",
+        record.framestats.ts, record.framestats.size, record.framestats.delay,
+        record.framestats.start_delay, record.framestats.packet_loss);
+    if (ga_encoder_)
+      ga_encoder_->SetFrameStats(record.framestats.ts, record.framestats.size, record.framestats.delay,
+                                 record.framestats.start_delay, record.framestats.packet_loss);
+    return;
+  }
+  controller_->PushClientRecord(record);
+}
+
 #ifdef E2ELATENCY_TELEMETRY_ENABLED
 void ICSP2PClient::HandleLatencyMessage(uint64_t latency_send_time_ms) {
   // If we have latency we are waiting to send out, dont update with new values.
@@ -217,6 +245,8 @@ void ICSP2PClient::HandleLatencyMessage(uint64_t latency_send_time_ms) {
 #endif
 
 int32_t ICSP2PClient::Init(void *arg) {
+  conf_session_ = ga_conf_session_current();
+  auto conf = ga_conf_snapshot();
   memset(cursor_shape_, 0, sizeof(cursor_shape_));
   first_cursor_info_ = true;
   streaming_ = false;
@@ -234,7 +264,7 @@ int32_t ICSP2PClient::Init(void *arg) {
     game_height = rect->bottom - rect->top + 1;
   }
 #else
-  if (ga_conf_readbool("measure-latency", 0) == 1) {
+  if (conf->measure_latency) {
     android::atrace_init();
   }
 #endif
@@ -246,8 +276,8 @@ int32_t ICSP2PClient::Init(void *arg) {
 #endif
 
   // Handle webrtc signaling related settings
-  std::string server_peer_id = ga_conf_readstr("server-peer-id");
-  std::string client_peer_id = ga_conf_readstr("client-peer-id");
+  std::string server_peer_id = conf->server_peer_id;
+  std::string client_peer_id = conf->client_peer_id;
 
   if (server_peer_id.empty()) {
     server_peer_id = "ga";
@@ -268,8 +298,8 @@ int32_t ICSP2PClient::Init(void *arg) {
   GlobalConfiguration::SetAECEnabled(false);
   GlobalConfiguration::SetAGCEnabled(false);
 
-  int32_t ice_port_min = ga_conf_readint("ice-port-min");
-  int32_t ice_port_max = ga_conf_readint("ice-port-max");
+  int32_t ice_port_min = conf->ice_port_min;
+  int32_t ice_port_max = conf->ice_port_max;
   if ((ice_port_min > 0) && (ice_port_max > 0)) {
     ga_logger(Severity::INFO, "ice_port_min = %ld ice_port_max = %ld\n", ice_port_min, ice_port_max);
     GlobalConfiguration::SetIcePortAllocationRange(ice_port_min, ice_port_max);
@@ -300,7 +330,7 @@ int32_t ICSP2PClient::Init(void *arg) {
 #endif
   P2PClientConfiguration config;
 
-  std::string codec = ga_conf_readstr("video-codec");
+  const std::string& codec = conf->video_codec;
 
   VideoCodecParameters video_param;
   if (ga_is_h265(codec)) {
@@ -316,15 +346,15 @@ int32_t ICSP2PClient::Init(void *arg) {
   VideoEncodingParameters video_encoding_param(video_param, 0, false);
   config.video_encodings.push_back(video_encoding_param);
 
-  std::string coturn_ip = ga_conf_readstr("coturn-ip");
+  const std::string& coturn_ip = conf->coturn_ip;
   if (!coturn_ip.empty())
   {
     IceServer stun_server, turn_server;
 
     ga_logger(Severity::INFO, "coturn_ip = %s\n", coturn_ip.c_str());
-    std::string coturn_username = ga_conf_readstr("coturn-username");
-    std::string coturn_password = ga_conf_readstr("coturn-password");
-    std::string coturn_port = ga_conf_readstr("coturn-port");
+    std::string coturn_username = conf->coturn_username;
+    std::string coturn_password = conf->coturn_password;
+    const std::string& coturn_port = conf->coturn_port;
 
     stun_server.urls.push_back("stun:" + coturn_ip + ":" + coturn_port);
     stun_server.username = coturn_username;
@@ -346,7 +376,7 @@ int32_t ICSP2PClient::Init(void *arg) {
   std::future<int32_t> connect_done = connect_status_.get_future();
   std::weak_ptr<ga::webrtc::ICSP2PClient> weak_this = shared_from_this();
   p2pclient_->AddAllowedRemoteId(client_peer_id);
-  uint32_t client_clones = (uint32_t) ga_conf_readint("client-clones");
+  uint32_t client_clones = (uint32_t) conf->client_clones;
   for (uint32_t i = 1; i <= client_clones; i++) {
       p2pclient_->AddAllowedRemoteId(client_peer_id + "-clone" + std::to_string(i));
   }
@@ -376,13 +406,14 @@ int32_t ICSP2PClient::Init(void *arg) {
     dump_file_ = fopen(dumpFileName, "wb");
   }
 
-  enable_render_drc_ = (ga_conf_readint("enable-render-drc") > 0)? true: false;
+  enable_render_drc_ = (conf->enable_render_drc > 0)? true: false;
 
   return 0;
 }
 
 void ICSP2PClient::Deinit()
 {
+  ga_conf_session_scope scope(conf_session_);
   if (stream_provider_)
     stream_provider_->DeRegisterEncoderObserver(*this);
   if (publication_)
@@ -398,7 +429,7 @@ void ICSP2PClient::Deinit()
     local_audio_stream_->Close();
 
 #ifndef WIN32
-  if (ga_conf_readbool("measure-latency", 0) == 1) {
+  if (ga_conf_snapshot()->measure_latency) {
     android::atrace_deinit();
   }
 #endif
@@ -411,8 +442,10 @@ int32_t ICSP2PClient::Start() {
 }
 
 void ICSP2PClient::ConnectCallback(bool is_fail, const std::string &error) {
-  if(!is_fail && (ga_conf_readbool("k8s", 0) == 1)) {
-    std::string filePath = ga_conf_readstr("aic-workdir") + "/" + ".p2p_status";
+  ga_conf_session_scope scope(conf_session_);
+  auto conf = ga_conf_snapshot();
+  if(!is_fail && conf->k8s) {
+    std::string filePath = conf->aic_workdir + "/" + ".p2p_status";
     std::ofstream statusFile;
     statusFile.open(filePath);
     statusFile << "started" <<"\n";
@@ -423,8 +456,12 @@ void ICSP2PClient::ConnectCallback(bool is_fail, const std::string &error) {
 
 void ICSP2PClient::OnMessageReceived(const std::string &remote_user_id,
                                   const std::string message) {
+  ga_conf_session_scope scope(conf_session_);
+  auto conf = ga_conf_snapshot();
   send_blocked_ = false;
-  if (message == "start") {
+  if (IsControlRecord(message)) {
+    OnControlRecord(message);
+  } else if (message == "start") {
     p2pclient_->Publish(remote_user_id, local_stream_,
       [&](std::shared_ptr<owt::p2p::Publication> pub) {
         streaming_ = true;
@@ -434,9 +471,15 @@ void ICSP2PClient::OnMessageReceived(const std::string &remote_user_id,
         publication_->AddObserver(*this);
       },
       nullptr);
-    bool clone_client = ga_conf_readint("client-clones") >= 1 && remote_user_id.find("-clone") != std::string::npos;
+    bool clone_client = conf->client_clones >= 1 && remote_user_id.find("-clone") != std::string::npos;
     if (!clone_client) {
       remote_user_id_ = remote_user_id;
+      // JSON until the new client asks for compact records
+      compact_control_ = false;
+    } else {
+      std::lock_guard<std::mutex> lock(clone_mutex_);
+      clone_peers_.insert(remote_user_id);
+      clone_count_ = clone_peers_.size();
     }
 
 #ifdef WIN32
@@ -456,8 +499,8 @@ void ICSP2PClient::OnMessageReceived(const std::string &remote_user_id,
     if (local_audio_stream_.get())
       p2pclient_->Publish(remote_user_id, local_audio_stream_, nullptr, nullptr);
 
-    if (ga_conf_readbool("enable-multi-user", 0) != 0) {
-      int32_t userId = ga_conf_readint("user");
+    if (conf->enable_multi_user) {
+      int32_t userId = conf->user;
       std::string str = "{\"key\":\"user-id\",\"val\":\"" + std::to_string(userId) + "\"}";
       p2pclient_->Send(remote_user_id, str.c_str(), nullptr, nullptr);
     }
@@ -469,7 +512,23 @@ void ICSP2PClient::OnMessageReceived(const std::string &remote_user_id,
       (j1["data"].is_object()) &&
       (j1["data"]["event"].is_string())) {
       std::string event_type = j1["data"]["event"];
-      if (event_type == "framestats") {
+      if (event_type == "controlformat") {
+        // Client sends and reads compact records from now on. Only the
+        // primary client negotiates; clones share its frame side data.
+        nlohmann::json event_param = j1["data"]["parameters"];
+        if (remote_user_id != remote_user_id_) {
+          ga_logger(Severity::INFO, "ics-p2p-client: ignore control format request of %s\n",
+                    remote_user_id.c_str());
+        } else if (event_param.is_object() && event_param["version"].is_number() &&
+            event_param["version"].get<int>() >= kControlRecordVersion) {
+          compact_control_ = true;
+          std::string ack = "{\"key\":\"control-format\",\"val\":\"" +
+                            std::to_string(kControlRecordVersion) + "\"}";
+          p2pclient_->Send(remote_user_id, ack.c_str(), nullptr, nullptr);
+          ga_logger(Severity::INFO, "ics-p2p-client: compact control records enabled\n");
+        }
+        return;
+      } else if (event_type == "framestats") {
         //ga_logger(Severity::INFO, "Debugs: event type %s\n", event_type);
         if (j1["data"]["parameters"].is_object()) {
           nlohmann::json event_param = j1["data"]["parameters"];
@@ -635,9 +694,10 @@ void ICSP2PClient::SendQoS(std::shared_ptr<QosInfo> qos_info) {
 }
 
 void ICSP2PClient::CreateStream() {
-  bool audio_enabled = ga_conf_readbool("enable-audio", 1);
-  bool av_bundle = ga_conf_readbool("av-bundle", 1);
-  ga_encoder_ = std::make_unique<GAVideoEncoder>();
+  auto conf = ga_conf_snapshot();
+  bool audio_enabled = conf->enable_audio;
+  bool av_bundle = conf->av_bundle;
+  ga_encoder_ = std::make_unique<GAVideoEncoder>(channel_);
   stream_provider_ = owt::base::EncodedStreamProvider::Create();
   stream_provider_->RegisterEncoderObserver(*this);
   std::shared_ptr<owt::base::LocalCustomizedStreamParameters> lcsp(new LocalCustomizedStreamParameters(av_bundle, true));
@@ -652,7 +712,8 @@ void ICSP2PClient::CreateStream() {
 
 void ga::webrtc::ICSP2PClient::RequestCursorShape() {
   ga_module_t *video_encoder = encoder_get_vencoder();
-  video_encoder->ioctl(GA_IOCTL_REQUEST_NEW_CURSOR, 0, nullptr);
+  if (video_encoder != nullptr)
+    ga_module_ioctl_channel(video_encoder, channel_, GA_IOCTL_REQUEST_NEW_CURSOR, 0, nullptr);
 }
 
 void ICSP2PClient::InsertFrame(ga_packet_t* packet) {
@@ -778,27 +839,49 @@ void ICSP2PClient::InsertFrame(ga_packet_t* packet) {
 
   bool send_e2e_latency_stats = HasClientStats() && (frame_to_send == client_latency_.received_frame_number + frame_delay_);
   
-  nlohmann::json output_message;
-  if (send_e2e_latency_stats) {
-    output_message["clientSendLatencyTime"]       = client_latency_.send_time_ms;
-    output_message["serverReceivedLatencyTime"]   = client_latency_.received_time_ms;
-    output_message["serverRenderClientInputTime"] = server_latency_.render_time_ms;
-  }
-  output_message["serverEncodeFrameTime"]         = server_latency_.encode_time_ms;
+  // Clients that negotiated compact records get a fixed binary record,
+  // others the JSON object. Connected clones read the same side data and
+  // only understand JSON.
+  bool compact = compact_control_ && clone_count_ == 0;
+  uint8_t latency_record[kLatencyRecordMaxSize];
+  size_t latency_msg_size = 0;
+  std::string latency_msg_string;
+  if (compact) {
+    LatencyRecord latency;
+    latency.encode_time_ms = server_latency_.encode_time_ms;
+    if (send_e2e_latency_stats) {
+      latency.has_client              = true;
+      latency.client_send_time_ms     = client_latency_.send_time_ms;
+      latency.server_received_time_ms = client_latency_.received_time_ms;
+      latency.server_render_time_ms   = server_latency_.render_time_ms;
+    }
+    latency_msg_size = WriteLatencyRecord(latency, latency_record, sizeof(latency_record));
+  } else {
+    nlohmann::json output_message;
+    if (send_e2e_latency_stats) {
+      output_message["clientSendLatencyTime"]       = client_latency_.send_time_ms;
+      output_message["serverReceivedLatencyTime"]   = client_latency_.received_time_ms;
+      output_message["serverRenderClientInputTime"] = server_latency_.render_time_ms;
+    }
+    output_message["serverEncodeFrameTime"]         = server_latency_.encode_time_ms;
 
-  std::string latency_msg_string = output_message.dump();
+    latency_msg_string = output_message.dump();
+    latency_msg_size = latency_msg_string.size();
+  }
   // copy message to meta data
-  if (!latency_msg_string.empty()) {
+  if (latency_msg_size > 0) {
     // allocate memory for latency message
-    meta_data.encoded_image_sidedata_new(latency_msg_string.size());
+    meta_data.encoded_image_sidedata_new(latency_msg_size);
     uint8_t* p_latency_message = meta_data.encoded_image_sidedata_get();
     size_t latency_message_size = meta_data.encoded_image_sidedata_size();
     // copy the message
-    if (latency_msg_string.size() > 0 && p_latency_message) {
-      memcpy(p_latency_message, latency_msg_string.data(), latency_msg_string.size());
+    if (p_latency_message) {
+      memcpy(p_latency_message, compact ? latency_record : (const uint8_t*)latency_msg_string.data(),
+             latency_msg_size);
     }
     ga_logger(Severity::DBG, "ics-p2p-client: InsertFrame: Frame delay is %lu, Frame %lu: msg_size %zu: Latency message sent from server: %s\n",
-      frame_delay_, frame_to_send, latency_message_size, latency_msg_string.c_str());
+      frame_delay_, frame_to_send, latency_message_size,
+      compact ? "(compact record)" : latency_msg_string.c_str());
 
     if (send_e2e_latency_stats) {
       client_latency_.send_time_ms          = 0;
@@ -811,9 +894,17 @@ void ICSP2PClient::InsertFrame(ga_packet_t* packet) {
   // End of E2ELatency
 #endif
 
-  std::vector<uint8_t> buffer;
   if (packet->data != nullptr && packet->size > 0) {
-    buffer.insert(buffer.begin(), packet->data, packet->data + packet->size);
+    // A refcounted packet is sent from its own buffer, held for the call.
+    // Others are copied into a reused buffer.
+    ga_buffer_t* ref = ga_buffer_ref(static_cast<ga_buffer_t*>(packet->buf));
+    const std::vector<uint8_t>* buffer = &frame_buffer_;
+    if (ref && ref->data.data() == packet->data &&
+        ref->data.size() == static_cast<size_t>(packet->size)) {
+      buffer = &ref->data;
+    } else {
+      frame_buffer_.assign(packet->data, packet->data + packet->size);
+    }
     if (dump_file_) {
       fwrite(packet->data, 1, packet->size, dump_file_);
     }
@@ -826,7 +917,8 @@ void ICSP2PClient::InsertFrame(ga_packet_t* packet) {
       android::atrace_end();
     }
 #endif
-    stream_provider_->SendOneFrame(buffer, meta_data);
+    stream_provider_->SendOneFrame(*buffer, meta_data);
+    ga_buffer_unref(&ref);
 
 #ifdef E2ELATENCY_TELEMETRY_ENABLED
     // free memory for latency message
@@ -872,9 +964,19 @@ void ICSP2PClient::OnStopped() {
 }
 
 void ICSP2PClient::OnKeyFrameRequest() {
-  if (ga_encoder_ != nullptr) {
+  // PLI and FIR both come here, a FIR asks for a full refresh of the decoder
+  if (ga_encoder_ != nullptr)
     ga_encoder_->RequestKeyFrame();
-  }
+}
+
+void ICSP2PClient::OnLossNotification(DependencyNotification notification) {
+  // A frame the client could not decode, its references are still there
+  bool lost = (!notification.last_frame_dependency_unknown &&
+               !notification.dependencies_of_last_received_decodable) ||
+              (!notification.last_packet_not_received &&
+               !notification.last_received_decodable);
+  if (lost && ga_encoder_ != nullptr)
+    ga_encoder_->RequestKeyFrame(true);
 }
 
 void ICSP2PClient::OnEnded() {
@@ -882,6 +984,7 @@ void ICSP2PClient::OnEnded() {
 }
 
 void ICSP2PClient::OnPeerConnectionClosed(const std::string& remote_user_id) {
+    ga_conf_session_scope scope(conf_session_);
 #ifdef WIN32
     if (hook_client_status_function_ == NULL) {
         hook_client_status_function_ = [](bool status) {
@@ -895,8 +998,11 @@ void ICSP2PClient::OnPeerConnectionClosed(const std::string& remote_user_id) {
     hook_client_status_function_(false);
 #endif
 
-    uint32_t client_clones = (uint32_t) ga_conf_readint("client-clones");
+    uint32_t client_clones = (uint32_t) ga_conf_snapshot()->client_clones;
     if (client_clones >= 1 && remote_user_id.find("-clone") != std::string::npos) {
+        std::lock_guard<std::mutex> lock(clone_mutex_);
+        clone_peers_.erase(remote_user_id);
+        clone_count_ = clone_peers_.size();
         ga_logger(Severity::INFO, "Do nothing for clone client stop\n");
         return;
     }
@@ -16,7 +16,10 @@
 
 #pragma once
 
+#include <atomic>
 #include <future>
+#include <mutex>
+#include <set>
 
 #include "p2p-socket-signaling-channel.h"
 
@@ -27,6 +30,7 @@
 #include "ga-controller-android.h"
 #endif
 #include "ga-video-input.h"
+#include "ga-conf.h"
 #include "ga-module.h"
 
 #ifndef WIN32
@@ -57,6 +61,8 @@ class ICSP2PClient : public owt::p2p::P2PClientObserver,
                      public PublicationObserver,
                      public std::enable_shared_from_this<ga ::webrtc ::ICSP2PClient> {
  public:
+  // |channel| is the GA channel of the session served by this client.
+  explicit ICSP2PClient(int channel = 0) : channel_(channel) {}
   ~ICSP2PClient() = default;
 
   ICSP2PClient& operator=(const ICSP2PClient&) = delete;
@@ -105,13 +111,14 @@ protected:
                               const std::string message) override;
   virtual void OnStreamAdded(std::shared_ptr<owt::base::RemoteStream> stream) override;
   virtual void OnPeerConnectionClosed(const std::string& remote_user_id) override;
-  virtual void OnLossNotification(DependencyNotification notification) override {};
+  virtual void OnLossNotification(DependencyNotification notification) override;
 
 private:
   void RegisterCallbacks();
   void ConnectCallback(bool is_fail, const std::string &error);
   void CreateStream();
   void RequestCursorShape();
+  void OnControlRecord(const std::string &message);
 
   std::shared_ptr<owt::p2p::P2PClient>    p2pclient_;
   std::shared_ptr<owt::base::LocalStream> local_stream_;
@@ -136,6 +143,9 @@ private:
 
   std::unique_ptr<owt::base::Clock> clock_;
 
+  int                channel_      = 0;
+  ga_conf_session_t* conf_session_ = nullptr;  // Bound while OWT callbacks read conf.
+
   std::string remote_user_id_;
   bool        streaming_         = false;
   uint8_t     cursor_shape_[4096];  // The latest cursor shape.
@@ -146,6 +156,14 @@ private:
   uint64_t    last_timestamp_    = 0;
   uint64_t    send_failures_     = 0;
   bool        send_blocked_      = true;
+  std::vector<uint8_t> frame_buffer_;  // Reused copy of packets that are not refcounted.
+  std::atomic<bool> compact_control_{false};  // Client negotiated compact control records.
+  // Frame side data goes to every peer of the publication, clone clients
+  // included. They never negotiate compact records, so side data is only
+  // compact while no clone is connected.
+  std::mutex            clone_mutex_;
+  std::set<std::string> clone_peers_;
+  std::atomic<size_t>   clone_count_{0};
 #ifdef E2ELATENCY_TELEMETRY_ENABLED
   // E2ELatency
   bool HasClientStats() const { return client_latency_.send_time_ms != 0; }
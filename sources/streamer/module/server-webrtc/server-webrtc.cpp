@@ -17,6 +17,9 @@
 #include <cassert>
 #include <future>
 #include <iostream>
+#include <map>
+#include <mutex>
+#include <vector>
 
 #include "encoder-common.h"
 #include "ga-common.h"
@@ -31,7 +34,29 @@
 #include "p2p-socket-signaling-channel.h"
 #endif
 
-static std::shared_ptr<ga::webrtc::ICSP2PClient> p2pclient_;
+using ClientPtr = std::shared_ptr<ga::webrtc::ICSP2PClient>;
+
+// One client per session, by channel. Channel 0 is created by init(),
+// the others by GA_IOCTL_ADD_SESSION. Clients are initialized and torn
+// down without holding the lock, OWT may call back into the encoder.
+static std::mutex clients_mutex_;
+static std::map<int, ClientPtr> p2pclients_;
+static bool started_ = false;
+static int conf_subscription_ = -1;
+
+static ClientPtr get_client(int channel) {
+  std::lock_guard<std::mutex> lock(clients_mutex_);
+  auto it = p2pclients_.find(channel);
+  return (it == p2pclients_.end()) ? nullptr : it->second;
+}
+
+static std::vector<ClientPtr> get_clients() {
+  std::lock_guard<std::mutex> lock(clients_mutex_);
+  std::vector<ClientPtr> clients;
+  for (auto& it : p2pclients_)
+    clients.push_back(it.second);
+  return clients;
+}
 
 static owt::base::LoggingSeverity get_owt_loglevel(const char* level) {
     if (std::string("none") == level)
@@ -49,6 +74,16 @@ static owt::base::LoggingSeverity get_owt_loglevel(const char* level) {
     return owt::base::LoggingSeverity::kWarning;
 }
 
+#ifndef WIN32
+// Follow owt-loglevel when the configuration is reloaded
+static void on_conf_changed(const ga_conf_snapshot_t* prev, const ga_conf_snapshot_t* cur, void* arg) {
+  if (cur->session != -1 || prev->owt_loglevel == cur->owt_loglevel)
+    return;
+  ga_logger(Severity::INFO, "webrtc: owt-loglevel changed to %s\n", cur->owt_loglevel.c_str());
+  owt::base::Logging::Severity(get_owt_loglevel(cur->owt_loglevel.c_str()));
+}
+#endif
+
 #ifdef WIN32
 static int webrtc_server_init(void* arg, void (*p)(struct timeval)) {
 #else
@@ -56,7 +91,7 @@ static int webrtc_server_init(void* arg) {
 #endif
   ga_logger(Severity::INFO, "webrtc_server_init\n");
 
-  owt::base::LoggingSeverity owtLogLevel = get_owt_loglevel(ga_conf_readstr("owt-loglevel").c_str());
+  owt::base::LoggingSeverity owtLogLevel = get_owt_loglevel(ga_conf_snapshot()->owt_loglevel.c_str());
 #ifdef WIN32
   owt::base::Logging::Severity(owt::base::LoggingSeverity::kNone);
   owt::base::Logging::LogToConsole(owt::base::LoggingSeverity::kNone);
@@ -71,33 +106,98 @@ static int webrtc_server_init(void* arg) {
   owt::base::Logging::LogToFileRotate(owtLogLevel, logDir, prefix, logSize);
 #else
   owt::base::Logging::Severity(owtLogLevel);
+  if (conf_subscription_ < 0)
+    conf_subscription_ = ga_conf_snapshot_subscribe(on_conf_changed, nullptr);
 #endif
-  p2pclient_ = std::make_shared<ga::webrtc::ICSP2PClient>();
-  return p2pclient_->Init(arg);
+  ClientPtr client = std::make_shared<ga::webrtc::ICSP2PClient>(0);
+  {
+    std::lock_guard<std::mutex> lock(clients_mutex_);
+    p2pclients_[0] = client;
+  }
+  return client->Init(arg);
 }
 
 static int webrtc_server_start(void* arg) {
   ga_logger(Severity::INFO, "webrtc_server_start\n");
-  if (p2pclient_)
-    return p2pclient_->Start();
-  else
+  std::vector<ClientPtr> clients = get_clients();
+  if (clients.empty())
     return -1;
+  {
+    std::lock_guard<std::mutex> lock(clients_mutex_);
+    started_ = true;
+  }
+  for (auto& client : clients) {
+    if (client->Start() < 0)
+      return -1;
+  }
+  return 0;
 }
 
 static int webrtc_server_stop(void* arg) {
   return 0;
 }
 
-static int webrtc_server_ioctl(int command, int argsize, void* arg) {
+static int webrtc_server_add_session(const ga_ioctl_session_t* session) {
+  ClientPtr client = std::make_shared<ga::webrtc::ICSP2PClient>(session->channel);
+  bool start;
+  {
+    std::lock_guard<std::mutex> lock(clients_mutex_);
+    if (p2pclients_.find(session->channel) != p2pclients_.end()) {
+      ga_logger(Severity::ERR, "webrtc: session on channel %d exists\n", session->channel);
+      return GA_IOCTL_ERR_BADID;
+    }
+    p2pclients_[session->channel] = client;
+    start = started_;
+  }
+  {
+    ga_conf_session_scope scope(session->conf);
+    if (client->Init(nullptr) < 0 || (start && client->Start() < 0)) {
+      ga_logger(Severity::ERR, "webrtc: failed to add session on channel %d\n", session->channel);
+      client->Deinit();
+      std::lock_guard<std::mutex> lock(clients_mutex_);
+      p2pclients_.erase(session->channel);
+      return GA_IOCTL_ERR_GENERAL;
+    }
+  }
+  ga_logger(Severity::INFO, "webrtc: session %d added on channel %d\n",
+            ga_conf_session_id(session->conf), session->channel);
+  return GA_IOCTL_ERR_NONE;
+}
+
+static int webrtc_server_remove_session(const ga_ioctl_session_t* session) {
+  ClientPtr client;
+  {
+    std::lock_guard<std::mutex> lock(clients_mutex_);
+    auto it = p2pclients_.find(session->channel);
+    if (it == p2pclients_.end())
+      return GA_IOCTL_ERR_BADID;
+    client = std::move(it->second);
+    p2pclients_.erase(it);
+  }
+  client->Deinit();
+  ga_logger(Severity::INFO, "webrtc: session on channel %d removed\n", session->channel);
+  return GA_IOCTL_ERR_NONE;
+}
+
+static int webrtc_server_ioctl_channel(int channel, int command, int argsize, void* arg) {
   int ret = 0;
   ga_ioctl_credit_t *credit = (ga_ioctl_credit_t*)arg;
   int64_t credit_bytes = 0;
+  ClientPtr client;
   switch (command) {
+  case GA_IOCTL_ADD_SESSION:
+  case GA_IOCTL_REMOVE_SESSION:
+    if (argsize != sizeof(ga_ioctl_session_t) || arg == nullptr)
+      return GA_IOCTL_ERR_INVALID_ARGUMENT;
+    if (command == GA_IOCTL_ADD_SESSION)
+      return webrtc_server_add_session((ga_ioctl_session_t*)arg);
+    return webrtc_server_remove_session((ga_ioctl_session_t*)arg);
   case GA_IOCTL_GET_CREDIT_BYTES:
     if (argsize != sizeof(ga_ioctl_credit_t))
       return GA_IOCTL_ERR_INVALID_ARGUMENT;
-    if(p2pclient_) {
-      credit_bytes = p2pclient_->GetCreditBytes();
+    client = get_client(channel);
+    if(client) {
+      credit_bytes = client->GetCreditBytes();
       bcopy(&credit_bytes, &(credit->credit_bytes), sizeof(credit->credit_bytes));
     }
     break;
@@ -107,8 +207,25 @@ static int webrtc_server_ioctl(int command, int argsize, void* arg) {
   return ret;
 }
 
+static int webrtc_server_ioctl(int command, int argsize, void* arg) {
+  return webrtc_server_ioctl_channel(0, command, argsize, arg);
+}
+
 static int webrtc_server_deinit(void* arg) {
-  p2pclient_->Deinit();
+  std::vector<ClientPtr> clients;
+  {
+    std::lock_guard<std::mutex> lock(clients_mutex_);
+    for (auto& it : p2pclients_)
+      clients.push_back(std::move(it.second));
+    p2pclients_.clear();
+    started_ = false;
+  }
+  for (auto& client : clients)
+    client->Deinit();
+  if (conf_subscription_ >= 0) {
+    ga_conf_snapshot_unsubscribe(conf_subscription_);
+    conf_subscription_ = -1;
+  }
   return 0;
 }
 
@@ -117,22 +234,23 @@ static int webrtc_server_send_packet(const char* prefix,
                                      ga_packet_t* pkt,
                                      int64_t encoderPts,
                                      struct timeval* ptv) {
-  if(p2pclient_)
-      p2pclient_->InsertFrame(pkt);
+  ClientPtr client = get_client(channelId);
+  if(client)
+      client->InsertFrame(pkt);
   return 0;
 }
 
 #ifdef WIN32
 static int webrtc_server_send_cursor(std::shared_ptr<CURSOR_DATA> cursorInfo, struct timeval* ptv) {
-  if(p2pclient_)
-    p2pclient_->SendCursor(cursorInfo);
+  for (auto& client : get_clients())
+    client->SendCursor(cursorInfo);
   return 0;
 }
 #endif
 
 static int webrtc_server_send_qos(std::shared_ptr<QosInfo> qosInfo) {
-  if(p2pclient_)
-    p2pclient_->SendQoS(std::move(qosInfo));
+  for (auto& client : get_clients())
+    client->SendQoS(qosInfo);
   return 0;
 }
 
@@ -152,6 +270,7 @@ ga_module_t* module_load() {
 #endif
   m.send_qos = webrtc_server_send_qos;
   m.ioctl = webrtc_server_ioctl;
+  m.ioctl_channel = webrtc_server_ioctl_channel;
   //
   encoder_register_sinkserver(&m);
   //
@@ -27,6 +27,9 @@
 #include <condition_variable>
 #include <csignal>
 #include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
 
 #include "cg-version.h"
 #include "ga-common.h"
@@ -45,6 +48,7 @@ namespace {
     std::mutex m_mutex;
     std::condition_variable m_cv;
     bool m_stop = false;
+    bool m_reload = false;
 }
 
 class Ctx
@@ -58,6 +62,7 @@ public:
     virtual void DeinitModules() = 0;
     virtual int RunModules() = 0;
     virtual void StopModules() = 0;
+    virtual int AddSession(int channel, ga_conf_session_t *conf) = 0;
 };
 
 class AndroidIcrCtx: public Ctx
@@ -71,6 +76,7 @@ public:
     void DeinitModules() override;
     int RunModules() override;
     void StopModules() override;
+    int AddSession(int channel, ga_conf_session_t *conf) override;
 
 private:
     ga_module_t *m_vsource = nullptr;
@@ -126,6 +132,18 @@ void AndroidIcrCtx::StopModules() {
         ga_module_stop(m_server, NULL);
 }
 
+int AndroidIcrCtx::AddSession(int channel, ga_conf_session_t *conf) {
+    ga_ioctl_session_t session;
+    session.channel = channel;
+    session.conf = conf;
+    if(ga_module_ioctl(m_vencoder, GA_IOCTL_ADD_SESSION, sizeof(session), &session) < 0
+    || ga_module_ioctl(m_server, GA_IOCTL_ADD_SESSION, sizeof(session), &session) < 0) {
+        ga_logger(Severity::ERR, "failed to add session %d\n", ga_conf_session_id(conf));
+        return -1;
+    }
+    return 0;
+}
+
 static const char* p2p_default_host = "localhost";
 static const char* p2p_default_port = "8095";
 static const char* icr_default_host = "127.0.0.1";
@@ -207,6 +225,8 @@ void usage(const char* app) {
       default_enable_multi_user);
     printf("  --user <user_id>                AIC user id, (default: %s)\n", default_user);
     printf("  --virtual-input-num <int>       Virtual input number  (default: %s)\n", default_virtual_input_num);
+    printf("  --sessions <n>,<n>,...          Serve several AIC sessions from this process. The first one replaces -n,\n");
+    printf("                                    the others use peer IDs <server-peer-id>-<n> and <client-peer-id>-<n>\n");
     printf("\n");
     printf("Video encoding options:\n");
     printf("  --codec <codec>                 Video codec (default: %s)\n", default_codec);
@@ -229,6 +249,13 @@ static void signal_handler(int signal) {
         printf("\nUser requested to terminate server.\n");
         m_cv.notify_one();
     }
+#ifndef WIN32
+    if (signal == SIGHUP) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_reload = true;
+        m_cv.notify_one();
+    }
+#endif
 }
 
 int
@@ -271,6 +298,7 @@ main(int argc, const char *argv[]) {
     const char* coturn_password = default_coturn_password;
     const char* coturn_port = default_coturn_port;
     const char* client_clones = default_client_clones;
+    std::vector<std::string> sessions;
     for (config_idx = 1; config_idx < argc; ++config_idx) {
         if (std::string("-h") == argv[config_idx] ||
             std::string("--help") == argv[config_idx]) {
@@ -314,6 +342,12 @@ main(int argc, const char *argv[]) {
         } else if (std::string("-n") == argv[config_idx]) {
             if (++config_idx >= argc) break;
             session = argv[config_idx];
+        } else if (std::string("--sessions") == argv[config_idx]) {
+            if (++config_idx >= argc) break;
+            std::stringstream list(argv[config_idx]);
+            std::string n;
+            while (std::getline(list, n, ','))
+                if (!n.empty()) sessions.push_back(n);
         } else if (std::string("--enable-multi-user") == argv[config_idx]) {
             if (++config_idx >= argc) break;
             enable_multi_user = argv[config_idx];
@@ -404,6 +438,9 @@ main(int argc, const char *argv[]) {
         return -1;
     }
 
+    if (!sessions.empty())
+        session = sessions[0].c_str();
+
     ga_set_loglevel(ga_get_loglevel_enum(loglevel));
 
     if(ga_init(argv[config_idx]) < 0)
@@ -465,23 +502,49 @@ main(int argc, const char *argv[]) {
     ga_conf_writev("coturn-port", coturn_port);
     ga_conf_writev("client-clones", client_clones);
 
+    // Additional sessions override the per-instance settings only
+    std::vector<ga_conf_session_t*> confs;
+    for (size_t i = 1; i < sessions.size(); i++) {
+        ga_conf_session_t *conf = ga_conf_session_create(atoi(sessions[i].c_str()));
+        if (conf == nullptr)
+            return -1;
+        ga_conf_session_writev(conf, "android-session", sessions[i].c_str());
+        ga_conf_session_writev(conf, "server-peer-id", (std::string(server_id) + "-" + sessions[i]).c_str());
+        ga_conf_session_writev(conf, "client-peer-id", (std::string(client_id) + "-" + sessions[i]).c_str());
+        confs.push_back(conf);
+    }
+
     std::unique_ptr<Ctx> ctx = std::make_unique<AndroidIcrCtx>();
 
     if(ctx->LoadModules() < 0) { return -1; }
     if(ctx->InitModules() < 0) { return -1; }
+    for (size_t i = 0; i < confs.size(); i++) {
+        if(ctx->AddSession(i + 1, confs[i]) < 0) { return -1; }
+    }
     if(ctx->RunModules() < 0)  { return -1; }
 
     std::signal(SIGTERM, signal_handler);
     std::signal(SIGINT, signal_handler);
+#ifndef WIN32
+    std::signal(SIGHUP, signal_handler);
+#endif
 
-    {
+    // SIGHUP reloads the config file, command line options are kept
+    for (;;) {
         std::unique_lock<std::mutex> lock(m_mutex);
-        m_cv.wait(lock, []{ return m_stop; });
+        m_cv.wait(lock, []{ return m_stop || m_reload; });
+        if (m_stop)
+            break;
+        m_reload = false;
+        lock.unlock();
+        ga_conf_reload(argv[config_idx]);
     }
     printf("Aborting...\n");
     ctx->StopModules();
     ctx->DeinitModules();
     ctx->UnloadModules();
+    for (auto& conf : confs)
+        ga_conf_session_destroy(&conf);
     ga_deinit();
 
     return 0;
@@ -0,0 +1,232 @@
+// Copyright (C) 2023 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions
+// and limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include <gtest/gtest.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "ga-audio-ring.h"
+
+using namespace std::chrono;
+using ga::webrtc::AudioRing;
+
+namespace {
+  // 10 ms of 48 kHz stereo 16 bit PCM
+  const size_t kFrameSize = 1920;
+
+  // A frame carries its sequence number and push time, then a pattern
+  struct FrameHeader
+  {
+    uint64_t seq;
+    int64_t  pushed_ns;
+  };
+
+  int64_t now_ns()
+  {
+    return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+  }
+
+  void make_frame(uint8_t *frame, uint64_t seq)
+  {
+    FrameHeader h = { seq, now_ns() };
+    memcpy(frame, &h, sizeof(h));
+    memset(frame + sizeof(h), (int)(seq & 0xff), kFrameSize - sizeof(h));
+  }
+
+  // Returns the header of a frame whose pattern is intact
+  bool check_frame(const uint8_t *frame, FrameHeader *h)
+  {
+    memcpy(h, frame, sizeof(*h));
+    for (size_t i = sizeof(*h); i < kFrameSize; i++) {
+      if (frame[i] != (uint8_t)(h->seq & 0xff))
+        return false;
+    }
+    return true;
+  }
+
+  double percentile(std::vector<double> &v, double p)
+  {
+    if (v.empty())
+      return 0.0;
+    std::sort(v.begin(), v.end());
+    return v[std::min(v.size() - 1, size_t(p * v.size()))];
+  }
+}
+
+TEST(AudioRingTest, PushPopInOrder)
+{
+  AudioRing ring;
+  ASSERT_TRUE(ring.Configure(kFrameSize, 3));
+  EXPECT_EQ(ring.FrameSize(), kFrameSize);
+  EXPECT_EQ(ring.Depth(), 3u);
+
+  uint8_t in[kFrameSize], out[kFrameSize];
+  FrameHeader h;
+  for (uint64_t seq = 0; seq < 10; seq++) {
+    make_frame(in, seq);
+    ASSERT_TRUE(ring.Push(in));
+    EXPECT_EQ(ring.Size(), 1u);
+    ASSERT_TRUE(ring.Pop(out));
+    ASSERT_TRUE(check_frame(out, &h));
+    EXPECT_EQ(h.seq, seq);
+  }
+  EXPECT_EQ(ring.Pushed(), 10u);
+  EXPECT_EQ(ring.Popped(), 10u);
+  EXPECT_EQ(ring.Overruns(), 0u);
+  EXPECT_EQ(ring.Underruns(), 0u);
+}
+
+TEST(AudioRingTest, OverrunDropsNewest)
+{
+  AudioRing ring;
+  ASSERT_TRUE(ring.Configure(kFrameSize, 3));
+
+  uint8_t frame[kFrameSize];
+  for (uint64_t seq = 0; seq < 5; seq++) {
+    make_frame(frame, seq);
+    EXPECT_EQ(ring.Push(frame), seq < 3);
+  }
+  EXPECT_EQ(ring.Overruns(), 2u);
+  EXPECT_EQ(ring.Size(), 3u);
+
+  FrameHeader h;
+  for (uint64_t seq = 0; seq < 3; seq++) {
+    ASSERT_TRUE(ring.Pop(frame));
+    ASSERT_TRUE(check_frame(frame, &h));
+    EXPECT_EQ(h.seq, seq);
+  }
+  EXPECT_FALSE(ring.Pop(frame));
+  EXPECT_EQ(ring.Underruns(), 1u);
+}
+
+TEST(AudioRingTest, ConfigureResets)
+{
+  AudioRing ring;
+  uint8_t frame[kFrameSize] = {};
+  EXPECT_FALSE(ring.Push(frame));
+  EXPECT_FALSE(ring.Pop(frame));
+
+  ASSERT_TRUE(ring.Configure(kFrameSize, 2));
+  ring.Push(frame);
+  ring.Push(frame);
+  ring.Push(frame);
+  ASSERT_TRUE(ring.Configure(kFrameSize / 2, 4));
+  EXPECT_TRUE(ring.Empty());
+  EXPECT_EQ(ring.Overruns(), 0u);
+  EXPECT_EQ(ring.Depth(), 4u);
+  EXPECT_FALSE(ring.Configure(0, 4));
+  EXPECT_FALSE(ring.Configure(kFrameSize, 0));
+}
+
+// Unpaced producer and consumer, the producer retries a full ring:
+// every frame arrives once, intact and in order.
+TEST(AudioRingTest, StressIntegrity)
+{
+  AudioRing ring;
+  ASSERT_TRUE(ring.Configure(kFrameSize, 8));
+  const uint64_t kFrames = 100000;
+  std::atomic<bool> done(false);
+
+  std::thread producer([&] {
+    uint8_t frame[kFrameSize];
+    for (uint64_t seq = 0; seq < kFrames; seq++) {
+      make_frame(frame, seq);
+      while (!ring.Push(frame))
+        std::this_thread::yield();
+    }
+    done = true;
+  });
+
+  uint8_t frame[kFrameSize];
+  uint64_t popped = 0, last = 0, bad = 0;
+  bool first = true;
+  while (!done || !ring.Empty()) {
+    if (!ring.Pop(frame)) {
+      std::this_thread::yield();
+      continue;
+    }
+    FrameHeader h;
+    if (!check_frame(frame, &h) || (first ? h.seq != 0 : h.seq != last + 1))
+      bad++;
+    first = false;
+    last = h.seq;
+    popped++;
+  }
+  producer.join();
+
+  EXPECT_EQ(bad, 0u);
+  EXPECT_EQ(popped, kFrames);
+  EXPECT_EQ(ring.Pushed(), kFrames);
+  EXPECT_EQ(ring.Popped(), kFrames);
+  printf("frames %llu overruns %llu underruns %llu\n", (unsigned long long)kFrames,
+         (unsigned long long)ring.Overruns(), (unsigned long long)ring.Underruns());
+}
+
+// A fake reader pushing 10 ms frames with jitter, and a fake 10 ms pull
+// which stalls once. Reports the age of pulled frames, drops and misses.
+TEST(AudioRingTest, StressPaced)
+{
+  AudioRing ring;
+  ASSERT_TRUE(ring.Configure(kFrameSize, 4));
+  const int kFrames = 300;
+  std::atomic<bool> done(false);
+
+  std::thread producer([&] {
+    std::mt19937 rng(1);
+    std::uniform_int_distribution<int> jitter_us(-3000, 3000);
+    uint8_t frame[kFrameSize];
+    auto start = steady_clock::now();
+    for (int seq = 0; seq < kFrames; seq++) {
+      std::this_thread::sleep_until(start + milliseconds(10 * seq) + microseconds(jitter_us(rng)));
+      make_frame(frame, seq);
+      auto t0 = steady_clock::now();
+      ring.Push(frame);
+      // the reader is never held up by the pull
+      EXPECT_LT(steady_clock::now() - t0, milliseconds(1));
+    }
+    done = true;
+  });
+
+  std::vector<double> age_ms;
+  uint8_t frame[kFrameSize];
+  auto next = steady_clock::now() + milliseconds(5);
+  for (int tick = 0; !done || !ring.Empty(); tick++) {
+    std::this_thread::sleep_until(next);
+    next += milliseconds(10);
+    if (tick == 100)
+      std::this_thread::sleep_for(milliseconds(80));  // stalled pull
+    FrameHeader h;
+    if (ring.Pop(frame) && check_frame(frame, &h))
+      age_ms.push_back((now_ns() - h.pushed_ns) / 1e6);
+  }
+  producer.join();
+
+  // the stall overflows a 40 ms ring
+  EXPECT_GT(ring.Overruns(), 0u);
+  EXPECT_EQ(ring.Pushed() + ring.Overruns(), (uint64_t)kFrames);
+  EXPECT_EQ(ring.Popped(), ring.Pushed());
+  printf("depth %zu: frames %d drops %llu underruns %llu, age ms p50 %.2f p99 %.2f max %.2f\n",
+         ring.Depth(), kFrames, (unsigned long long)ring.Overruns(),
+         (unsigned long long)ring.Underruns(),
+         percentile(age_ms, 0.5), percentile(age_ms, 0.99), percentile(age_ms, 1.0));
+}
@@ -0,0 +1,345 @@
+// Copyright (C) 2023 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions
+// and limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+// Microbenchmark for dpipe.
+//
+// One producer gets a free buffer, touches it and stores it, while one or
+// more consumers load frames and put them back, the way vsource and the
+// video encoders use the pipe. The lock-free dpipe is compared with the
+// previous implementation, which moved buffers between two linked lists
+// under a mutex and signalled a condition variable on every store.
+//
+// Reported are the frames delivered per second, the store-to-load latency
+// and the number of frames the producer recycled from the output pool
+// because no free buffer was left.
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "dpipe.h"
+
+using namespace std::chrono;
+
+namespace {
+    int g_frames = 1000000;
+    int g_consumers = 1;
+    int g_nframe = 8;
+    int g_size = 4096;
+    int g_timeout_ms = 0;
+
+    uint64_t now_ns()
+    {
+        return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+    }
+
+    // Header written by the producer into each frame
+    struct Frame
+    {
+        uint64_t stamp;
+        uint64_t seq;
+    };
+
+    // The previous dpipe: buffers on two linked lists under one mutex
+    namespace legacy {
+        struct buffer_t
+        {
+            void *pointer;
+            buffer_t *next;
+        };
+
+        struct pipe_t
+        {
+            std::condition_variable cond;
+            std::mutex io_mutex;
+            buffer_t *in = nullptr;
+            buffer_t *out = nullptr;
+            buffer_t *out_tail = nullptr;
+            std::vector<buffer_t> buffers;
+            std::vector<std::vector<uint8_t>> storage;
+        };
+
+        pipe_t *create(int nframe, int maxframesize)
+        {
+            pipe_t *p = new pipe_t;
+            p->buffers.resize(nframe);
+            p->storage.resize(nframe);
+            for (int i = 0; i < nframe; i++) {
+                p->storage[i].resize(maxframesize);
+                p->buffers[i].pointer = p->storage[i].data();
+                p->buffers[i].next = p->in;
+                p->in = &p->buffers[i];
+            }
+            return p;
+        }
+
+        buffer_t *get(pipe_t *p)
+        {
+            std::lock_guard<std::mutex> lock(p->io_mutex);
+            buffer_t *b = p->in;
+            if (b) {
+                p->in = b->next;
+            } else if ((b = p->out) != nullptr) {
+                p->out = b->next;
+                if (!p->out)
+                    p->out_tail = nullptr;
+            }
+            if (b)
+                b->next = nullptr;
+            return b;
+        }
+
+        void put(pipe_t *p, buffer_t *b)
+        {
+            std::lock_guard<std::mutex> lock(p->io_mutex);
+            b->next = p->in;
+            p->in = b;
+        }
+
+        buffer_t *load(pipe_t *p, const struct timespec *abstime)
+        {
+            std::unique_lock<std::mutex> lock(p->io_mutex);
+            bool failed = false;
+            while (!p->out) {
+                if (!abstime) {
+                    p->cond.wait(lock);
+                } else if (!failed) {
+                    auto tp = system_clock::time_point(duration_cast<system_clock::duration>(
+                        seconds(abstime->tv_sec) + nanoseconds(abstime->tv_nsec)));
+                    p->cond.wait_until(lock, tp);
+                    failed = true;
+                } else {
+                    return nullptr;
+                }
+            }
+            buffer_t *b = p->out;
+            p->out = b->next;
+            if (!p->out)
+                p->out_tail = nullptr;
+            b->next = nullptr;
+            return b;
+        }
+
+        void store(pipe_t *p, buffer_t *b)
+        {
+            std::lock_guard<std::mutex> lock(p->io_mutex);
+            if (p->out_tail) {
+                p->out_tail->next = b;
+                p->out_tail = b;
+            } else {
+                p->out = p->out_tail = b;
+            }
+            b->next = nullptr;
+            p->cond.notify_one();
+        }
+    }
+
+    // Same calls for both implementations
+    struct LegacyOps
+    {
+        using pipe_t = legacy::pipe_t;
+        using buffer_t = legacy::buffer_t;
+        static pipe_t *create(int nframe, int size) { return legacy::create(nframe, size); }
+        static void destroy(pipe_t *p) { delete p; }
+        static buffer_t *get(pipe_t *p) { return legacy::get(p); }
+        static void put(pipe_t *p, buffer_t *b) { legacy::put(p, b); }
+        static buffer_t *load(pipe_t *p, const struct timespec *t) { return legacy::load(p, t); }
+        static void store(pipe_t *p, buffer_t *b) { legacy::store(p, b); }
+    };
+
+    struct DpipeOps
+    {
+        using pipe_t = dpipe_t;
+        using buffer_t = dpipe_buffer_t;
+        static pipe_t *create(int nframe, int size) { return dpipe_create(0, "dpipe-bench", nframe, size); }
+        static void destroy(pipe_t *p) { dpipe_destroy(p); }
+        static buffer_t *get(pipe_t *p) { return dpipe_get(p); }
+        static void put(pipe_t *p, buffer_t *b) { dpipe_put(p, b); }
+        static buffer_t *load(pipe_t *p, const struct timespec *t) { return dpipe_load(p, t); }
+        static void store(pipe_t *p, buffer_t *b) { dpipe_store(p, b); }
+    };
+
+    struct Result
+    {
+        double seconds;
+        uint64_t delivered;
+        uint64_t recycled;
+        std::vector<uint64_t> latency;
+    };
+
+    template <typename Ops>
+    Result run()
+    {
+        typename Ops::pipe_t *pipe = Ops::create(g_nframe, g_size);
+        std::atomic<bool> done(false);
+        std::vector<std::vector<uint64_t>> latency(g_consumers);
+        std::vector<std::atomic<uint64_t>> delivered(g_consumers);
+        std::vector<std::thread> consumers;
+
+        for (int c = 0; c < g_consumers; c++) {
+            latency[c].reserve(g_frames / g_consumers + 1);
+            consumers.emplace_back([&, c]() {
+                for (;;) {
+                    typename Ops::buffer_t *b;
+                    if (g_timeout_ms > 0) {
+                        struct timespec abstime;
+                        clock_gettime(CLOCK_REALTIME, &abstime);
+                        abstime.tv_nsec += long(g_timeout_ms) * 1000000;
+                        abstime.tv_sec += abstime.tv_nsec / 1000000000;
+                        abstime.tv_nsec %= 1000000000;
+                        b = Ops::load(pipe, &abstime);
+                    } else {
+                        b = Ops::load(pipe, nullptr);
+                    }
+                    if (!b) {
+                        if (done)
+                            break;
+                        continue;
+                    }
+                    Frame *f = static_cast<Frame *>(b->pointer);
+                    if (f->seq == UINT64_MAX) {
+                        Ops::put(pipe, b);
+                        break;
+                    }
+                    latency[c].push_back(now_ns() - f->stamp);
+                    delivered[c]++;
+                    f->seq = 0;
+                    Ops::put(pipe, b);
+                }
+            });
+        }
+
+        uint64_t recycled = 0;
+        uint64_t start = now_ns();
+        for (int i = 0; i < g_frames; i++) {
+            typename Ops::buffer_t *b;
+            while ((b = Ops::get(pipe)) == nullptr)
+                std::this_thread::yield();
+            Frame *f = static_cast<Frame *>(b->pointer);
+            // a buffer still holding an undelivered frame was recycled
+            if (f->seq != 0)
+                recycled++;
+            memset(b->pointer, 0, std::min<int>(g_size, 256));
+            f->seq = i + 1;
+            f->stamp = now_ns();
+            Ops::store(pipe, b);
+        }
+        // wait until the consumers drained the pipe, then stop them
+        uint64_t total = 0;
+        do {
+            std::this_thread::yield();
+            total = 0;
+            for (auto &d : delivered)
+                total += d.load();
+        } while (total + recycled < uint64_t(g_frames) && now_ns() - start < 60000000000ULL);
+        uint64_t end = now_ns();
+
+        done = true;
+        for (int c = 0; c < g_consumers; c++) {
+            typename Ops::buffer_t *b;
+            while ((b = Ops::get(pipe)) == nullptr)
+                std::this_thread::yield();
+            static_cast<Frame *>(b->pointer)->seq = UINT64_MAX;
+            Ops::store(pipe, b);
+        }
+        for (auto &t : consumers)
+            t.join();
+        Ops::destroy(pipe);
+
+        Result r;
+        r.seconds = (end - start) / 1e9;
+        r.delivered = total;
+        r.recycled = recycled;
+        for (auto &l : latency)
+            r.latency.insert(r.latency.end(), l.begin(), l.end());
+        std::sort(r.latency.begin(), r.latency.end());
+        return r;
+    }
+
+    void report(const char *name, const Result &r)
+    {
+        auto pct = [&r](double p) -> double {
+            if (r.latency.empty())
+                return 0.0;
+            size_t i = std::min(r.latency.size() - 1, size_t(p * r.latency.size()));
+            return r.latency[i] / 1000.0;
+        };
+        printf("%-8s %10.0f frames/s  delivered=%llu recycled=%llu  latency us p50=%.2f p99=%.2f p99.9=%.2f\n",
+               name, r.delivered / r.seconds, (unsigned long long)r.delivered, (unsigned long long)r.recycled,
+               pct(0.5), pct(0.99), pct(0.999));
+    }
+}
+
+static void usage(const char* app)
+{
+    printf("usage: %s [options]\n", app);
+    printf("  -n, --frames <n>     frames stored by the producer (default: %d)\n", g_frames);
+    printf("  -c, --consumers <n>  number of consumer threads (default: %d)\n", g_consumers);
+    printf("  -p, --pool <n>       frame buffers in the pipe (default: %d)\n", g_nframe);
+    printf("  -s, --size <n>       frame buffer size in bytes (default: %d)\n", g_size);
+    printf("  -t, --timeout <ms>   load with a timeout instead of blocking (default: %d)\n", g_timeout_ms);
+}
+
+int main(int argc, char* argv[])
+{
+    static const struct option long_opts[] = {
+        { "frames",    required_argument, nullptr, 'n' },
+        { "consumers", required_argument, nullptr, 'c' },
+        { "pool",      required_argument, nullptr, 'p' },
+        { "size",      required_argument, nullptr, 's' },
+        { "timeout",   required_argument, nullptr, 't' },
+        { "help",      no_argument,       nullptr, 'h' },
+        { nullptr,     0,                 nullptr, 0 },
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "n:c:p:s:t:h", long_opts, nullptr)) != -1) {
+        switch (opt) {
+        case 'n': g_frames = atoi(optarg); break;
+        case 'c': g_consumers = atoi(optarg); break;
+        case 'p': g_nframe = atoi(optarg); break;
+        case 's': g_size = atoi(optarg); break;
+        case 't': g_timeout_ms = atoi(optarg); break;
+        case 'h': usage(argv[0]); return 0;
+        default: usage(argv[0]); return -1;
+        }
+    }
+
+    if (g_frames <= 0 || g_consumers <= 0 || g_nframe <= g_consumers ||
+        g_size < int(sizeof(Frame)) || g_timeout_ms < 0) {
+        usage(argv[0]);
+        return -1;
+    }
+
+    printf("frames=%d consumers=%d pool=%d size=%d timeout=%dms\n",
+           g_frames, g_consumers, g_nframe, g_size, g_timeout_ms);
+
+    report("mutex", run<LegacyOps>());
+    report("dpipe", run<DpipeOps>());
+
+    return 0;
+}
@@ -0,0 +1,199 @@
+// Copyright (C) 2023 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions
+// and limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include <gtest/gtest.h>
+#include <time.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "dpipe.h"
+
+using namespace std::chrono;
+
+namespace {
+  const int kFrames = 8;
+  const int kFrameSize = 256;
+
+  struct PipeDeleter
+  {
+    void operator()(dpipe_t *dpipe) const { dpipe_destroy(dpipe); }
+  };
+  using Pipe = std::unique_ptr<dpipe_t, PipeDeleter>;
+
+  Pipe make_pipe(const char *name)
+  {
+    return Pipe(dpipe_create(0, name, kFrames, kFrameSize));
+  }
+
+  struct timespec after_ms(int ms)
+  {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_nsec += (long)ms * 1000000;
+    ts.tv_sec += ts.tv_nsec / 1000000000;
+    ts.tv_nsec %= 1000000000;
+    return ts;
+  }
+
+  // Takes every buffer left in the pipe, free or stored
+  std::set<dpipe_buffer_t *> drain(dpipe_t *dpipe)
+  {
+    std::set<dpipe_buffer_t *> buffers;
+    dpipe_buffer_t *buffer;
+    while ((buffer = dpipe_get(dpipe)) != nullptr)
+      buffers.insert(buffer);
+    return buffers;
+  }
+}
+
+TEST(DpipeTest, BuffersAreAligned)
+{
+  Pipe dpipe = make_pipe("dpipe-test-aligned");
+  ASSERT_TRUE(dpipe);
+  EXPECT_EQ(nullptr, dpipe_create(0, "dpipe-test-aligned", kFrames, kFrameSize));
+  EXPECT_EQ(dpipe.get(), dpipe_lookup("dpipe-test-aligned"));
+
+  std::set<dpipe_buffer_t *> buffers = drain(dpipe.get());
+  ASSERT_EQ((size_t)kFrames, buffers.size());
+  for (dpipe_buffer_t *buffer : buffers)
+    EXPECT_EQ(0u, (uintptr_t)buffer->pointer % DPIPE_ALIGNMENT);
+}
+
+TEST(DpipeTest, LoadsInStoreOrder)
+{
+  Pipe dpipe = make_pipe("dpipe-test-order");
+  ASSERT_TRUE(dpipe);
+  EXPECT_EQ(nullptr, dpipe_load_nowait(dpipe.get()));
+
+  std::vector<dpipe_buffer_t *> stored;
+  for (int i = 0; i < 3; i++) {
+    stored.push_back(dpipe_get(dpipe.get()));
+    dpipe_store(dpipe.get(), stored.back());
+  }
+  struct timespec ts = after_ms(100);
+  EXPECT_EQ(stored[0], dpipe_load(dpipe.get(), &ts));
+  EXPECT_EQ(stored[1], dpipe_load(dpipe.get(), nullptr));
+  EXPECT_EQ(stored[2], dpipe_load_nowait(dpipe.get()));
+
+  ts = after_ms(20);
+  EXPECT_EQ(nullptr, dpipe_load(dpipe.get(), &ts));
+}
+
+TEST(DpipeTest, GetRecyclesEldestStoredFrame)
+{
+  Pipe dpipe = make_pipe("dpipe-test-recycle");
+  ASSERT_TRUE(dpipe);
+
+  std::vector<dpipe_buffer_t *> stored;
+  for (int i = 0; i < kFrames; i++) {
+    stored.push_back(dpipe_get(dpipe.get()));
+    dpipe_store(dpipe.get(), stored.back());
+  }
+  EXPECT_EQ(stored[0], dpipe_get(dpipe.get()));
+  EXPECT_EQ(stored[1], dpipe_load_nowait(dpipe.get()));
+}
+
+TEST(DpipeTest, LoadWakesOnStore)
+{
+  Pipe dpipe = make_pipe("dpipe-test-wake");
+  ASSERT_TRUE(dpipe);
+
+  dpipe_buffer_t *loaded = nullptr;
+  std::thread consumer([&] {
+    struct timespec ts = after_ms(5000);
+    loaded = dpipe_load(dpipe.get(), &ts);
+  });
+  std::this_thread::sleep_for(milliseconds(20));
+  dpipe_buffer_t *buffer = dpipe_get(dpipe.get());
+  dpipe_store(dpipe.get(), buffer);
+  consumer.join();
+  EXPECT_EQ(buffer, loaded);
+}
+
+// Producers recycle stored frames through dpipe_get() while several
+// consumers load them, more threads than cores so that any of them may be
+// preempted in the middle of a ring operation. No buffer may be lost or
+// handed to two threads at once.
+TEST(DpipeTest, StressKeepsEveryBuffer)
+{
+  Pipe dpipe = make_pipe("dpipe-test-stress");
+  ASSERT_TRUE(dpipe);
+
+  const int producers = 2;
+  const int consumers = 2 * std::max(2u, std::thread::hardware_concurrency());
+  std::atomic<bool> stop(false);
+  std::atomic<int> shared(0);
+  std::atomic<long> loads(0);
+
+  // The frame header tells which thread holds the buffer
+  auto take = [&](dpipe_buffer_t *buffer) {
+    auto *owner = reinterpret_cast<std::atomic<int> *>(buffer->pointer);
+    if (owner->exchange(1) != 0)
+      shared++;
+  };
+  auto give = [&](dpipe_buffer_t *buffer) {
+    reinterpret_cast<std::atomic<int> *>(buffer->pointer)->store(0);
+  };
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < producers; i++) {
+    threads.emplace_back([&] {
+      while (!stop.load()) {
+        dpipe_buffer_t *buffer = dpipe_get(dpipe.get());
+        if (buffer == nullptr) {
+          std::this_thread::yield();
+          continue;
+        }
+        take(buffer);
+        give(buffer);
+        dpipe_store(dpipe.get(), buffer);
+      }
+    });
+  }
+  for (int i = 0; i < consumers; i++) {
+    threads.emplace_back([&, i] {
+      while (!stop.load()) {
+        dpipe_buffer_t *buffer;
+        if (i % 2) {
+          buffer = dpipe_load_nowait(dpipe.get());
+        } else {
+          struct timespec ts = after_ms(10);
+          buffer = dpipe_load(dpipe.get(), &ts);
+        }
+        if (buffer == nullptr)
+          continue;
+        take(buffer);
+        loads++;
+        give(buffer);
+        dpipe_put(dpipe.get(), buffer);
+      }
+    });
+  }
+  std::this_thread::sleep_for(seconds(2));
+  stop.store(true);
+  for (std::thread &t : threads)
+    t.join();
+
+  EXPECT_GT(loads.load(), 0);
+  EXPECT_EQ(0, shared.load());
+  EXPECT_EQ((size_t)kFrames, drain(dpipe.get()).size());
+}
@@ -0,0 +1,364 @@
+// Copyright (C) 2023 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions
+// and limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include <gtest/gtest.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <ga-conf.h>
+
+namespace {
+  class GaConfTest: public ::testing::Test
+  {
+  protected:
+    void SetUp() override {
+      ga_conf_clear();
+      ga_conf_writev("icr-ip", "127.0.0.1");
+      ga_conf_writev("icr-port", "23432");
+      session_ = ga_conf_session_create(3);
+      ASSERT_NE(session_, nullptr);
+    }
+    void TearDown() override {
+      ga_conf_session_destroy(&session_);
+      ga_conf_clear();
+    }
+
+    // Reads |key| on a thread of its own, with nothing bound
+    static int ReadIntOnOtherThread(const char *key) {
+      int value = -1;
+      std::thread([&]{ value = ga_conf_readint(key); }).join();
+      return value;
+    }
+
+    ga_conf_session_t *session_ = nullptr;
+  };
+
+  // Configuration file removed with the object
+  class ConfFile
+  {
+  public:
+    ConfFile() {
+      char tmpl[] = "/tmp/ga-conf-test-XXXXXX";
+      int fd = mkstemp(tmpl);
+      EXPECT_GE(fd, 0);
+      close(fd);
+      path_ = tmpl;
+    }
+    ~ConfFile() { unlink(path_.c_str()); }
+
+    const char *path() const { return path_.c_str(); }
+
+    void Write(const std::string &text) {
+      FILE *fp = fopen(path_.c_str(), "w");
+      ASSERT_NE(fp, nullptr);
+      fputs(text.c_str(), fp);
+      fclose(fp);
+    }
+
+  private:
+    std::string path_;
+  };
+
+  struct Change {
+    int prev_fps;
+    int cur_fps;
+  };
+
+  void record_change(const ga_conf_snapshot_t *prev, const ga_conf_snapshot_t *cur, void *arg)
+  {
+    static_cast<std::vector<Change> *>(arg)->push_back({ prev->video_fps, cur->video_fps });
+  }
+}
+
+TEST_F(GaConfTest, SessionOverridesOnBoundThread)
+{
+  ASSERT_EQ(ga_conf_session_writev(session_, "icr-port", "24000"), 0);
+
+  EXPECT_EQ(ga_conf_readint("icr-port"), 23432);
+  {
+    ga_conf_session_scope scope(session_);
+    EXPECT_EQ(ga_conf_session_current(), session_);
+    EXPECT_EQ(ga_conf_readint("icr-port"), 24000);
+    EXPECT_EQ(ga_conf_readstr("icr-port"), "24000");
+    // other threads keep the global configuration
+    EXPECT_EQ(ReadIntOnOtherThread("icr-port"), 23432);
+  }
+  EXPECT_EQ(ga_conf_session_current(), nullptr);
+  EXPECT_EQ(ga_conf_readint("icr-port"), 23432);
+}
+
+TEST_F(GaConfTest, SessionFallsBackToGlobal)
+{
+  ASSERT_EQ(ga_conf_session_writev(session_, "android-session", "3"), 0);
+
+  ga_conf_session_scope scope(session_);
+  EXPECT_EQ(ga_conf_readstr("icr-ip"), "127.0.0.1");
+  EXPECT_EQ(ga_conf_readint("android-session"), 3);
+  EXPECT_EQ(ga_conf_readstr("not-set"), "");
+
+  // the global value changes under the session
+  ga_conf_writev("icr-ip", "10.0.0.1");
+  EXPECT_EQ(ga_conf_readstr("icr-ip"), "10.0.0.1");
+}
+
+TEST_F(GaConfTest, NestedScopesRestore)
+{
+  ga_conf_session_t *other = ga_conf_session_create(4);
+  ASSERT_NE(other, nullptr);
+  ga_conf_session_writev(session_, "user", "1");
+  ga_conf_session_writev(other, "user", "2");
+
+  {
+    ga_conf_session_scope outer(session_);
+    EXPECT_EQ(ga_conf_readint("user"), 1);
+    {
+      ga_conf_session_scope inner(other);
+      EXPECT_EQ(ga_conf_readint("user"), 2);
+      {
+        // unbound inside a session
+        ga_conf_session_scope none(nullptr);
+        EXPECT_EQ(ga_conf_readint("user"), 0);
+      }
+      EXPECT_EQ(ga_conf_readint("user"), 2);
+    }
+    EXPECT_EQ(ga_conf_readint("user"), 1);
+  }
+  EXPECT_EQ(ga_conf_session_current(), nullptr);
+  ga_conf_session_destroy(&other);
+  EXPECT_EQ(other, nullptr);
+}
+
+TEST_F(GaConfTest, SessionsOnConcurrentThreads)
+{
+  ga_conf_session_t *other = ga_conf_session_create(4);
+  ASSERT_NE(other, nullptr);
+  ga_conf_session_writev(session_, "icr-port", "24000");
+  ga_conf_session_writev(other, "icr-port", "25000");
+
+  // each thread only ever sees its own session
+  int mismatches[2] = { 0, 0 };
+  auto reader = [&](ga_conf_session_t *session, int expected, int *mismatch) {
+    ga_conf_session_scope scope(session);
+    for (int i = 0; i < 10000; i++) {
+      if (ga_conf_readint("icr-port") != expected)
+        (*mismatch)++;
+    }
+  };
+  std::thread a(reader, session_, 24000, &mismatches[0]);
+  std::thread b(reader, other, 25000, &mismatches[1]);
+  a.join();
+  b.join();
+  EXPECT_EQ(mismatches[0], 0);
+  EXPECT_EQ(mismatches[1], 0);
+  ga_conf_session_destroy(&other);
+}
+
+TEST_F(GaConfTest, SessionIdentity)
+{
+  EXPECT_EQ(ga_conf_session_id(session_), 3);
+  EXPECT_EQ(ga_conf_session_id(nullptr), -1);
+  EXPECT_EQ(ga_conf_session_writev(nullptr, "user", "1"), -1);
+  EXPECT_EQ(ga_conf_session_writev(session_, nullptr, "1"), -1);
+
+  EXPECT_EQ(ga_conf_session_bind(session_), nullptr);
+  EXPECT_EQ(ga_conf_session_bind(nullptr), session_);
+}
+
+TEST_F(GaConfTest, SnapshotDefaults)
+{
+  ga_conf_clear();
+  std::shared_ptr<const ga_conf_snapshot_t> snap = ga_conf_snapshot();
+  ASSERT_NE(snap, nullptr);
+  EXPECT_EQ(snap->session, -1);
+#define GA_CONF_EXPECT_DEFAULT(type, field, key, defval) \
+  EXPECT_EQ(snap->field, (GA_CONF_TYPE_##type)(defval)) << key;
+  GA_CONF_SCHEMA(GA_CONF_EXPECT_DEFAULT)
+#undef GA_CONF_EXPECT_DEFAULT
+}
+
+TEST_F(GaConfTest, SnapshotTyping)
+{
+  ga_conf_writev("video-fps", "60");
+  ga_conf_writev("ice-port-min", "0x100");
+  ga_conf_writev("av-bundle", "false");
+  ga_conf_writev("k8s", "true");
+  ga_conf_writev("server-peer-id", "server 1");
+
+  std::shared_ptr<const ga_conf_snapshot_t> snap = ga_conf_snapshot();
+  EXPECT_EQ(snap->video_fps, 60);
+  EXPECT_EQ(snap->ice_port_min, 256);
+  EXPECT_FALSE(snap->av_bundle);
+  EXPECT_TRUE(snap->k8s);
+  EXPECT_EQ(snap->server_peer_id, "server 1");
+
+  // malformed values fall back to their defaults
+  ga_conf_writev("video-fps", "sixty");
+  ga_conf_writev("audio-ring-depth", "99999999999");
+  ga_conf_writev("av-bundle", "maybe");
+  EXPECT_EQ(ga_conf_snapshot_reload(), -1);
+  snap = ga_conf_snapshot();
+  EXPECT_EQ(snap->video_fps, 0);
+  EXPECT_EQ(snap->audio_ring_depth, 3);
+  EXPECT_TRUE(snap->av_bundle);
+}
+
+TEST_F(GaConfTest, SessionSnapshot)
+{
+  ga_conf_writev("video-fps", "60");
+  ga_conf_writev("video-codec", "h264");
+  ga_conf_session_writev(session_, "video-fps", "30");
+
+  std::shared_ptr<const ga_conf_snapshot_t> global = ga_conf_snapshot();
+  std::shared_ptr<const ga_conf_snapshot_t> own;
+  {
+    ga_conf_session_scope scope(session_);
+    own = ga_conf_snapshot();
+  }
+  EXPECT_EQ(global->session, -1);
+  EXPECT_EQ(global->video_fps, 60);
+  EXPECT_EQ(own->session, 3);
+  EXPECT_EQ(own->video_fps, 30);
+  EXPECT_EQ(own->video_codec, "h264");
+}
+
+TEST_F(GaConfTest, SnapshotIsReusedUntilChange)
+{
+  std::shared_ptr<const ga_conf_snapshot_t> a = ga_conf_snapshot();
+  std::shared_ptr<const ga_conf_snapshot_t> b = ga_conf_snapshot();
+  EXPECT_EQ(a.get(), b.get());
+
+  ga_conf_writev("video-fps", "24");
+  std::shared_ptr<const ga_conf_snapshot_t> c = ga_conf_snapshot();
+  EXPECT_NE(a.get(), c.get());
+  EXPECT_GT(c->generation, a->generation);
+  EXPECT_EQ(a->video_fps, 0);
+  EXPECT_EQ(c->video_fps, 24);
+}
+
+TEST_F(GaConfTest, ReloadKeepsHeldSnapshot)
+{
+  ConfFile file;
+  file.Write("video-fps = 30\nvideo-codec = h264\n");
+  ASSERT_GE(ga_conf_load(file.path()), 0);
+  ga_conf_writev("user", "7");
+
+  std::shared_ptr<const ga_conf_snapshot_t> held = ga_conf_snapshot();
+  EXPECT_EQ(held->video_fps, 30);
+
+  std::vector<Change> changes;
+  int id = ga_conf_snapshot_subscribe(record_change, &changes);
+  ASSERT_GE(id, 0);
+
+  file.Write("video-fps = 60\n");
+  EXPECT_EQ(ga_conf_reload(file.path()), 0);
+  ga_conf_snapshot_unsubscribe(id);
+
+  // the holder keeps a consistent view of the old configuration
+  EXPECT_EQ(held->video_fps, 30);
+  EXPECT_EQ(held->video_codec, "h264");
+  EXPECT_EQ(held->user, 7);
+
+  std::shared_ptr<const ga_conf_snapshot_t> cur = ga_conf_snapshot();
+  EXPECT_EQ(cur->video_fps, 60);
+  EXPECT_EQ(cur->video_codec, "");
+  // set at runtime, survives the reload
+  EXPECT_EQ(cur->user, 7);
+
+  ASSERT_EQ(changes.size(), 1u);
+  EXPECT_EQ(changes[0].prev_fps, 30);
+  EXPECT_EQ(changes[0].cur_fps, 60);
+}
+
+TEST_F(GaConfTest, FailedReloadLeavesConfiguration)
+{
+  ConfFile file;
+  file.Write("video-fps = 30\n");
+  ASSERT_GE(ga_conf_load(file.path()), 0);
+
+  EXPECT_EQ(ga_conf_reload("/nonexistent/ga-conf-test.conf"), -1);
+  EXPECT_EQ(ga_conf_readint("video-fps"), 30);
+  EXPECT_EQ(ga_conf_snapshot()->video_fps, 30);
+}
+
+TEST_F(GaConfTest, ReloadWhileReading)
+{
+  // Width and height always change together in the file
+  ConfFile file;
+  file.Write("video-res-width = 1280\nvideo-res-height = 720\n");
+  ASSERT_GE(ga_conf_load(file.path()), 0);
+
+  std::atomic<bool> stop{false};
+  std::atomic<int> torn{0};
+  std::atomic<int> reads{0};
+  std::thread reader([&]{
+    while (!stop) {
+      std::shared_ptr<const ga_conf_snapshot_t> snap = ga_conf_snapshot();
+      int w = snap->video_res_width, h = snap->video_res_height;
+      if (!((w == 1280 && h == 720) || (w == 1920 && h == 1080)))
+        torn++;
+      reads++;
+    }
+  });
+
+  for (int i = 0; i < 200; i++) {
+    file.Write((i % 2)? "video-res-width = 1280\nvideo-res-height = 720\n":
+                        "video-res-width = 1920\nvideo-res-height = 1080\n");
+    EXPECT_EQ(ga_conf_reload(file.path()), 0);
+  }
+  stop = true;
+  reader.join();
+
+  EXPECT_GT(reads, 0);
+  EXPECT_EQ(torn, 0);
+  EXPECT_EQ(ga_conf_snapshot()->video_res_width, 1280);
+}
+
+TEST_F(GaConfTest, WarnsAboutNearMissKeys)
+{
+  ConfFile file;
+  file.Write("vidoe-fps = 30\n"
+             "enable-audoi = 1\n"
+             "video-codec = h264\n"
+             "my-own-setting = 1\n"
+             "usr = 1\n");
+
+  testing::internal::CaptureStderr();
+  ASSERT_GE(ga_conf_load(file.path()), 0);
+  std::string err = testing::internal::GetCapturedStderr();
+
+  EXPECT_NE(err.find("unknown parameter 'vidoe-fps', did you mean 'video-fps'?"), std::string::npos) << err;
+  EXPECT_NE(err.find("unknown parameter 'enable-audoi', did you mean 'enable-audio'?"), std::string::npos) << err;
+  // known keys, keys far from any typed parameter and short keys are quiet
+  EXPECT_EQ(err.find("'video-codec'"), std::string::npos) << err;
+  EXPECT_EQ(err.find("my-own-setting"), std::string::npos) << err;
+  EXPECT_EQ(err.find("'usr'"), std::string::npos) << err;
+
+  // the misspelled value is not taken
+  EXPECT_EQ(ga_conf_snapshot()->video_fps, 0);
+
+  // reloading checks again
+  file.Write("video-fsp = 30\n");
+  testing::internal::CaptureStderr();
+  EXPECT_EQ(ga_conf_reload(file.path()), 0);
+  err = testing::internal::GetCapturedStderr();
+  EXPECT_NE(err.find("did you mean 'video-fps'?"), std::string::npos) << err;
+}
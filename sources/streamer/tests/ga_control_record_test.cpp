@@ -0,0 +1,238 @@
+// Copyright (C) 2023 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions
+// and limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include <gtest/gtest.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "ga-control-record.h"
+
+using namespace ga::webrtc;
+
+namespace {
+  const char kBase64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+  std::string base64(const std::vector<uint8_t> &in, bool pad = true)
+  {
+    std::string out;
+    size_t i = 0;
+    for (; i + 3 <= in.size(); i += 3) {
+      uint32_t v = (in[i] << 16) | (in[i + 1] << 8) | in[i + 2];
+      out += kBase64[(v >> 18) & 63];
+      out += kBase64[(v >> 12) & 63];
+      out += kBase64[(v >> 6) & 63];
+      out += kBase64[v & 63];
+    }
+    size_t rest = in.size() - i;
+    if (rest > 0) {
+      uint32_t v = (in[i] << 16) | (rest > 1 ? in[i + 1] << 8 : 0);
+      out += kBase64[(v >> 18) & 63];
+      out += kBase64[(v >> 12) & 63];
+      if (rest > 1)
+        out += kBase64[(v >> 6) & 63];
+      if (pad)
+        out.append(3 - rest, '=');
+    }
+    return out;
+  }
+
+  std::string tagged(const std::vector<uint8_t> &record, bool pad = true)
+  {
+    return std::string(1, kControlRecordTag) + base64(record, pad);
+  }
+
+  void put_u32(std::vector<uint8_t> &out, uint32_t v)
+  {
+    for (int i = 0; i < 4; i++)
+      out.push_back((uint8_t)(v >> (8 * i)));
+  }
+
+  void put_u64(std::vector<uint8_t> &out, uint64_t v)
+  {
+    put_u32(out, (uint32_t)v);
+    put_u32(out, (uint32_t)(v >> 32));
+  }
+
+  std::vector<uint8_t> mouse_down(int32_t x, int32_t y, uint8_t which)
+  {
+    std::vector<uint8_t> r = { kRecordMouseDown, 0 };
+    put_u32(r, (uint32_t)x);
+    put_u32(r, (uint32_t)y);
+    r.push_back(which);
+    return r;
+  }
+
+  std::vector<uint8_t> frame_stats(bool latency)
+  {
+    std::vector<uint8_t> r = { kRecordFrameStats, (uint8_t)(latency ? kRecordHasLatency : 0) };
+    for (uint32_t v = 1; v <= 5; v++)
+      put_u32(r, v * 100);
+    if (latency)
+      put_u64(r, 0x0123456789abcdefull);
+    return r;
+  }
+}
+
+TEST(ControlRecordTest, ParsesFixedRecords)
+{
+  ControlRecord record;
+  ASSERT_TRUE(ParseControlRecord(tagged(mouse_down(-5, 720, 2)), &record));
+  EXPECT_EQ(kRecordMouseDown, record.type);
+  EXPECT_EQ(-5, record.mouse.x);
+  EXPECT_EQ(720, record.mouse.y);
+  EXPECT_EQ(2, record.mouse.which);
+  EXPECT_FALSE(record.HasLatency());
+
+  ASSERT_TRUE(ParseControlRecord(tagged(frame_stats(true)), &record));
+  EXPECT_EQ(kRecordFrameStats, record.type);
+  EXPECT_EQ(100, record.framestats.ts);
+  EXPECT_EQ(500, record.framestats.packet_loss);
+  EXPECT_TRUE(record.HasLatency());
+  EXPECT_EQ(0x0123456789abcdefull, record.latency_ms);
+}
+
+TEST(ControlRecordTest, ParsesUnpaddedBase64)
+{
+  ControlRecord record;
+  // 11 bytes leave a partial last group
+  ASSERT_TRUE(ParseControlRecord(tagged(mouse_down(1, 2, 3), false), &record));
+  EXPECT_EQ(3, record.mouse.which);
+}
+
+TEST(ControlRecordTest, CommandTakesRestOfRecord)
+{
+  std::vector<uint8_t> r = { kRecordTouch, 0, 7 };
+  std::string command = "d 0 10 10 255";
+  r.insert(r.end(), command.begin(), command.end());
+
+  ControlRecord record;
+  ASSERT_TRUE(ParseControlRecord(tagged(r), &record));
+  EXPECT_EQ(7, record.input.id);
+  EXPECT_EQ(command, std::string(record.data, record.data_size));
+}
+
+TEST(ControlRecordTest, RejectsTruncatedRecords)
+{
+  ControlRecord record;
+  std::vector<uint8_t> full = frame_stats(true);
+  for (size_t size = 0; size < full.size(); size++) {
+    std::vector<uint8_t> r(full.begin(), full.begin() + size);
+    EXPECT_FALSE(ParseControlRecord(tagged(r), &record)) << size << " bytes";
+  }
+  // Latency flag without the latency field
+  std::vector<uint8_t> r = frame_stats(false);
+  r[1] = kRecordHasLatency;
+  EXPECT_FALSE(ParseControlRecord(tagged(r), &record));
+
+  std::vector<uint8_t> touch = { kRecordTouch, 0 };
+  EXPECT_FALSE(ParseControlRecord(tagged(touch), &record));
+}
+
+TEST(ControlRecordTest, RejectsOversizedRecords)
+{
+  ControlRecord record;
+  // Trailing bytes after a fixed record
+  std::vector<uint8_t> r = mouse_down(1, 2, 3);
+  r.push_back(0);
+  EXPECT_FALSE(ParseControlRecord(tagged(r), &record));
+
+  // Records that do not fit the decode buffer
+  std::vector<uint8_t> touch = { kRecordTouch, 0, 1 };
+  touch.resize(kControlRecordMaxSize, 'x');
+  EXPECT_TRUE(ParseControlRecord(tagged(touch), &record));
+  touch.push_back('x');
+  EXPECT_FALSE(ParseControlRecord(tagged(touch), &record));
+  touch.resize(64 * 1024, 'x');
+  EXPECT_FALSE(ParseControlRecord(tagged(touch), &record));
+}
+
+TEST(ControlRecordTest, RejectsMalformedRecords)
+{
+  ControlRecord record;
+  EXPECT_FALSE(ParseControlRecord("", &record));
+  EXPECT_FALSE(ParseControlRecord("!", &record));
+  EXPECT_FALSE(ParseControlRecord("{\"type\":\"control\"}", &record));
+  // Missing tag
+  EXPECT_FALSE(ParseControlRecord(base64(mouse_down(1, 2, 3)), &record));
+
+  std::vector<uint8_t> unknown = { 0, 0, 1, 2, 3, 4 };
+  EXPECT_FALSE(ParseControlRecord(tagged(unknown), &record));
+  unknown[0] = kRecordLatency;  // server to client only
+  EXPECT_FALSE(ParseControlRecord(tagged(unknown), &record));
+  unknown[0] = 0xff;
+  EXPECT_FALSE(ParseControlRecord(tagged(unknown), &record));
+}
+
+TEST(ControlRecordTest, RejectsInvalidBase64)
+{
+  ControlRecord record;
+  std::string valid = tagged(mouse_down(1, 2, 3));
+  ASSERT_TRUE(ParseControlRecord(valid, &record));
+
+  // Characters outside the alphabet
+  for (char c : std::string(" .-_\n\0", 6)) {
+    std::string bad = valid;
+    bad[4] = c;
+    EXPECT_FALSE(ParseControlRecord(bad, &record)) << (int)c;
+  }
+  // Padding in the middle, too much padding
+  std::string bad = valid;
+  bad[4] = '=';
+  EXPECT_FALSE(ParseControlRecord(bad, &record));
+  EXPECT_FALSE(ParseControlRecord(valid + "=", &record));
+  EXPECT_FALSE(ParseControlRecord(valid + "==", &record));
+  std::string four = tagged(frame_stats(false));  // 22 bytes, 2 padding
+  EXPECT_FALSE(ParseControlRecord(four + "=", &record));
+
+  // A single character cannot make a byte
+  std::vector<uint8_t> key = { kRecordKeyDown, 0 };
+  put_u32(key, 65);
+  std::string lone = tagged(key);
+  ASSERT_TRUE(ParseControlRecord(lone, &record));
+  EXPECT_FALSE(ParseControlRecord(lone + "A", &record));
+
+  // Non zero bits after the last byte
+  std::string dirty = tagged(mouse_down(1, 2, 3), false);
+  dirty.back() = kBase64[(strchr(kBase64, dirty.back()) - kBase64) | 1];
+  EXPECT_FALSE(ParseControlRecord(dirty, &record));
+}
+
+TEST(ControlRecordTest, WritesLatencyRecord)
+{
+  LatencyRecord latency;
+  latency.encode_time_ms = 12;
+  uint8_t out[kLatencyRecordMaxSize];
+
+  ASSERT_EQ(10u, WriteLatencyRecord(latency, out, sizeof(out)));
+  EXPECT_EQ(kRecordLatency, out[0]);
+  EXPECT_EQ(0, out[1]);
+  EXPECT_EQ(12, out[2]);
+
+  latency.has_client              = true;
+  latency.client_send_time_ms     = 1;
+  latency.server_received_time_ms = 2;
+  latency.server_render_time_ms   = 3;
+  ASSERT_EQ(kLatencyRecordMaxSize, WriteLatencyRecord(latency, out, sizeof(out)));
+  EXPECT_EQ(kRecordHasClient, out[1]);
+  EXPECT_EQ(1, out[10]);
+  EXPECT_EQ(2, out[18]);
+  EXPECT_EQ(3, out[26]);
+
+  EXPECT_EQ(0u, WriteLatencyRecord(latency, out, sizeof(out) - 1));
+}
@@ -0,0 +1,170 @@
+// Copyright (C) 2023 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions
+// and limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include <gtest/gtest.h>
+#include <atomic>
+#include <string.h>
+#include <ga-module.h>
+#include <encoder-common.h>
+
+// Allocation counting hook. The C allocator is replaced for the whole
+// process, shared libraries and operator new included, and forwards to
+// the glibc implementation.
+extern "C" {
+  void *__libc_malloc(size_t size);
+  void *__libc_calloc(size_t nmemb, size_t size);
+  void *__libc_realloc(void *ptr, size_t size);
+}
+
+namespace {
+  std::atomic<bool> g_counting{false};
+  std::atomic<long> g_allocs{0};
+
+  void count_alloc()
+  {
+    if (g_counting.load(std::memory_order_relaxed))
+      g_allocs.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  // Counts allocations made while alive
+  class AllocationCounter
+  {
+  public:
+    AllocationCounter() { g_allocs = 0; g_counting = true; }
+    ~AllocationCounter() { g_counting = false; }
+    long count() const { return g_allocs.load(); }
+  };
+
+  // Side data attached by the video path for one frame: the frame
+  // metadata, plus a latency message of |latency_size| if not zero.
+  void send_frame(ga_buffer_pool_t *pool, int latency_size)
+  {
+    ga_buffer_t *buf = ga_buffer_pool_get(pool, 64 * 1024);
+    ASSERT_NE(buf, nullptr);
+
+    ga_packet_t pkt;
+    ga_init_packet(&pkt);
+    pkt.buf  = buf;
+    pkt.data = buf->data.data();
+    pkt.size = (int)buf->data.size();
+
+    FrameMetaData *meta = (FrameMetaData *)ga_packet_new_side_data(
+      &pkt, ga_packet_side_data_type::GA_PACKET_DATA_NEW_EXTRADATA, sizeof(FrameMetaData));
+    ASSERT_NE(meta, nullptr);
+    meta->last_slice = true;
+    meta->encode_end_ms = 42;
+    if (latency_size > 0) {
+      uint8_t *latency = ga_packet_new_side_data(
+        &pkt, ga_packet_side_data_type::GA_PACKET_DATA_PALETTE, latency_size);
+      ASSERT_NE(latency, nullptr);
+      memset(latency, 0x5a, latency_size);
+    }
+
+    int size = 0;
+    FrameMetaData *got = (FrameMetaData *)ga_packet_get_side_data(
+      &pkt, ga_packet_side_data_type::GA_PACKET_DATA_NEW_EXTRADATA, &size);
+    EXPECT_EQ(got, meta);
+    EXPECT_EQ(size, (int)sizeof(FrameMetaData));
+    EXPECT_EQ(got->encode_end_ms, 42u);
+
+    ga_packet_free_side_data(&pkt);
+    ga_buffer_unref(&buf);
+  }
+}
+
+extern "C" void *malloc(size_t size)
+{
+  count_alloc();
+  return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t nmemb, size_t size)
+{
+  count_alloc();
+  return __libc_calloc(nmemb, size);
+}
+
+extern "C" void *realloc(void *ptr, size_t size)
+{
+  count_alloc();
+  return __libc_realloc(ptr, size);
+}
+
+TEST(GaPacketTest, FrameMetaDataIsInline)
+{
+  ga_packet_t pkt;
+  ga_init_packet(&pkt);
+
+  AllocationCounter counter;
+  uint8_t *data = ga_packet_new_side_data(
+    &pkt, ga_packet_side_data_type::GA_PACKET_DATA_NEW_EXTRADATA, sizeof(FrameMetaData));
+  ASSERT_NE(data, nullptr);
+  EXPECT_GE(data, pkt.side_data_storage);
+  EXPECT_LT(data, pkt.side_data_storage + sizeof(pkt.side_data_storage));
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(data) % 16, 0u);
+  ga_packet_free_side_data(&pkt);
+  EXPECT_EQ(counter.count(), 0);
+
+  EXPECT_EQ(pkt.side_data, nullptr);
+  EXPECT_EQ(pkt.side_data_elems, 0);
+}
+
+TEST(GaPacketTest, ManySideData)
+{
+  ga_packet_t pkt;
+  ga_init_packet(&pkt);
+
+  // more entries than held inline, small and large ones
+  const int sizes[] = { 8, 3000, 16, 100000, 200 };
+  uint8_t *data[5];
+  for (int i = 0; i < 5; i++) {
+    data[i] = ga_packet_new_side_data(&pkt, ga_packet_side_data_type::GA_PACKET_DATA_PALETTE, sizes[i]);
+    ASSERT_NE(data[i], nullptr);
+    memset(data[i], i, sizes[i] + GA_INPUT_BUFFER_PADDING_SIZE);
+  }
+  ASSERT_EQ(pkt.side_data_elems, 5);
+  for (int i = 0; i < 5; i++) {
+    EXPECT_EQ(pkt.side_data[i].data, data[i]);
+    EXPECT_EQ(pkt.side_data[i].size, sizes[i]);
+    EXPECT_EQ(data[i][sizes[i] - 1], i);
+  }
+  ga_packet_free_side_data(&pkt);
+  EXPECT_EQ(pkt.side_data_elems, 0);
+
+  // the packet can be reused
+  EXPECT_NE(ga_packet_new_side_data(&pkt, ga_packet_side_data_type::GA_PACKET_DATA_PALETTE, 4), nullptr);
+  ga_packet_free_side_data(&pkt);
+}
+
+// Once warmed up, streaming frames with side data does not allocate.
+TEST(GaPacketTest, SteadyStateDoesNotAllocate)
+{
+  ga_buffer_pool_t *pool = ga_buffer_pool_create(4);
+  ASSERT_NE(pool, nullptr);
+
+  const int latency_sizes[] = { 0, 120, 700, 4000 };
+  for (int i = 0; i < 16; i++)
+    send_frame(pool, latency_sizes[i % 4]);
+
+  {
+    AllocationCounter counter;
+    for (int i = 0; i < 1000; i++)
+      send_frame(pool, latency_sizes[i % 4]);
+    EXPECT_EQ(counter.count(), 0);
+  }
+
+  ga_buffer_pool_destroy(&pool);
+}
@@ -0,0 +1,221 @@
+// Copyright (C) 2023 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions
+// and limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+// Benchmark for the input batcher of the Android controller.
+//
+// A touch device sends drags at a high rate: a down, a stream of moves and
+// an up. The commands are written to a socket pair standing in for the
+// virtual input socket, the way the controller writes to the input pipe.
+// Compared are the previous injection, which wrote each command and its
+// commit separately, the batcher without coalescing and the batcher with
+// the given coalescing windows.
+//
+// Reported are the write calls per event and the delay from the push of a
+// move to the arrival of its position. Moves replaced by a newer position
+// before being written never arrive and are counted as coalesced.
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ga-input-batcher.h"
+
+using namespace std::chrono;
+using ga::webrtc::InputBatcher;
+
+namespace {
+    int g_rate = 240;           // events per second
+    int g_seconds = 3;
+    int g_drag = 60;            // moves per drag
+    std::vector<int> g_windows = { 4, 8, 16 };
+
+    uint64_t now_ns()
+    {
+        return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+    }
+
+    struct Result
+    {
+        uint64_t events = 0;
+        uint64_t writes = 0;
+        uint64_t moves = 0;
+        uint64_t delivered = 0;
+        std::vector<uint64_t> latency;
+    };
+
+    // Reads the receiving end, the position of a move is its sequence number
+    void read_moves(int fd, const std::vector<uint64_t> *pushed, Result *r)
+    {
+        std::string pending;
+        char buf[4096];
+        ssize_t n;
+        while ((n = read(fd, buf, sizeof(buf))) > 0) {
+            uint64_t now = now_ns();
+            pending.append(buf, n);
+            size_t eol;
+            while ((eol = pending.find('\n')) != std::string::npos) {
+                unsigned contact, seq;
+                if (sscanf(pending.c_str(), "m %u %u", &contact, &seq) == 2 && seq < pushed->size()) {
+                    r->latency.push_back(now - (*pushed)[seq]);
+                    r->delivered++;
+                }
+                pending.erase(0, eol + 1);
+            }
+        }
+    }
+
+    // |window| -1 is the previous injection, command and commit written apart
+    Result run(int window)
+    {
+        int fds[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+            perror("socketpair");
+            exit(1);
+        }
+        Result r;
+        std::vector<uint64_t> pushed(uint64_t(g_rate) * g_seconds + 1, 0);
+        std::thread reader(read_moves, fds[1], &pushed, &r);
+        std::atomic<uint64_t> writes(0);
+
+        auto write_all = [&](const std::string &commands) {
+            if (write(fds[0], commands.data(), commands.size()) < 0)
+                perror("write");
+            writes++;
+        };
+        InputBatcher *batcher = nullptr;
+        if (window >= 0) {
+            batcher = new InputBatcher(1, window, [&](size_t, const std::string &commands) {
+                write_all(commands);
+            });
+        }
+
+        auto period = nanoseconds(1000000000LL / g_rate);
+        auto next = steady_clock::now();
+        char cmd[64], commit[] = "c\n";
+        for (size_t seq = 1; seq < pushed.size(); seq++) {
+            std::this_thread::sleep_until(next);
+            next += period;
+
+            int n;
+            size_t phase = seq % (g_drag + 2);
+            if (phase == 0) {
+                n = snprintf(cmd, sizeof(cmd), "d 0 %zu 100 255\n", seq);
+            } else if (phase == size_t(g_drag + 1)) {
+                n = snprintf(cmd, sizeof(cmd), "u 0\n");
+            } else {
+                n = snprintf(cmd, sizeof(cmd), "m 0 %zu 100 255\n", seq);
+                r.moves++;
+            }
+            pushed[seq] = now_ns();
+            r.events++;
+            if (batcher) {
+                memcpy(cmd + n, commit, sizeof(commit));
+                batcher->Push(0, cmd, n + 2);
+            } else {
+                write_all(std::string(cmd, n));
+                write_all(commit);
+            }
+        }
+        delete batcher;
+        shutdown(fds[0], SHUT_WR);
+        reader.join();
+        close(fds[0]);
+        close(fds[1]);
+
+        r.writes = writes;
+        std::sort(r.latency.begin(), r.latency.end());
+        return r;
+    }
+
+    void report(const char *name, const Result &r)
+    {
+        auto pct = [&r](double p) -> double {
+            if (r.latency.empty())
+                return 0.0;
+            size_t i = std::min(r.latency.size() - 1, size_t(p * r.latency.size()));
+            return r.latency[i] / 1000000.0;
+        };
+        uint64_t coalesced = r.moves - r.delivered;
+        printf("%-10s writes/event=%.2f  moves coalesced=%llu/%llu  latency ms p50=%.2f p99=%.2f max=%.2f\n",
+               name, double(r.writes) / r.events, (unsigned long long)coalesced,
+               (unsigned long long)r.moves, pct(0.5), pct(0.99), pct(1.0));
+    }
+}
+
+static void usage(const char* app)
+{
+    printf("usage: %s [options]\n", app);
+    printf("  -r, --rate <n>       events per second (default: %d)\n", g_rate);
+    printf("  -s, --seconds <n>    duration of each run (default: %d)\n", g_seconds);
+    printf("  -d, --drag <n>       moves between down and up (default: %d)\n", g_drag);
+    printf("  -w, --window <ms>    coalescing window to run, repeatable (default: 4, 8, 16)\n");
+}
+
+int main(int argc, char* argv[])
+{
+    static const struct option long_opts[] = {
+        { "rate",    required_argument, nullptr, 'r' },
+        { "seconds", required_argument, nullptr, 's' },
+        { "drag",    required_argument, nullptr, 'd' },
+        { "window",  required_argument, nullptr, 'w' },
+        { "help",    no_argument,       nullptr, 'h' },
+        { nullptr,   0,                 nullptr, 0 },
+    };
+
+    std::vector<int> windows;
+    int opt;
+    while ((opt = getopt_long(argc, argv, "r:s:d:w:h", long_opts, nullptr)) != -1) {
+        switch (opt) {
+        case 'r': g_rate = atoi(optarg); break;
+        case 's': g_seconds = atoi(optarg); break;
+        case 'd': g_drag = atoi(optarg); break;
+        case 'w': windows.push_back(atoi(optarg)); break;
+        case 'h': usage(argv[0]); return 0;
+        default: usage(argv[0]); return -1;
+        }
+    }
+    if (!windows.empty())
+        g_windows = windows;
+
+    if (g_rate <= 0 || g_rate > 10000 || g_seconds <= 0 || g_drag <= 0) {
+        usage(argv[0]);
+        return -1;
+    }
+
+    printf("rate=%d/s seconds=%d drag=%d\n", g_rate, g_seconds, g_drag);
+
+    report("separate", run(-1));
+    report("batched", run(0));
+    for (int w : g_windows) {
+        if (w <= 0)
+            continue;
+        char name[32];
+        snprintf(name, sizeof(name), "window %d", w);
+        report(name, run(w));
+    }
+
+    return 0;
+}
@@ -0,0 +1,192 @@
+// Copyright (C) 2023 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions
+// and limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ga-input-batcher.h"
+
+using namespace std::chrono;
+using ga::webrtc::InputBatcher;
+
+namespace {
+  // Window long enough for a test to push before it ends
+  const int kWindowMs = 200;
+
+  struct Write
+  {
+    size_t      device;
+    std::string commands;
+  };
+
+  class InputBatcherTest : public testing::Test
+  {
+  protected:
+    std::unique_ptr<InputBatcher> make(size_t devices, int window_ms)
+    {
+      return std::make_unique<InputBatcher>(devices, window_ms,
+        [this](size_t device, const std::string &commands) {
+          std::lock_guard<std::mutex> lock(mutex_);
+          writes_.push_back({ device, commands });
+        });
+    }
+
+    std::vector<Write> writes()
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      return writes_;
+    }
+
+    // Waits for |count| writes, returns false on timeout
+    bool wait_writes(size_t count, milliseconds timeout = milliseconds(2000))
+    {
+      auto deadline = steady_clock::now() + timeout;
+      while (steady_clock::now() < deadline) {
+        if (writes().size() >= count)
+          return true;
+        std::this_thread::sleep_for(milliseconds(1));
+      }
+      return false;
+    }
+
+    std::mutex         mutex_;
+    std::vector<Write> writes_;
+  };
+}
+
+TEST_F(InputBatcherTest, WithoutWindowEveryPushIsOneWrite)
+{
+  auto batcher = make(1, 0);
+  EXPECT_EQ(0, batcher->WindowMs());
+  batcher->Push(0, "d 0 10 10 255\nc\n");
+  batcher->Push(0, "m 0 11 11 255\nc\n");
+  batcher->Push(0, "m 0 12 12 255\nc");  // newline is added
+
+  auto w = writes();
+  ASSERT_EQ(3u, w.size());
+  EXPECT_EQ("d 0 10 10 255\nc\n", w[0].commands);
+  EXPECT_EQ("m 0 11 11 255\nc\n", w[1].commands);
+  EXPECT_EQ("m 0 12 12 255\nc\n", w[2].commands);
+}
+
+TEST_F(InputBatcherTest, NegativeWindowIsTakenAsZero)
+{
+  auto batcher = make(1, -1);
+  EXPECT_EQ(0, batcher->WindowMs());
+  batcher->Push(0, "m 0 1 1 255\nc\n");
+  batcher->Push(0, "m 0 2 2 255\nc\n");
+  EXPECT_EQ(2u, writes().size());
+}
+
+TEST_F(InputBatcherTest, FirstMoveAfterQuietWindowIsWritten)
+{
+  auto batcher = make(1, kWindowMs);
+  batcher->Push(0, "m 0 1 1 255\nc\n");
+  auto w = writes();
+  ASSERT_EQ(1u, w.size());
+  EXPECT_EQ("m 0 1 1 255\nc\n", w[0].commands);
+}
+
+TEST_F(InputBatcherTest, KeepsLatestMovePerContactUntilWindowEnds)
+{
+  auto batcher = make(1, kWindowMs);
+  batcher->Push(0, "m 0 1 1 255\nc\n");
+  batcher->Push(0, "m 0 2 2 255\nc\n");
+  batcher->Push(0, "m 1 5 5 255\nc\n");
+  batcher->Push(0, "m 0 3 3 255\nm 1 6 6 255\nc\n");
+  EXPECT_EQ(1u, writes().size());
+
+  ASSERT_TRUE(wait_writes(2));
+  auto w = writes();
+  ASSERT_EQ(2u, w.size());
+  EXPECT_EQ("m 0 3 3 255\nm 1 6 6 255\nc\n", w[1].commands);
+}
+
+TEST_F(InputBatcherTest, OtherCommandsFlushPendingMovesFirst)
+{
+  auto batcher = make(1, kWindowMs);
+  batcher->Push(0, "d 0 1 1 255\nc\n");
+  batcher->Push(0, "m 0 2 2 255\nc\n");  // first move, written
+  batcher->Push(0, "m 0 3 3 255\nc\n");  // held
+  batcher->Push(0, "m 0 4 4 255\nc\n");  // replaces the held move
+  batcher->Push(0, "u 0\nc\n");
+
+  auto w = writes();
+  ASSERT_EQ(3u, w.size());
+  EXPECT_EQ("d 0 1 1 255\nc\n", w[0].commands);
+  EXPECT_EQ("m 0 2 2 255\nc\n", w[1].commands);
+  EXPECT_EQ("m 0 4 4 255\nc\nu 0\nc\n", w[2].commands);
+
+  // Nothing is left for the window to write
+  std::this_thread::sleep_for(milliseconds(2 * kWindowMs));
+  EXPECT_EQ(3u, writes().size());
+}
+
+TEST_F(InputBatcherTest, MixedPushIsNotCoalesced)
+{
+  auto batcher = make(1, kWindowMs);
+  batcher->Push(0, "m 0 1 1 255\nc\n");
+  batcher->Push(0, "m 0 2 2 255\nu 1\nc\n");
+  batcher->Push(0, "m 0 3 3 255\n");  // no commit
+  EXPECT_EQ(3u, writes().size());
+}
+
+TEST_F(InputBatcherTest, DevicesAreCoalescedSeparately)
+{
+  auto batcher = make(2, kWindowMs);
+  batcher->Push(0, "m 0 1 1 255\nc\n");
+  batcher->Push(0, "m 0 2 2 255\nc\n");  // held
+  batcher->Push(1, "m 0 7 7 255\nc\n");  // first move of device 1
+  batcher->Push(1, "u 0\nc\n");
+
+  auto w = writes();
+  ASSERT_EQ(3u, w.size());
+  EXPECT_EQ(1u, w[1].device);
+  EXPECT_EQ(1u, w[2].device);
+  EXPECT_EQ("u 0\nc\n", w[2].commands);
+
+  ASSERT_TRUE(wait_writes(4));
+  w = writes();
+  EXPECT_EQ(0u, w[3].device);
+  EXPECT_EQ("m 0 2 2 255\nc\n", w[3].commands);
+}
+
+TEST_F(InputBatcherTest, DestructionWritesPendingMoves)
+{
+  auto batcher = make(1, 10 * 1000);
+  batcher->Push(0, "m 0 1 1 255\nc\n");
+  batcher->Push(0, "m 0 2 2 255\nc\n");
+  EXPECT_EQ(1u, writes().size());
+
+  batcher.reset();
+  auto w = writes();
+  ASSERT_EQ(2u, w.size());
+  EXPECT_EQ("m 0 2 2 255\nc\n", w[1].commands);
+}
+
+TEST_F(InputBatcherTest, IgnoresUnknownDeviceAndEmptyPush)
+{
+  auto batcher = make(1, 0);
+  batcher->Push(1, "u 0\nc\n");
+  batcher->Push(0, "");
+  EXPECT_TRUE(writes().empty());
+}
@@ -14,12 +14,17 @@
 //
 // SPDX-License-Identifier: Apache-2.0
 
+#include <algorithm>
 #include <chrono>
 #include <csignal>
 #include <mutex>
 #include <string>
+#include <vector>
 #include <stdio.h>
 #include <stdlib.h>
+#include <time.h>
+#include <sys/resource.h>
+#include <ga-conf.h>
 #include <ga-module.h>
 #include <CSendRecvMessage.h>
 
@@ -41,6 +46,35 @@ namespace {
   std::condition_variable g_cv;
   static bool g_stop = false;
   static FILE* g_bitstream = NULL;
+
+  // Benchmark of the receiver, see run_bench()
+  static int g_bench_seconds = 0;
+  static int g_sessions = 1;
+
+  struct BenchStats {
+    uint64_t frames = 0;
+    uint64_t keyframes = 0;
+    uint64_t bytes = 0;
+    int64_t last_us = 0;
+    std::vector<int32_t> intervals_us;
+  };
+  std::mutex g_bench_mutex;
+  bool g_measuring = false;
+  std::vector<BenchStats> g_bench;   // per session
+
+  int64_t now_us()
+  {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+  }
+
+  double cpu_seconds()
+  {
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_utime.tv_sec + ru.ru_stime.tv_sec + (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6;
+  }
 }
 
 std::string ga_conf_readstr(const char *key)
@@ -61,8 +95,11 @@ std::string ga_conf_readstr(const char *key)
 int ga_conf_readint(const char *key)
 {
   ga_logger(Severity::DBG, "ga_conf_readint: %s\n", key);
-  if (std::string("android-session") == key ||
-      std::string("user") == key) {
+  if (std::string("android-session") == key) {
+    // sessions of the benchmark are bound to the receivers
+    return std::max(0, ga_conf_session_id(ga_conf_session_current()));
+  } else if (std::string("user") == key ||
+      std::string("irrv-recv-timeout-ms") == key) {
     return 0;
   } else if (std::string("icr-port") == key) {
     return g_icr_port;
@@ -87,7 +124,21 @@ int encoder_send_packet(const char* prefix, int channelId, ga_packet_t *pkt, int
   ga_logger(Severity::DBG, "encoder_send_packet: pkt=%p, size=%d\n", pkt, (pkt)? pkt->size: 0);
   if (!pkt)
     return -1;
-  if (g_bitstream) {
+  if (g_bench_seconds > 0) {
+    std::lock_guard<std::mutex> lock(g_bench_mutex);
+    if (g_measuring && channelId >= 0 && channelId < (int)g_bench.size()) {
+      BenchStats& b = g_bench[channelId];
+      int64_t now = now_us();
+      if (b.last_us)
+        b.intervals_us.push_back((int32_t)(now - b.last_us));
+      b.last_us = now;
+      b.frames++;
+      b.bytes += pkt->size;
+      if (pkt->flags & IRRV_VFRAME_FLAG_KEY)
+        b.keyframes++;
+    }
+  }
+  if (g_bitstream && channelId == 0) {
     fwrite(pkt->data, 1, pkt->size, g_bitstream);
   }
   return 0;
@@ -105,6 +156,7 @@ static void signal_handler(int signal) {
 void usage(const char* app)
 {
     printf("usage: %s [options] <output>\n", app);
+    printf("       %s [options] --bench <seconds> [--sessions <n>] [<output>]\n", app);
     printf("\n");
     printf("Captured output will be in a raw encoded format, i.e. .h264, .h265, .av1\n");
     printf("\n");
@@ -119,10 +171,113 @@ void usage(const char* app)
     printf("  --icr-ip <ip>           ICR server ip address (default: %s)\n", g_icr_default_host);
     printf("  --icr-port <port>       ICR server port (default: %d)\n", g_icr_default_port);
     printf("\n");
+    printf("Benchmark options, against ICR or irrv-server-emu:\n");
+    printf("  --bench <seconds>       Measure the receiver for the given time, after 1s of warm up\n");
+    printf("  --sessions <n>          Receivers of sessions 0 to n-1 (default: 1)\n");
+    printf("\n");
     printf("AIC (Android In Container) server options:\n");
     printf("  --workdir <path>        Path to AIC workdir (default: %s)\n", g_default_workdir);
 }
 
+// Runs the receivers of g_sessions sessions for g_bench_seconds and
+// reports what they received: rates, CPU time of the process per frame,
+// and the spread of the frame inter-arrival times.
+static int run_bench()
+{
+  std::vector<ga_conf_session_t*> confs(g_sessions, nullptr);
+  std::vector<std::unique_ptr<CSendRecvMessage>> receivers;
+  g_bench.resize(g_sessions);
+
+  for (int i = 0; i < g_sessions; ++i) {
+    confs[i] = ga_conf_session_create(i);
+    receivers.push_back(std::make_unique<CSendRecvMessage>(false, i, confs[i]));
+    receivers.back()->start();
+  }
+
+  int ready = 0;
+  auto deadline = std::chrono::system_clock::now() + 5s;
+  for (int i = 0; i < g_sessions; ++i) {
+    if (!receivers[i]->ready(deadline)) {
+      fprintf(stderr, "warning: session %d not ready after 5s\n", i);
+      continue;
+    }
+    receivers[i]->irrv_set_encodestart();
+    receivers[i]->irrv_set_keyframe();
+    ready++;
+  }
+  if (ready == 0) {
+    fprintf(stderr, "fatal: no session ready\n");
+    return -1;
+  }
+
+  {
+    std::unique_lock<std::mutex> lock(g_mutex);
+    g_cv.wait_for(lock, 1s, []{ return g_stop; });
+  }
+  {
+    std::lock_guard<std::mutex> lock(g_bench_mutex);
+    g_measuring = true;
+  }
+  double cpu_start = cpu_seconds();
+  auto start = std::chrono::steady_clock::now();
+  {
+    std::unique_lock<std::mutex> lock(g_mutex);
+    g_cv.wait_for(lock, std::chrono::seconds(g_bench_seconds), []{ return g_stop; });
+  }
+  {
+    std::lock_guard<std::mutex> lock(g_bench_mutex);
+    g_measuring = false;
+  }
+  double cpu = cpu_seconds() - cpu_start;
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  ga_ioctl_recvstats_t total{};
+  long jitter_max_us = 0;
+  for (int i = 0; i < g_sessions; ++i) {
+    receivers[i]->irrv_set_encodestop();
+    receivers[i]->stop();
+    ga_ioctl_recvstats_t stats{};
+    receivers[i]->get_recv_stats(&stats);
+    total.jitter_us += stats.jitter_us;
+    total.assembly_max_us = std::max(total.assembly_max_us, stats.assembly_max_us);
+    total.timeouts += stats.timeouts;
+    total.reconnects += stats.reconnects;
+    jitter_max_us = std::max(jitter_max_us, stats.jitter_us);
+  }
+  receivers.clear();
+  for (auto& conf : confs)
+    ga_conf_session_destroy(&conf);
+
+  uint64_t frames = 0, keyframes = 0, bytes = 0;
+  std::vector<int32_t> intervals;
+  for (auto& b : g_bench) {
+    frames += b.frames;
+    keyframes += b.keyframes;
+    bytes += b.bytes;
+    intervals.insert(intervals.end(), b.intervals_us.begin(), b.intervals_us.end());
+  }
+  std::sort(intervals.begin(), intervals.end());
+  auto pct = [&intervals](double p) -> double {
+    if (intervals.empty())
+      return 0.0;
+    size_t i = std::min(intervals.size() - 1, size_t(p * intervals.size()));
+    return intervals[i] / 1000.0;
+  };
+
+  printf("Benchmark: %d/%d sessions over %.1f s\n", ready, g_sessions, seconds);
+  printf("  frames:   %llu, %.1f/s, %.2f/s per session, %llu key frames\n",
+    (unsigned long long)frames, frames / seconds, frames / seconds / ready, (unsigned long long)keyframes);
+  printf("  bytes:    %.1f MB, %.2f MB/s, %.2f Mbit/s\n",
+    bytes / 1e6, bytes / seconds / 1e6, bytes * 8 / seconds / 1e6);
+  printf("  cpu:      %.2f s, %.1f%% of a core, %.1f us/frame\n",
+    cpu, cpu / seconds * 100, frames ? cpu * 1e6 / frames : 0.0);
+  printf("  interval: p50 %.2f ms, p90 %.2f ms, p99 %.2f ms, max %.2f ms\n",
+    pct(0.5), pct(0.9), pct(0.99), pct(1.0));
+  printf("  jitter:   avg %ld us, max %ld us, assembly max %ld us, %ld timeouts, %ld reconnects\n",
+    total.jitter_us / ready, jitter_max_us, total.assembly_max_us, total.timeouts, total.reconnects);
+  return 0;
+}
+
 int main(int argc, char* argv[])
 {
   int idx;
@@ -143,21 +298,45 @@ int main(int argc, char* argv[])
     } else if (std::string("--workdir") == argv[idx]) {
       if (++idx >= argc) break;
       g_workdir = argv[idx];
+    } else if (std::string("--bench") == argv[idx]) {
+      if (++idx >= argc) break;
+      g_bench_seconds = atoi(argv[idx]);
+    } else if (std::string("--sessions") == argv[idx]) {
+      if (++idx >= argc) break;
+      g_sessions = atoi(argv[idx]);
     } else {
       break;
     }
   }
 
-  if(idx >= argc) {
+  if (g_bench_seconds < 0 || g_sessions <= 0 || (g_sessions > 1 && g_bench_seconds == 0)) {
+    fprintf(stderr, "fatal: invalid benchmark options\n");
+    usage(argv[0]);
+    return -1;
+  }
+
+  if(idx >= argc && g_bench_seconds == 0) {
     fprintf(stderr, "fatal: invalid option or no output file specified\n");
     usage(argv[0]);
     return -1;
   }
 
-  g_bitstream = fopen(argv[idx], "wb");
-  if (!g_bitstream) {
-    fprintf(stderr, "fatal: failed to open file for writing: %s\n", argv[idx]);
-    exit(-1);
+  if (idx < argc) {
+    g_bitstream = fopen(argv[idx], "wb");
+    if (!g_bitstream) {
+      fprintf(stderr, "fatal: failed to open file for writing: %s\n", argv[idx]);
+      exit(-1);
+    }
+  }
+
+  if (g_bench_seconds > 0) {
+    ga_set_loglevel(ga_get_loglevel_enum(g_loglevel));
+    std::signal(SIGTERM, signal_handler);
+    std::signal(SIGINT, signal_handler);
+    int ret = run_bench();
+    if (g_bitstream)
+      fclose(g_bitstream);
+    return ret;
   }
 
   printf("Starting IRRV server client, press CTRL^C to stop...");
@@ -205,6 +384,12 @@ int main(int argc, char* argv[])
 
   irrv->stop();
 
+  ga_ioctl_recvstats_t stats{};
+  irrv->get_recv_stats(&stats);
+  printf("Received %ld frames: jitter %ld us, assembly avg %ld us max %ld us, %ld timeouts, %ld reconnects\n",
+    stats.frames, stats.jitter_us, stats.assembly_avg_us, stats.assembly_max_us,
+    stats.timeouts, stats.reconnects);
+
   fclose(g_bitstream);
 
   return 0;
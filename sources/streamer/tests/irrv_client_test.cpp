@@ -58,7 +58,8 @@ int ga_conf_readint(const char *key)
 {
   ga_logger(Severity::DBG, "ga_conf_readint: %s\n", key);
   if (std::string("android-session") == key ||
-      std::string("user") == key) {
+      std::string("user") == key ||
+      std::string("irrv-recv-timeout-ms") == key) {
     return 0;
   } else if (std::string("icr-port") == key) {
     return g_icr_port;
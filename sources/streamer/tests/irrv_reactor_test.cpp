@@ -0,0 +1,452 @@
+// Copyright (C) 2023 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions
+// and limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+// The shared IRRV receiver thread: handlers run without the reactor lock,
+// and one session waiting for its ICR, its sink or a partial frame does
+// not delay the others. The ICR side is played by loopback sockets.
+
+#include <gtest/gtest.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <ga-conf.h>
+#include <ga-module.h>
+#include <CIrrvReactor.h>
+#include <CSendRecvMessage.h>
+
+using namespace std::chrono;
+using namespace std::chrono_literals;
+
+namespace {
+  // Packets the sink received
+  struct Received {
+    int channel;
+    std::vector<uint8_t> data;
+    int flags;
+  };
+
+  std::mutex g_mutex;
+  std::condition_variable g_cv;
+  std::vector<Received> g_received;
+  int g_blocked_channel = -1;    // the sink stalls on this channel while set
+
+  size_t count_received(int channel)
+  {
+    size_t n = 0;
+    for (const Received& r : g_received)
+      n += (r.channel == channel);
+    return n;
+  }
+
+  bool wait_received(int channel, size_t count, milliseconds timeout)
+  {
+    std::unique_lock<std::mutex> lock(g_mutex);
+    return g_cv.wait_for(lock, timeout, [&]{ return count_received(channel) >= count; });
+  }
+}
+
+int encoder_send_packet(const char *prefix, int channelId, ga_packet_t *pkt, int64_t encoderPts, struct timeval *ptv)
+{
+  std::unique_lock<std::mutex> lock(g_mutex);
+  g_cv.wait(lock, [&]{ return g_blocked_channel != channelId; });
+  g_received.push_back({ channelId, std::vector<uint8_t>(pkt->data, pkt->data + pkt->size), pkt->flags });
+  g_cv.notify_all();
+  return 0;
+}
+
+namespace {
+  // Handler on one end of a socket pair, the test writes to the other
+  class PairHandler: public CIrrvReactor::Handler
+  {
+  public:
+    PairHandler() {
+      socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds_);
+    }
+    ~PairHandler() override {
+      close(fds_[0]);
+      close(fds_[1]);
+    }
+
+    int fd() override { return fds_[0]; }
+
+    void on_readable() override {
+      char buf[256];
+      ssize_t n;
+      while ((n = read(fds_[0], buf, sizeof(buf))) > 0)
+        bytes += n;
+      readable++;
+      if (hook)
+        hook();
+    }
+
+    void on_idle() override { idle++; }
+
+    void Poke() { EXPECT_EQ(write(fds_[1], "x", 1), 1); }
+
+    std::atomic<int> bytes{0};
+    std::atomic<int> readable{0};
+    std::atomic<int> idle{0};
+    std::function<void()> hook;
+
+  private:
+    int fds_[2] = { -1, -1 };
+  };
+
+  template<class Pred>
+  bool wait_until(Pred pred, milliseconds timeout)
+  {
+    auto end = steady_clock::now() + timeout;
+    while (!pred()) {
+      if (steady_clock::now() > end)
+        return false;
+      std::this_thread::sleep_for(1ms);
+    }
+    return true;
+  }
+}
+
+TEST(IrrvReactorTest, DispatchesReadableAndIdle)
+{
+  PairHandler handler;
+  CIrrvReactor::instance().add(&handler);
+
+  handler.Poke();
+  handler.Poke();
+  EXPECT_TRUE(wait_until([&]{ return handler.bytes == 2; }, 1s));
+  EXPECT_GE(handler.readable, 1);
+
+  int idle = handler.idle;
+  std::this_thread::sleep_for(milliseconds(CIrrvReactor::IDLE_INTERVAL_MS * 3));
+  EXPECT_GE(handler.idle - idle, 2);
+
+  CIrrvReactor::instance().remove(&handler);
+}
+
+TEST(IrrvReactorTest, HandlersRunWithoutReactorLock)
+{
+  PairHandler busy;
+  std::promise<void> release;
+  std::shared_future<void> released = release.get_future().share();
+  std::atomic<bool> inside{false};
+  busy.hook = [&]{ inside = true; released.wait(); };
+  CIrrvReactor::instance().add(&busy);
+
+  busy.Poke();
+  ASSERT_TRUE(wait_until([&]{ return inside.load(); }, 1s));
+
+  // Sessions come and go while another one is in its handler
+  PairHandler other;
+  auto done = std::async(std::launch::async, [&]{
+    CIrrvReactor::instance().add(&other);
+    CIrrvReactor::instance().remove(&other);
+  });
+  bool completed = done.wait_for(1s) == std::future_status::ready;
+  release.set_value();
+  done.wait();
+  EXPECT_TRUE(completed);
+
+  CIrrvReactor::instance().remove(&busy);
+}
+
+TEST(IrrvReactorTest, RemoveWaitsForRunningHandler)
+{
+  PairHandler handler;
+  std::atomic<bool> inside{false};
+  std::atomic<bool> finished{false};
+  handler.hook = [&]{
+    inside = true;
+    std::this_thread::sleep_for(200ms);
+    finished = true;
+  };
+  CIrrvReactor::instance().add(&handler);
+
+  handler.Poke();
+  ASSERT_TRUE(wait_until([&]{ return inside.load(); }, 1s));
+  CIrrvReactor::instance().remove(&handler);
+  EXPECT_TRUE(finished);
+
+  // not called anymore
+  int readable = handler.readable;
+  handler.Poke();
+  std::this_thread::sleep_for(milliseconds(CIrrvReactor::IDLE_INTERVAL_MS * 2));
+  EXPECT_EQ(handler.readable, readable);
+}
+
+namespace {
+  // ICR side of the IRRV connection of one session
+  class FakeIcr
+  {
+  public:
+    FakeIcr(int backlog = 4) {
+      listen_ = socket(AF_INET, SOCK_STREAM, 0);
+      struct sockaddr_in addr{};
+      addr.sin_family = AF_INET;
+      addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+      socklen_t len = sizeof(addr);
+      EXPECT_EQ(bind(listen_, (struct sockaddr *)&addr, len), 0);
+      EXPECT_EQ(listen(listen_, backlog), 0);
+      getsockname(listen_, (struct sockaddr *)&addr, &len);
+      port_ = ntohs(addr.sin_port);
+    }
+    ~FakeIcr() {
+      CloseConnection();
+      close(listen_);
+    }
+
+    int port() const { return port_; }
+
+    bool Accept(milliseconds timeout) {
+      struct pollfd pfd = { listen_, POLLIN, 0 };
+      if (poll(&pfd, 1, (int)timeout.count()) != 1)
+        return false;
+      CloseConnection();
+      conn_ = accept(listen_, nullptr, nullptr);
+      return conn_ >= 0;
+    }
+
+    // The receiver closed the connection
+    bool WaitClosed(milliseconds timeout) {
+      auto end = steady_clock::now() + timeout;
+      char buf[256];
+      while (steady_clock::now() < end) {
+        struct pollfd pfd = { conn_, POLLIN, 0 };
+        if (poll(&pfd, 1, 10) == 1 && recv(conn_, buf, sizeof(buf), MSG_DONTWAIT) == 0)
+          return true;
+      }
+      return false;
+    }
+
+    void CloseConnection() {
+      if (conn_ >= 0)
+        close(conn_);
+      conn_ = -1;
+    }
+
+    void SendHead(int width, int height) {
+      irrv_vhead_event_t ev{};
+      ev.event.magic = IRRV_MAGIC;
+      ev.event.type  = IRRV_EVENT_VHEAD;
+      ev.event.size  = sizeof(ev);
+      ev.info.width  = width;
+      ev.info.height = height;
+      Send(&ev, sizeof(ev));
+    }
+
+    // The event header and the first |bytes| of the data
+    void SendFrameStart(const std::vector<uint8_t>& data, bool key, size_t bytes) {
+      irrv_vframe_event_t ev{};
+      ev.event.magic      = IRRV_MAGIC;
+      ev.event.type       = IRRV_EVENT_VFRAME;
+      ev.event.size       = sizeof(ev) + data.size();
+      ev.info.flags       = key? IRRV_VFRAME_FLAG_KEY: 0;
+      ev.info.data_size   = data.size();
+      ev.info.video_size  = data.size();
+      Send(&ev, sizeof(ev));
+      Send(data.data(), bytes);
+    }
+
+    void SendFrame(const std::vector<uint8_t>& data, bool key) {
+      SendFrameStart(data, key, data.size());
+    }
+
+    void Send(const void* data, size_t size) {
+      ASSERT_EQ(send(conn_, data, size, MSG_NOSIGNAL), (ssize_t)size);
+    }
+
+  private:
+    int listen_ = -1;
+    int conn_ = -1;
+    int port_ = 0;
+  };
+
+  std::vector<uint8_t> make_frame(size_t size, uint8_t seed)
+  {
+    std::vector<uint8_t> data(size);
+    for (size_t i = 0; i < size; i++)
+      data[i] = (uint8_t)(seed + i * 7);
+    return data;
+  }
+
+  class IrrvReceiverTest: public ::testing::Test
+  {
+  protected:
+    void SetUp() override {
+      ga_conf_clear();
+      ga_conf_writev("icr-ip", "127.0.0.1");
+      std::lock_guard<std::mutex> lock(g_mutex);
+      g_received.clear();
+      g_blocked_channel = -1;
+    }
+    void TearDown() override {
+      for (auto& msg : receivers_)
+        msg->stop();
+      receivers_.clear();
+      for (ga_conf_session_t*& conf : confs_)
+        ga_conf_session_destroy(&conf);
+      confs_.clear();
+      ga_conf_clear();
+    }
+
+    // Receiver on |channel| connecting to |icr|
+    CSendRecvMessage* AddSession(int channel, const FakeIcr& icr, int recv_timeout_ms = 0) {
+      ga_conf_session_t* conf = ga_conf_session_create(channel);
+      // the receiver connects to icr-port + 1000 + android-session
+      ga_conf_session_writev(conf, "icr-port", std::to_string(icr.port() - 1000).c_str());
+      if (recv_timeout_ms > 0)
+        ga_conf_session_writev(conf, "irrv-recv-timeout-ms", std::to_string(recv_timeout_ms).c_str());
+      confs_.push_back(conf);
+      receivers_.push_back(std::make_unique<CSendRecvMessage>(false, channel, conf));
+      receivers_.back()->start();
+      return receivers_.back().get();
+    }
+
+    // Connected and past the stream header
+    void Connect(CSendRecvMessage* msg, FakeIcr& icr) {
+      ASSERT_TRUE(icr.Accept(2000ms));
+      icr.SendHead(640, 480);
+      ASSERT_TRUE(msg->ready(system_clock::now() + 2s));
+    }
+
+    std::vector<ga_conf_session_t*> confs_;
+    std::vector<std::unique_ptr<CSendRecvMessage>> receivers_;
+  };
+}
+
+TEST_F(IrrvReceiverTest, AssemblesFrameSentInPieces)
+{
+  FakeIcr icr;
+  CSendRecvMessage* msg = AddSession(1, icr);
+  Connect(msg, icr);
+
+  std::vector<uint8_t> frame = make_frame(100000, 1);
+  icr.SendFrameStart(frame, true, 0);
+  for (size_t off = 0; off < frame.size(); off += 25000) {
+    std::this_thread::sleep_for(20ms);
+    icr.Send(frame.data() + off, 25000);
+  }
+  icr.SendFrame(make_frame(1000, 2), false);
+
+  ASSERT_TRUE(wait_received(1, 2, 1s));
+  std::lock_guard<std::mutex> lock(g_mutex);
+  EXPECT_EQ(g_received[0].data, frame);
+  EXPECT_EQ(g_received[0].flags, GA_PKT_FLAG_KEY);
+  EXPECT_EQ(g_received[1].data.size(), 1000u);
+  EXPECT_EQ(g_received[1].flags, 0);
+}
+
+TEST_F(IrrvReceiverTest, PartialFrameDoesNotDelayOtherSessions)
+{
+  FakeIcr stalled, live;
+  CSendRecvMessage* a = AddSession(1, stalled, 300);
+  CSendRecvMessage* b = AddSession(2, live);
+  Connect(a, stalled);
+  Connect(b, live);
+
+  // Half a frame, then nothing
+  std::vector<uint8_t> frame = make_frame(50000, 3);
+  stalled.SendFrameStart(frame, true, frame.size() / 2);
+
+  auto start = steady_clock::now();
+  for (int i = 0; i < 10; i++) {
+    live.SendFrame(make_frame(5000, i), i == 0);
+    std::this_thread::sleep_for(10ms);
+  }
+  ASSERT_TRUE(wait_received(2, 10, 1s));
+  EXPECT_LT(steady_clock::now() - start, 250ms);
+
+  // The stalled session gives up on the frame and reconnects
+  EXPECT_TRUE(stalled.WaitClosed(2000ms));
+  EXPECT_TRUE(stalled.Accept(2000ms));
+  std::lock_guard<std::mutex> lock(g_mutex);
+  EXPECT_EQ(count_received(1), 0u);
+}
+
+TEST_F(IrrvReceiverTest, SlowSinkDoesNotDelayOtherSessions)
+{
+  FakeIcr slow, live;
+  CSendRecvMessage* a = AddSession(1, slow);
+  CSendRecvMessage* b = AddSession(2, live);
+  Connect(a, slow);
+  Connect(b, live);
+
+  {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    g_blocked_channel = 1;
+  }
+  for (int i = 0; i < 3; i++)
+    slow.SendFrame(make_frame(5000, i), i == 0);
+  for (int i = 0; i < 5; i++)
+    live.SendFrame(make_frame(5000, i), i == 0);
+  EXPECT_TRUE(wait_received(2, 5, 1s));
+
+  {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    g_blocked_channel = -1;
+  }
+  g_cv.notify_all();
+  // queued meanwhile, nothing lost
+  EXPECT_TRUE(wait_received(1, 3, 1s));
+}
+
+TEST_F(IrrvReceiverTest, PendingConnectDoesNotDelayOtherSessions)
+{
+  // A listener that cannot take more connections: once its queue is
+  // full, connection attempts stay pending
+  FakeIcr full(0);
+  std::vector<int> fillers;
+  for (int i = 0; i < 4; i++) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    struct sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(full.port());
+    connect(fd, (struct sockaddr *)&addr, sizeof(addr));
+    fillers.push_back(fd);
+  }
+  std::this_thread::sleep_for(50ms);
+
+  FakeIcr live;
+  CSendRecvMessage* a = AddSession(1, full);
+  CSendRecvMessage* b = AddSession(2, live);
+  Connect(b, live);
+  EXPECT_FALSE(a->ready());
+
+  auto start = steady_clock::now();
+  for (int i = 0; i < 20; i++) {
+    live.SendFrame(make_frame(5000, i), i == 0);
+    std::this_thread::sleep_for(50ms);
+  }
+  ASSERT_TRUE(wait_received(2, 20, 1s));
+  EXPECT_LT(steady_clock::now() - start, 1250ms);
+
+  for (int fd : fillers)
+    close(fd);
+}
@@ -0,0 +1,801 @@
+// Copyright (C) 2023 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions
+// and limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+// Emulator of the ICR side of IRRV, to drive the receiver at a controlled
+// load without an Android instance or an encoder.
+//
+// Every session listens on the port the receiver of that session connects
+// to, <port> + 1000 + <session>, and speaks the protocol of the encoder:
+// VHEAD on connection, VAUTH_ACK for VAUTH, and VFRAMEs at the frame rate
+// once the receiver sends IRRV_CTRL_START. VCTRLs act on the emulated
+// encoder the way they act on ICR: key frame requests, bitrate, frame
+// rate, GOP and resolution changes, start, pause and stop.
+//
+// Frame sizes follow the bitrate, with periodic IDR frames a given times
+// larger than the others, and are drawn from a fixed, uniform or lognormal
+// distribution. The payload is an Annex B NAL of the frame type followed
+// by filler. Frames that are due while the previous one is still being
+// sent are skipped, as the encoder would drop them.
+//
+// Sessions are spread over worker threads, each of them serving its
+// sessions from one epoll loop.
+
+#include <arpa/inet.h>
+#include <getopt.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <sys/uio.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "irrv/irrv_protocol.h"
+
+namespace {
+    const char* g_ip = "0.0.0.0";
+    int g_port = 23432;             // ICR port, as --icr-port of the receiver
+    int g_first_session = 0;
+    int g_sessions = 1;
+    int g_threads = 1;
+    int g_width = 720;
+    int g_height = 1280;
+    int g_fps = 30;
+    int g_bitrate = 4000000;        // bits per second
+    std::string g_dist = "lognormal";
+    double g_spread = 0.3;
+    int g_gop = 120;                // frames between IDR frames, 0 for none
+    double g_idr_ratio = 8.0;       // IDR size over the other frames
+    int g_resize_seconds = 0;       // period of the resolution changes, 0 for none
+    int g_resize_width = 0;
+    int g_resize_height = 0;
+    bool g_auth = false;
+    int g_seconds = 0;
+    int g_report_seconds = 5;
+
+    std::atomic<bool> g_stop(false);
+
+    // Totals over all sessions, read by the report
+    struct Counters
+    {
+        std::atomic<uint64_t> frames{0};
+        std::atomic<uint64_t> idr{0};
+        std::atomic<uint64_t> bytes{0};
+        std::atomic<uint64_t> skipped{0};
+        std::atomic<uint64_t> ctrls{0};
+        std::atomic<uint64_t> connects{0};
+        std::atomic<uint64_t> disconnects{0};
+        std::atomic<int> connected{0};
+        std::atomic<int> streaming{0};
+    };
+    Counters g_counters;
+
+    int64_t now_ns()
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+    }
+
+    struct Session
+    {
+        int id = 0;
+        int listen_fd = -1;
+        int fd = -1;
+        bool authed = false;
+        bool started = false;
+
+        // Emulated encoder
+        int head_width = 0;         // sent in VHEAD, bounds the frame size
+        int head_height = 0;
+        int width = 0;
+        int height = 0;
+        int fps = 0;
+        int bitrate = 0;
+        int gop = 0;
+        uint64_t gop_frame = 0;
+        bool force_idr = false;
+        bool resized = false;
+        int64_t next_frame_ns = 0;
+        int64_t next_resize_ns = 0;
+        std::mt19937 rng;
+
+        std::string in;             // partial client event
+        std::string out;            // unsent bytes, frames are skipped while not empty
+    };
+
+    enum { kListen = 0, kClient = 1, kTimer = 2 };
+
+    uint64_t tag(size_t index, int kind)
+    {
+        return (uint64_t(index) << 2) | kind;
+    }
+
+    class Worker
+    {
+    public:
+        bool Add(int id)
+        {
+            Session s;
+            s.id = id;
+            s.rng.seed(id);
+            s.width = g_width;
+            s.height = g_height;
+            s.fps = g_fps;
+            s.bitrate = g_bitrate;
+            s.gop = g_gop;
+
+            s.listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+            if (s.listen_fd < 0) {
+                perror("socket");
+                return false;
+            }
+            int on = 1;
+            setsockopt(s.listen_fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+            struct sockaddr_in addr;
+            memset(&addr, 0, sizeof(addr));
+            addr.sin_family = AF_INET;
+            addr.sin_port = htons(g_port + 1000 + id);
+            inet_pton(AF_INET, g_ip, &addr.sin_addr);
+            if (bind(s.listen_fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(s.listen_fd, 1) < 0) {
+                fprintf(stderr, "session %d: failed to listen on %s:%d: %s\n", id, g_ip,
+                        g_port + 1000 + id, strerror(errno));
+                close(s.listen_fd);
+                return false;
+            }
+            sessions_.push_back(std::move(s));
+            return true;
+        }
+
+        void Start()
+        {
+            thread_ = std::thread(&Worker::Run, this);
+        }
+
+        void Join()
+        {
+            if (thread_.joinable())
+                thread_.join();
+        }
+
+        ~Worker()
+        {
+            for (auto& s : sessions_) {
+                if (s.fd >= 0)
+                    close(s.fd);
+                close(s.listen_fd);
+            }
+            if (timer_ >= 0)
+                close(timer_);
+            if (epoll_ >= 0)
+                close(epoll_);
+        }
+
+    private:
+        void Run()
+        {
+            epoll_ = epoll_create1(0);
+            timer_ = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+            if (epoll_ < 0 || timer_ < 0) {
+                perror("epoll");
+                g_stop = true;
+                return;
+            }
+            Watch(timer_, tag(0, kTimer), EPOLLIN);
+            for (size_t i = 0; i < sessions_.size(); i++)
+                Watch(sessions_[i].listen_fd, tag(i, kListen), EPOLLIN);
+
+            struct epoll_event events[64];
+            while (!g_stop) {
+                ArmTimer();
+                int n = epoll_wait(epoll_, events, 64, 100);
+                for (int i = 0; i < n; i++) {
+                    size_t index = events[i].data.u64 >> 2;
+                    switch (events[i].data.u64 & 3) {
+                    case kListen:
+                        Accept(sessions_[index]);
+                        break;
+                    case kClient:
+                        if (sessions_[index].fd < 0)
+                            break;   // disconnected earlier in this batch
+                        if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+                            Disconnect(sessions_[index]);
+                            break;
+                        }
+                        if ((events[i].events & EPOLLOUT) && !Flush(sessions_[index]))
+                            break;
+                        if (events[i].events & EPOLLIN)
+                            Receive(sessions_[index]);
+                        break;
+                    case kTimer:
+                    {
+                        uint64_t expirations;
+                        ssize_t r = read(timer_, &expirations, sizeof(expirations));
+                        (void)r;
+                        break;
+                    }
+                    }
+                }
+                SendDueFrames(now_ns());
+            }
+        }
+
+        void Watch(int fd, uint64_t data, uint32_t events)
+        {
+            struct epoll_event ev;
+            ev.events = events;
+            ev.data.u64 = data;
+            epoll_ctl(epoll_, EPOLL_CTL_ADD, fd, &ev);
+        }
+
+        void Rewatch(Session& s, size_t index)
+        {
+            struct epoll_event ev;
+            ev.events = s.out.empty() ? EPOLLIN : EPOLLIN | EPOLLOUT;
+            ev.data.u64 = tag(index, kClient);
+            epoll_ctl(epoll_, EPOLL_CTL_MOD, s.fd, &ev);
+        }
+
+        size_t Index(const Session& s) const
+        {
+            return &s - sessions_.data();
+        }
+
+        // The timer fires at the earliest frame due
+        void ArmTimer()
+        {
+            int64_t next = INT64_MAX;
+            for (auto& s : sessions_) {
+                if (Streaming(s))
+                    next = std::min(next, s.next_frame_ns);
+            }
+            struct itimerspec its;
+            memset(&its, 0, sizeof(its));
+            if (next != INT64_MAX) {
+                next = std::max<int64_t>(next, 1);
+                its.it_value.tv_sec = next / 1000000000LL;
+                its.it_value.tv_nsec = next % 1000000000LL;
+            }
+            timerfd_settime(timer_, TFD_TIMER_ABSTIME, &its, nullptr);
+        }
+
+        bool Streaming(const Session& s) const
+        {
+            return s.fd >= 0 && s.started && (!g_auth || s.authed);
+        }
+
+        void Accept(Session& s)
+        {
+            int fd = accept4(s.listen_fd, nullptr, nullptr, SOCK_NONBLOCK);
+            if (fd < 0)
+                return;
+            if (s.fd >= 0) {
+                // one receiver per session, as ICR
+                fprintf(stderr, "session %d: already connected, refusing connection\n", s.id);
+                close(fd);
+                return;
+            }
+            int on = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+            s.fd = fd;
+            s.authed = false;
+            s.started = false;
+            s.in.clear();
+            s.out.clear();
+            s.head_width = s.width;
+            s.head_height = s.height;
+            Watch(fd, tag(Index(s), kClient), EPOLLIN);
+            g_counters.connects++;
+            g_counters.connected++;
+
+            irrv_vhead_event_t head_ev;
+            memset(&head_ev, 0, sizeof(head_ev));
+            head_ev.event.magic = IRRV_MAGIC;
+            head_ev.event.type = IRRV_EVENT_VHEAD;
+            head_ev.event.size = sizeof(head_ev);
+            head_ev.info.width = s.head_width;
+            head_ev.info.height = s.head_height;
+            head_ev.info.format = IRRV_STREAM_FORMAT_H264_RAW;
+            head_ev.info.auth = g_auth;
+            struct iovec iov = { &head_ev, sizeof(head_ev) };
+            Send(s, &iov, 1);
+        }
+
+        void Disconnect(Session& s)
+        {
+            if (s.fd < 0)
+                return;
+            if (Streaming(s))
+                g_counters.streaming--;
+            epoll_ctl(epoll_, EPOLL_CTL_DEL, s.fd, nullptr);
+            close(s.fd);
+            s.fd = -1;
+            s.started = false;
+            s.authed = false;
+            g_counters.disconnects++;
+            g_counters.connected--;
+        }
+
+        // Sends what is queued first. Returns false if the session was
+        // disconnected.
+        bool Send(Session& s, struct iovec* iov, int count)
+        {
+            size_t total = 0;
+            for (int i = 0; i < count; i++)
+                total += iov[i].iov_len;
+
+            size_t sent = 0;
+            if (s.out.empty()) {
+                struct msghdr msg;
+                memset(&msg, 0, sizeof(msg));
+                msg.msg_iov = iov;
+                msg.msg_iovlen = count;
+                ssize_t n = sendmsg(s.fd, &msg, MSG_NOSIGNAL);
+                if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                    Disconnect(s);
+                    return false;
+                }
+                sent = n > 0 ? n : 0;
+            }
+            if (sent < total) {
+                bool was_empty = s.out.empty();
+                size_t skip = sent;
+                for (int i = 0; i < count; i++) {
+                    size_t len = iov[i].iov_len;
+                    if (skip >= len) {
+                        skip -= len;
+                        continue;
+                    }
+                    s.out.append((const char*)iov[i].iov_base + skip, len - skip);
+                    skip = 0;
+                }
+                if (was_empty)
+                    Rewatch(s, Index(s));
+            }
+            return true;
+        }
+
+        bool Flush(Session& s)
+        {
+            while (!s.out.empty()) {
+                ssize_t n = send(s.fd, s.out.data(), s.out.size(), MSG_NOSIGNAL);
+                if (n < 0) {
+                    if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+                        return true;
+                    Disconnect(s);
+                    return false;
+                }
+                s.out.erase(0, n);
+            }
+            Rewatch(s, Index(s));
+            return true;
+        }
+
+        void Receive(Session& s)
+        {
+            char buf[4096];
+            ssize_t n = recv(s.fd, buf, sizeof(buf), 0);
+            if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+                Disconnect(s);
+                return;
+            }
+            if (n < 0)
+                return;
+            s.in.append(buf, n);
+
+            // The size of an event covers its header and payload. The
+            // receiver does not set the magic of VAUTH, it is not checked.
+            size_t offset = 0;
+            while (s.in.size() - offset >= sizeof(irrv_event_t)) {
+                irrv_event_t ev;
+                memcpy(&ev, s.in.data() + offset, sizeof(ev));
+                if (ev.size < sizeof(ev) || ev.size > sizeof(buf)) {
+                    fprintf(stderr, "session %d: broken event type 0x%x size %u\n", s.id, ev.type, ev.size);
+                    Disconnect(s);
+                    return;
+                }
+                if (s.in.size() - offset < ev.size)
+                    break;
+                const char* payload = s.in.data() + offset + sizeof(ev);
+                size_t payload_size = ev.size - sizeof(ev);
+                offset += ev.size;
+                if (!Handle(s, ev, payload, payload_size))
+                    return;
+            }
+            s.in.erase(0, offset);
+        }
+
+        // Returns false if the session was disconnected
+        bool Handle(Session& s, const irrv_event_t& ev, const char* payload, size_t size)
+        {
+            switch (ev.type) {
+            case IRRV_EVENT_VHEAD_ACK:
+                return true;
+            case IRRV_EVENT_VAUTH:
+            {
+                irrv_vauth_t vauth;
+                memset(&vauth, 0, sizeof(vauth));
+                memcpy(&vauth, payload, std::min(size, sizeof(vauth)));
+                const unsigned char auth_id[IRRV_UUID_LEN] = DEFAULT_AUTH_ID;
+                const unsigned char auth_key[IRRV_UUID_LEN] = DEFAULT_AUTH_KEY;
+                bool passed = !memcmp(vauth.id, auth_id, IRRV_UUID_LEN) &&
+                              !memcmp(vauth.key, auth_key, IRRV_UUID_LEN);
+
+                irrv_vauth_event_t auth_ev;
+                memset(&auth_ev, 0, sizeof(auth_ev));
+                auth_ev.event.magic = IRRV_MAGIC;
+                auth_ev.event.type = IRRV_EVENT_VAUTH_ACK;
+                auth_ev.event.size = sizeof(auth_ev);
+                auth_ev.info.result = passed ? AUTH_PASSED : AUTH_FAILED;
+                struct iovec iov = { &auth_ev, sizeof(auth_ev) };
+                if (!Send(s, &iov, 1))
+                    return false;
+                if (!passed) {
+                    fprintf(stderr, "session %d: authentication failed\n", s.id);
+                    Disconnect(s);
+                    return false;
+                }
+                bool was_streaming = Streaming(s);
+                s.authed = true;
+                if (!was_streaming && Streaming(s))
+                    g_counters.streaming++;
+                return true;
+            }
+            case IRRV_EVENT_VCTRL:
+            {
+                if (g_auth && !s.authed)
+                    return true;
+                irrv_vctrl_t vctrl;
+                memset(&vctrl, 0, sizeof(vctrl));
+                memcpy(&vctrl, payload, std::min(size, sizeof(vctrl)));
+                g_counters.ctrls++;
+                Control(s, vctrl);
+                return true;
+            }
+            default:
+                return true;
+            }
+        }
+
+        void Control(Session& s, const irrv_vctrl_t& vctrl)
+        {
+            bool was_streaming = Streaming(s);
+            switch (vctrl.ctrl_type) {
+            case IRRV_CTRL_START:
+                if (!s.started) {
+                    s.started = true;
+                    s.force_idr = true;
+                    s.next_frame_ns = now_ns();
+                    s.next_resize_ns = s.next_frame_ns + g_resize_seconds * 1000000000LL;
+                }
+                break;
+            case IRRV_CTRL_PAUSE:
+            case IRRV_CTRL_STOP:
+                s.started = false;
+                break;
+            case IRRV_CTRL_KEYFRAME_SETTING:
+                s.force_idr = true;
+                break;
+            case IRRV_CTRL_BITRATE_SETTING:
+                if (vctrl.value > 0)
+                    s.bitrate = vctrl.value;
+                break;
+            case IRRV_CTRL_FRAMERATE_SETTING:
+                if (vctrl.value > 0)
+                    s.fps = vctrl.value;
+                break;
+            case IRRV_CTRL_GOP_SETTING:
+                s.gop = vctrl.value;
+                break;
+            case IRRV_CTRL_RESOLUTION:
+                if (vctrl.resolution.width > 0 && vctrl.resolution.height > 0) {
+                    s.width = vctrl.resolution.width;
+                    s.height = vctrl.resolution.height;
+                    s.force_idr = true;
+                }
+                break;
+            default:
+                break;
+            }
+            bool streaming = Streaming(s);
+            if (streaming != was_streaming)
+                g_counters.streaming += streaming ? 1 : -1;
+        }
+
+        size_t FrameSize(Session& s, bool idr)
+        {
+            double mean = s.bitrate / 8.0 / s.fps;
+            // the average over a GOP matches the bitrate
+            if (s.gop > 1)
+                mean = mean * s.gop / (s.gop - 1 + g_idr_ratio);
+            if (idr)
+                mean *= g_idr_ratio;
+
+            double size = mean;
+            if (g_dist == "uniform") {
+                std::uniform_real_distribution<double> d(1.0 - g_spread, 1.0 + g_spread);
+                size = mean * d(s.rng);
+            } else if (g_dist == "lognormal") {
+                std::lognormal_distribution<double> d(-g_spread * g_spread / 2, g_spread);
+                size = mean * d(s.rng);
+            }
+            // the receiver drops the connection on frames larger than this
+            double limit = 4.0 * s.head_width * s.head_height;
+            return (size_t)std::max(16.0, std::min(size, limit));
+        }
+
+        void SendDueFrames(int64_t now)
+        {
+            for (auto& s : sessions_) {
+                if (!Streaming(s) || s.next_frame_ns > now)
+                    continue;
+
+                int64_t period = 1000000000LL / s.fps;
+                s.next_frame_ns += period;
+                if (s.next_frame_ns <= now)
+                    s.next_frame_ns = now + period;   // late, do not burst
+
+                if (g_resize_seconds > 0 && now >= s.next_resize_ns) {
+                    s.resized = !s.resized;
+                    s.width = s.resized ? g_resize_width : s.head_width;
+                    s.height = s.resized ? g_resize_height : s.head_height;
+                    s.force_idr = true;
+                    s.next_resize_ns = now + g_resize_seconds * 1000000000LL;
+                }
+
+                if (!s.out.empty()) {
+                    g_counters.skipped++;
+                    continue;
+                }
+                SendFrame(s);
+            }
+        }
+
+        void SendFrame(Session& s)
+        {
+            bool idr = s.force_idr || (s.gop > 0 && s.gop_frame % s.gop == 0);
+            if (s.force_idr)
+                s.gop_frame = 0;
+            s.force_idr = false;
+            s.gop_frame++;
+
+            size_t size = FrameSize(s, idr);
+            if (filler_.size() < size)
+                filler_.resize(size, 0x5a);
+
+            irrv_vframe_event_t frame_ev;
+            memset(&frame_ev, 0, sizeof(frame_ev));
+            frame_ev.event.magic = IRRV_MAGIC;
+            frame_ev.event.type = IRRV_EVENT_VFRAME;
+            frame_ev.event.size = sizeof(frame_ev);
+            frame_ev.info.flags = idr ? IRRV_VFRAME_FLAG_KEY : IRRV_VFRAME_FLAG_NONE;
+            frame_ev.info.data_size = size;
+            frame_ev.info.width = s.width;
+            frame_ev.info.height = s.height;
+
+            // Annex B start code and the NAL header of an IDR or a non-IDR slice
+            uint8_t nal[5] = { 0, 0, 0, 1, uint8_t(idr ? 0x65 : 0x41) };
+            size_t nal_size = std::min(size, sizeof(nal));
+            struct iovec iov[3] = {
+                { &frame_ev, sizeof(frame_ev) },
+                { nal, nal_size },
+                { filler_.data(), size - nal_size },
+            };
+            if (!Send(s, iov, 3))
+                return;
+
+            g_counters.frames++;
+            g_counters.bytes += size;
+            if (idr)
+                g_counters.idr++;
+        }
+
+        std::vector<Session> sessions_;
+        std::vector<uint8_t> filler_;
+        std::thread thread_;
+        int epoll_ = -1;
+        int timer_ = -1;
+    };
+
+    double cpu_seconds()
+    {
+        struct rusage ru;
+        getrusage(RUSAGE_SELF, &ru);
+        return ru.ru_utime.tv_sec + ru.ru_stime.tv_sec + (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6;
+    }
+
+    void report(double seconds, double cpu)
+    {
+        static uint64_t frames = 0, idr = 0, bytes = 0, skipped = 0, ctrls = 0;
+        uint64_t f = g_counters.frames, i = g_counters.idr, b = g_counters.bytes;
+        uint64_t s = g_counters.skipped, c = g_counters.ctrls;
+        printf("sessions %d/%d streaming %d: %.1f frames/s, %.2f Mbit/s, %llu IDR, %llu skipped, "
+               "%llu ctrls, %llu connects, %llu disconnects, cpu %.1f%%\n",
+               g_counters.connected.load(), g_sessions, g_counters.streaming.load(),
+               (f - frames) / seconds, (b - bytes) * 8 / seconds / 1e6,
+               (unsigned long long)(i - idr), (unsigned long long)(s - skipped),
+               (unsigned long long)(c - ctrls), (unsigned long long)g_counters.connects.load(),
+               (unsigned long long)g_counters.disconnects.load(), cpu / seconds * 100);
+        fflush(stdout);
+        frames = f;
+        idr = i;
+        bytes = b;
+        skipped = s;
+        ctrls = c;
+    }
+
+    void signal_handler(int)
+    {
+        g_stop = true;
+    }
+
+    bool parse_size(const char* s, int* width, int* height)
+    {
+        return sscanf(s, "%dx%d", width, height) == 2 && *width > 0 && *height > 0;
+    }
+}
+
+static void usage(const char* app)
+{
+    printf("usage: %s [options]\n", app);
+    printf("Session <n> listens on <port> + 1000 + <n>, the port its receiver connects to.\n");
+    printf("  -i, --ip <ip>            address to listen on (default: %s)\n", g_ip);
+    printf("  -p, --port <port>        ICR port, as given to the receiver (default: %d)\n", g_port);
+    printf("  -n, --sessions <n>       number of sessions (default: %d)\n", g_sessions);
+    printf("      --first-session <n>  first session id (default: %d)\n", g_first_session);
+    printf("  -j, --threads <n>        worker threads (default: %d)\n", g_threads);
+    printf("  -s, --size <w>x<h>       resolution (default: %dx%d)\n", g_width, g_height);
+    printf("  -f, --fps <n>            frame rate (default: %d)\n", g_fps);
+    printf("  -b, --bitrate <bps>      bitrate (default: %d)\n", g_bitrate);
+    printf("  -d, --dist <name>        frame size distribution: fixed, uniform, lognormal (default: %s)\n",
+           g_dist.c_str());
+    printf("      --spread <x>         relative spread of uniform, sigma of lognormal (default: %.2f)\n", g_spread);
+    printf("  -g, --gop <n>            frames between IDR frames, 0 for none (default: %d)\n", g_gop);
+    printf("      --idr-ratio <x>      size of IDR frames over the others (default: %.1f)\n", g_idr_ratio);
+    printf("      --resize <w>x<h>     resolution to switch to and back periodically\n");
+    printf("      --resize-interval <s> period of the resolution changes (default: 10 with --resize)\n");
+    printf("  -a, --auth               require authentication\n");
+    printf("  -t, --seconds <n>        run duration, 0 until interrupted (default: %d)\n", g_seconds);
+    printf("  -r, --report <n>         statistics period in seconds (default: %d)\n", g_report_seconds);
+}
+
+int main(int argc, char* argv[])
+{
+    enum { kFirstSession = 256, kSpread, kIdrRatio, kResize, kResizeInterval };
+    static const struct option long_opts[] = {
+        { "ip",              required_argument, nullptr, 'i' },
+        { "port",            required_argument, nullptr, 'p' },
+        { "sessions",        required_argument, nullptr, 'n' },
+        { "first-session",   required_argument, nullptr, kFirstSession },
+        { "threads",         required_argument, nullptr, 'j' },
+        { "size",            required_argument, nullptr, 's' },
+        { "fps",             required_argument, nullptr, 'f' },
+        { "bitrate",         required_argument, nullptr, 'b' },
+        { "dist",            required_argument, nullptr, 'd' },
+        { "spread",          required_argument, nullptr, kSpread },
+        { "gop",             required_argument, nullptr, 'g' },
+        { "idr-ratio",       required_argument, nullptr, kIdrRatio },
+        { "resize",          required_argument, nullptr, kResize },
+        { "resize-interval", required_argument, nullptr, kResizeInterval },
+        { "auth",            no_argument,       nullptr, 'a' },
+        { "seconds",         required_argument, nullptr, 't' },
+        { "report",          required_argument, nullptr, 'r' },
+        { "help",            no_argument,       nullptr, 'h' },
+        { nullptr,           0,                 nullptr, 0 },
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "i:p:n:j:s:f:b:d:g:at:r:h", long_opts, nullptr)) != -1) {
+        switch (opt) {
+        case 'i': g_ip = optarg; break;
+        case 'p': g_port = atoi(optarg); break;
+        case 'n': g_sessions = atoi(optarg); break;
+        case kFirstSession: g_first_session = atoi(optarg); break;
+        case 'j': g_threads = atoi(optarg); break;
+        case 's':
+            if (!parse_size(optarg, &g_width, &g_height)) {
+                usage(argv[0]);
+                return -1;
+            }
+            break;
+        case 'f': g_fps = atoi(optarg); break;
+        case 'b': g_bitrate = atoi(optarg); break;
+        case 'd': g_dist = optarg; break;
+        case kSpread: g_spread = atof(optarg); break;
+        case 'g': g_gop = atoi(optarg); break;
+        case kIdrRatio: g_idr_ratio = atof(optarg); break;
+        case kResize:
+            if (!parse_size(optarg, &g_resize_width, &g_resize_height)) {
+                usage(argv[0]);
+                return -1;
+            }
+            if (g_resize_seconds == 0)
+                g_resize_seconds = 10;
+            break;
+        case kResizeInterval: g_resize_seconds = atoi(optarg); break;
+        case 'a': g_auth = true; break;
+        case 't': g_seconds = atoi(optarg); break;
+        case 'r': g_report_seconds = atoi(optarg); break;
+        case 'h': usage(argv[0]); return 0;
+        default: usage(argv[0]); return -1;
+        }
+    }
+
+    if (g_port <= 0 || g_sessions <= 0 || g_first_session < 0 || g_threads <= 0 || g_fps <= 0 ||
+        g_bitrate <= 0 || g_gop < 0 || g_idr_ratio < 1.0 || g_spread < 0 || g_seconds < 0 ||
+        g_report_seconds <= 0 || (g_dist != "fixed" && g_dist != "uniform" && g_dist != "lognormal") ||
+        (g_resize_seconds > 0 && g_resize_width <= 0)) {
+        usage(argv[0]);
+        return -1;
+    }
+    g_threads = std::min(g_threads, g_sessions);
+
+    std::vector<Worker> workers(g_threads);
+    for (int i = 0; i < g_sessions; i++) {
+        if (!workers[i % g_threads].Add(g_first_session + i))
+            return -1;
+    }
+
+    signal(SIGINT, signal_handler);
+    signal(SIGTERM, signal_handler);
+
+    printf("%d sessions on ports %d-%d, %dx%d at %d fps, %d bps, %s sizes, gop %d, idr ratio %.1f\n",
+           g_sessions, g_port + 1000 + g_first_session, g_port + 1000 + g_first_session + g_sessions - 1,
+           g_width, g_height, g_fps, g_bitrate, g_dist.c_str(), g_gop, g_idr_ratio);
+    fflush(stdout);
+
+    for (auto& w : workers)
+        w.Start();
+
+    auto start = std::chrono::steady_clock::now();
+    auto last = start;
+    double last_cpu = cpu_seconds();
+    while (!g_stop) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        auto now = std::chrono::steady_clock::now();
+        if (now - last >= std::chrono::seconds(g_report_seconds)) {
+            double cpu = cpu_seconds();
+            report(std::chrono::duration<double>(now - last).count(), cpu - last_cpu);
+            last = now;
+            last_cpu = cpu;
+        }
+        if (g_seconds > 0 && now - start >= std::chrono::seconds(g_seconds))
+            g_stop = true;
+    }
+
+    for (auto& w : workers)
+        w.Join();
+
+    printf("sent %llu frames, %llu IDR, %.1f MB, %llu skipped\n",
+           (unsigned long long)g_counters.frames.load(), (unsigned long long)g_counters.idr.load(),
+           g_counters.bytes / 1e6, (unsigned long long)g_counters.skipped.load());
+    return 0;
+}
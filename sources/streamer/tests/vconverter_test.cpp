@@ -0,0 +1,144 @@
+// Copyright (C) 2023 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions
+// and limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+#include <vconverter.h>
+
+namespace {
+  // Planes of a frame in one buffer
+  struct Frame
+  {
+    Frame(int w, int h, AVPixelFormat fmt) : width(w), height(h), format(fmt)
+    {
+      if (fmt == AV_PIX_FMT_RGBA) {
+        data.resize(w * 4 * h);
+        plane[0] = data.data();
+        stride[0] = w * 4;
+      } else {
+        data.resize(w * h * 3 / 2);
+        plane[0] = data.data();
+        plane[1] = plane[0] + w * h;
+        stride[0] = w;
+        if (fmt == AV_PIX_FMT_NV12) {
+          stride[1] = w;
+        } else {
+          plane[2] = plane[1] + w * h / 4;
+          stride[1] = stride[2] = w / 2;
+        }
+      }
+    }
+
+    int width, height;
+    AVPixelFormat format;
+    std::vector<uint8_t> data;
+    uint8_t *plane[4] = {};
+    int stride[4] = {};
+  };
+
+  Frame pattern(int w, int h)
+  {
+    Frame f(w, h, AV_PIX_FMT_RGBA);
+    for (size_t i = 0; i < f.data.size(); i++)
+      f.data[i] = (uint8_t)(i * 131 + i / 4099);
+    return f;
+  }
+
+  int convert(const Frame &src, Frame &dst, int flags, int threads)
+  {
+    return convert_frame(src.plane, src.stride, src.width, src.height, src.format,
+                         dst.plane, dst.stride, dst.width, dst.height, dst.format, flags, threads);
+  }
+}
+
+// Slices converted on several threads give the frame of one converter
+TEST(VConverterTest, SlicedMatchesSingle)
+{
+  Frame src = pattern(3840, 2160);
+  const AVPixelFormat formats[] = { AV_PIX_FMT_NV12, AV_PIX_FMT_YUV420P };
+  for (AVPixelFormat fmt : formats) {
+    Frame single(3840, 2160, fmt), sliced(3840, 2160, fmt);
+    ASSERT_EQ(convert(src, single, SWS_BICUBIC, 1), 2160);
+    ASSERT_EQ(convert(src, sliced, SWS_BICUBIC, 4), 2160);
+    EXPECT_EQ(single.data, sliced.data);
+  }
+}
+
+TEST(VConverterTest, SlicedScaling)
+{
+  Frame src = pattern(1920, 1080);
+  Frame single(1280, 720, AV_PIX_FMT_YUV420P), sliced(1280, 720, AV_PIX_FMT_YUV420P);
+  ASSERT_EQ(convert(src, single, SWS_BILINEAR, 1), 720);
+  ASSERT_EQ(convert(src, sliced, SWS_BILINEAR, 3), 720);
+  EXPECT_EQ(single.data, sliced.data);
+}
+
+TEST(VConverterTest, ConcurrentConversions)
+{
+  Frame src = pattern(1280, 720);
+  Frame expected(1280, 720, AV_PIX_FMT_NV12);
+  ASSERT_EQ(convert(src, expected, SWS_FAST_BILINEAR, 1), 720);
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; t++) {
+    threads.emplace_back([&src, &expected, t] {
+      Frame dst(1280, 720, AV_PIX_FMT_NV12);
+      for (int i = 0; i < 10; i++) {
+        EXPECT_EQ(convert(src, dst, SWS_FAST_BILINEAR, 1 + (t + i) % 3), 720);
+        EXPECT_EQ(dst.data, expected.data);
+      }
+    });
+  }
+  for (auto &t : threads)
+    t.join();
+}
+
+TEST(VConverterTest, AcquiredConvertersAreReused)
+{
+  set_frame_converter_cache_size(VCONV_CACHE_SIZE);
+  SwsContext *a = acquire_frame_converter(64, 64, AV_PIX_FMT_RGBA, 64, 64, AV_PIX_FMT_NV12, SWS_POINT);
+  SwsContext *b = acquire_frame_converter(64, 64, AV_PIX_FMT_RGBA, 64, 64, AV_PIX_FMT_NV12, SWS_POINT);
+  ASSERT_NE(a, nullptr);
+  ASSERT_NE(b, nullptr);
+  EXPECT_NE(a, b);
+  release_frame_converter(b);
+  EXPECT_EQ(acquire_frame_converter(64, 64, AV_PIX_FMT_RGBA, 64, 64, AV_PIX_FMT_NV12, SWS_POINT), b);
+  // other flags, other converter
+  SwsContext *c = acquire_frame_converter(64, 64, AV_PIX_FMT_RGBA, 64, 64, AV_PIX_FMT_NV12, SWS_BICUBIC);
+  EXPECT_NE(c, a);
+  EXPECT_NE(c, b);
+  release_frame_converter(a);
+  release_frame_converter(b);
+  release_frame_converter(c);
+}
+
+// Shared converters are kept, whatever the cache size
+TEST(VConverterTest, SharedConvertersAreNotEvicted)
+{
+  SwsContext *shared = create_frame_converter(32, 32, AV_PIX_FMT_RGBA, 32, 32, AV_PIX_FMT_NV12);
+  ASSERT_NE(shared, nullptr);
+  EXPECT_EQ(create_frame_converter(32, 32, AV_PIX_FMT_RGBA, 32, 32, AV_PIX_FMT_NV12), shared);
+
+  set_frame_converter_cache_size(0);
+  for (int i = 0; i < 8; i++) {
+    SwsContext *ctx = acquire_frame_converter(32 + i * 2, 32, AV_PIX_FMT_RGBA, 32, 32, AV_PIX_FMT_NV12, SWS_POINT);
+    ASSERT_NE(ctx, nullptr);
+    release_frame_converter(ctx);
+  }
+  EXPECT_EQ(lookup_frame_converter(32, 32, AV_PIX_FMT_RGBA, 32, 32, AV_PIX_FMT_NV12), shared);
+  set_frame_converter_cache_size(VCONV_CACHE_SIZE);
+}